@@ -75,6 +75,9 @@ if(tensorflow_BUILD_CONTRIB_KERNELS)
       "${tensorflow_source_dir}/tensorflow/contrib/data/kernels/threadpool_dataset_op.cc"
       "${tensorflow_source_dir}/tensorflow/contrib/data/kernels/unique_dataset_op.cc"
       "${tensorflow_source_dir}/tensorflow/contrib/data/ops/dataset_ops.cc"
+      "${tensorflow_source_dir}/tensorflow/contrib/embedding_table/kernels/embedding_table.cc"
+      "${tensorflow_source_dir}/tensorflow/contrib/embedding_table/kernels/embedding_table_ops.cc"
+      "${tensorflow_source_dir}/tensorflow/contrib/embedding_table/ops/embedding_table_ops.cc"
       "${tensorflow_source_dir}/tensorflow/contrib/factorization/kernels/clustering_ops.cc"
       "${tensorflow_source_dir}/tensorflow/contrib/factorization/kernels/masked_matmul_ops.cc"
       "${tensorflow_source_dir}/tensorflow/contrib/factorization/kernels/wals_solver_ops.cc"
@@ -100,6 +103,8 @@ if(tensorflow_BUILD_CONTRIB_KERNELS)
       "${tensorflow_source_dir}/tensorflow/contrib/nccl/kernels/nccl_ops.cc"
       "${tensorflow_source_dir}/tensorflow/contrib/nccl/ops/nccl_ops.cc"
       "${tensorflow_source_dir}/tensorflow/contrib/nearest_neighbor/kernels/hyperplane_lsh_probes.cc"
+      "${tensorflow_source_dir}/tensorflow/contrib/nearest_neighbor/kernels/inner_product_search_ops.cc"
+      "${tensorflow_source_dir}/tensorflow/contrib/nearest_neighbor/kernels/ivf_index_ops.cc"
       "${tensorflow_source_dir}/tensorflow/contrib/nearest_neighbor/ops/nearest_neighbor_ops.cc"
       "${tensorflow_source_dir}/tensorflow/contrib/resampler/kernels/resampler_ops.cc"
       "${tensorflow_source_dir}/tensorflow/contrib/resampler/ops/resampler_ops.cc"
@@ -163,7 +168,12 @@ if(WIN32)
       # not working on windows yet
       "${tensorflow_source_dir}/tensorflow/core/kernels/neon/*"
       # not in core - those are loaded dynamically as dll
+      "${tensorflow_source_dir}/tensorflow/contrib/embedding_table/kernels/embedding_table.cc"
+      "${tensorflow_source_dir}/tensorflow/contrib/embedding_table/kernels/embedding_table_ops.cc"
+      "${tensorflow_source_dir}/tensorflow/contrib/embedding_table/ops/embedding_table_ops.cc"
       "${tensorflow_source_dir}/tensorflow/contrib/nearest_neighbor/kernels/hyperplane_lsh_probes.cc"
+      "${tensorflow_source_dir}/tensorflow/contrib/nearest_neighbor/kernels/inner_product_search_ops.cc"
+      "${tensorflow_source_dir}/tensorflow/contrib/nearest_neighbor/kernels/ivf_index_ops.cc"
       "${tensorflow_source_dir}/tensorflow/contrib/nearest_neighbor/ops/nearest_neighbor_ops.cc"
       "${tensorflow_source_dir}/tensorflow/contrib/resampler/kernels/resampler_ops.cc"
       "${tensorflow_source_dir}/tensorflow/contrib/rnn/kernels/blas_gemm.cc"
@@ -398,6 +398,8 @@ GENERATE_PYTHON_OP_LIB("contrib_nccl_ops"
 GENERATE_PYTHON_OP_LIB("contrib_periodic_resample_ops"
   DESTINATION ${CMAKE_CURRENT_BINARY_DIR}/tf_python/tensorflow/contrib/periodic_resample/python/ops/gen_periodic_resample_op.py)
 
+GENERATE_PYTHON_OP_LIB("contrib_embedding_table_ops"
+  DESTINATION ${CMAKE_CURRENT_BINARY_DIR}/tf_python/tensorflow/contrib/embedding_table/ops/gen_embedding_table_ops.py)
 GENERATE_PYTHON_OP_LIB("contrib_nearest_neighbor_ops"
   DESTINATION ${CMAKE_CURRENT_BINARY_DIR}/tf_python/tensorflow/contrib/nearest_neighbor/ops/gen_nearest_neighbor_ops.py)
 GENERATE_PYTHON_OP_LIB("contrib_resampler_ops"
@@ -634,6 +636,10 @@ if(WIN32)
         "${tensorflow_source_dir}/tensorflow/contrib/nearest_neighbor/kernels/heap.h"
         "${tensorflow_source_dir}/tensorflow/contrib/nearest_neighbor/kernels/hyperplane_lsh_probes.h"
         "${tensorflow_source_dir}/tensorflow/contrib/nearest_neighbor/kernels/hyperplane_lsh_probes.cc"
+        "${tensorflow_source_dir}/tensorflow/contrib/nearest_neighbor/kernels/inner_product_search.h"
+        "${tensorflow_source_dir}/tensorflow/contrib/nearest_neighbor/kernels/inner_product_search_ops.cc"
+        "${tensorflow_source_dir}/tensorflow/contrib/nearest_neighbor/kernels/ivf_index.h"
+        "${tensorflow_source_dir}/tensorflow/contrib/nearest_neighbor/kernels/ivf_index_ops.cc"
         "${tensorflow_source_dir}/tensorflow/contrib/nearest_neighbor/ops/nearest_neighbor_ops.cc"
     )
 
@@ -641,6 +647,20 @@ if(WIN32)
         SOURCES "${tf_nearest_neighbor_srcs}"
         DEPENDS pywrap_tensorflow_internal tf_python_ops
         DISTCOPY ${CMAKE_CURRENT_BINARY_DIR}/tf_python/tensorflow/contrib/nearest_neighbor/python/ops/)
+
+    # include contrib/embedding_table as .so
+    #
+    set(tf_embedding_table_srcs
+        "${tensorflow_source_dir}/tensorflow/contrib/embedding_table/kernels/embedding_table.h"
+        "${tensorflow_source_dir}/tensorflow/contrib/embedding_table/kernels/embedding_table.cc"
+        "${tensorflow_source_dir}/tensorflow/contrib/embedding_table/kernels/embedding_table_ops.cc"
+        "${tensorflow_source_dir}/tensorflow/contrib/embedding_table/ops/embedding_table_ops.cc"
+    )
+
+    AddUserOps(TARGET _embedding_table_ops
+        SOURCES "${tf_embedding_table_srcs}"
+        DEPENDS pywrap_tensorflow_internal tf_python_ops
+        DISTCOPY ${CMAKE_CURRENT_BINARY_DIR}/tf_python/tensorflow/contrib/embedding_table/python/ops/)
 endif(WIN32)
 
 if(WIN32)
@@ -155,6 +155,7 @@ if (tensorflow_BUILD_PYTHON_TESTS)
     "${tensorflow_source_dir}/tensorflow/python/training/*_test.py"
     "${tensorflow_source_dir}/tensorflow/contrib/coder/*_test.py"
     "${tensorflow_source_dir}/tensorflow/contrib/data/*_test.py"
+    "${tensorflow_source_dir}/tensorflow/contrib/embedding_table/python/kernel_tests/*_test.py"
     "${tensorflow_source_dir}/tensorflow/contrib/factorization/*_test.py"
     "${tensorflow_source_dir}/tensorflow/contrib/feature_column/python/feature_column/*_test.py"
     "${tensorflow_source_dir}/tensorflow/contrib/image/*_test.py"
@@ -379,6 +380,7 @@ if (tensorflow_BUILD_CC_TESTS)
     "${tensorflow_source_dir}/tensorflow/python/*_test.cc"
     "${tensorflow_source_dir}/tensorflow/core/*_test.cc"
     "${tensorflow_source_dir}/tensorflow/user_ops/*_test.cc"
+    "${tensorflow_source_dir}/tensorflow/contrib/embedding_table/*_test.cc"
     "${tensorflow_source_dir}/tensorflow/contrib/nearest_neighbor/*_test.cc"
     "${tensorflow_source_dir}/tensorflow/contrib/rnn/*_test.cc"
   )
@@ -0,0 +1,40 @@
+# Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Embedding tables held and updated on parameter servers.
+
+## Embedding tables
+
+An embedding table resource keeps a row of embeddings and the optimizer slots
+for every int64 id it has seen, grows as unseen ids arrive, and applies sparse
+optimizer updates to its rows in place, with checkpointing support.
+
+@@embedding_table
+@@embedding_table_lookup
+@@embedding_table_apply_sgd
+@@embedding_table_apply_adagrad
+@@embedding_table_apply_adam
+@@embedding_table_apply_ftrl
+@@embedding_table_size
+@@PartitionedEmbeddingTable
+
+"""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+# pylint: disable=unused-import,wildcard-import, line-too-long
+from tensorflow.contrib.embedding_table.python.ops.embedding_table_ops import *
+# pylint: enable=unused-import,wildcard-import,line-too-long
@@ -0,0 +1,250 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/contrib/embedding_table/kernels/embedding_table.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/random_distributions.h"
+
+namespace tensorflow {
+namespace embedding_table {
+
+namespace {
+// Mixes the bits of an id, so that consecutive ids spread over the shards
+// and row locks.
+uint64 MixId(int64 id) {
+  uint64 h = static_cast<uint64>(id);
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+}  // namespace
+
+Status ParseOptimizer(const string& name, Optimizer* optimizer) {
+  if (name == "sgd") {
+    *optimizer = Optimizer::kSgd;
+  } else if (name == "adagrad") {
+    *optimizer = Optimizer::kAdagrad;
+  } else if (name == "adam") {
+    *optimizer = Optimizer::kAdam;
+  } else if (name == "ftrl") {
+    *optimizer = Optimizer::kFtrl;
+  } else {
+    return errors::InvalidArgument("Unknown optimizer: ", name);
+  }
+  return Status::OK();
+}
+
+int NumSlots(Optimizer optimizer) {
+  switch (optimizer) {
+    case Optimizer::kSgd:
+      return 0;
+    case Optimizer::kAdagrad:
+      return 1;
+    case Optimizer::kAdam:
+    case Optimizer::kFtrl:
+      return 2;
+  }
+  return 0;
+}
+
+EmbeddingTable::EmbeddingTable(const Options& options)
+    : options_(options),
+      num_slots_(NumSlots(options.optimizer)),
+      row_floats_(options.dim * (1 + num_slots_)) {}
+
+int64 EmbeddingTable::size() const {
+  int64 size = 0;
+  for (const Shard& s : shards_) {
+    tf_shared_lock l(s.mu);
+    size += s.rows.size();
+  }
+  return size;
+}
+
+EmbeddingTable::Shard* EmbeddingTable::shard(int64 id) {
+  return &shards_[MixId(id) % kNumShards];
+}
+
+mutex* EmbeddingTable::row_lock(int64 id) {
+  return &row_locks_[(MixId(id) >> 32) % kNumRowLocks];
+}
+
+float* EmbeddingTable::FindRow(int64 id, bool insert) {
+  Shard* s = shard(id);
+  {
+    tf_shared_lock l(s->mu);
+    auto it = s->rows.find(id);
+    if (it != s->rows.end()) return it->second;
+  }
+  if (!insert) return nullptr;
+  mutex_lock l(s->mu);
+  auto it = s->rows.find(id);
+  if (it != s->rows.end()) return it->second;
+  float* row = AddRowLocked(s, id);
+  InitializeRow(id, row);
+  return row;
+}
+
+float* EmbeddingTable::AddRowLocked(Shard* s, int64 id) {
+  if (s->num_free == 0) {
+    s->chunks.emplace_back(new float[kRowsPerChunk * row_floats_]);
+    s->num_free = kRowsPerChunk;
+  }
+  float* row =
+      s->chunks.back().get() + (kRowsPerChunk - s->num_free) * row_floats_;
+  --s->num_free;
+  s->rows[id] = row;
+  return row;
+}
+
+void EmbeddingTable::InitializeRow(int64 id, float* row) const {
+  const int64 dim = options_.dim;
+  if (options_.init_stddev == 0.0f) {
+    std::fill_n(row, dim, 0.0f);
+  } else {
+    random::PhiloxRandom gen(static_cast<uint64>(options_.seed),
+                             static_cast<uint64>(id));
+    typedef random::NormalDistribution<random::PhiloxRandom, float> Normal;
+    Normal normal;
+    int64 i = 0;
+    while (i < dim) {
+      const Normal::ResultType samples = normal(&gen);
+      for (int j = 0; j < Normal::kResultElementCount && i < dim; ++j) {
+        if (std::fabs(samples[j]) < 2.0f) {
+          row[i++] = samples[j] * options_.init_stddev;
+        }
+      }
+    }
+  }
+  const bool accumulates = options_.optimizer == Optimizer::kAdagrad ||
+                           options_.optimizer == Optimizer::kFtrl;
+  // The first slot of Adagrad and FTRL is the accumulator.
+  std::fill_n(row + dim, dim * num_slots_, 0.0f);
+  if (accumulates) {
+    std::fill_n(row + dim, dim, options_.initial_accumulator_value);
+  }
+}
+
+void EmbeddingTable::Lookup(int64 id, bool insert_missing, float* out) {
+  float* row = FindRow(id, insert_missing);
+  if (row == nullptr) {
+    std::unique_ptr<float[]> initial(new float[row_floats_]);
+    InitializeRow(id, initial.get());
+    std::copy_n(initial.get(), options_.dim, out);
+    return;
+  }
+  mutex_lock l(*row_lock(id));
+  std::copy_n(row, options_.dim, out);
+}
+
+void EmbeddingTable::ApplySgd(int64 id, const float* grad, float lr) {
+  float* var = FindRow(id, true);
+  mutex_lock l(*row_lock(id));
+  for (int64 i = 0; i < options_.dim; ++i) {
+    var[i] -= lr * grad[i];
+  }
+}
+
+void EmbeddingTable::ApplyAdagrad(int64 id, const float* grad, float lr) {
+  float* var = FindRow(id, true);
+  float* accum = var + options_.dim;
+  mutex_lock l(*row_lock(id));
+  for (int64 i = 0; i < options_.dim; ++i) {
+    accum[i] += grad[i] * grad[i];
+    var[i] -= lr * grad[i] / std::sqrt(accum[i]);
+  }
+}
+
+void EmbeddingTable::ApplyAdam(int64 id, const float* grad, float lr,
+                               float beta1, float beta2, float epsilon,
+                               float beta1_power, float beta2_power) {
+  float* var = FindRow(id, true);
+  float* m = var + options_.dim;
+  float* v = m + options_.dim;
+  const float alpha = lr * std::sqrt(1 - beta2_power) / (1 - beta1_power);
+  mutex_lock l(*row_lock(id));
+  for (int64 i = 0; i < options_.dim; ++i) {
+    m[i] += (grad[i] - m[i]) * (1 - beta1);
+    v[i] += (grad[i] * grad[i] - v[i]) * (1 - beta2);
+    var[i] -= (m[i] * alpha) / (std::sqrt(v[i]) + epsilon);
+  }
+}
+
+void EmbeddingTable::ApplyFtrl(int64 id, const float* grad, float lr,
+                               float l1, float l2, float lr_power) {
+  float* var = FindRow(id, true);
+  float* accum = var + options_.dim;
+  float* linear = accum + options_.dim;
+  mutex_lock l(*row_lock(id));
+  for (int64 i = 0; i < options_.dim; ++i) {
+    const float new_accum = accum[i] + grad[i] * grad[i];
+    const float new_accum_power = std::pow(new_accum, -lr_power);
+    linear[i] +=
+        grad[i] - (new_accum_power - std::pow(accum[i], -lr_power)) / lr *
+                      var[i];
+    const float quadratic = new_accum_power / lr + 2 * l2;
+    if (std::fabs(linear[i]) > l1) {
+      var[i] = (std::copysign(l1, linear[i]) - linear[i]) / quadratic;
+    } else {
+      var[i] = 0;
+    }
+    accum[i] = new_accum;
+  }
+}
+
+void EmbeddingTable::Export(std::vector<int64>* ids,
+                            std::vector<float>* values,
+                            std::vector<float>* slots) {
+  const int64 dim = options_.dim;
+  for (Shard& s : shards_) {
+    tf_shared_lock l(s.mu);
+    for (const auto& it : s.rows) {
+      mutex_lock row_l(*row_lock(it.first));
+      ids->push_back(it.first);
+      values->insert(values->end(), it.second, it.second + dim);
+      slots->insert(slots->end(), it.second + dim, it.second + row_floats_);
+    }
+  }
+}
+
+void EmbeddingTable::Import(const int64* ids, const float* values,
+                            const float* slots, int64 n) {
+  for (Shard& s : shards_) {
+    mutex_lock l(s.mu);
+    s.rows.clear();
+    s.chunks.clear();
+    s.num_free = 0;
+  }
+  const int64 dim = options_.dim;
+  const int64 slot_floats = dim * num_slots_;
+  for (int64 i = 0; i < n; ++i) {
+    Shard* s = shard(ids[i]);
+    mutex_lock l(s->mu);
+    float* row = AddRowLocked(s, ids[i]);
+    std::copy_n(values + i * dim, dim, row);
+    std::copy_n(slots + i * slot_floats, slot_floats, row + dim);
+  }
+}
+
+}  // namespace embedding_table
+}  // namespace tensorflow
@@ -0,0 +1,147 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CONTRIB_EMBEDDING_TABLE_KERNELS_EMBEDDING_TABLE_H_
+#define TENSORFLOW_CONTRIB_EMBEDDING_TABLE_KERNELS_EMBEDDING_TABLE_H_
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace embedding_table {
+
+// The optimizer whose state is kept with every row of a table.
+enum class Optimizer { kSgd, kAdagrad, kAdam, kFtrl };
+
+// Parses "sgd", "adagrad", "adam" or "ftrl".
+Status ParseOptimizer(const string& name, Optimizer* optimizer);
+
+// Returns the number of slot vectors the optimizer keeps per row.
+int NumSlots(Optimizer optimizer);
+
+// A table of float embeddings of a fixed dimension keyed by int64 ids,
+// which grows as unseen ids are looked up or updated, and applies sparse
+// optimizer updates in place.
+//
+// The ids are hashed into shards, each a hash map from ids to rows guarded
+// by its own mutex, which is only held exclusively to insert a row.  Rows
+// are never moved or removed, except by Import(), so their memory is used
+// without holding the shard mutex.  The values and optimizer slots of a
+// row are read and updated under one of a fixed set of striped row locks,
+// so updates to different rows proceed in parallel and every row is
+// updated atomically, even if an id occurs more than once in a batch.
+//
+// A new row starts out with slots holding the initial accumulator value
+// for Adagrad and FTRL, or zeros otherwise, and with values drawn from a
+// normal distribution with standard deviation init_stddev truncated at
+// two standard deviations.  The draw is seeded with the seed of the table
+// and the id, so it does not depend on the order in which ids are seen or
+// on how ids are partitioned over tables.
+//
+// Thread safe, except for Import().
+class EmbeddingTable {
+ public:
+  struct Options {
+    int64 dim = 1;
+    Optimizer optimizer = Optimizer::kSgd;
+    float initial_accumulator_value = 0.1f;
+    float init_stddev = 0.0f;
+    int64 seed = 0;
+  };
+
+  explicit EmbeddingTable(const Options& options);
+
+  int64 dim() const { return options_.dim; }
+  Optimizer optimizer() const { return options_.optimizer; }
+  int num_slots() const { return num_slots_; }
+
+  // Returns the number of rows.
+  int64 size() const;
+
+  // Copies the values of the row of 'id' into the dim() floats at 'out'.
+  // Inserts a row for an unseen id if 'insert_missing', otherwise copies
+  // the values the row would start out with.
+  void Lookup(int64 id, bool insert_missing, float* out);
+
+  // Apply the gradient 'grad' of dim() floats to the row of 'id',
+  // inserting it if needed, with the update of the corresponding
+  // training_ops (ApplyGradientDescent, ApplyAdagrad, ApplyAdam with the
+  // given powers of the betas, and ApplyFtrl).
+  void ApplySgd(int64 id, const float* grad, float lr);
+  void ApplyAdagrad(int64 id, const float* grad, float lr);
+  void ApplyAdam(int64 id, const float* grad, float lr, float beta1,
+                 float beta2, float epsilon, float beta1_power,
+                 float beta2_power);
+  void ApplyFtrl(int64 id, const float* grad, float lr, float l1, float l2,
+                 float lr_power);
+
+  // Appends the ids of all rows to *ids, their values to *values and their
+  // slots to *slots, row by row.
+  void Export(std::vector<int64>* ids, std::vector<float>* values,
+              std::vector<float>* slots);
+
+  // Replaces the content of the table with 'n' rows in the layout of
+  // Export().  The ids must be distinct.  Must not run concurrently with
+  // any other method, which may hold on to rows that this frees.
+  void Import(const int64* ids, const float* values, const float* slots,
+              int64 n);
+
+ private:
+  static const int kNumShards = 16;
+  static const int kNumRowLocks = 1024;
+  static const int64 kRowsPerChunk = 256;
+
+  // A hash map from ids to rows, whose memory comes from chunks of
+  // kRowsPerChunk rows.
+  struct Shard {
+    mutable mutex mu;
+    std::unordered_map<int64, float*> rows GUARDED_BY(mu);
+    std::vector<std::unique_ptr<float[]>> chunks GUARDED_BY(mu);
+    int64 num_free GUARDED_BY(mu) = 0;  // Rows left in the last chunk.
+  };
+
+  Shard* shard(int64 id);
+  mutex* row_lock(int64 id);
+
+  // Returns the row of 'id', i.e. its values followed by its slots, or
+  // nullptr if it is unseen and not 'insert'.
+  float* FindRow(int64 id, bool insert);
+  // Adds an uninitialized row for 'id' to 'shard'.
+  float* AddRowLocked(Shard* shard, int64 id)
+      EXCLUSIVE_LOCKS_REQUIRED(shard->mu);
+  // Sets the row_floats_ floats at 'row' to the initial row of 'id'.
+  void InitializeRow(int64 id, float* row) const;
+
+  const Options options_;
+  const int num_slots_;
+  const int64 row_floats_;  // dim * (1 + num_slots)
+
+  Shard shards_[kNumShards];
+  mutex row_locks_[kNumRowLocks];
+
+  TF_DISALLOW_COPY_AND_ASSIGN(EmbeddingTable);
+};
+
+}  // namespace embedding_table
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CONTRIB_EMBEDDING_TABLE_KERNELS_EMBEDDING_TABLE_H_
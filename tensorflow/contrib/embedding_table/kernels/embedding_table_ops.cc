@@ -0,0 +1,389 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include "tensorflow/contrib/embedding_table/kernels/embedding_table.h"
+
+namespace tensorflow {
+
+using errors::InvalidArgument;
+
+using embedding_table::EmbeddingTable;
+using embedding_table::Optimizer;
+
+// Wraps an EmbeddingTable in a resource. Lookups and updates hold the mutex
+// in shared mode, so they run in parallel, while an import is exclusive.
+class EmbeddingTableResource : public ResourceBase {
+ public:
+  explicit EmbeddingTableResource(const EmbeddingTable::Options& options)
+      : table_(options) {}
+
+  string DebugString() override {
+    return strings::StrCat("EmbeddingTable(dim=", table_.dim(),
+                           ", size=", table_.size(), ")");
+  }
+
+  int64 MemoryUsed() const override {
+    return table_.size() * table_.dim() * (1 + table_.num_slots()) *
+           sizeof(float);
+  }
+
+  mutex* get_mutex() { return &mu_; }
+  EmbeddingTable* table() { return &table_; }
+
+ private:
+  mutex mu_;
+  EmbeddingTable table_;
+};
+
+namespace {
+
+// Runs fn(i) for i in [0, n) over the intra-op thread pool.
+void ParallelForIds(OpKernelContext* context, int64 n, int64 cost_per_id,
+                    const std::function<void(int64)>& fn) {
+  auto* worker_threads = context->device()->tensorflow_cpu_worker_threads();
+  Shard(worker_threads->num_threads, worker_threads->workers, n, cost_per_id,
+        [&fn](int64 start, int64 end) {
+          for (int64 i = start; i < end; ++i) fn(i);
+        });
+}
+
+Status CheckIds(const Tensor& ids) {
+  if (!TensorShapeUtils::IsVector(ids.shape())) {
+    return InvalidArgument("Need a one-dimensional ids tensor, got ",
+                           ids.dims(), " dimensions.");
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+class CreateEmbeddingTableOp : public OpKernel {
+ public:
+  explicit CreateEmbeddingTableOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("dim", &options_.dim));
+    string optimizer;
+    OP_REQUIRES_OK(context, context->GetAttr("optimizer", &optimizer));
+    OP_REQUIRES_OK(context, embedding_table::ParseOptimizer(
+                                optimizer, &options_.optimizer));
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("initial_accumulator_value",
+                                    &options_.initial_accumulator_value));
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("init_stddev", &options_.init_stddev));
+    OP_REQUIRES_OK(context, context->GetAttr("seed", &options_.seed));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    auto* result = new EmbeddingTableResource(options_);
+    // Only create one, if one does not exist already. Report status for all
+    // other exceptions.
+    auto status = CreateResource(context, HandleFromInput(context, 0), result);
+    if (!status.ok() && status.code() != tensorflow::error::ALREADY_EXISTS) {
+      OP_REQUIRES(context, false, status);
+    }
+  }
+
+ private:
+  EmbeddingTable::Options options_;
+};
+
+class EmbeddingTableLookupOp : public OpKernel {
+ public:
+  explicit EmbeddingTableLookupOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("insert_missing", &insert_missing_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    EmbeddingTableResource* resource;
+    OP_REQUIRES_OK(context,
+                   LookupResource(context, HandleFromInput(context, 0),
+                                  &resource));
+    core::ScopedUnref unref_me(resource);
+    tf_shared_lock l(*resource->get_mutex());
+    EmbeddingTable* table = resource->table();
+
+    const Tensor& ids = context->input(1);
+    OP_REQUIRES_OK(context, CheckIds(ids));
+    const int64 num_ids = ids.dim_size(0);
+    const int64 dim = table->dim();
+    Tensor* values_tensor = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, TensorShape({num_ids, dim}),
+                                            &values_tensor));
+    auto ids_vec = ids.vec<int64>();
+    float* values = values_tensor->matrix<float>().data();
+    const bool insert_missing = insert_missing_;
+    ParallelForIds(context, num_ids, 10 * dim, [&](int64 i) {
+      table->Lookup(ids_vec(i), insert_missing, values + i * dim);
+    });
+  }
+
+ private:
+  bool insert_missing_;
+};
+
+// Base class of the ops that apply gradients to the rows of a table, which
+// implement ApplyRow() for the given optimizer.
+class EmbeddingTableApplyOp : public OpKernel {
+ public:
+  EmbeddingTableApplyOp(OpKernelConstruction* context, Optimizer optimizer,
+                        int num_hyperparameters)
+      : OpKernel(context),
+        optimizer_(optimizer),
+        num_hyperparameters_(num_hyperparameters) {}
+
+  void Compute(OpKernelContext* context) override {
+    EmbeddingTableResource* resource;
+    OP_REQUIRES_OK(context,
+                   LookupResource(context, HandleFromInput(context, 0),
+                                  &resource));
+    core::ScopedUnref unref_me(resource);
+    tf_shared_lock l(*resource->get_mutex());
+    EmbeddingTable* table = resource->table();
+    OP_REQUIRES(context, table->optimizer() == optimizer_,
+                InvalidArgument(name(), " cannot update a table created for "
+                                        "another optimizer."));
+
+    const Tensor& ids = context->input(1);
+    const Tensor& grad = context->input(2);
+    OP_REQUIRES_OK(context, CheckIds(ids));
+    OP_REQUIRES(context, TensorShapeUtils::IsMatrix(grad.shape()),
+                InvalidArgument("Need a two-dimensional grad tensor, got ",
+                                grad.dims(), " dimensions."));
+    OP_REQUIRES(context, grad.dim_size(0) == ids.dim_size(0),
+                InvalidArgument("Got ", ids.dim_size(0), " ids for ",
+                                grad.dim_size(0), " gradients."));
+    OP_REQUIRES(context, grad.dim_size(1) == table->dim(),
+                InvalidArgument("The table has dimension ", table->dim(),
+                                " but the gradients have dimension ",
+                                grad.dim_size(1), "."));
+    std::vector<float> hyperparameters;
+    for (int i = 0; i < num_hyperparameters_; ++i) {
+      const Tensor& t = context->input(3 + i);
+      OP_REQUIRES(context, TensorShapeUtils::IsScalar(t.shape()),
+                  InvalidArgument("Hyperparameter ", i, " is not a scalar: ",
+                                  t.shape().DebugString()));
+      hyperparameters.push_back(t.scalar<float>()());
+    }
+
+    const int64 dim = table->dim();
+    auto ids_vec = ids.vec<int64>();
+    const float* grads = grad.matrix<float>().data();
+    const float* h = hyperparameters.data();
+    ParallelForIds(context, ids.dim_size(0), 20 * dim, [&](int64 i) {
+      ApplyRow(table, ids_vec(i), grads + i * dim, h);
+    });
+  }
+
+ protected:
+  // Applies 'grad' to the row of 'id' with the hyperparameters 'h', in the
+  // order of the inputs of the op.
+  virtual void ApplyRow(EmbeddingTable* table, int64 id, const float* grad,
+                        const float* h) = 0;
+
+ private:
+  const Optimizer optimizer_;
+  const int num_hyperparameters_;
+};
+
+class EmbeddingTableApplySgdOp : public EmbeddingTableApplyOp {
+ public:
+  explicit EmbeddingTableApplySgdOp(OpKernelConstruction* context)
+      : EmbeddingTableApplyOp(context, Optimizer::kSgd, 1) {}
+
+ protected:
+  void ApplyRow(EmbeddingTable* table, int64 id, const float* grad,
+                const float* h) override {
+    table->ApplySgd(id, grad, h[0]);
+  }
+};
+
+class EmbeddingTableApplyAdagradOp : public EmbeddingTableApplyOp {
+ public:
+  explicit EmbeddingTableApplyAdagradOp(OpKernelConstruction* context)
+      : EmbeddingTableApplyOp(context, Optimizer::kAdagrad, 1) {}
+
+ protected:
+  void ApplyRow(EmbeddingTable* table, int64 id, const float* grad,
+                const float* h) override {
+    table->ApplyAdagrad(id, grad, h[0]);
+  }
+};
+
+class EmbeddingTableApplyAdamOp : public EmbeddingTableApplyOp {
+ public:
+  explicit EmbeddingTableApplyAdamOp(OpKernelConstruction* context)
+      : EmbeddingTableApplyOp(context, Optimizer::kAdam, 6) {}
+
+ protected:
+  void ApplyRow(EmbeddingTable* table, int64 id, const float* grad,
+                const float* h) override {
+    table->ApplyAdam(id, grad, h[0], h[1], h[2], h[3], h[4], h[5]);
+  }
+};
+
+class EmbeddingTableApplyFtrlOp : public EmbeddingTableApplyOp {
+ public:
+  explicit EmbeddingTableApplyFtrlOp(OpKernelConstruction* context)
+      : EmbeddingTableApplyOp(context, Optimizer::kFtrl, 4) {}
+
+ protected:
+  void ApplyRow(EmbeddingTable* table, int64 id, const float* grad,
+                const float* h) override {
+    table->ApplyFtrl(id, grad, h[0], h[1], h[2], h[3]);
+  }
+};
+
+class EmbeddingTableSizeOp : public OpKernel {
+ public:
+  explicit EmbeddingTableSizeOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    EmbeddingTableResource* resource;
+    OP_REQUIRES_OK(context,
+                   LookupResource(context, HandleFromInput(context, 0),
+                                  &resource));
+    core::ScopedUnref unref_me(resource);
+    tf_shared_lock l(*resource->get_mutex());
+    Tensor* size_tensor = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, TensorShape(), &size_tensor));
+    size_tensor->scalar<int64>()() = resource->table()->size();
+  }
+};
+
+// Op for exporting a table, e.g. to save it in a checkpoint.
+class EmbeddingTableExportOp : public OpKernel {
+ public:
+  explicit EmbeddingTableExportOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    EmbeddingTableResource* resource;
+    OP_REQUIRES_OK(context,
+                   LookupResource(context, HandleFromInput(context, 0),
+                                  &resource));
+    core::ScopedUnref unref_me(resource);
+    tf_shared_lock l(*resource->get_mutex());
+    EmbeddingTable* table = resource->table();
+
+    std::vector<int64> ids;
+    std::vector<float> values;
+    std::vector<float> slots;
+    table->Export(&ids, &values, &slots);
+    const int64 size = ids.size();
+    Tensor* ids_tensor = nullptr;
+    Tensor* values_tensor = nullptr;
+    Tensor* slots_tensor = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, TensorShape({size}),
+                                                     &ids_tensor));
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       1, TensorShape({size, table->dim()}), &values_tensor));
+    OP_REQUIRES_OK(
+        context,
+        context->allocate_output(
+            2, TensorShape({size, table->num_slots(), table->dim()}),
+            &slots_tensor));
+    std::copy(ids.begin(), ids.end(), ids_tensor->vec<int64>().data());
+    std::copy(values.begin(), values.end(),
+              values_tensor->matrix<float>().data());
+    std::copy(slots.begin(), slots.end(),
+              slots_tensor->tensor<float, 3>().data());
+  }
+};
+
+// Op for importing a table, e.g. when restoring it from a checkpoint.
+class EmbeddingTableImportOp : public OpKernel {
+ public:
+  explicit EmbeddingTableImportOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    EmbeddingTableResource* resource;
+    OP_REQUIRES_OK(context,
+                   LookupResource(context, HandleFromInput(context, 0),
+                                  &resource));
+    core::ScopedUnref unref_me(resource);
+    mutex_lock l(*resource->get_mutex());
+    EmbeddingTable* table = resource->table();
+
+    const Tensor& ids = context->input(1);
+    const Tensor& values = context->input(2);
+    const Tensor& slots = context->input(3);
+    OP_REQUIRES_OK(context, CheckIds(ids));
+    const int64 size = ids.dim_size(0);
+    const TensorShape values_shape({size, table->dim()});
+    const TensorShape slots_shape({size, table->num_slots(), table->dim()});
+    OP_REQUIRES(context, values.shape() == values_shape,
+                InvalidArgument("Expected values of shape ",
+                                values_shape.DebugString(), ", got ",
+                                values.shape().DebugString(), "."));
+    OP_REQUIRES(context, slots.shape() == slots_shape,
+                InvalidArgument("Expected slots of shape ",
+                                slots_shape.DebugString(), ", got ",
+                                slots.shape().DebugString(), "."));
+    table->Import(ids.vec<int64>().data(), values.matrix<float>().data(),
+                  slots.tensor<float, 3>().data(), size);
+  }
+};
+
+REGISTER_RESOURCE_HANDLE_KERNEL(EmbeddingTableResource);
+
+REGISTER_KERNEL_BUILDER(Name("EmbeddingTableIsInitialized").Device(DEVICE_CPU),
+                        IsResourceInitialized<EmbeddingTableResource>);
+
+REGISTER_KERNEL_BUILDER(Name("CreateEmbeddingTable").Device(DEVICE_CPU),
+                        CreateEmbeddingTableOp);
+
+REGISTER_KERNEL_BUILDER(Name("EmbeddingTableLookup").Device(DEVICE_CPU),
+                        EmbeddingTableLookupOp);
+
+REGISTER_KERNEL_BUILDER(Name("EmbeddingTableApplySgd").Device(DEVICE_CPU),
+                        EmbeddingTableApplySgdOp);
+
+REGISTER_KERNEL_BUILDER(Name("EmbeddingTableApplyAdagrad").Device(DEVICE_CPU),
+                        EmbeddingTableApplyAdagradOp);
+
+REGISTER_KERNEL_BUILDER(Name("EmbeddingTableApplyAdam").Device(DEVICE_CPU),
+                        EmbeddingTableApplyAdamOp);
+
+REGISTER_KERNEL_BUILDER(Name("EmbeddingTableApplyFtrl").Device(DEVICE_CPU),
+                        EmbeddingTableApplyFtrlOp);
+
+REGISTER_KERNEL_BUILDER(Name("EmbeddingTableSize").Device(DEVICE_CPU),
+                        EmbeddingTableSizeOp);
+
+REGISTER_KERNEL_BUILDER(Name("EmbeddingTableExport").Device(DEVICE_CPU),
+                        EmbeddingTableExportOp);
+
+REGISTER_KERNEL_BUILDER(Name("EmbeddingTableImport").Device(DEVICE_CPU),
+                        EmbeddingTableImportOp);
+
+}  // namespace tensorflow
@@ -0,0 +1,181 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/contrib/embedding_table/kernels/embedding_table.h"
+
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace embedding_table {
+namespace {
+
+TEST(EmbeddingTableTest, LookupGrowsTable) {
+  EmbeddingTable::Options options;
+  options.dim = 3;
+  EmbeddingTable table(options);
+  std::vector<float> out(3, 1.0f);
+  table.Lookup(7, /*insert_missing=*/false, out.data());
+  EXPECT_EQ(std::vector<float>({0, 0, 0}), out);
+  EXPECT_EQ(0, table.size());
+  for (int64 id = 0; id < 1000; ++id) table.Lookup(id, true, out.data());
+  table.Lookup(7, true, out.data());
+  EXPECT_EQ(1000, table.size());
+}
+
+TEST(EmbeddingTableTest, InitialValuesDependOnSeedAndIdOnly) {
+  EmbeddingTable::Options options;
+  options.dim = 64;
+  options.init_stddev = 0.5f;
+  options.seed = 3;
+  EmbeddingTable first(options);
+  EmbeddingTable second(options);
+  std::vector<float> a(64), b(64);
+  // Insert the ids in different orders.
+  for (int64 id = 0; id < 10; ++id) first.Lookup(id, true, a.data());
+  for (int64 id = 9; id >= 0; --id) second.Lookup(id, true, b.data());
+  first.Lookup(4, true, a.data());
+  second.Lookup(4, false, b.data());
+  EXPECT_EQ(a, b);
+  bool any_nonzero = false;
+  for (float x : a) {
+    EXPECT_LT(std::fabs(x), 1.0f);
+    any_nonzero |= x != 0;
+  }
+  EXPECT_TRUE(any_nonzero);
+  first.Lookup(5, true, b.data());
+  EXPECT_NE(a, b);
+}
+
+TEST(EmbeddingTableTest, Adagrad) {
+  EmbeddingTable::Options options;
+  options.dim = 2;
+  options.optimizer = Optimizer::kAdagrad;
+  options.initial_accumulator_value = 0.1f;
+  EmbeddingTable table(options);
+  const float grad[] = {1.0f, -2.0f};
+  table.ApplyAdagrad(5, grad, 0.5f);
+  table.ApplyAdagrad(5, grad, 0.5f);
+  float var[2] = {0, 0};
+  float accum[2] = {0.1f, 0.1f};
+  for (int step = 0; step < 2; ++step) {
+    for (int i = 0; i < 2; ++i) {
+      accum[i] += grad[i] * grad[i];
+      var[i] -= 0.5f * grad[i] / std::sqrt(accum[i]);
+    }
+  }
+  float out[2];
+  table.Lookup(5, false, out);
+  EXPECT_NEAR(var[0], out[0], 1e-6);
+  EXPECT_NEAR(var[1], out[1], 1e-6);
+}
+
+TEST(EmbeddingTableTest, Adam) {
+  EmbeddingTable::Options options;
+  options.dim = 1;
+  options.optimizer = Optimizer::kAdam;
+  EmbeddingTable table(options);
+  const float grad = 0.5f;
+  table.ApplyAdam(1, &grad, 0.1f, 0.9f, 0.999f, 1e-8f, 0.9f, 0.999f);
+  // After one step m = 0.05, v = 0.00025 and the bias corrections cancel
+  // them out to a step of lr * sign(grad).
+  float out;
+  table.Lookup(1, false, &out);
+  EXPECT_NEAR(-0.1f, out, 1e-5);
+}
+
+TEST(EmbeddingTableTest, Ftrl) {
+  EmbeddingTable::Options options;
+  options.dim = 1;
+  options.optimizer = Optimizer::kFtrl;
+  options.initial_accumulator_value = 1.0f;
+  EmbeddingTable table(options);
+  // With lr_power = -0.5: linear = 3, quadratic = sqrt(10) / lr.
+  const float grad = 3.0f;
+  table.ApplyFtrl(1, &grad, 1.0f, 1.0f, 0.0f, -0.5f);
+  float out;
+  table.Lookup(1, false, &out);
+  EXPECT_NEAR((1.0f - 3.0f) / std::sqrt(10.0f), out, 1e-6);
+  // Below the l1 threshold the weight is zero.
+  const float small_grad = 0.5f;
+  table.ApplyFtrl(2, &small_grad, 1.0f, 1.0f, 0.0f, -0.5f);
+  table.Lookup(2, false, &out);
+  EXPECT_EQ(0.0f, out);
+}
+
+TEST(EmbeddingTableTest, ConcurrentUpdatesOfOneRowAreAtomic) {
+  EmbeddingTable::Options options;
+  options.dim = 16;
+  EmbeddingTable table(options);
+  const std::vector<float> grad(16, -1.0f);
+  {
+    thread::ThreadPool pool(Env::Default(), "test", 8);
+    for (int i = 0; i < 8; ++i) {
+      pool.Schedule([&table, &grad]() {
+        for (int step = 0; step < 1000; ++step) {
+          table.ApplySgd(step % 4, grad.data(), 1.0f);
+        }
+      });
+    }
+  }
+  std::vector<float> out(16);
+  for (int64 id = 0; id < 4; ++id) {
+    table.Lookup(id, false, out.data());
+    EXPECT_EQ(std::vector<float>(16, 2000.0f), out);
+  }
+}
+
+TEST(EmbeddingTableTest, ExportImport) {
+  EmbeddingTable::Options options;
+  options.dim = 2;
+  options.optimizer = Optimizer::kAdagrad;
+  EmbeddingTable table(options);
+  const float grad[] = {1.0f, 2.0f};
+  for (int64 id = 0; id < 300; ++id) table.ApplyAdagrad(id * 7, grad, 0.1f);
+  std::vector<int64> ids;
+  std::vector<float> values, slots;
+  table.Export(&ids, &values, &slots);
+  ASSERT_EQ(300, ids.size());
+  EXPECT_EQ(600, values.size());
+  EXPECT_EQ(600, slots.size());
+
+  EmbeddingTable restored(options);
+  float out[2];
+  restored.Lookup(1, true, out);
+  restored.Import(ids.data(), values.data(), slots.data(), ids.size());
+  EXPECT_EQ(300, restored.size());
+  float expected[2];
+  for (int64 id = 0; id < 300; ++id) {
+    table.Lookup(id * 7, false, expected);
+    restored.Lookup(id * 7, false, out);
+    EXPECT_EQ(expected[0], out[0]);
+    EXPECT_EQ(expected[1], out[1]);
+  }
+  // The accumulators are restored too.
+  table.ApplyAdagrad(7, grad, 0.1f);
+  restored.ApplyAdagrad(7, grad, 0.1f);
+  table.Lookup(7, false, expected);
+  restored.Lookup(7, false, out);
+  EXPECT_EQ(expected[0], out[0]);
+  EXPECT_EQ(expected[1], out[1]);
+}
+
+}  // namespace
+}  // namespace embedding_table
+}  // namespace tensorflow
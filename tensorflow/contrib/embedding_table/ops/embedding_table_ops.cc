@@ -0,0 +1,291 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/common_shape_fns.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/shape_inference.h"
+
+namespace tensorflow {
+
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+namespace {
+
+// Checks the table handle, the ids and the gradient of an apply op, and
+// that its remaining inputs are scalars.
+Status ApplyShapeFn(InferenceContext* c) {
+  ShapeHandle unused;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+  ShapeHandle ids;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &ids));
+  ShapeHandle grad;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &grad));
+  DimensionHandle unused_dim;
+  TF_RETURN_IF_ERROR(c->Merge(c->Dim(ids, 0), c->Dim(grad, 0), &unused_dim));
+  for (int i = 3; i < c->num_inputs(); ++i) {
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(i), 0, &unused));
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+REGISTER_RESOURCE_HANDLE_OP(EmbeddingTableResource);
+
+REGISTER_OP("EmbeddingTableIsInitialized")
+    .Input("table_handle: resource")
+    .Output("is_initialized: bool")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused_input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused_input));
+      c->set_output(0, c->Scalar());
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Checks whether an embedding table has been created.
+)doc");
+
+REGISTER_OP("CreateEmbeddingTable")
+    .Input("table_handle: resource")
+    .Attr("dim: int >= 1")
+    .Attr("optimizer: {'sgd', 'adagrad', 'adam', 'ftrl'} = 'adagrad'")
+    .Attr("initial_accumulator_value: float = 0.1")
+    .Attr("init_stddev: float = 0.0")
+    .Attr("seed: int = 0")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused_input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused_input));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Creates an empty embedding table, which holds a row of `dim` floats and the
+optimizer slots for every id that has been looked up or updated.
+
+table_handle: Handle to the table resource to be created.
+dim: the dimension of the embeddings.
+optimizer: the optimizer whose slots the table keeps, and which is the only one
+  that may update it: `sgd` without slots, `adagrad` with an accumulator,
+  `adam` with the first and second moments, and `ftrl` with an accumulator
+  and a linear term.
+initial_accumulator_value: the initial value of the accumulators of `adagrad`
+  and `ftrl`.
+init_stddev: the standard deviation of the initial values of the embeddings,
+  which are drawn from a normal distribution truncated at two standard
+  deviations, or zero if `init_stddev` is zero.
+seed: the seed for the initial values, which are determined by `seed` and the
+  id alone.
+)doc");
+
+REGISTER_OP("EmbeddingTableLookup")
+    .Input("table_handle: resource")
+    .Input("ids: int64")
+    .Output("values: float")
+    .Attr("insert_missing: bool = true")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused_input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused_input));
+      ShapeHandle ids;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &ids));
+      c->set_output(0, c->Matrix(c->Dim(ids, 0), c->UnknownDim()));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Looks up the embeddings of a batch of ids in parallel.
+
+table_handle: Handle to the table.
+ids: the ids to look up, of shape `num_ids`.
+values: the embeddings, of shape `num_ids` times `dim`.
+insert_missing: whether to insert rows for unseen ids. Otherwise the initial
+  values of their rows are returned without growing the table.
+)doc");
+
+REGISTER_OP("EmbeddingTableApplySgd")
+    .Input("table_handle: resource")
+    .Input("ids: int64")
+    .Input("grad: float")
+    .Input("lr: float")
+    .SetShapeFn(ApplyShapeFn)
+    .Doc(R"doc(
+Updates the rows of `ids` by gradient descent, inserting unseen ids.
+
+var -= lr * grad
+
+Rows are updated in parallel, and each row is updated atomically, including
+for ids that occur more than once.
+
+table_handle: Handle to a table with optimizer `sgd`.
+ids: the ids of the rows to update, of shape `num_ids`.
+grad: the gradients, of shape `num_ids` times `dim`.
+lr: Scaling factor. Must be a scalar.
+)doc");
+
+REGISTER_OP("EmbeddingTableApplyAdagrad")
+    .Input("table_handle: resource")
+    .Input("ids: int64")
+    .Input("grad: float")
+    .Input("lr: float")
+    .SetShapeFn(ApplyShapeFn)
+    .Doc(R"doc(
+Updates the rows of `ids` and their accumulators by Adagrad, inserting unseen
+ids.
+
+accum += grad * grad
+var -= lr * grad * (1 / sqrt(accum))
+
+Rows are updated in parallel, and each row is updated atomically, including
+for ids that occur more than once.
+
+table_handle: Handle to a table with optimizer `adagrad`.
+ids: the ids of the rows to update, of shape `num_ids`.
+grad: the gradients, of shape `num_ids` times `dim`.
+lr: Scaling factor. Must be a scalar.
+)doc");
+
+REGISTER_OP("EmbeddingTableApplyAdam")
+    .Input("table_handle: resource")
+    .Input("ids: int64")
+    .Input("grad: float")
+    .Input("lr: float")
+    .Input("beta1: float")
+    .Input("beta2: float")
+    .Input("epsilon: float")
+    .Input("beta1_power: float")
+    .Input("beta2_power: float")
+    .SetShapeFn(ApplyShapeFn)
+    .Doc(R"doc(
+Updates the rows of `ids` and their moments by Adam, inserting unseen ids.
+
+Only the moments of the rows of `ids` decay, as in `LazyAdamOptimizer`.
+
+lr_t <- lr * sqrt(1 - beta2_power) / (1 - beta1_power)
+m_t <- beta1 * m_{t-1} + (1 - beta1) * grad
+v_t <- beta2 * v_{t-1} + (1 - beta2) * grad * grad
+var <- var - lr_t * m_t / (sqrt(v_t) + epsilon)
+
+Rows are updated in parallel, and each row is updated atomically, including
+for ids that occur more than once.
+
+table_handle: Handle to a table with optimizer `adam`.
+ids: the ids of the rows to update, of shape `num_ids`.
+grad: the gradients, of shape `num_ids` times `dim`.
+lr: Scaling factor. Must be a scalar.
+beta1: Momentum factor. Must be a scalar.
+beta2: Momentum factor. Must be a scalar.
+epsilon: Ridge term. Must be a scalar.
+beta1_power: `beta1` to the power of the current step. Must be a scalar.
+beta2_power: `beta2` to the power of the current step. Must be a scalar.
+)doc");
+
+REGISTER_OP("EmbeddingTableApplyFtrl")
+    .Input("table_handle: resource")
+    .Input("ids: int64")
+    .Input("grad: float")
+    .Input("lr: float")
+    .Input("l1: float")
+    .Input("l2: float")
+    .Input("lr_power: float")
+    .SetShapeFn(ApplyShapeFn)
+    .Doc(R"doc(
+Updates the rows of `ids` and their accumulators and linear terms by the
+FTRL-proximal scheme, inserting unseen ids.
+
+accum_new = accum + grad * grad
+linear += grad - (accum_new^(-lr_power) - accum^(-lr_power)) / lr * var
+quadratic = 1.0 / (accum_new^(lr_power) * lr) + 2 * l2
+var = (sign(linear) * l1 - linear) / quadratic if |linear| > l1 else 0.0
+accum = accum_new
+
+Rows are updated in parallel, and each row is updated atomically, including
+for ids that occur more than once.
+
+table_handle: Handle to a table with optimizer `ftrl`.
+ids: the ids of the rows to update, of shape `num_ids`.
+grad: the gradients, of shape `num_ids` times `dim`.
+lr: Scaling factor. Must be a scalar.
+l1: L1 regularization. Must be a scalar.
+l2: L2 regularization. Must be a scalar.
+lr_power: Scaling factor. Must be a scalar.
+)doc");
+
+REGISTER_OP("EmbeddingTableSize")
+    .Input("table_handle: resource")
+    .Output("size: int64")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused_input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused_input));
+      c->set_output(0, c->Scalar());
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Returns the number of rows in an embedding table.
+)doc");
+
+REGISTER_OP("EmbeddingTableExport")
+    .Input("table_handle: resource")
+    .Output("ids: int64")
+    .Output("values: float")
+    .Output("slots: float")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused_input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused_input));
+      c->set_output(0, c->Vector(c->UnknownDim()));
+      c->set_output(1, c->UnknownShapeOfRank(2));
+      c->set_output(2, c->UnknownShapeOfRank(3));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Exports the content of an embedding table, e.g. to save it in a checkpoint.
+
+table_handle: Handle to the table.
+ids: the ids of all rows, of shape `size`.
+values: the embeddings of the rows, of shape `size` times `dim`.
+slots: the optimizer slots of the rows, of shape `size` times the number of
+  slots times `dim`.
+)doc");
+
+REGISTER_OP("EmbeddingTableImport")
+    .Input("table_handle: resource")
+    .Input("ids: int64")
+    .Input("values: float")
+    .Input("slots: float")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused_input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused_input));
+      ShapeHandle ids;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &ids));
+      ShapeHandle values;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &values));
+      ShapeHandle slots;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 3, &slots));
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(ids, 0), c->Dim(values, 0), &unused));
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(ids, 0), c->Dim(slots, 0), &unused));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Replaces the content of an embedding table with the output of
+`EmbeddingTableExport`, e.g. when restoring it from a checkpoint.
+
+table_handle: Handle to the table.
+ids: the distinct ids of the rows, of shape `size`.
+values: the embeddings of the rows, of shape `size` times `dim`.
+slots: the optimizer slots of the rows, of shape `size` times the number of
+  slots times `dim`.
+)doc");
+
+}  // namespace tensorflow
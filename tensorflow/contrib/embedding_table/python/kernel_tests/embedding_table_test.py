@@ -0,0 +1,151 @@
+# Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for the embedding table ops."""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import os
+
+import numpy as np
+
+from tensorflow.contrib.embedding_table.python.ops import embedding_table_ops
+from tensorflow.core.protobuf import config_pb2
+from tensorflow.python.client import session
+from tensorflow.python.framework import ops
+from tensorflow.python.ops import resources
+from tensorflow.python.platform import test
+from tensorflow.python.training import saver
+
+
+class EmbeddingTableTest(test.TestCase):
+
+  def testLookupInsertsMissingIds(self):
+    with self.test_session() as sess:
+      table = embedding_table_ops.embedding_table(4, name="table",
+                                                  init_stddev=0.1, seed=1)
+      resources.initialize_resources(resources.shared_resources()).run()
+      ids = np.array([3, 5, 3], dtype=np.int64)
+      peek = sess.run(embedding_table_ops.embedding_table_lookup(
+          table, ids, insert_missing=False))
+      self.assertEqual(0, embedding_table_ops.embedding_table_size(
+          table).eval())
+      values = sess.run(embedding_table_ops.embedding_table_lookup(table, ids))
+      self.assertEqual(2, embedding_table_ops.embedding_table_size(
+          table).eval())
+    self.assertAllEqual(peek, values)
+    self.assertAllEqual(values[0], values[2])
+    self.assertEqual((3, 4), values.shape)
+
+  def testAdagradWithDuplicateIds(self):
+    ids = np.array([1, 2, 1], dtype=np.int64)
+    grad = np.array([[1., 2.], [3., 4.], [5., 6.]], dtype=np.float32)
+    with self.test_session() as sess:
+      table = embedding_table_ops.embedding_table(2, name="table")
+      resources.initialize_resources(resources.shared_resources()).run()
+      sess.run(embedding_table_ops.embedding_table_apply_adagrad(
+          table, ids, grad, 0.5))
+      values = sess.run(embedding_table_ops.embedding_table_lookup(
+          table, np.array([1, 2], dtype=np.int64)))
+    expected = np.zeros([3, 2], dtype=np.float32)
+    accum = np.full([3, 2], 0.1, dtype=np.float32)
+    for i, g in zip(ids, grad):
+      accum[i] += g * g
+      expected[i] -= 0.5 * g / np.sqrt(accum[i])
+    self.assertAllClose(expected[1:], values)
+
+  def testWrongOptimizerFails(self):
+    with self.test_session() as sess:
+      table = embedding_table_ops.embedding_table(2, name="table",
+                                                  optimizer="ftrl")
+      resources.initialize_resources(resources.shared_resources()).run()
+      with self.assertRaisesOpError("another optimizer"):
+        sess.run(embedding_table_ops.embedding_table_apply_sgd(
+            table, np.zeros([1], np.int64), np.zeros([1, 2], np.float32),
+            0.1))
+
+  def testSaveRestore(self):
+    save_path = os.path.join(self.get_temp_dir(), "embedding_table")
+    ids = np.arange(100, dtype=np.int64) * 11
+    grad = np.random.RandomState(0).randn(100, 3).astype(np.float32)
+
+    with ops.Graph().as_default() as g, self.test_session(graph=g) as sess:
+      table = embedding_table_ops.embedding_table(3, name="table",
+                                                  optimizer="adam")
+      resources.initialize_resources(resources.shared_resources()).run()
+      sess.run(embedding_table_ops.embedding_table_apply_adam(
+          table, ids, grad, 0.1, 0.9, 0.999, 1e-8, 0.9, 0.999))
+      expected = sess.run(embedding_table_ops.embedding_table_lookup(
+          table, ids))
+      saver.Saver().save(sess, save_path)
+
+    with ops.Graph().as_default() as g, self.test_session(graph=g) as sess:
+      table = embedding_table_ops.embedding_table(3, name="table",
+                                                  optimizer="adam")
+      saver.Saver().restore(sess, save_path)
+      self.assertEqual(100, embedding_table_ops.embedding_table_size(
+          table).eval())
+      actual = sess.run(embedding_table_ops.embedding_table_lookup(
+          table, ids, insert_missing=False))
+    self.assertAllClose(expected, actual)
+
+
+class PartitionedEmbeddingTableTest(test.TestCase):
+
+  def testShardsOnParameterServers(self):
+    workers, _ = test.create_local_cluster(num_workers=1, num_ps=2)
+    ids = np.array([0, 1, 2, 3, 4, 7, 1], dtype=np.int64)
+    grad = np.random.RandomState(1).randn(7, 4).astype(np.float32)
+    with ops.Graph().as_default():
+      with ops.device("/job:worker/task:0"):
+        table = embedding_table_ops.PartitionedEmbeddingTable(
+            4, name="table",
+            devices=["/job:ps/task:0", "/job:ps/task:1"],
+            optimizer="sgd", init_stddev=0.5, seed=2)
+        initial = table.lookup(ids)
+        update = table.apply_sgd(ids, grad, 0.1)
+        updated = table.lookup(ids, insert_missing=False)
+        size = table.size()
+      init_op = resources.initialize_resources(resources.shared_resources())
+      self.assertEqual(2, len(table.handles))
+      self.assertEqual("/job:ps/task:0", table.handles[0].device)
+      self.assertEqual("/job:ps/task:1", table.handles[1].device)
+      config = config_pb2.ConfigProto(allow_soft_placement=False)
+      with session.Session(workers[0].target, config=config) as sess:
+        sess.run(init_op)
+        initial_values = sess.run(initial)
+        sess.run(update)
+        updated_values, num_rows = sess.run([updated, size])
+
+    # A single table with the same seed has the same initial values.
+    with ops.Graph().as_default() as g, self.test_session(graph=g):
+      single = embedding_table_ops.embedding_table(4, name="single",
+                                                   optimizer="sgd",
+                                                   init_stddev=0.5, seed=2)
+      resources.initialize_resources(resources.shared_resources()).run()
+      self.assertAllEqual(
+          initial_values,
+          embedding_table_ops.embedding_table_lookup(single, ids).eval())
+
+    self.assertEqual(6, num_rows)
+    expected = initial_values.copy()
+    for i, g in zip(ids, grad):
+      expected[ids == i] -= 0.1 * g
+    self.assertAllClose(expected, updated_values)
+
+
+if __name__ == "__main__":
+  test.main()
@@ -0,0 +1,320 @@
+# Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Wrappers for embedding table operations."""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+from tensorflow.contrib.util import loader
+from tensorflow.python.framework import dtypes
+from tensorflow.python.framework import ops
+from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import control_flow_ops
+from tensorflow.python.ops import data_flow_ops
+from tensorflow.python.ops import math_ops
+from tensorflow.python.ops import resources
+from tensorflow.python.platform import resource_loader
+from tensorflow.python.training import saver
+
+_embedding_table_ops = loader.load_op_library(
+    resource_loader.get_path_to_datafile("_embedding_table_ops.so"))
+
+
+class EmbeddingTableSaveable(saver.BaseSaverBuilder.SaveableObject):
+  """SaveableObject implementation for embedding tables."""
+
+  def __init__(self, table_handle, create_op, name):
+    """Creates an EmbeddingTableSaveable object.
+
+    Args:
+      table_handle: handle to the embedding table resource.
+      create_op: the op to create the table.
+      name: the name to save the table under.
+    """
+    ids, values, slots = _embedding_table_ops.embedding_table_export(
+        table_handle)
+    # The table is always saved in full, so there is no slice spec.
+    slice_spec = ""
+    specs = [
+        saver.BaseSaverBuilder.SaveSpec(ids, slice_spec, name + "_ids"),
+        saver.BaseSaverBuilder.SaveSpec(values, slice_spec, name + "_values"),
+        saver.BaseSaverBuilder.SaveSpec(slots, slice_spec, name + "_slots"),
+    ]
+    super(EmbeddingTableSaveable, self).__init__(table_handle, specs, name)
+    self._table_handle = table_handle
+    self._create_op = create_op
+
+  def restore(self, restored_tensors, unused_restored_shapes):
+    """Restores the associated table from 'restored_tensors'.
+
+    Args:
+      restored_tensors: the tensors that were loaded from a checkpoint.
+      unused_restored_shapes: the shapes this object should conform to after
+        restore. Not meaningful for tables.
+
+    Returns:
+      The operation that restores the state of the table.
+    """
+    with ops.colocate_with(self._table_handle):
+      with ops.control_dependencies([self._create_op]):
+        return _embedding_table_ops.embedding_table_import(
+            self._table_handle, *restored_tensors)
+
+
+def embedding_table(dim,
+                    name,
+                    optimizer="adagrad",
+                    initial_accumulator_value=0.1,
+                    init_stddev=0.0,
+                    seed=0,
+                    container=None):
+  """Creates an embedding table and returns a handle to it.
+
+  The table holds a row of `dim` floats and the slots of `optimizer` for every
+  int64 id that has been looked up or updated, and grows as unseen ids arrive.
+  Place it on a parameter server with `tf.device` so that lookups and updates
+  run there and only the rows of a batch cross the network.
+
+  The table is registered as a shared resource, so it is created by
+  `resources.initialize_resources(resources.shared_resources())` (part of the
+  default `tf.train.Scaffold` init op), and it is saved to and restored from
+  checkpoints by `tf.train.Saver`.
+
+  Args:
+    dim: the dimension of the embeddings.
+    name: A name for the table.
+    optimizer: one of "sgd", "adagrad", "adam" or "ftrl", the only optimizer
+      that may update the table.
+    initial_accumulator_value: the initial accumulator value of "adagrad" and
+      "ftrl".
+    init_stddev: the standard deviation of the truncated normal initial values
+      of the embeddings, or zero for zeros.
+    seed: the seed of the initial values, which only depend on it and the id.
+    container: An optional `string`. Defaults to `""`.
+
+  Returns:
+    A `Tensor` of type `resource`. The handle to the table.
+  """
+  with ops.name_scope(name, "EmbeddingTable") as name:
+    table_handle = _embedding_table_ops.embedding_table_resource_handle_op(
+        container=container, shared_name=name, name=name)
+    create_op = _embedding_table_ops.create_embedding_table(
+        table_handle,
+        dim=dim,
+        optimizer=optimizer,
+        initial_accumulator_value=initial_accumulator_value,
+        init_stddev=init_stddev,
+        seed=seed)
+    is_initialized_op = _embedding_table_ops.embedding_table_is_initialized(
+        table_handle)
+    # Adds the table to the saveable list.
+    saveable = EmbeddingTableSaveable(table_handle, create_op,
+                                      table_handle.name)
+    ops.add_to_collection(ops.GraphKeys.SAVEABLE_OBJECTS, saveable)
+    resources.register_resource(table_handle, create_op, is_initialized_op)
+    return table_handle
+
+
+def embedding_table_lookup(table_handle, ids, insert_missing=True, name=None):
+  """Looks up the embeddings of a batch of int64 ids.
+
+  Args:
+    table_handle: handle to the table.
+    ids: the ids, of shape `num_ids`.
+    insert_missing: whether to add rows for unseen ids, or to return the values
+      they would start out with without growing the table.
+    name: A name for the operation (optional).
+
+  Returns:
+    The embeddings, of shape `num_ids` times `dim`.
+  """
+  return _embedding_table_ops.embedding_table_lookup(
+      table_handle, ids, insert_missing=insert_missing, name=name)
+
+
+def embedding_table_apply_sgd(table_handle, ids, grad, lr, name=None):
+  """Applies gradient descent to the rows of `ids` in place."""
+  return _embedding_table_ops.embedding_table_apply_sgd(
+      table_handle, ids, grad, lr, name=name)
+
+
+def embedding_table_apply_adagrad(table_handle, ids, grad, lr, name=None):
+  """Applies Adagrad to the rows of `ids` in place."""
+  return _embedding_table_ops.embedding_table_apply_adagrad(
+      table_handle, ids, grad, lr, name=name)
+
+
+def embedding_table_apply_adam(table_handle, ids, grad, lr, beta1, beta2,
+                               epsilon, beta1_power, beta2_power, name=None):
+  """Applies lazy Adam to the rows of `ids` in place."""
+  return _embedding_table_ops.embedding_table_apply_adam(
+      table_handle, ids, grad, lr, beta1, beta2, epsilon, beta1_power,
+      beta2_power, name=name)
+
+
+def embedding_table_apply_ftrl(table_handle, ids, grad, lr, l1, l2,
+                               lr_power=-0.5, name=None):
+  """Applies FTRL-proximal to the rows of `ids` in place."""
+  return _embedding_table_ops.embedding_table_apply_ftrl(
+      table_handle, ids, grad, lr, l1, l2, lr_power, name=name)
+
+
+def embedding_table_size(table_handle, name=None):
+  """Returns the number of rows in an embedding table."""
+  return _embedding_table_ops.embedding_table_size(table_handle, name=name)
+
+ops.NotDifferentiable("EmbeddingTableLookup")
+ops.NotDifferentiable("EmbeddingTableExport")
+ops.NotDifferentiable("EmbeddingTableSize")
+
+
+class PartitionedEmbeddingTable(object):
+  """An embedding table partitioned over devices by id.
+
+  Id `i` lives in the table on `devices[i % len(devices)]`, typically one per
+  parameter server task. A lookup or update sends each shard only the ids and
+  gradient rows that live there, and the shard gathers or updates its rows in
+  place, so no dense slice of the table crosses the network.
+
+  The table is not a variable and has no gradient: compute the gradient with
+  respect to the looked up embeddings and pass it to the `apply_*` method
+  matching `optimizer`.
+  """
+
+  def __init__(self,
+               dim,
+               name,
+               devices=None,
+               optimizer="adagrad",
+               initial_accumulator_value=0.1,
+               init_stddev=0.0,
+               seed=0):
+    """Creates one embedding table per device.
+
+    Args:
+      dim: the dimension of the embeddings.
+      name: A name for the table.
+      devices: the devices of the shards, or None for a single shard on the
+        current device.
+      optimizer: one of "sgd", "adagrad", "adam" or "ftrl".
+      initial_accumulator_value: the initial accumulator value of "adagrad"
+        and "ftrl".
+      init_stddev: the standard deviation of the initial values.
+      seed: the seed of the initial values, which is shared by the shards, so
+        that they do not depend on the number of shards.
+    """
+    self._dim = dim
+    self._handles = []
+    with ops.name_scope(name, "PartitionedEmbeddingTable") as scope:
+      for i, device in enumerate(devices or [None]):
+        with ops.device(device):
+          self._handles.append(
+              embedding_table(
+                  dim,
+                  name="shard_%d" % i,
+                  optimizer=optimizer,
+                  initial_accumulator_value=initial_accumulator_value,
+                  init_stddev=init_stddev,
+                  seed=seed))
+    self._name = scope
+
+  @property
+  def dim(self):
+    return self._dim
+
+  @property
+  def handles(self):
+    """The handles of the shards."""
+    return list(self._handles)
+
+  def _partition(self, ids, grad=None):
+    """Splits `ids` and the rows of `grad` by shard, on the current device."""
+    ids = ops.convert_to_tensor(ids, dtype=dtypes.int64)
+    num_shards = len(self._handles)
+    shard_ids = math_ops.to_int32(math_ops.floormod(ids, num_shards))
+    positions = data_flow_ops.dynamic_partition(
+        math_ops.range(array_ops.size(ids)), shard_ids, num_shards)
+    ids = data_flow_ops.dynamic_partition(ids, shard_ids, num_shards)
+    if grad is not None:
+      grad = data_flow_ops.dynamic_partition(
+          ops.convert_to_tensor(grad, dtype=dtypes.float32), shard_ids,
+          num_shards)
+    return positions, ids, grad
+
+  def lookup(self, ids, insert_missing=True, name=None):
+    """Looks up the embeddings of `ids`, a vector of int64 ids.
+
+    Args:
+      ids: the ids, of shape `num_ids`.
+      insert_missing: whether to add rows for unseen ids.
+      name: A name for the operation (optional).
+
+    Returns:
+      The embeddings, of shape `num_ids` times `dim`.
+    """
+    with ops.name_scope(name, "lookup", [ids]):
+      if len(self._handles) == 1:
+        return embedding_table_lookup(self._handles[0], ids, insert_missing)
+      positions, shard_ids, _ = self._partition(ids)
+      values = []
+      for handle, ids in zip(self._handles, shard_ids):
+        with ops.colocate_with(handle):
+          values.append(embedding_table_lookup(handle, ids, insert_missing))
+      return data_flow_ops.dynamic_stitch(positions, values)
+
+  def _apply(self, apply_fn, ids, grad, hyperparameters, name):
+    with ops.name_scope(name, "apply", [ids, grad]):
+      if len(self._handles) == 1:
+        return apply_fn(self._handles[0], ids, grad, *hyperparameters)
+      _, shard_ids, shard_grads = self._partition(ids, grad)
+      updates = []
+      for handle, ids, grad in zip(self._handles, shard_ids, shard_grads):
+        with ops.colocate_with(handle):
+          updates.append(apply_fn(handle, ids, grad, *hyperparameters))
+      return control_flow_ops.group(*updates)
+
+  def apply_sgd(self, ids, grad, lr, name=None):
+    """Applies gradient descent to the rows of `ids`."""
+    return self._apply(embedding_table_apply_sgd, ids, grad, [lr], name)
+
+  def apply_adagrad(self, ids, grad, lr, name=None):
+    """Applies Adagrad to the rows of `ids`."""
+    return self._apply(embedding_table_apply_adagrad, ids, grad, [lr], name)
+
+  def apply_adam(self, ids, grad, lr, beta1, beta2, epsilon, beta1_power,
+                 beta2_power, name=None):
+    """Applies lazy Adam to the rows of `ids`.
+
+    The caller keeps `beta1_power` and `beta2_power` for the current step, as
+    `tf.train.AdamOptimizer` does.
+    """
+    return self._apply(
+        embedding_table_apply_adam, ids, grad,
+        [lr, beta1, beta2, epsilon, beta1_power, beta2_power], name)
+
+  def apply_ftrl(self, ids, grad, lr, l1, l2, lr_power=-0.5, name=None):
+    """Applies FTRL-proximal to the rows of `ids`."""
+    return self._apply(embedding_table_apply_ftrl, ids, grad,
+                       [lr, l1, l2, lr_power], name)
+
+  def size(self, name=None):
+    """Returns the total number of rows of the shards."""
+    with ops.name_scope(name, "size"):
+      sizes = []
+      for handle in self._handles:
+        with ops.colocate_with(handle):
+          sizes.append(embedding_table_size(handle))
+      return math_ops.add_n(sizes)
@@ -25,6 +25,25 @@ The following ops generate multiprobe sequences for various hash families.
 
 @@hyperplane_lsh_hash
 
+### Brute-force search ops
+
+The following ops find the database points with the largest inner products
+with a batch of queries.
+
+@@inner_product_search
+@@quantized_inner_product_search
+@@product_quantized_inner_product_search
+
+### Approximate search index
+
+An inverted file (IVF) index resource with checkpointing support.
+
+@@ivf_index
+@@ivf_index_train
+@@ivf_index_add
+@@ivf_index_search
+@@ivf_index_size
+
 """
 
 from __future__ import absolute_import
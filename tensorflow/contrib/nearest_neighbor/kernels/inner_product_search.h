@@ -0,0 +1,364 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CONTRIB_NEAREST_NEIGHBOR_KERNELS_INNER_PRODUCT_SEARCH_H_
+#define TENSORFLOW_CONTRIB_NEAREST_NEIGHBOR_KERNELS_INNER_PRODUCT_SEARCH_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+
+#include "tensorflow/contrib/nearest_neighbor/kernels/heap.h"
+
+namespace tensorflow {
+namespace nearest_neighbor {
+
+// This file implements brute-force maximum inner product search: for a batch
+// of queries, find the k database points with the largest inner product.
+//
+// The database is streamed through in tiles that fit into the L2 cache. For
+// each tile, a Scorer computes the scores of all points in the tile against
+// all queries at once (a small matrix product for float databases, integer
+// dot products for int8 databases and table lookups for product-quantized
+// databases), and the scores are pushed into one top-k heap per query. This
+// avoids materializing the full [num_queries, num_points] score matrix.
+//
+// A Scorer must provide
+//
+//   int64_t num_queries() const;
+//   int64_t num_points() const;
+//   int64_t bytes_per_point() const;
+//   // Writes the score of point p against query q to
+//   // scores[(p - begin) * num_queries() + q] for p in [begin, end).
+//   void ScoreTile(int64_t begin, int64_t end, float* scores) const;
+//
+// and ScoreTile must be safe to call concurrently.
+
+// Keeps the k (score, index) pairs with the largest scores pushed into it.
+// Ties in the score are broken in favor of smaller indices.
+class TopKAccumulator {
+ public:
+  // The heap key orders by score, then by decreasing index, so that the top
+  // of the min-heap is always the entry to evict next.
+  using Key = std::pair<float, int64_t>;
+
+  explicit TopKAccumulator(int k)
+      : k_(k), size_(0), threshold_(-std::numeric_limits<float>::infinity()) {}
+
+  void Push(float score, int64_t index) {
+    if (size_ < k_) {
+      heap_.Insert(Key(score, -index), index);
+      if (++size_ == k_) threshold_ = heap_.MinKey().first;
+    } else if (Key(score, -index) > heap_.MinKey()) {
+      heap_.ReplaceTop(Key(score, -index), index);
+      threshold_ = heap_.MinKey().first;
+    }
+  }
+
+  // Returns a score that a point must at least reach to enter the
+  // accumulator.
+  float threshold() const { return threshold_; }
+
+  // Appends the contents of the accumulator, in no particular order.
+  void AppendTo(std::vector<std::pair<float, int64_t>>* out) {
+    const auto& items = heap_.GetData();
+    for (int i = 0; i < size_; ++i) {
+      out->emplace_back(items[i].key.first, items[i].data);
+    }
+  }
+
+ private:
+  int k_;
+  int size_;
+  float threshold_;
+  SimpleHeap<Key, int64_t> heap_;
+};
+
+// Scores a float database against float queries using Eigen's matrix
+// product on each tile.
+class FloatInnerProductScorer {
+ public:
+  using Matrix =
+      Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+  using ConstMatrixMap = Eigen::Map<const Matrix>;
+  using MatrixMap = Eigen::Map<Matrix>;
+
+  // `queries` is [num_queries, dim] and `database` is [num_points, dim], both
+  // row-major. The pointers must outlive the scorer.
+  FloatInnerProductScorer(const float* queries, int64_t num_queries,
+                          const float* database, int64_t num_points,
+                          int64_t dim)
+      : queries_(queries),
+        database_(database),
+        num_queries_(num_queries),
+        num_points_(num_points),
+        dim_(dim) {}
+
+  int64_t num_queries() const { return num_queries_; }
+  int64_t num_points() const { return num_points_; }
+  int64_t bytes_per_point() const { return dim_ * sizeof(float); }
+
+  void ScoreTile(int64_t begin, int64_t end, float* scores) const {
+    ConstMatrixMap tile(database_ + begin * dim_, end - begin, dim_);
+    ConstMatrixMap queries(queries_, num_queries_, dim_);
+    MatrixMap out(scores, end - begin, num_queries_);
+    out.noalias() = tile * queries.transpose();
+  }
+
+ private:
+  const float* queries_;
+  const float* database_;
+  const int64_t num_queries_;
+  const int64_t num_points_;
+  const int64_t dim_;
+};
+
+// Returns the inner product of two int8 vectors. The loop is written so that
+// compilers vectorize it into 16-bit multiply-adds.
+inline int32_t Int8DotProduct(const int8_t* a, const int8_t* b, int64_t dim) {
+  int32_t sum = 0;
+  for (int64_t i = 0; i < dim; ++i) {
+    sum += static_cast<int16_t>(a[i]) * static_cast<int16_t>(b[i]);
+  }
+  return sum;
+}
+
+// Scores a symmetrically quantized int8 database, where point p represents
+// scales[p] * database[p, :]. The queries are quantized per query to int8 on
+// construction, and scores are computed with integer dot products.
+class Int8InnerProductScorer {
+ public:
+  Int8InnerProductScorer(const float* queries, int64_t num_queries,
+                         const int8_t* database, const float* scales,
+                         int64_t num_points, int64_t dim)
+      : database_(database),
+        scales_(scales),
+        num_queries_(num_queries),
+        num_points_(num_points),
+        dim_(dim),
+        quantized_queries_(num_queries * dim),
+        query_scales_(num_queries) {
+    for (int64_t q = 0; q < num_queries; ++q) {
+      const float* query = queries + q * dim;
+      float max_abs = 0;
+      for (int64_t i = 0; i < dim; ++i) {
+        max_abs = std::max(max_abs, std::abs(query[i]));
+      }
+      const float scale = max_abs > 0 ? max_abs / 127.0f : 1.0f;
+      query_scales_[q] = scale;
+      for (int64_t i = 0; i < dim; ++i) {
+        quantized_queries_[q * dim + i] =
+            static_cast<int8_t>(std::round(query[i] / scale));
+      }
+    }
+  }
+
+  int64_t num_queries() const { return num_queries_; }
+  int64_t num_points() const { return num_points_; }
+  int64_t bytes_per_point() const { return dim_ * sizeof(int8_t); }
+
+  void ScoreTile(int64_t begin, int64_t end, float* scores) const {
+    for (int64_t p = begin; p < end; ++p) {
+      const int8_t* point = database_ + p * dim_;
+      for (int64_t q = 0; q < num_queries_; ++q) {
+        const int32_t dot =
+            Int8DotProduct(quantized_queries_.data() + q * dim_, point, dim_);
+        *scores++ = scales_[p] * query_scales_[q] * static_cast<float>(dot);
+      }
+    }
+  }
+
+ private:
+  const int8_t* database_;
+  const float* scales_;
+  const int64_t num_queries_;
+  const int64_t num_points_;
+  const int64_t dim_;
+  std::vector<int8_t> quantized_queries_;
+  std::vector<float> query_scales_;
+};
+
+// Scores a product-quantized database. The dimensions are split into
+// num_subspaces contiguous subspaces of subspace_dim dimensions each, and
+// point p is approximated by the concatenation of
+// codebooks[m, codes[p, m], :] over m. Each query is expanded once into a
+// lookup table of its inner products with all codewords (asymmetric distance
+// computation), so scoring a point costs num_subspaces table lookups.
+class ProductQuantizedInnerProductScorer {
+ public:
+  static constexpr int kNumCodewords = 256;
+
+  // `codebooks` is [num_subspaces, kNumCodewords, subspace_dim] and `codes`
+  // is [num_points, num_subspaces].
+  ProductQuantizedInnerProductScorer(const float* queries,
+                                     int64_t num_queries,
+                                     const float* codebooks,
+                                     const uint8_t* codes, int64_t num_points,
+                                     int64_t num_subspaces,
+                                     int64_t subspace_dim)
+      : codes_(codes),
+        num_queries_(num_queries),
+        num_points_(num_points),
+        num_subspaces_(num_subspaces),
+        lookup_tables_(num_queries * num_subspaces * kNumCodewords) {
+    using Matrix =
+        Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+    using OuterStride = Eigen::OuterStride<Eigen::Dynamic>;
+    for (int64_t m = 0; m < num_subspaces; ++m) {
+      Eigen::Map<const Matrix> codebook(
+          codebooks + m * kNumCodewords * subspace_dim, kNumCodewords,
+          subspace_dim);
+      Eigen::Map<const Matrix, 0, OuterStride> sub_queries(
+          queries + m * subspace_dim, num_queries, subspace_dim,
+          OuterStride(num_subspaces * subspace_dim));
+      // lookup_tables_[q, m, :] = codebook * query_q[m-th subspace].
+      Eigen::Map<Matrix, 0, OuterStride> tables(
+          lookup_tables_.data() + m * kNumCodewords, num_queries,
+          kNumCodewords, OuterStride(num_subspaces * kNumCodewords));
+      tables.noalias() = sub_queries * codebook.transpose();
+    }
+  }
+
+  int64_t num_queries() const { return num_queries_; }
+  int64_t num_points() const { return num_points_; }
+  int64_t bytes_per_point() const { return num_subspaces_; }
+
+  void ScoreTile(int64_t begin, int64_t end, float* scores) const {
+    for (int64_t p = begin; p < end; ++p) {
+      const uint8_t* code = codes_ + p * num_subspaces_;
+      for (int64_t q = 0; q < num_queries_; ++q) {
+        const float* table =
+            lookup_tables_.data() + q * num_subspaces_ * kNumCodewords;
+        float score = 0;
+        for (int64_t m = 0; m < num_subspaces_; ++m) {
+          score += table[m * kNumCodewords + code[m]];
+        }
+        *scores++ = score;
+      }
+    }
+  }
+
+ private:
+  const uint8_t* codes_;
+  const int64_t num_queries_;
+  const int64_t num_points_;
+  const int64_t num_subspaces_;
+  std::vector<float> lookup_tables_;
+};
+
+// Target size of a database tile plus its score buffer. Chosen to fit into a
+// typical per-core L2 cache.
+constexpr int64_t kInnerProductSearchTileBytes = 256 * 1024;
+
+// Returns the number of database points scored per tile.
+template <typename Scorer>
+int64_t InnerProductSearchTileSize(const Scorer& scorer) {
+  const int64_t bytes_per_point =
+      scorer.bytes_per_point() + scorer.num_queries() * sizeof(float);
+  return std::max<int64_t>(1, kInnerProductSearchTileBytes / bytes_per_point);
+}
+
+// Finds the k highest scoring points for every query of `scorer`. The results
+// are written to scores[q * k + i] and indices[q * k + i], sorted by
+// decreasing score and then increasing index. Requires k <= num_points.
+//
+// `parallel_for(num_partitions, cost_per_partition, fn)` must call
+// fn(begin, end) on disjoint ranges covering [0, num_partitions); every
+// partition scans a contiguous range of tiles into its own accumulators,
+// which are merged at the end.
+template <typename Scorer>
+void InnerProductSearch(
+    const Scorer& scorer, int k, int num_partitions,
+    const std::function<void(int64_t, int64_t,
+                             const std::function<void(int64_t, int64_t)>&)>&
+        parallel_for,
+    float* scores, int64_t* indices) {
+  const int64_t num_queries = scorer.num_queries();
+  const int64_t num_points = scorer.num_points();
+  const int64_t tile_size = InnerProductSearchTileSize(scorer);
+  const int64_t num_tiles = (num_points + tile_size - 1) / tile_size;
+  num_partitions = static_cast<int>(
+      std::max<int64_t>(1, std::min<int64_t>(num_partitions, num_tiles)));
+  const int64_t tiles_per_partition =
+      (num_tiles + num_partitions - 1) / num_partitions;
+
+  std::vector<std::vector<TopKAccumulator>> partition_accumulators(
+      num_partitions);
+  parallel_for(
+      num_partitions,
+      tiles_per_partition * tile_size * scorer.bytes_per_point(),
+      [&](int64_t begin_partition, int64_t end_partition) {
+        std::vector<float> tile_scores(tile_size * num_queries);
+        for (int64_t partition = begin_partition; partition < end_partition;
+             ++partition) {
+          std::vector<TopKAccumulator>& accumulators =
+              partition_accumulators[partition];
+          accumulators.assign(num_queries, TopKAccumulator(k));
+          std::vector<float> thresholds(num_queries);
+          const int64_t begin_point =
+              std::min(num_points, partition * tiles_per_partition * tile_size);
+          const int64_t end_point = std::min(
+              num_points, (partition + 1) * tiles_per_partition * tile_size);
+          for (int64_t begin = begin_point; begin < end_point;
+               begin += tile_size) {
+            const int64_t end = std::min(end_point, begin + tile_size);
+            scorer.ScoreTile(begin, end, tile_scores.data());
+            for (int64_t q = 0; q < num_queries; ++q) {
+              thresholds[q] = accumulators[q].threshold();
+            }
+            const float* score = tile_scores.data();
+            for (int64_t p = begin; p < end; ++p) {
+              for (int64_t q = 0; q < num_queries; ++q, ++score) {
+                // Most points are rejected by this comparison alone. It is
+                // written so that NaN scores still fill up the accumulator.
+                if (!(*score < thresholds[q])) {
+                  accumulators[q].Push(*score, p);
+                  thresholds[q] = accumulators[q].threshold();
+                }
+              }
+            }
+          }
+        }
+      });
+
+  const auto by_score = [](const std::pair<float, int64_t>& a,
+                           const std::pair<float, int64_t>& b) {
+    return a.first > b.first || (a.first == b.first && a.second < b.second);
+  };
+  std::vector<std::pair<float, int64_t>> merged;
+  for (int64_t q = 0; q < num_queries; ++q) {
+    merged.clear();
+    for (int partition = 0; partition < num_partitions; ++partition) {
+      partition_accumulators[partition][q].AppendTo(&merged);
+    }
+    std::partial_sort(merged.begin(), merged.begin() + k, merged.end(),
+                      by_score);
+    for (int i = 0; i < k; ++i) {
+      scores[q * k + i] = merged[i].first;
+      indices[q * k + i] = merged[i].second;
+    }
+  }
+}
+
+}  // namespace nearest_neighbor
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CONTRIB_NEAREST_NEIGHBOR_KERNELS_INNER_PRODUCT_SEARCH_H_
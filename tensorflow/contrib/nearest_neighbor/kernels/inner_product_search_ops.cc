@@ -0,0 +1,203 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+
+#include "tensorflow/contrib/nearest_neighbor/kernels/inner_product_search.h"
+
+namespace tensorflow {
+
+using errors::InvalidArgument;
+
+using nearest_neighbor::FloatInnerProductScorer;
+using nearest_neighbor::InnerProductSearch;
+using nearest_neighbor::Int8InnerProductScorer;
+using nearest_neighbor::ProductQuantizedInnerProductScorer;
+
+// Common input checking and output handling for the inner product search ops.
+// Subclasses validate their database inputs and run the search with a
+// scorer from inner_product_search.h.
+class InnerProductSearchOpBase : public OpKernel {
+ public:
+  explicit InnerProductSearchOpBase(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+ protected:
+  // Checks the queries and k inputs, which are the first and last inputs of
+  // all ops, and stores k in *k.
+  Status GetQueriesAndK(OpKernelContext* context, const Tensor** queries,
+                        int* k) {
+    *queries = &context->input(0);
+    if ((*queries)->dims() != 2) {
+      return InvalidArgument("Need a two-dimensional queries tensor, got ",
+                             (*queries)->dims(), " dimensions.");
+    }
+    const Tensor& k_tensor = context->input(context->num_inputs() - 1);
+    if (k_tensor.dims() != 0) {
+      return InvalidArgument("Need a scalar k tensor, got ", k_tensor.dims(),
+                             " dimensions.");
+    }
+    *k = k_tensor.scalar<int32>()();
+    if (*k < 1) {
+      return InvalidArgument("k must be at least 1 but got ", *k, ".");
+    }
+    return Status::OK();
+  }
+
+  // Allocates the outputs and runs the search.
+  template <typename Scorer>
+  void Search(OpKernelContext* context, const Scorer& scorer, int k) {
+    OP_REQUIRES(context, k <= scorer.num_points(),
+                InvalidArgument("Need k <= num_points, got k = ", k,
+                                " and num_points = ", scorer.num_points(),
+                                "."));
+    TensorShape output_shape({scorer.num_queries(), k});
+    Tensor* scores_tensor = nullptr;
+    Tensor* indices_tensor = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, output_shape, &scores_tensor));
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(1, output_shape, &indices_tensor));
+    if (scorer.num_queries() == 0) return;
+
+    auto* worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    InnerProductSearch(
+        scorer, k, worker_threads->num_threads,
+        [worker_threads](int64_t total, int64_t cost_per_unit,
+                         const std::function<void(int64_t, int64_t)>& fn) {
+          worker_threads->workers->ParallelFor(
+              total, cost_per_unit,
+              [&fn](int64 start, int64 end) { fn(start, end); });
+        },
+        scores_tensor->matrix<float>().data(),
+        reinterpret_cast<int64_t*>(indices_tensor->matrix<int64>().data()));
+  }
+};
+
+class InnerProductSearchOp : public InnerProductSearchOpBase {
+ public:
+  explicit InnerProductSearchOp(OpKernelConstruction* context)
+      : InnerProductSearchOpBase(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor* queries;
+    int k;
+    OP_REQUIRES_OK(context, GetQueriesAndK(context, &queries, &k));
+    const Tensor& database = context->input(1);
+    OP_REQUIRES(context, database.dims() == 2,
+                InvalidArgument("Need a two-dimensional database tensor, got ",
+                                database.dims(), " dimensions."));
+    OP_REQUIRES(context, queries->dim_size(1) == database.dim_size(1),
+                InvalidArgument("Queries have dimension ",
+                                queries->dim_size(1), " but database points ",
+                                "have dimension ", database.dim_size(1), "."));
+
+    FloatInnerProductScorer scorer(
+        queries->matrix<float>().data(), queries->dim_size(0),
+        database.matrix<float>().data(), database.dim_size(0),
+        database.dim_size(1));
+    Search(context, scorer, k);
+  }
+};
+
+class QuantizedInnerProductSearchOp : public InnerProductSearchOpBase {
+ public:
+  explicit QuantizedInnerProductSearchOp(OpKernelConstruction* context)
+      : InnerProductSearchOpBase(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor* queries;
+    int k;
+    OP_REQUIRES_OK(context, GetQueriesAndK(context, &queries, &k));
+    const Tensor& database = context->input(1);
+    OP_REQUIRES(context, database.dims() == 2,
+                InvalidArgument("Need a two-dimensional database tensor, got ",
+                                database.dims(), " dimensions."));
+    OP_REQUIRES(context, queries->dim_size(1) == database.dim_size(1),
+                InvalidArgument("Queries have dimension ",
+                                queries->dim_size(1), " but database points ",
+                                "have dimension ", database.dim_size(1), "."));
+    const Tensor& scales = context->input(2);
+    OP_REQUIRES(context, scales.dims() == 1,
+                InvalidArgument("Need a one-dimensional database_scales ",
+                                "tensor, got ", scales.dims(), " dimensions."));
+    OP_REQUIRES(context, scales.dim_size(0) == database.dim_size(0),
+                InvalidArgument("Got ", scales.dim_size(0), " scales for ",
+                                database.dim_size(0), " database points."));
+
+    Int8InnerProductScorer scorer(
+        queries->matrix<float>().data(), queries->dim_size(0),
+        reinterpret_cast<const int8_t*>(database.matrix<int8>().data()),
+        scales.vec<float>().data(), database.dim_size(0),
+        database.dim_size(1));
+    Search(context, scorer, k);
+  }
+};
+
+class ProductQuantizedInnerProductSearchOp : public InnerProductSearchOpBase {
+ public:
+  explicit ProductQuantizedInnerProductSearchOp(OpKernelConstruction* context)
+      : InnerProductSearchOpBase(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor* queries;
+    int k;
+    OP_REQUIRES_OK(context, GetQueriesAndK(context, &queries, &k));
+    const Tensor& codebooks = context->input(1);
+    OP_REQUIRES(context, codebooks.dims() == 3,
+                InvalidArgument("Need a three-dimensional codebooks tensor, ",
+                                "got ", codebooks.dims(), " dimensions."));
+    const int64 num_codewords =
+        ProductQuantizedInnerProductScorer::kNumCodewords;
+    OP_REQUIRES(context, codebooks.dim_size(1) == num_codewords,
+                InvalidArgument("Need ", num_codewords,
+                                " codewords per subspace, got ",
+                                codebooks.dim_size(1), "."));
+    const Tensor& codes = context->input(2);
+    OP_REQUIRES(context, codes.dims() == 2,
+                InvalidArgument("Need a two-dimensional codes tensor, got ",
+                                codes.dims(), " dimensions."));
+    const int64 num_subspaces = codebooks.dim_size(0);
+    const int64 subspace_dim = codebooks.dim_size(2);
+    OP_REQUIRES(context, codes.dim_size(1) == num_subspaces,
+                InvalidArgument("Codes have ", codes.dim_size(1),
+                                " subspaces but codebooks have ",
+                                num_subspaces, "."));
+    OP_REQUIRES(context, queries->dim_size(1) == num_subspaces * subspace_dim,
+                InvalidArgument("Queries have dimension ",
+                                queries->dim_size(1), " but codebooks have ",
+                                num_subspaces, " subspaces of dimension ",
+                                subspace_dim, "."));
+
+    ProductQuantizedInnerProductScorer scorer(
+        queries->matrix<float>().data(), queries->dim_size(0),
+        codebooks.flat<float>().data(), codes.matrix<uint8>().data(),
+        codes.dim_size(0), num_subspaces, subspace_dim);
+    Search(context, scorer, k);
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("InnerProductSearch").Device(DEVICE_CPU),
+                        InnerProductSearchOp);
+
+REGISTER_KERNEL_BUILDER(Name("QuantizedInnerProductSearch").Device(DEVICE_CPU),
+                        QuantizedInnerProductSearchOp);
+
+REGISTER_KERNEL_BUILDER(
+    Name("ProductQuantizedInnerProductSearch").Device(DEVICE_CPU),
+    ProductQuantizedInnerProductSearchOp);
+
+}  // namespace tensorflow
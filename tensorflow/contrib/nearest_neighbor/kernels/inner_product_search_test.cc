@@ -0,0 +1,141 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/contrib/nearest_neighbor/kernels/inner_product_search.h"
+
+#include <random>
+#include <vector>
+
+#include "tensorflow/core/platform/test.h"
+
+namespace {
+
+using tensorflow::nearest_neighbor::FloatInnerProductScorer;
+using tensorflow::nearest_neighbor::InnerProductSearch;
+using tensorflow::nearest_neighbor::Int8InnerProductScorer;
+using tensorflow::nearest_neighbor::ProductQuantizedInnerProductScorer;
+using tensorflow::nearest_neighbor::TopKAccumulator;
+
+// Runs every partition on the calling thread.
+void SerialFor(int64_t total, int64_t cost_per_unit,
+               const std::function<void(int64_t, int64_t)>& fn) {
+  for (int64_t i = 0; i < total; ++i) {
+    fn(i, i + 1);
+  }
+}
+
+// Returns the indices of the k largest scores, ties broken by lower index.
+std::vector<int64_t> ReferenceTopK(const std::vector<float>& scores, int k) {
+  std::vector<int64_t> indices(scores.size());
+  for (size_t i = 0; i < indices.size(); ++i) indices[i] = i;
+  std::stable_sort(indices.begin(), indices.end(),
+                   [&scores](int64_t a, int64_t b) {
+                     return scores[a] > scores[b];
+                   });
+  indices.resize(k);
+  return indices;
+}
+
+TEST(TopKAccumulatorTest, KeepsLargestAndBreaksTiesByIndex) {
+  TopKAccumulator accumulator(3);
+  accumulator.Push(1.0, 0);
+  accumulator.Push(5.0, 1);
+  accumulator.Push(3.0, 2);
+  EXPECT_EQ(1.0, accumulator.threshold());
+  accumulator.Push(3.0, 3);
+  accumulator.Push(5.0, 4);
+  accumulator.Push(0.5, 5);
+  EXPECT_EQ(3.0, accumulator.threshold());
+
+  std::vector<std::pair<float, int64_t>> contents;
+  accumulator.AppendTo(&contents);
+  std::sort(contents.begin(), contents.end());
+  std::vector<std::pair<float, int64_t>> expected = {
+      {3.0, 2}, {5.0, 1}, {5.0, 4}};
+  EXPECT_EQ(expected, contents);
+}
+
+TEST(InnerProductSearchTest, FloatMatchesBruteForce) {
+  const int64_t kNumQueries = 3;
+  const int64_t kNumPoints = 5003;
+  const int64_t kDim = 24;
+  const int kK = 17;
+  std::mt19937 gen(1);
+  std::normal_distribution<float> dist;
+  std::vector<float> queries(kNumQueries * kDim);
+  std::vector<float> database(kNumPoints * kDim);
+  for (float& v : queries) v = dist(gen);
+  for (float& v : database) v = dist(gen);
+
+  FloatInnerProductScorer scorer(queries.data(), kNumQueries, database.data(),
+                                 kNumPoints, kDim);
+  std::vector<float> scores(kNumQueries * kK);
+  std::vector<int64_t> indices(kNumQueries * kK);
+  for (int num_partitions : {1, 4, 1000}) {
+    InnerProductSearch(scorer, kK, num_partitions, SerialFor, scores.data(),
+                       indices.data());
+    for (int64_t q = 0; q < kNumQueries; ++q) {
+      std::vector<float> all_scores(kNumPoints);
+      for (int64_t p = 0; p < kNumPoints; ++p) {
+        for (int64_t i = 0; i < kDim; ++i) {
+          all_scores[p] += queries[q * kDim + i] * database[p * kDim + i];
+        }
+      }
+      std::vector<int64_t> expected = ReferenceTopK(all_scores, kK);
+      for (int i = 0; i < kK; ++i) {
+        EXPECT_EQ(expected[i], indices[q * kK + i]);
+        EXPECT_NEAR(all_scores[expected[i]], scores[q * kK + i], 1e-4);
+      }
+    }
+  }
+}
+
+TEST(InnerProductSearchTest, Int8ScoresAreScaled) {
+  // Two queries against three quantized points of dimension two.
+  std::vector<float> queries = {1.0, 0.0, 0.0, 127.0};
+  std::vector<int8_t> database = {1, 2, -3, 4, 100, -100};
+  std::vector<float> scales = {1.0, 0.5, 2.0};
+  Int8InnerProductScorer scorer(queries.data(), 2, database.data(),
+                                scales.data(), 3, 2);
+  std::vector<float> scores(2 * 3);
+  std::vector<int64_t> indices(2 * 3);
+  InnerProductSearch(scorer, 3, 2, SerialFor, scores.data(), indices.data());
+  // The second query has a tie between the first two points.
+  EXPECT_EQ((std::vector<int64_t>{2, 0, 1, 0, 1, 2}), indices);
+  const std::vector<float> expected_scores = {200, 1, -1.5, 254, 254, -25400};
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_NEAR(expected_scores[i], scores[i], 1e-3);
+  }
+}
+
+TEST(InnerProductSearchTest, ProductQuantizedUsesCodebooks) {
+  // Two subspaces of dimension one. Codeword c of subspace m is m * 256 + c.
+  const int kCodewords = ProductQuantizedInnerProductScorer::kNumCodewords;
+  std::vector<float> codebooks(2 * kCodewords);
+  for (int i = 0; i < 2 * kCodewords; ++i) codebooks[i] = i;
+  std::vector<uint8_t> codes = {0, 0, 10, 1, 3, 255};
+  std::vector<float> queries = {1.0, -1.0};
+  ProductQuantizedInnerProductScorer scorer(queries.data(), 1,
+                                            codebooks.data(), codes.data(), 3,
+                                            2, 1);
+  std::vector<float> scores(2);
+  std::vector<int64_t> indices(2);
+  InnerProductSearch(scorer, 2, 1, SerialFor, scores.data(), indices.data());
+  // Scores are 0 - 256, 10 - 257 and 3 - 511.
+  EXPECT_EQ((std::vector<int64_t>{1, 0}), indices);
+  EXPECT_EQ((std::vector<float>{-247, -256}), scores);
+}
+
+}  // namespace
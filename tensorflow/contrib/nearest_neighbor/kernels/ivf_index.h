@@ -0,0 +1,281 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CONTRIB_NEAREST_NEIGHBOR_KERNELS_IVF_INDEX_H_
+#define TENSORFLOW_CONTRIB_NEAREST_NEIGHBOR_KERNELS_IVF_INDEX_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+
+#include "tensorflow/contrib/nearest_neighbor/kernels/inner_product_search.h"
+
+namespace tensorflow {
+namespace nearest_neighbor {
+
+// An inverted file (IVF) index for approximate maximum inner product search.
+//
+// The index partitions the database into num_lists inverted lists, one per
+// centroid of a k-means clustering of training data. A point is stored in
+// the list of the centroid with which it has the largest inner product. A
+// query scores all centroids, probes the num_probes lists with the largest
+// centroid scores, and exactly scores the points in those lists.
+//
+// The class is not thread-safe; callers must synchronize mutations with
+// searches. Search() itself is const and may be called concurrently.
+class IvfIndex {
+ public:
+  using Matrix =
+      Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+  using ConstMatrixMap = Eigen::Map<const Matrix>;
+  using Vector = Eigen::Matrix<float, Eigen::Dynamic, 1>;
+
+  // Same contract as in InnerProductSearch().
+  using ParallelFor = std::function<void(
+      int64_t, int64_t, const std::function<void(int64_t, int64_t)>&)>;
+
+  IvfIndex(int64_t dim, int64_t num_lists)
+      : dim_(dim), num_lists_(num_lists), trained_(false), lists_(num_lists) {}
+
+  int64_t dim() const { return dim_; }
+  int64_t num_lists() const { return num_lists_; }
+  bool trained() const { return trained_; }
+
+  int64_t size() const {
+    int64_t size = 0;
+    for (const InvertedList& list : lists_) size += list.ids.size();
+    return size;
+  }
+
+  // Computes the centroids with num_iterations of Lloyd's algorithm on the
+  // [num_samples, dim] row-major `samples`, initialized with k-means++.
+  // Requires num_samples >= num_lists and an empty index.
+  void Train(const float* samples, int64_t num_samples, int num_iterations,
+             uint64_t seed, const ParallelFor& parallel_for) {
+    ConstMatrixMap data(samples, num_samples, dim_);
+    std::mt19937_64 rng(seed);
+    InitializeCentroids(data, &rng);
+
+    std::vector<int64_t> assignment(num_samples);
+    for (int iteration = 0; iteration < num_iterations; ++iteration) {
+      // Assign every sample to the nearest centroid in Euclidean distance,
+      // i.e. the one maximizing <x, c> - |c|^2 / 2.
+      const Vector half_norms = centroids_.rowwise().squaredNorm() * 0.5f;
+      parallel_for(
+          num_samples, num_lists_ * dim_ * 2,
+          [&](int64_t begin, int64_t end) {
+            const Matrix scores =
+                data.middleRows(begin, end - begin) * centroids_.transpose();
+            for (int64_t i = begin; i < end; ++i) {
+              (scores.row(i - begin) - half_norms.transpose())
+                  .maxCoeff(&assignment[i]);
+            }
+          });
+
+      Matrix sums = Matrix::Zero(num_lists_, dim_);
+      std::vector<int64_t> counts(num_lists_, 0);
+      for (int64_t i = 0; i < num_samples; ++i) {
+        sums.row(assignment[i]) += data.row(i);
+        ++counts[assignment[i]];
+      }
+      std::uniform_int_distribution<int64_t> random_sample(0, num_samples - 1);
+      for (int64_t c = 0; c < num_lists_; ++c) {
+        if (counts[c] > 0) {
+          centroids_.row(c) = sums.row(c) / static_cast<float>(counts[c]);
+        } else {
+          // Restart empty clusters at a random sample.
+          centroids_.row(c) = data.row(random_sample(rng));
+        }
+      }
+    }
+    trained_ = true;
+  }
+
+  // Adds the [num_points, dim] row-major `vectors` with the given ids.
+  // Requires a trained index.
+  void Add(const int64_t* ids, const float* vectors, int64_t num_points,
+           const ParallelFor& parallel_for) {
+    ConstMatrixMap data(vectors, num_points, dim_);
+    std::vector<int64_t> assignment(num_points);
+    parallel_for(num_points, num_lists_ * dim_ * 2,
+                 [&](int64_t begin, int64_t end) {
+                   const Matrix scores = data.middleRows(begin, end - begin) *
+                                         centroids_.transpose();
+                   for (int64_t i = begin; i < end; ++i) {
+                     scores.row(i - begin).maxCoeff(&assignment[i]);
+                   }
+                 });
+    for (int64_t i = 0; i < num_points; ++i) {
+      InvertedList& list = lists_[assignment[i]];
+      list.ids.push_back(ids[i]);
+      list.vectors.insert(list.vectors.end(), vectors + i * dim_,
+                          vectors + (i + 1) * dim_);
+    }
+  }
+
+  // Finds the k points with the largest inner products with each of the
+  // [num_queries, dim] row-major `queries`, probing num_probes lists per
+  // query. Results are written to scores[q * k + i] and ids[q * k + i] in
+  // decreasing order of score. If the probed lists hold fewer than k points,
+  // the remaining results have score -inf and id -1.
+  void Search(const float* queries, int64_t num_queries, int k,
+              int64_t num_probes, const ParallelFor& parallel_for,
+              float* scores, int64_t* ids) const {
+    num_probes = std::min(num_probes, num_lists_);
+    ConstMatrixMap query_matrix(queries, num_queries, dim_);
+    const int64_t cost_per_query =
+        num_lists_ * dim_ * 2 +
+        (size() * num_probes / std::max<int64_t>(1, num_lists_)) * dim_ * 2;
+    parallel_for(
+        num_queries, cost_per_query, [&](int64_t begin, int64_t end) {
+          const Matrix centroid_scores =
+              query_matrix.middleRows(begin, end - begin) *
+              centroids_.transpose();
+          std::vector<std::pair<float, int64_t>> probes(num_lists_);
+          std::vector<std::pair<float, int64_t>> results;
+          for (int64_t q = begin; q < end; ++q) {
+            for (int64_t c = 0; c < num_lists_; ++c) {
+              probes[c] = {centroid_scores(q - begin, c), c};
+            }
+            std::partial_sort(
+                probes.begin(), probes.begin() + num_probes, probes.end(),
+                [](const std::pair<float, int64_t>& a,
+                   const std::pair<float, int64_t>& b) {
+                  return a.first > b.first;
+                });
+
+            Eigen::Map<const Vector> query(queries + q * dim_, dim_);
+            TopKAccumulator accumulator(k);
+            for (int64_t p = 0; p < num_probes; ++p) {
+              const InvertedList& list = lists_[probes[p].second];
+              const int64_t list_size = list.ids.size();
+              if (list_size == 0) continue;
+              const Vector list_scores =
+                  ConstMatrixMap(list.vectors.data(), list_size, dim_) * query;
+              for (int64_t i = 0; i < list_size; ++i) {
+                if (!(list_scores(i) < accumulator.threshold())) {
+                  accumulator.Push(list_scores(i), list.ids[i]);
+                }
+              }
+            }
+
+            results.clear();
+            accumulator.AppendTo(&results);
+            std::sort(results.begin(), results.end(),
+                      [](const std::pair<float, int64_t>& a,
+                         const std::pair<float, int64_t>& b) {
+                        return a.first > b.first ||
+                               (a.first == b.first && a.second < b.second);
+                      });
+            for (int i = 0; i < k; ++i) {
+              const bool found = i < static_cast<int>(results.size());
+              scores[q * k + i] =
+                  found ? results[i].first
+                        : -std::numeric_limits<float>::infinity();
+              ids[q * k + i] = found ? results[i].second : -1;
+            }
+          }
+        });
+  }
+
+  // Serialization. The index is fully described by its centroids and, for
+  // every list in order, the ids and vectors of its points.
+  const Matrix& centroids() const { return centroids_; }
+  int64_t list_size(int64_t list) const { return lists_[list].ids.size(); }
+  const int64_t* list_ids(int64_t list) const {
+    return lists_[list].ids.data();
+  }
+  const float* list_vectors(int64_t list) const {
+    return lists_[list].vectors.data();
+  }
+
+  // Removes all points and centroids.
+  void Clear() {
+    centroids_.resize(0, dim_);
+    for (InvertedList& list : lists_) {
+      list.ids.clear();
+      list.vectors.clear();
+    }
+    trained_ = false;
+  }
+
+  // Replaces the contents of the index. `centroids` is [num_lists, dim],
+  // `ids` and `vectors` hold the points of all lists concatenated in list
+  // order, and list_sizes[l] is the number of points in list l.
+  void Restore(const float* centroids, const int64_t* list_sizes,
+               const int64_t* ids, const float* vectors) {
+    centroids_ = ConstMatrixMap(centroids, num_lists_, dim_);
+    int64_t offset = 0;
+    for (int64_t l = 0; l < num_lists_; ++l) {
+      InvertedList& list = lists_[l];
+      list.ids.assign(ids + offset, ids + offset + list_sizes[l]);
+      list.vectors.assign(vectors + offset * dim_,
+                          vectors + (offset + list_sizes[l]) * dim_);
+      offset += list_sizes[l];
+    }
+    trained_ = true;
+  }
+
+ private:
+  // Chooses the initial centroids among the samples with k-means++ seeding:
+  // each next centroid is sampled with probability proportional to its
+  // squared distance from the closest centroid chosen so far.
+  void InitializeCentroids(const ConstMatrixMap& data, std::mt19937_64* rng) {
+    const int64_t num_samples = data.rows();
+    centroids_.resize(num_lists_, dim_);
+    std::uniform_int_distribution<int64_t> random_sample(0, num_samples - 1);
+    centroids_.row(0) = data.row(random_sample(*rng));
+    Vector min_distances =
+        (data.rowwise() - centroids_.row(0)).rowwise().squaredNorm();
+    for (int64_t c = 1; c < num_lists_; ++c) {
+      const double total = min_distances.cast<double>().sum();
+      int64_t chosen = random_sample(*rng);
+      if (total > 0) {
+        double target =
+            std::uniform_real_distribution<double>(0, total)(*rng);
+        for (chosen = 0; chosen < num_samples - 1; ++chosen) {
+          target -= min_distances(chosen);
+          if (target <= 0) break;
+        }
+      }
+      centroids_.row(c) = data.row(chosen);
+      min_distances = min_distances.cwiseMin(
+          (data.rowwise() - centroids_.row(c)).rowwise().squaredNorm());
+    }
+  }
+
+  struct InvertedList {
+    std::vector<int64_t> ids;
+    // Row-major [ids.size(), dim].
+    std::vector<float> vectors;
+  };
+
+  const int64_t dim_;
+  const int64_t num_lists_;
+  bool trained_;
+  Matrix centroids_;
+  std::vector<InvertedList> lists_;
+};
+
+}  // namespace nearest_neighbor
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CONTRIB_NEAREST_NEIGHBOR_KERNELS_IVF_INDEX_H_
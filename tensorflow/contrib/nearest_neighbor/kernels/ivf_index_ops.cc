@@ -0,0 +1,374 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/mutex.h"
+
+#include "tensorflow/contrib/nearest_neighbor/kernels/ivf_index.h"
+
+namespace tensorflow {
+
+using errors::FailedPrecondition;
+using errors::InvalidArgument;
+
+using nearest_neighbor::IvfIndex;
+
+// Wraps an IvfIndex in a resource. Searches hold the mutex in shared mode, so
+// concurrent search ops run in parallel while mutations are exclusive.
+class IvfIndexResource : public ResourceBase {
+ public:
+  IvfIndexResource(int64 dim, int64 num_lists) : index_(dim, num_lists) {}
+
+  string DebugString() override {
+    tf_shared_lock l(mu_);
+    return strings::StrCat("IvfIndex(dim=", index_.dim(),
+                           ", num_lists=", index_.num_lists(),
+                           ", size=", index_.size(), ")");
+  }
+
+  mutex* get_mutex() { return &mu_; }
+  IvfIndex* index() { return &index_; }
+
+ private:
+  mutex mu_;
+  IvfIndex index_;
+};
+
+namespace {
+
+// Adapts the intra-op thread pool to the IvfIndex::ParallelFor contract.
+IvfIndex::ParallelFor WorkerParallelFor(OpKernelContext* context) {
+  auto* worker_threads = context->device()->tensorflow_cpu_worker_threads();
+  return [worker_threads](int64_t total, int64_t cost_per_unit,
+                          const std::function<void(int64_t, int64_t)>& fn) {
+    worker_threads->workers->ParallelFor(
+        total, cost_per_unit,
+        [&fn](int64 start, int64 end) { fn(start, end); });
+  };
+}
+
+Status CheckVectors(const IvfIndex& index, const Tensor& vectors,
+                    const char* name) {
+  if (vectors.dims() != 2) {
+    return InvalidArgument("Need a two-dimensional ", name, " tensor, got ",
+                           vectors.dims(), " dimensions.");
+  }
+  if (vectors.dim_size(1) != index.dim()) {
+    return InvalidArgument("The index has dimension ", index.dim(), " but ",
+                           name, " have dimension ", vectors.dim_size(1), ".");
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+class CreateIvfIndexOp : public OpKernel {
+ public:
+  explicit CreateIvfIndexOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("dim", &dim_));
+    OP_REQUIRES_OK(context, context->GetAttr("num_lists", &num_lists_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    auto* result = new IvfIndexResource(dim_, num_lists_);
+    // Only create one, if one does not exist already. Report status for all
+    // other exceptions.
+    auto status = CreateResource(context, HandleFromInput(context, 0), result);
+    if (!status.ok() && status.code() != tensorflow::error::ALREADY_EXISTS) {
+      OP_REQUIRES(context, false, status);
+    }
+  }
+
+ private:
+  int64 dim_;
+  int64 num_lists_;
+};
+
+class IvfIndexTrainOp : public OpKernel {
+ public:
+  explicit IvfIndexTrainOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("num_iterations", &num_iterations_));
+    OP_REQUIRES_OK(context, context->GetAttr("seed", &seed_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    IvfIndexResource* resource;
+    OP_REQUIRES_OK(context,
+                   LookupResource(context, HandleFromInput(context, 0),
+                                  &resource));
+    core::ScopedUnref unref_me(resource);
+    mutex_lock l(*resource->get_mutex());
+    IvfIndex* index = resource->index();
+
+    const Tensor& samples = context->input(1);
+    OP_REQUIRES_OK(context, CheckVectors(*index, samples, "samples"));
+    OP_REQUIRES(context, samples.dim_size(0) >= index->num_lists(),
+                InvalidArgument("Need at least num_lists = ",
+                                index->num_lists(), " samples, got ",
+                                samples.dim_size(0), "."));
+    OP_REQUIRES(context, index->size() == 0,
+                FailedPrecondition("Cannot train an index that contains ",
+                                   index->size(), " points."));
+    index->Train(samples.matrix<float>().data(), samples.dim_size(0),
+                 num_iterations_, seed_, WorkerParallelFor(context));
+  }
+
+ private:
+  int num_iterations_;
+  int64 seed_;
+};
+
+class IvfIndexAddOp : public OpKernel {
+ public:
+  explicit IvfIndexAddOp(OpKernelConstruction* context) : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    IvfIndexResource* resource;
+    OP_REQUIRES_OK(context,
+                   LookupResource(context, HandleFromInput(context, 0),
+                                  &resource));
+    core::ScopedUnref unref_me(resource);
+    mutex_lock l(*resource->get_mutex());
+    IvfIndex* index = resource->index();
+
+    const Tensor& ids = context->input(1);
+    const Tensor& vectors = context->input(2);
+    OP_REQUIRES(context, ids.dims() == 1,
+                InvalidArgument("Need a one-dimensional ids tensor, got ",
+                                ids.dims(), " dimensions."));
+    OP_REQUIRES_OK(context, CheckVectors(*index, vectors, "vectors"));
+    OP_REQUIRES(context, ids.dim_size(0) == vectors.dim_size(0),
+                InvalidArgument("Got ", ids.dim_size(0), " ids for ",
+                                vectors.dim_size(0), " vectors."));
+    OP_REQUIRES(context, index->trained(),
+                FailedPrecondition("The index must be trained before adding "
+                                   "vectors."));
+    index->Add(reinterpret_cast<const int64_t*>(ids.vec<int64>().data()),
+               vectors.matrix<float>().data(), vectors.dim_size(0),
+               WorkerParallelFor(context));
+  }
+};
+
+class IvfIndexSearchOp : public OpKernel {
+ public:
+  explicit IvfIndexSearchOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("num_probes", &num_probes_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    IvfIndexResource* resource;
+    OP_REQUIRES_OK(context,
+                   LookupResource(context, HandleFromInput(context, 0),
+                                  &resource));
+    core::ScopedUnref unref_me(resource);
+    tf_shared_lock l(*resource->get_mutex());
+    const IvfIndex& index = *resource->index();
+
+    const Tensor& queries = context->input(1);
+    OP_REQUIRES_OK(context, CheckVectors(index, queries, "queries"));
+    const Tensor& k_tensor = context->input(2);
+    OP_REQUIRES(context, k_tensor.dims() == 0,
+                InvalidArgument("Need a scalar k tensor, got ",
+                                k_tensor.dims(), " dimensions."));
+    const int k = k_tensor.scalar<int32>()();
+    OP_REQUIRES(context, k >= 1,
+                InvalidArgument("k must be at least 1 but got ", k, "."));
+    OP_REQUIRES(context, index.trained(),
+                FailedPrecondition("The index must be trained before "
+                                   "searching."));
+
+    TensorShape output_shape({queries.dim_size(0), k});
+    Tensor* scores_tensor = nullptr;
+    Tensor* ids_tensor = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, output_shape, &scores_tensor));
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(1, output_shape, &ids_tensor));
+    int64* ids = ids_tensor->matrix<int64>().data();
+    index.Search(queries.matrix<float>().data(), queries.dim_size(0), k,
+                 num_probes_, WorkerParallelFor(context),
+                 scores_tensor->matrix<float>().data(),
+                 reinterpret_cast<int64_t*>(ids));
+  }
+
+ private:
+  int64 num_probes_;
+};
+
+class IvfIndexSizeOp : public OpKernel {
+ public:
+  explicit IvfIndexSizeOp(OpKernelConstruction* context) : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    IvfIndexResource* resource;
+    OP_REQUIRES_OK(context,
+                   LookupResource(context, HandleFromInput(context, 0),
+                                  &resource));
+    core::ScopedUnref unref_me(resource);
+    tf_shared_lock l(*resource->get_mutex());
+    Tensor* size_tensor = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, TensorShape(), &size_tensor));
+    size_tensor->scalar<int64>()() = resource->index()->size();
+  }
+};
+
+// Op for serializing an index, e.g. to save it in a checkpoint.
+class IvfIndexSerializeOp : public OpKernel {
+ public:
+  explicit IvfIndexSerializeOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    IvfIndexResource* resource;
+    OP_REQUIRES_OK(context,
+                   LookupResource(context, HandleFromInput(context, 0),
+                                  &resource));
+    core::ScopedUnref unref_me(resource);
+    tf_shared_lock l(*resource->get_mutex());
+    const IvfIndex& index = *resource->index();
+    const int64 dim = index.dim();
+    const int64 num_lists = index.num_lists();
+    const int64 size = index.size();
+
+    Tensor* centroids_tensor = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       0, TensorShape({index.trained() ? num_lists : 0, dim}),
+                       &centroids_tensor));
+    if (index.trained()) {
+      std::copy_n(index.centroids().data(), num_lists * dim,
+                  centroids_tensor->matrix<float>().data());
+    }
+
+    Tensor* list_sizes_tensor = nullptr;
+    Tensor* ids_tensor = nullptr;
+    Tensor* vectors_tensor = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(1, TensorShape({num_lists}),
+                                            &list_sizes_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(2, TensorShape({size}),
+                                                     &ids_tensor));
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(3, TensorShape({size, dim}),
+                                            &vectors_tensor));
+    auto list_sizes = list_sizes_tensor->vec<int64>();
+    int64* ids = ids_tensor->vec<int64>().data();
+    float* vectors = vectors_tensor->matrix<float>().data();
+    for (int64 l = 0; l < num_lists; ++l) {
+      const int64 list_size = index.list_size(l);
+      list_sizes(l) = list_size;
+      ids = std::copy_n(index.list_ids(l), list_size, ids);
+      vectors = std::copy_n(index.list_vectors(l), list_size * dim, vectors);
+    }
+  }
+};
+
+// Op for deserializing an index, e.g. when restoring it from a checkpoint.
+class IvfIndexDeserializeOp : public OpKernel {
+ public:
+  explicit IvfIndexDeserializeOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    IvfIndexResource* resource;
+    OP_REQUIRES_OK(context,
+                   LookupResource(context, HandleFromInput(context, 0),
+                                  &resource));
+    core::ScopedUnref unref_me(resource);
+    mutex_lock l(*resource->get_mutex());
+    IvfIndex* index = resource->index();
+
+    const Tensor& centroids = context->input(1);
+    const Tensor& list_sizes = context->input(2);
+    const Tensor& ids = context->input(3);
+    const Tensor& vectors = context->input(4);
+    OP_REQUIRES_OK(context, CheckVectors(*index, centroids, "centroids"));
+    OP_REQUIRES(context,
+                centroids.dim_size(0) == 0 ||
+                    centroids.dim_size(0) == index->num_lists(),
+                InvalidArgument("Expected 0 or ", index->num_lists(),
+                                " centroids, got ", centroids.dim_size(0),
+                                "."));
+    OP_REQUIRES(context,
+                TensorShapeUtils::IsVector(list_sizes.shape()) &&
+                    list_sizes.dim_size(0) == index->num_lists(),
+                InvalidArgument("Expected list_sizes of shape [",
+                                index->num_lists(), "], got ",
+                                list_sizes.shape().DebugString(), "."));
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(ids.shape()),
+                InvalidArgument("Need a one-dimensional ids tensor, got ",
+                                ids.dims(), " dimensions."));
+    OP_REQUIRES_OK(context, CheckVectors(*index, vectors, "vectors"));
+    OP_REQUIRES(context, ids.dim_size(0) == vectors.dim_size(0),
+                InvalidArgument("Got ", ids.dim_size(0), " ids for ",
+                                vectors.dim_size(0), " vectors."));
+    auto list_sizes_vec = list_sizes.vec<int64>();
+    int64 total_size = 0;
+    for (int64 l = 0; l < index->num_lists(); ++l) {
+      OP_REQUIRES(context, list_sizes_vec(l) >= 0,
+                  InvalidArgument("Negative size of list ", l, "."));
+      total_size += list_sizes_vec(l);
+    }
+    OP_REQUIRES(context, total_size == ids.dim_size(0),
+                InvalidArgument("List sizes add up to ", total_size,
+                                " but got ", ids.dim_size(0), " points."));
+
+    if (centroids.dim_size(0) == 0) {
+      OP_REQUIRES(context, total_size == 0,
+                  InvalidArgument("An untrained index cannot hold points."));
+      index->Clear();
+      return;
+    }
+    index->Restore(centroids.matrix<float>().data(),
+                   reinterpret_cast<const int64_t*>(list_sizes_vec.data()),
+                   reinterpret_cast<const int64_t*>(ids.vec<int64>().data()),
+                   vectors.matrix<float>().data());
+  }
+};
+
+REGISTER_RESOURCE_HANDLE_KERNEL(IvfIndexResource);
+
+REGISTER_KERNEL_BUILDER(Name("IvfIndexIsInitialized").Device(DEVICE_CPU),
+                        IsResourceInitialized<IvfIndexResource>);
+
+REGISTER_KERNEL_BUILDER(Name("CreateIvfIndex").Device(DEVICE_CPU),
+                        CreateIvfIndexOp);
+
+REGISTER_KERNEL_BUILDER(Name("IvfIndexTrain").Device(DEVICE_CPU),
+                        IvfIndexTrainOp);
+
+REGISTER_KERNEL_BUILDER(Name("IvfIndexAdd").Device(DEVICE_CPU), IvfIndexAddOp);
+
+REGISTER_KERNEL_BUILDER(Name("IvfIndexSearch").Device(DEVICE_CPU),
+                        IvfIndexSearchOp);
+
+REGISTER_KERNEL_BUILDER(Name("IvfIndexSize").Device(DEVICE_CPU),
+                        IvfIndexSizeOp);
+
+REGISTER_KERNEL_BUILDER(Name("IvfIndexSerialize").Device(DEVICE_CPU),
+                        IvfIndexSerializeOp);
+
+REGISTER_KERNEL_BUILDER(Name("IvfIndexDeserialize").Device(DEVICE_CPU),
+                        IvfIndexDeserializeOp);
+
+}  // namespace tensorflow
@@ -0,0 +1,118 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/contrib/nearest_neighbor/kernels/ivf_index.h"
+
+#include <random>
+#include <vector>
+
+#include "tensorflow/core/platform/test.h"
+
+namespace {
+
+using tensorflow::nearest_neighbor::IvfIndex;
+
+void SerialFor(int64_t total, int64_t cost_per_unit,
+               const std::function<void(int64_t, int64_t)>& fn) {
+  fn(0, total);
+}
+
+// Points clustered around +-e_0 and +-e_1 in two dimensions.
+std::vector<float> ClusteredPoints(int64_t num_points, std::mt19937* gen) {
+  std::normal_distribution<float> noise(0, 0.05);
+  const float centers[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+  std::vector<float> points(num_points * 2);
+  for (int64_t i = 0; i < num_points; ++i) {
+    points[2 * i] = centers[i % 4][0] + noise(*gen);
+    points[2 * i + 1] = centers[i % 4][1] + noise(*gen);
+  }
+  return points;
+}
+
+TEST(IvfIndexTest, TrainFindsClusters) {
+  std::mt19937 gen(0);
+  std::vector<float> samples = ClusteredPoints(400, &gen);
+  IvfIndex index(2, 4);
+  EXPECT_FALSE(index.trained());
+  index.Train(samples.data(), 400, 10, /*seed=*/1, SerialFor);
+  EXPECT_TRUE(index.trained());
+  // Every cluster center is close to one of the centroids.
+  for (int64_t i = 0; i < 4; ++i) {
+    const float max_score =
+        (index.centroids() *
+         Eigen::Map<const IvfIndex::Vector>(samples.data() + 2 * i, 2))
+            .maxCoeff();
+    EXPECT_GT(max_score, 0.8);
+  }
+}
+
+TEST(IvfIndexTest, SearchAllListsIsExact) {
+  std::mt19937 gen(1);
+  const int64_t kNumPoints = 1000;
+  std::vector<float> points = ClusteredPoints(kNumPoints, &gen);
+  std::vector<int64_t> ids(kNumPoints);
+  for (int64_t i = 0; i < kNumPoints; ++i) ids[i] = 100 + i;
+  IvfIndex index(2, 4);
+  index.Train(points.data(), kNumPoints, 10, /*seed=*/1, SerialFor);
+  index.Add(ids.data(), points.data(), kNumPoints, SerialFor);
+  EXPECT_EQ(kNumPoints, index.size());
+
+  const std::vector<float> queries = {0.3, 0.7, -1.0, -0.2};
+  const int kK = 5;
+  std::vector<float> scores(2 * kK);
+  std::vector<int64_t> result_ids(2 * kK);
+  index.Search(queries.data(), 2, kK, /*num_probes=*/4, SerialFor,
+               scores.data(), result_ids.data());
+  for (int64_t q = 0; q < 2; ++q) {
+    std::vector<std::pair<float, int64_t>> expected;
+    for (int64_t i = 0; i < kNumPoints; ++i) {
+      expected.emplace_back(-(queries[2 * q] * points[2 * i] +
+                              queries[2 * q + 1] * points[2 * i + 1]),
+                            ids[i]);
+    }
+    std::sort(expected.begin(), expected.end());
+    for (int i = 0; i < kK; ++i) {
+      EXPECT_EQ(expected[i].second, result_ids[q * kK + i]);
+      EXPECT_NEAR(-expected[i].first, scores[q * kK + i], 1e-5);
+    }
+  }
+}
+
+TEST(IvfIndexTest, SearchPadsMissingResults) {
+  IvfIndex index(2, 2);
+  const std::vector<float> centroids = {1, 0, -1, 0};
+  const std::vector<int64_t> list_sizes = {1, 1};
+  const std::vector<int64_t> ids = {7, 8};
+  const std::vector<float> vectors = {2, 0, -2, 0};
+  index.Restore(centroids.data(), list_sizes.data(), ids.data(),
+                vectors.data());
+  EXPECT_EQ(2, index.size());
+
+  const std::vector<float> query = {1, 0};
+  std::vector<float> scores(2);
+  std::vector<int64_t> result_ids(2);
+  index.Search(query.data(), 1, 2, /*num_probes=*/1, SerialFor, scores.data(),
+               result_ids.data());
+  EXPECT_EQ(7, result_ids[0]);
+  EXPECT_EQ(2, scores[0]);
+  EXPECT_EQ(-1, result_ids[1]);
+  EXPECT_EQ(-std::numeric_limits<float>::infinity(), scores[1]);
+
+  index.Clear();
+  EXPECT_FALSE(index.trained());
+  EXPECT_EQ(0, index.size());
+}
+
+}  // namespace
@@ -13,10 +13,36 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include "tensorflow/core/framework/common_shape_fns.h"
 #include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/shape_inference.h"
 
 namespace tensorflow {
 
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+namespace {
+
+// Shape function for the search ops. `queries_input` is the index of the
+// queries input, and k is always the last input.
+Status InnerProductSearchShapeFn(InferenceContext* c, int queries_input) {
+  ShapeHandle queries;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(queries_input), 2, &queries));
+  ShapeHandle k_shape;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(c->num_inputs() - 1), 0, &k_shape));
+  DimensionHandle k;
+  TF_RETURN_IF_ERROR(c->MakeDimForScalarInput(c->num_inputs() - 1, &k));
+  ShapeHandle output = c->Matrix(c->Dim(queries, 0), k);
+  c->set_output(0, output);
+  c->set_output(1, output);
+  return Status::OK();
+}
+
+}  // namespace
+
 REGISTER_OP("HyperplaneLSHProbes")
     .Attr("CoordinateType: {float, double}")
     .Input("point_hyperplane_product: CoordinateType")
@@ -46,4 +72,289 @@ probes: the output matrix of probes. Size `batch_size` times `num_probes`.
 table_ids: the output matrix of tables ids. Size `batch_size` times `num_probes`.
 )doc");
 
+REGISTER_OP("InnerProductSearch")
+    .Input("queries: float")
+    .Input("database: float")
+    .Input("k: int32")
+    .Output("scores: float")
+    .Output("indices: int64")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle database;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &database));
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(c->input(0), 1),
+                                  c->Dim(database, 1), &unused));
+      return InnerProductSearchShapeFn(c, 0);
+    })
+    .Doc(R"doc(
+Finds the database points with the largest inner products with each query.
+
+This is an exact (brute-force) search equivalent to
+`top_k(matmul(queries, database, transpose_b=True), k)`, but the database is
+streamed through in cache-sized tiles and only the k best scores per query are
+kept, so the full score matrix is never materialized.
+
+queries: the query matrix, of shape `batch_size` times `dim`.
+database: the database matrix, of shape `num_points` times `dim`.
+k: the number of results per query. Must be at most `num_points`.
+scores: the `k` largest inner products for each query, in decreasing order.
+  Size `batch_size` times `k`.
+indices: the database rows of the results. Ties are broken in favor of smaller
+  indices. Size `batch_size` times `k`.
+)doc");
+
+REGISTER_OP("QuantizedInnerProductSearch")
+    .Input("queries: float")
+    .Input("database: int8")
+    .Input("database_scales: float")
+    .Input("k: int32")
+    .Output("scores: float")
+    .Output("indices: int64")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle database;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &database));
+      ShapeHandle scales;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &scales));
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(c->input(0), 1),
+                                  c->Dim(database, 1), &unused));
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(database, 0), c->Dim(scales, 0), &unused));
+      return InnerProductSearchShapeFn(c, 0);
+    })
+    .Doc(R"doc(
+Finds the points of an int8 quantized database with the largest inner products
+with each query.
+
+Database point `i` represents the vector `database_scales[i] * database[i, :]`.
+The queries are quantized to int8 per query with a symmetric scale, and scores
+are computed with integer dot products, so the results are approximate.
+
+queries: the query matrix, of shape `batch_size` times `dim`.
+database: the quantized database matrix, of shape `num_points` times `dim`.
+database_scales: the scale of each database point, of shape `num_points`.
+k: the number of results per query. Must be at most `num_points`.
+scores: the `k` largest approximate inner products for each query, in
+  decreasing order. Size `batch_size` times `k`.
+indices: the database rows of the results. Size `batch_size` times `k`.
+)doc");
+
+REGISTER_OP("ProductQuantizedInnerProductSearch")
+    .Input("queries: float")
+    .Input("codebooks: float")
+    .Input("codes: uint8")
+    .Input("k: int32")
+    .Output("scores: float")
+    .Output("indices: int64")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle codebooks;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 3, &codebooks));
+      ShapeHandle codes;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &codes));
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(codebooks, 0), c->Dim(codes, 1), &unused));
+      TF_RETURN_IF_ERROR(c->WithValue(c->Dim(codebooks, 1), 256, &unused));
+      return InnerProductSearchShapeFn(c, 0);
+    })
+    .Doc(R"doc(
+Finds the points of a product-quantized database with the largest inner
+products with each query.
+
+The `dim` dimensions are split into `num_subspaces` contiguous subspaces of
+`subspace_dim = dim / num_subspaces` dimensions. Database point `i` represents
+the concatenation of `codebooks[m, codes[i, m], :]` over all subspaces `m`.
+Each query is expanded into a table of its inner products with all codewords,
+so scoring a point costs `num_subspaces` table lookups.
+
+queries: the query matrix, of shape `batch_size` times `dim`.
+codebooks: the codewords, of shape `num_subspaces` times 256 times
+  `subspace_dim`.
+codes: the codeword of every database point in every subspace, of shape
+  `num_points` times `num_subspaces`.
+k: the number of results per query. Must be at most `num_points`.
+scores: the `k` largest approximate inner products for each query, in
+  decreasing order. Size `batch_size` times `k`.
+indices: the database rows of the results. Size `batch_size` times `k`.
+)doc");
+
+REGISTER_RESOURCE_HANDLE_OP(IvfIndexResource);
+
+REGISTER_OP("IvfIndexIsInitialized")
+    .Input("index_handle: resource")
+    .Output("is_initialized: bool")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused_input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused_input));
+      c->set_output(0, c->Scalar());
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Checks whether an IVF index has been created.
+)doc");
+
+REGISTER_OP("CreateIvfIndex")
+    .Input("index_handle: resource")
+    .Attr("dim: int >= 1")
+    .Attr("num_lists: int >= 1")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused_input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused_input));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Creates an empty, untrained inverted file (IVF) index for approximate maximum
+inner product search.
+
+The index partitions the database into `num_lists` inverted lists, one per
+centroid of a k-means clustering of training data. Points are stored in the
+list of the centroid with the largest inner product, and queries only score
+the points in the lists of their best scoring centroids.
+
+index_handle: Handle to the index resource to be created.
+dim: the dimension of the indexed vectors.
+num_lists: the number of inverted lists (k-means centroids).
+)doc");
+
+REGISTER_OP("IvfIndexTrain")
+    .Input("index_handle: resource")
+    .Input("samples: float")
+    .Attr("num_iterations: int >= 0 = 10")
+    .Attr("seed: int = 0")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused_input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused_input));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &unused_input));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Computes the centroids of an empty IVF index with k-means.
+
+index_handle: Handle to the index.
+samples: training vectors, of shape `num_samples` times `dim`. Requires
+  `num_samples >= num_lists`.
+num_iterations: the number of iterations of Lloyd's algorithm.
+seed: the seed for the k-means++ initialization.
+)doc");
+
+REGISTER_OP("IvfIndexAdd")
+    .Input("index_handle: resource")
+    .Input("ids: int64")
+    .Input("vectors: float")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused_input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused_input));
+      ShapeHandle ids;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &ids));
+      ShapeHandle vectors;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &vectors));
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(ids, 0), c->Dim(vectors, 0), &unused));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Adds vectors to a trained IVF index.
+
+index_handle: Handle to the index.
+ids: the ids returned by searches for the added vectors, of shape
+  `num_points`.
+vectors: the vectors to add, of shape `num_points` times `dim`.
+)doc");
+
+REGISTER_OP("IvfIndexSearch")
+    .Input("index_handle: resource")
+    .Input("queries: float")
+    .Input("k: int32")
+    .Attr("num_probes: int >= 1 = 1")
+    .Output("scores: float")
+    .Output("ids: int64")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused_input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused_input));
+      return InnerProductSearchShapeFn(c, 1);
+    })
+    .Doc(R"doc(
+Finds approximate nearest neighbors by inner product in an IVF index.
+
+Each query scores all centroids and exactly scores the points in the
+`num_probes` lists with the largest centroid scores. Queries are searched in
+parallel.
+
+index_handle: Handle to the index.
+queries: the query matrix, of shape `batch_size` times `dim`.
+k: the number of results per query.
+num_probes: the number of inverted lists to search per query.
+scores: the `k` largest inner products found for each query, in decreasing
+  order. If fewer than `k` points were scored, the remaining scores are `-inf`.
+  Size `batch_size` times `k`.
+ids: the ids of the results, or -1 for missing results. Size `batch_size`
+  times `k`.
+)doc");
+
+REGISTER_OP("IvfIndexSize")
+    .Input("index_handle: resource")
+    .Output("size: int64")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused_input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused_input));
+      c->set_output(0, c->Scalar());
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Returns the number of points in an IVF index.
+)doc");
+
+REGISTER_OP("IvfIndexSerialize")
+    .Input("index_handle: resource")
+    .Output("centroids: float")
+    .Output("list_sizes: int64")
+    .Output("ids: int64")
+    .Output("vectors: float")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused_input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused_input));
+      c->set_output(0, c->Matrix(c->UnknownDim(), c->UnknownDim()));
+      c->set_output(1, c->Vector(c->UnknownDim()));
+      c->set_output(2, c->Vector(c->UnknownDim()));
+      c->set_output(3, c->Matrix(c->UnknownDim(), c->UnknownDim()));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Exports the contents of an IVF index as tensors, e.g. for checkpointing.
+
+index_handle: Handle to the index.
+centroids: the centroids, of shape `num_lists` times `dim`, or `0` times `dim`
+  for an untrained index.
+list_sizes: the number of points in each list, of shape `num_lists`.
+ids: the ids of all points, concatenated in list order.
+vectors: the vectors of all points, concatenated in list order.
+)doc");
+
+REGISTER_OP("IvfIndexDeserialize")
+    .Input("index_handle: resource")
+    .Input("centroids: float")
+    .Input("list_sizes: int64")
+    .Input("ids: int64")
+    .Input("vectors: float")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused_input;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused_input));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &unused_input));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &unused_input));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 1, &unused_input));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(4), 2, &unused_input));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Replaces the contents of an IVF index with tensors from IvfIndexSerialize.
+
+index_handle: Handle to the index.
+centroids: the centroids, of shape `num_lists` times `dim`, or `0` times `dim`
+  for an untrained index.
+list_sizes: the number of points in each list, of shape `num_lists`.
+ids: the ids of all points, concatenated in list order.
+vectors: the vectors of all points, concatenated in list order.
+)doc");
+
 }  // namespace tensorflow
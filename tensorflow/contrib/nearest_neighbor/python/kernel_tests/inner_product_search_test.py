@@ -0,0 +1,117 @@
+# Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for the inner product search ops."""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import numpy as np
+
+from tensorflow.contrib.nearest_neighbor.python.ops.nearest_neighbor_ops import inner_product_search
+from tensorflow.contrib.nearest_neighbor.python.ops.nearest_neighbor_ops import product_quantized_inner_product_search
+from tensorflow.contrib.nearest_neighbor.python.ops.nearest_neighbor_ops import quantized_inner_product_search
+from tensorflow.python.client import session
+from tensorflow.python.framework import constant_op
+from tensorflow.python.framework import ops
+from tensorflow.python.ops import math_ops
+from tensorflow.python.ops import nn_ops
+from tensorflow.python.platform import test
+
+
+class InnerProductSearchTest(test.TestCase):
+
+  def testMatchesMatMulTopK(self):
+    rng = np.random.RandomState(0)
+    queries = rng.randn(5, 32).astype(np.float32)
+    database = rng.randn(20000, 32).astype(np.float32)
+    k = 10
+    with self.test_session():
+      scores, indices = inner_product_search(queries, database, k)
+      all_scores = np.dot(queries, database.T)
+      expected_indices = np.argsort(-all_scores, axis=1)[:, :k]
+      self.assertAllEqual(expected_indices, indices.eval())
+      self.assertAllClose(-np.sort(-all_scores, axis=1)[:, :k], scores.eval(),
+                          rtol=1e-4, atol=1e-4)
+
+  def testQuantized(self):
+    rng = np.random.RandomState(1)
+    queries = rng.randn(3, 16).astype(np.float32)
+    database = rng.randn(1000, 16).astype(np.float32)
+    scales = np.abs(database).max(axis=1) / 127.0
+    quantized = np.round(database / scales[:, None]).astype(np.int8)
+    with self.test_session():
+      scores, indices = quantized_inner_product_search(
+          queries, quantized, scales.astype(np.float32), 1000)
+      scores, indices = scores.eval(), indices.eval()
+      # Every point is returned, in (approximately) the exact order.
+      exact = np.dot(queries, (quantized * scales[:, None]).T)
+      self.assertAllEqual(np.sort(indices, axis=1),
+                          np.tile(np.arange(1000), (3, 1)))
+      self.assertAllClose(
+          np.array([exact[i, indices[i]] for i in range(3)]), scores,
+          rtol=0.05, atol=0.05)
+
+  def testProductQuantized(self):
+    rng = np.random.RandomState(2)
+    num_subspaces, subspace_dim = 4, 2
+    queries = rng.randn(2, num_subspaces * subspace_dim).astype(np.float32)
+    codebooks = rng.randn(num_subspaces, 256, subspace_dim).astype(np.float32)
+    codes = rng.randint(0, 256, size=(500, num_subspaces)).astype(np.uint8)
+    decoded = np.concatenate(
+        [codebooks[m, codes[:, m], :] for m in range(num_subspaces)], axis=1)
+    k = 7
+    with self.test_session():
+      scores, indices = product_quantized_inner_product_search(
+          queries, codebooks, codes, k)
+      all_scores = np.dot(queries, decoded.T)
+      self.assertAllEqual(np.argsort(-all_scores, axis=1)[:, :k],
+                          indices.eval())
+      self.assertAllClose(-np.sort(-all_scores, axis=1)[:, :k], scores.eval(),
+                          rtol=1e-4, atol=1e-4)
+
+  def testKTooLarge(self):
+    with self.test_session():
+      scores, _ = inner_product_search(
+          np.zeros((1, 2), np.float32), np.zeros((3, 2), np.float32), 4)
+      with self.assertRaisesOpError("Need k <= num_points"):
+        scores.eval()
+
+
+class InnerProductSearchBenchmark(test.Benchmark):
+
+  def benchmarkInnerProductSearchVersusMatMulTopK(self):
+    num_points, dim, k = 1000000, 128, 100
+    rng = np.random.RandomState(0)
+    database_value = rng.randn(num_points, dim).astype(np.float32)
+    for batch_size in [1, 16, 128]:
+      with ops.Graph().as_default():
+        queries = constant_op.constant(
+            rng.randn(batch_size, dim).astype(np.float32))
+        database = constant_op.constant(database_value)
+        fused = inner_product_search(queries, database, k)
+        unfused = nn_ops.top_k(
+            math_ops.matmul(queries, database, transpose_b=True), k)
+        with session.Session() as sess:
+          for name, op in [("inner_product_search", fused),
+                           ("matmul_top_k", unfused)]:
+            self.run_op_benchmark(
+                sess, op, min_iters=10,
+                name="%s_batch_%d_points_%d_dim_%d_k_%d" %
+                (name, batch_size, num_points, dim, k))
+
+
+if __name__ == "__main__":
+  test.main()
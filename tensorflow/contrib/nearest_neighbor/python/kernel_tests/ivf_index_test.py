@@ -0,0 +1,95 @@
+# Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for the IVF index ops."""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import os
+
+import numpy as np
+
+from tensorflow.contrib.nearest_neighbor.python.ops import nearest_neighbor_ops
+from tensorflow.python.framework import ops
+from tensorflow.python.ops import resources
+from tensorflow.python.platform import test
+from tensorflow.python.training import saver
+
+
+class IvfIndexTest(test.TestCase):
+
+  def _clustered_points(self, num_points, dim, num_clusters, seed):
+    rng = np.random.RandomState(seed)
+    centers = rng.randn(num_clusters, dim).astype(np.float32) * 5
+    labels = rng.randint(0, num_clusters, size=num_points)
+    return centers[labels] + rng.randn(num_points, dim).astype(np.float32)
+
+  def testSearchAllListsIsExact(self):
+    points = self._clustered_points(2000, 8, 16, seed=0)
+    ids = np.arange(2000, dtype=np.int64) * 3
+    queries = np.random.RandomState(1).randn(4, 8).astype(np.float32)
+    with self.test_session() as sess:
+      index = nearest_neighbor_ops.ivf_index(8, 16, name="index")
+      resources.initialize_resources(resources.shared_resources()).run()
+      sess.run(nearest_neighbor_ops.ivf_index_train(index, points))
+      sess.run(nearest_neighbor_ops.ivf_index_add(index, ids, points))
+      self.assertEqual(2000, nearest_neighbor_ops.ivf_index_size(index).eval())
+      scores, result_ids = sess.run(
+          nearest_neighbor_ops.ivf_index_search(index, queries, 10,
+                                                num_probes=16))
+    all_scores = np.dot(queries, points.T)
+    self.assertAllEqual(ids[np.argsort(-all_scores, axis=1)[:, :10]],
+                        result_ids)
+    self.assertAllClose(-np.sort(-all_scores, axis=1)[:, :10], scores,
+                        rtol=1e-4, atol=1e-4)
+
+  def testAddBeforeTrainFails(self):
+    with self.test_session() as sess:
+      index = nearest_neighbor_ops.ivf_index(2, 1, name="index")
+      resources.initialize_resources(resources.shared_resources()).run()
+      with self.assertRaisesOpError("must be trained"):
+        sess.run(nearest_neighbor_ops.ivf_index_add(
+            index, np.zeros([1], np.int64), np.zeros([1, 2], np.float32)))
+
+  def testSaveRestore(self):
+    save_path = os.path.join(self.get_temp_dir(), "ivf_index")
+    points = self._clustered_points(500, 4, 8, seed=2)
+    ids = np.arange(500, dtype=np.int64)
+    queries = np.random.RandomState(3).randn(3, 4).astype(np.float32)
+
+    with ops.Graph().as_default() as g, self.test_session(graph=g) as sess:
+      index = nearest_neighbor_ops.ivf_index(4, 8, name="index")
+      resources.initialize_resources(resources.shared_resources()).run()
+      sess.run(nearest_neighbor_ops.ivf_index_train(index, points))
+      sess.run(nearest_neighbor_ops.ivf_index_add(index, ids, points))
+      expected = sess.run(
+          nearest_neighbor_ops.ivf_index_search(index, queries, 5,
+                                                num_probes=2))
+      saver.Saver().save(sess, save_path)
+
+    with ops.Graph().as_default() as g, self.test_session(graph=g) as sess:
+      index = nearest_neighbor_ops.ivf_index(4, 8, name="index")
+      saver.Saver().restore(sess, save_path)
+      self.assertEqual(500, nearest_neighbor_ops.ivf_index_size(index).eval())
+      actual = sess.run(
+          nearest_neighbor_ops.ivf_index_search(index, queries, 5,
+                                                num_probes=2))
+    self.assertAllClose(expected[0], actual[0])
+    self.assertAllEqual(expected[1], actual[1])
+
+
+if __name__ == "__main__":
+  test.main()
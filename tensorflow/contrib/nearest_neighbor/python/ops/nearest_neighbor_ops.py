@@ -20,7 +20,9 @@ from __future__ import print_function
 
 from tensorflow.contrib.util import loader
 from tensorflow.python.framework import ops
+from tensorflow.python.ops import resources
 from tensorflow.python.platform import resource_loader
+from tensorflow.python.training import saver
 
 _nearest_neighbor_ops = loader.load_op_library(
     resource_loader.get_path_to_datafile("_nearest_neighbor_ops.so"))
@@ -62,3 +64,226 @@ def hyperplane_lsh_probes(point_hyperplane_product,
                                                      name=name)
 
 ops.NotDifferentiable("HyperplaneLSHProbes")
+
+
+def inner_product_search(queries, database, k, name=None):
+  """Finds the database points with the largest inner products with queries.
+
+  This is an exact search equivalent to
+  `tf.nn.top_k(tf.matmul(queries, database, transpose_b=True), k)`, but the
+  database is streamed through in cache-sized tiles so that the full score
+  matrix is never materialized.
+
+  Args:
+    queries: a float matrix of shape `batch_size` times `dim`.
+    database: a float matrix of shape `num_points` times `dim`.
+    k: the number of results per query. Must be at most `num_points`.
+    name: A name prefix for the returned tensors (optional).
+
+  Returns:
+    scores: the `k` largest inner products for each query, in decreasing order.
+      Size `batch_size` times `k`.
+    indices: the database rows (int64) of the results. Size `batch_size` times
+      `k`.
+  """
+  return _nearest_neighbor_ops.inner_product_search(queries, database, k,
+                                                    name=name)
+
+
+def quantized_inner_product_search(queries,
+                                   database,
+                                   database_scales,
+                                   k,
+                                   name=None):
+  """Approximate inner product search over an int8 quantized database.
+
+  Args:
+    queries: a float matrix of shape `batch_size` times `dim`.
+    database: an int8 matrix of shape `num_points` times `dim`. Row `i`
+      represents the vector `database_scales[i] * database[i, :]`.
+    database_scales: a float vector of shape `num_points`.
+    k: the number of results per query. Must be at most `num_points`.
+    name: A name prefix for the returned tensors (optional).
+
+  Returns:
+    scores: the `k` largest approximate inner products for each query, in
+      decreasing order. Size `batch_size` times `k`.
+    indices: the database rows (int64) of the results. Size `batch_size` times
+      `k`.
+  """
+  return _nearest_neighbor_ops.quantized_inner_product_search(
+      queries, database, database_scales, k, name=name)
+
+
+def product_quantized_inner_product_search(queries,
+                                           codebooks,
+                                           codes,
+                                           k,
+                                           name=None):
+  """Approximate inner product search over a product-quantized database.
+
+  Args:
+    queries: a float matrix of shape `batch_size` times `dim`.
+    codebooks: a float tensor of shape `num_subspaces` times 256 times
+      `dim / num_subspaces`.
+    codes: a uint8 matrix of shape `num_points` times `num_subspaces`. Point
+      `i` represents the concatenation of `codebooks[m, codes[i, m], :]` over
+      all subspaces `m`.
+    k: the number of results per query. Must be at most `num_points`.
+    name: A name prefix for the returned tensors (optional).
+
+  Returns:
+    scores: the `k` largest approximate inner products for each query, in
+      decreasing order. Size `batch_size` times `k`.
+    indices: the database rows (int64) of the results. Size `batch_size` times
+      `k`.
+  """
+  return _nearest_neighbor_ops.product_quantized_inner_product_search(
+      queries, codebooks, codes, k, name=name)
+
+ops.NotDifferentiable("InnerProductSearch")
+ops.NotDifferentiable("QuantizedInnerProductSearch")
+ops.NotDifferentiable("ProductQuantizedInnerProductSearch")
+
+
+class IvfIndexSaveable(saver.BaseSaverBuilder.SaveableObject):
+  """SaveableObject implementation for IVF indexes."""
+
+  def __init__(self, index_handle, create_op, name):
+    """Creates an IvfIndexSaveable object.
+
+    Args:
+      index_handle: handle to the IVF index resource.
+      create_op: the op to create the index.
+      name: the name to save the index under.
+    """
+    centroids, list_sizes, ids, vectors = (
+        _nearest_neighbor_ops.ivf_index_serialize(index_handle))
+    # The index is always saved in full, so there is no slice spec.
+    slice_spec = ""
+    specs = [
+        saver.BaseSaverBuilder.SaveSpec(centroids, slice_spec,
+                                        name + "_centroids"),
+        saver.BaseSaverBuilder.SaveSpec(list_sizes, slice_spec,
+                                        name + "_list_sizes"),
+        saver.BaseSaverBuilder.SaveSpec(ids, slice_spec, name + "_ids"),
+        saver.BaseSaverBuilder.SaveSpec(vectors, slice_spec, name + "_vectors"),
+    ]
+    super(IvfIndexSaveable, self).__init__(index_handle, specs, name)
+    self._index_handle = index_handle
+    self._create_op = create_op
+
+  def restore(self, restored_tensors, unused_restored_shapes):
+    """Restores the associated index from 'restored_tensors'.
+
+    Args:
+      restored_tensors: the tensors that were loaded from a checkpoint.
+      unused_restored_shapes: the shapes this object should conform to after
+        restore. Not meaningful for indexes.
+
+    Returns:
+      The operation that restores the state of the index.
+    """
+    with ops.control_dependencies([self._create_op]):
+      return _nearest_neighbor_ops.ivf_index_deserialize(
+          self._index_handle, *restored_tensors)
+
+
+def ivf_index(dim, num_lists, name, container=None):
+  """Creates an inverted file (IVF) index and returns a handle to it.
+
+  The index supports approximate maximum inner product search. It partitions
+  the database into `num_lists` inverted lists, one per centroid of a k-means
+  clustering computed by `ivf_index_train`. Queries only score the points in
+  the lists of their best scoring centroids.
+
+  The index is registered as a shared resource, so it is created by
+  `resources.initialize_resources(resources.shared_resources())` (part of the
+  default `tf.train.Scaffold` init op), and it is saved to and restored from
+  checkpoints by `tf.train.Saver`.
+
+  Args:
+    dim: the dimension of the indexed vectors.
+    num_lists: the number of inverted lists.
+    name: A name for the index.
+    container: An optional `string`. Defaults to `""`.
+
+  Returns:
+    A `Tensor` of type `resource`. The handle to the index.
+  """
+  with ops.name_scope(name, "IvfIndex") as name:
+    index_handle = _nearest_neighbor_ops.ivf_index_resource_handle_op(
+        container=container, shared_name=name, name=name)
+    create_op = _nearest_neighbor_ops.create_ivf_index(
+        index_handle, dim=dim, num_lists=num_lists)
+    is_initialized_op = _nearest_neighbor_ops.ivf_index_is_initialized(
+        index_handle)
+    # Adds the index to the saveable list.
+    saveable = IvfIndexSaveable(index_handle, create_op, index_handle.name)
+    ops.add_to_collection(ops.GraphKeys.SAVEABLE_OBJECTS, saveable)
+    resources.register_resource(index_handle, create_op, is_initialized_op)
+    return index_handle
+
+
+def ivf_index_train(index_handle, samples, num_iterations=10, seed=0,
+                    name=None):
+  """Computes the centroids of an empty IVF index with k-means.
+
+  Args:
+    index_handle: handle to the index.
+    samples: training vectors, of shape `num_samples` times `dim`, with
+      `num_samples >= num_lists`.
+    num_iterations: the number of iterations of Lloyd's algorithm.
+    seed: the seed for the k-means++ initialization.
+    name: A name for the operation (optional).
+
+  Returns:
+    The training op.
+  """
+  return _nearest_neighbor_ops.ivf_index_train(
+      index_handle, samples, num_iterations=num_iterations, seed=seed,
+      name=name)
+
+
+def ivf_index_add(index_handle, ids, vectors, name=None):
+  """Adds vectors with the given int64 ids to a trained IVF index.
+
+  Args:
+    index_handle: handle to the index.
+    ids: the ids of the vectors, of shape `num_points`.
+    vectors: the vectors, of shape `num_points` times `dim`.
+    name: A name for the operation (optional).
+
+  Returns:
+    The op that adds the vectors.
+  """
+  return _nearest_neighbor_ops.ivf_index_add(index_handle, ids, vectors,
+                                             name=name)
+
+
+def ivf_index_search(index_handle, queries, k, num_probes=1, name=None):
+  """Finds approximate nearest neighbors by inner product in an IVF index.
+
+  Args:
+    index_handle: handle to the index.
+    queries: the query matrix, of shape `batch_size` times `dim`.
+    k: the number of results per query.
+    num_probes: the number of inverted lists to search per query.
+    name: A name prefix for the returned tensors (optional).
+
+  Returns:
+    scores: the `k` largest inner products found for each query, in decreasing
+      order, padded with `-inf`. Size `batch_size` times `k`.
+    ids: the ids of the results, padded with -1. Size `batch_size` times `k`.
+  """
+  return _nearest_neighbor_ops.ivf_index_search(
+      index_handle, queries, k, num_probes=num_probes, name=name)
+
+
+def ivf_index_size(index_handle, name=None):
+  """Returns the number of points in an IVF index."""
+  return _nearest_neighbor_ops.ivf_index_size(index_handle, name=name)
+
+ops.NotDifferentiable("IvfIndexSearch")
+ops.NotDifferentiable("IvfIndexSerialize")
+ops.NotDifferentiable("IvfIndexDeserialize")
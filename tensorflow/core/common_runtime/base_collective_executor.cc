@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/common_runtime/ring_reducer.h"
+#include "tensorflow/core/common_runtime/tree_reducer.h"
 #include "tensorflow/core/lib/core/notification.h"
 
 #define VALUE_IN_DEBUG_STRING false
@@ -106,6 +107,16 @@ class CollectiveAdapterImpl : public CollectiveAdapter {
 
   int64 ChunkBytes(int i) const override { return sizeof(T) * ChunkElts(i); }
 
+  // Number of T elements in chunks [begin, end).
+  inline int64 ChunkRangeElts(int begin, int end) const {
+    DCHECK_LE(begin, end);
+    DCHECK_LE(end, num_chunks_);
+    const T* range_start =
+        std::min(data_end_, data_start_ + begin * chunk_elts_);
+    const T* range_end = std::min(data_end_, data_start_ + end * chunk_elts_);
+    return range_end - range_start;
+  }
+
   // Returns a new Tensor that aliases the required chunk.
   Tensor ChunkAlias(int i) override {
     int64 start = chunk_elts_ * i;
@@ -122,6 +133,19 @@ class CollectiveAdapterImpl : public CollectiveAdapter {
     return Tensor(allocator_, dt_, {ChunkElts(i)}, empty);
   }
 
+  Tensor ChunkRangeAlias(int begin, int end) override {
+    int64 start = chunk_elts_ * begin;
+    int64 num_elts = ChunkRangeElts(begin, end);
+    // As in ChunkAlias, empty ranges are taken from the front.
+    return (num_elts > 0) ? output_.Slice(start, start + num_elts)
+                          : output_.Slice(0, 0);
+  }
+
+  Tensor TempChunkRange(int begin, int end) const override {
+    AllocationAttributes empty;
+    return Tensor(allocator_, dt_, {ChunkRangeElts(begin, end)}, empty);
+  }
+
   string DebugString() const override {
     return strings::StrCat(
         "base addr ", reinterpret_cast<int64>(DMAHelper::base(&output_)),
@@ -182,11 +206,60 @@ CollectiveAdapter* MakeCollectiveAdapter(Tensor* output, int num_chunks,
   }
 }
 
+namespace {
+// Reductions of at least this many bytes are bandwidth bound, where the
+// RingReducer, which can also split the ring into subdivisions, does best.
+const int64 kRingReduceMinBytes = 4 << 20;
+// Reductions of fewer bytes are latency bound and use recursive halving,
+// which has the fewest steps.  Sizes in between use pipelined trees.
+const int64 kBinaryTreeReduceMinBytes = 64 << 10;
+}  // namespace
+
+ReduceAlgorithm ChooseReduceAlgorithm(const CollectiveParams& col_params,
+                                      int64 tensor_bytes) {
+  const int group_size = col_params.group.group_size;
+  const int num_tasks = col_params.group.num_tasks;
+  // With two members all of the algorithms exchange the same messages.
+  if (group_size <= 2 || tensor_bytes >= kRingReduceMinBytes) {
+    return RING_REDUCE;
+  }
+  // With several devices in each of several tasks keep the traffic between
+  // tasks to one message per device and step.
+  if (num_tasks > 1 && num_tasks < group_size &&
+      col_params.instance.same_num_devices_per_task) {
+    return HIERARCHICAL_REDUCE;
+  }
+  if (tensor_bytes < kBinaryTreeReduceMinBytes) {
+    return RECURSIVE_HALVING_REDUCE;
+  }
+  return DOUBLE_BINARY_TREE_REDUCE;
+}
+
+BaseCollectiveExecutor::BaseCollectiveExecutor(
+    CollectiveExecutorMgrInterface* cem,
+    PerStepCollectiveRemoteAccess* remote_access, int64 step_id,
+    const DeviceMgr* dev_mgr, int64 fusion_threshold_bytes)
+    : CollectiveExecutor(cem),
+      step_id_(step_id),
+      dev_mgr_(dev_mgr),
+      remote_access_(remote_access) {
+  if (fusion_threshold_bytes > 0) {
+    fusion_.reset(new CollectiveFusion(
+        this, dev_mgr_, fusion_threshold_bytes,
+        [this](OpKernelContext* ctx, const CollectiveParams& col_params,
+               const string& exec_key, const Tensor* input, Tensor* output,
+               const StatusCallback& done) {
+          ReduceAsync(ctx, col_params, exec_key, input, output, done);
+        }));
+  }
+}
+
 BaseCollectiveExecutor::~BaseCollectiveExecutor() {}
 
 void BaseCollectiveExecutor::StartAbort(const Status& s) {
   LOG(WARNING) << "BaseCollectiveExecutor::StartAbort " << s;
   remote_access_->StartAbort(s);
+  if (fusion_) fusion_->StartAbort(s);
 }
 
 void BaseCollectiveExecutor::ExecuteAsync(OpKernelContext* ctx,
@@ -214,26 +287,12 @@ void BaseCollectiveExecutor::ExecuteAsync(OpKernelContext* ctx,
   string error;
   switch (col_params.instance.type) {
     case REDUCTION_COLLECTIVE: {
-      // TODO(tucker): support other reduction algorithms,
-      // e.g. tree-reduce, hybrid tree/ring, delegate-to-NCCL, etc.
-      const Tensor* input = &ctx->input(0);
-      RingReducer* reducer =
-          CreateReducer(ctx, CtxParams(ctx), col_params, exec_key, step_id_,
-                        input, output, &error);
-      if (!reducer) {
-        done_safe(errors::Internal(error));
+      if (fusion_ && fusion_->CanFuse(ctx, col_params)) {
+        fusion_->Enqueue(ctx, col_params, exec_key, done_safe);
         return;
       }
-      // Run in an I/O thread, so as not to starve the executor threads.
-      // TODO(tucker): Instead of forking every per-device Collective
-      // Op off into its own thread, consider queuing them on a
-      // fixed-size thread-pool dedicated to running CollectiveOps.
-      SchedClosure([reducer, done_safe]() {
-        reducer->Run([reducer, done_safe](const Status& s) {
-          done_safe(s);
-          delete reducer;
-        });
-      });
+      ReduceAsync(ctx, col_params, exec_key, &ctx->input(0), output,
+                  done_safe);
     } break;
 
     case BROADCAST_COLLECTIVE: {
@@ -258,7 +317,34 @@ void BaseCollectiveExecutor::ExecuteAsync(OpKernelContext* ctx,
   }
 }
 
-RingReducer* BaseCollectiveExecutor::CreateReducer(
+void BaseCollectiveExecutor::ReduceAsync(OpKernelContext* ctx,
+                                         const CollectiveParams& col_params,
+                                         const string& exec_key,
+                                         const Tensor* input, Tensor* output,
+                                         const StatusCallback& done) {
+  // TODO(tucker): support other reduction algorithms,
+  // e.g. hybrid tree/ring, delegate-to-NCCL, etc.
+  string error;
+  CollectiveReducer* reducer = CreateReducer(
+      ctx, CtxParams(ctx), col_params, exec_key, step_id_, input, output,
+      &error);
+  if (!reducer) {
+    done(errors::Internal(error));
+    return;
+  }
+  // Run in an I/O thread, so as not to starve the executor threads.
+  // TODO(tucker): Instead of forking every per-device Collective
+  // Op off into its own thread, consider queuing them on a
+  // fixed-size thread-pool dedicated to running CollectiveOps.
+  SchedClosure([reducer, done]() {
+    reducer->Run([reducer, done](const Status& s) {
+      done(s);
+      delete reducer;
+    });
+  });
+}
+
+CollectiveReducer* BaseCollectiveExecutor::CreateReducer(
     OpKernelContext* ctx, OpKernelContext::Params* params,
     const CollectiveParams& col_params, const string& exec_key, int64 step_id,
     const Tensor* input, Tensor* output, string* error) {
@@ -273,10 +359,16 @@ RingReducer* BaseCollectiveExecutor::CreateReducer(
       TF_FALLTHROUGH_INTENDED;
     case DT_FLOAT:
     case DT_DOUBLE:
-    case DT_INT64:
-      return new RingReducer(this, dev_mgr_, ctx, params, col_params, exec_key,
-                             step_id, input, output);
-      break;
+    case DT_INT64: {
+      const ReduceAlgorithm algorithm =
+          ChooseReduceAlgorithm(col_params, input->TotalBytes());
+      if (algorithm == RING_REDUCE) {
+        return new RingReducer(this, dev_mgr_, ctx, params, col_params,
+                               exec_key, step_id, input, output);
+      }
+      return new TreeReducer(this, dev_mgr_, ctx, params, col_params, exec_key,
+                             step_id, algorithm, input, output);
+    } break;
     default:
       *error = strings::StrCat("Collective Reduce does not support datatype ",
                                col_params.instance.data_type);
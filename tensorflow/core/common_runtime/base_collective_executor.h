@@ -17,13 +17,13 @@ limitations under the License.
 
 #include <string>
 #include "tensorflow/core/common_runtime/buf_rendezvous.h"
+#include "tensorflow/core/common_runtime/collective_fusion.h"
 #include "tensorflow/core/framework/collective.h"
 #include "tensorflow/core/framework/device_attributes.pb.h"
 
 namespace tensorflow {
 class Broadcaster;
 class DeviceMgr;
-class RingReducer;
 
 // Helper interface that aliases regular subfields of a Tensor as separate
 // Tensors for in-place update.
@@ -50,6 +50,15 @@ class CollectiveAdapter {
   // Bytes in chunk i
   virtual int64 ChunkBytes(int i) const = 0;
 
+  // Returns tensor for the contiguous chunks [begin, end) which aliases
+  // the backing buffer.
+  virtual Tensor ChunkRangeAlias(int begin, int end) = 0;
+
+  // Returns tensor allocated on the same device but with its own
+  // separate backing buffer.  Will have same type and size as
+  // chunks [begin, end).
+  virtual Tensor TempChunkRange(int begin, int end) const = 0;
+
   // Generate a CPU RAM scalar tensor of the same DataType as the
   // backing tensor with the given integer value.
   virtual Tensor Scalar(int v) const = 0;
@@ -80,18 +89,52 @@ class CollectiveAdapter {
 CollectiveAdapter* MakeCollectiveAdapter(Tensor* output, int num_chunks,
                                          Allocator* allocator);
 
+// Interface of the classes implementing a REDUCTION_COLLECTIVE for
+// one device.
+class CollectiveReducer {
+ public:
+  virtual ~CollectiveReducer() {}
+
+  // Reduces the input into the output of the collective Op and then
+  // calls 'done'.  Blocks, so must run in a blockable thread.
+  virtual void Run(StatusCallback done) = 0;
+};
+
+// Algorithms implementing REDUCTION_COLLECTIVE.
+enum ReduceAlgorithm {
+  // RingReducer: 2 * (N - 1) latency steps, bandwidth optimal.
+  RING_REDUCE = 0,
+  // TreeReducer with a recursive halving reduce-scatter followed by a
+  // recursive doubling all-gather: 2 * log2(N) latency steps.
+  RECURSIVE_HALVING_REDUCE,
+  // TreeReducer with two complementary binary trees, each reducing and
+  // then broadcasting a pipelined half of the tensor.
+  DOUBLE_BINARY_TREE_REDUCE,
+  // TreeReducer with recursive halving/doubling first among the devices
+  // of each task and then among the devices of equal local rank in
+  // different tasks.
+  HIERARCHICAL_REDUCE,
+};
+
+// Returns the algorithm to use for reducing tensors of 'tensor_bytes'
+// bytes across the group described by 'col_params', which must have
+// been completed by a ParamResolver.  Every member of the group makes
+// the same choice.
+ReduceAlgorithm ChooseReduceAlgorithm(const CollectiveParams& col_params,
+                                      int64 tensor_bytes);
+
 // Default implementation of CollectiveExecutor.  Delegates the actual
 // work of moving data to a class specialized for the operation type,
 // arguments and device+interconnect topology.
 class BaseCollectiveExecutor : public CollectiveExecutor {
  public:
+  // If 'fusion_threshold_bytes' is positive, reductions of smaller
+  // tensors that are pending at the same time are fused into one, see
+  // CollectiveFusion.
   BaseCollectiveExecutor(CollectiveExecutorMgrInterface* cem,
                          PerStepCollectiveRemoteAccess* remote_access,
-                         int64 step_id, const DeviceMgr* dev_mgr)
-      : CollectiveExecutor(cem),
-        step_id_(step_id),
-        dev_mgr_(dev_mgr),
-        remote_access_(remote_access) {}
+                         int64 step_id, const DeviceMgr* dev_mgr,
+                         int64 fusion_threshold_bytes = 0);
 
   ~BaseCollectiveExecutor() override;
 
@@ -131,14 +174,21 @@ class BaseCollectiveExecutor : public CollectiveExecutor {
   const int64 step_id_;
   const DeviceMgr* dev_mgr_;  // Not owned.
   std::unique_ptr<PerStepCollectiveRemoteAccess> remote_access_;
+  std::unique_ptr<CollectiveFusion> fusion_;
 
  private:
-  RingReducer* CreateReducer(OpKernelContext* ctx,
-                             OpKernelContext::Params* params,
-                             const CollectiveParams& col_params,
-                             const string& exec_key, int64 step_id,
-                             const Tensor* input, Tensor* output,
-                             string* error);
+  // Reduces 'input' into 'output' for the collective Op of 'ctx' in a
+  // separate thread, then calls 'done'.
+  void ReduceAsync(OpKernelContext* ctx, const CollectiveParams& col_params,
+                   const string& exec_key, const Tensor* input,
+                   Tensor* output, const StatusCallback& done);
+
+  CollectiveReducer* CreateReducer(OpKernelContext* ctx,
+                                   OpKernelContext::Params* params,
+                                   const CollectiveParams& col_params,
+                                   const string& exec_key, int64 step_id,
+                                   const Tensor* input, Tensor* output,
+                                   string* error);
 
   Broadcaster* CreateBroadcaster(OpKernelContext* ctx,
                                  OpKernelContext::Params* params,
@@ -0,0 +1,308 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/collective_fusion.h"
+
+#include <string.h>
+#include <algorithm>
+#include <iterator>
+
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+namespace {
+// Upper bound on the number of collectives in a batch, which sizes the
+// plan the leader sends.
+const int kMaxFusedCollectives = 128;
+
+string OpName(const std::unique_ptr<OpKernel>& op) {
+  return op ? op->type_string() : "Id";
+}
+}  // namespace
+
+CollectiveFusion::CollectiveFusion(CollectiveExecutor* col_exec,
+                                   const DeviceMgr* dev_mgr,
+                                   int64 threshold_bytes, ReduceFn reduce_fn)
+    : col_exec_(col_exec),
+      dev_mgr_(dev_mgr),
+      threshold_bytes_(threshold_bytes),
+      reduce_fn_(std::move(reduce_fn)) {}
+
+CollectiveFusion::~CollectiveFusion() {}
+
+bool CollectiveFusion::CanFuse(OpKernelContext* ctx,
+                               const CollectiveParams& col_params) const {
+  if (threshold_bytes_ <= 0 ||
+      col_params.instance.type != REDUCTION_COLLECTIVE ||
+      col_params.group.group_size < 2) {
+    return false;
+  }
+  // The fused buffer is packed and unpacked by memcpy.
+  if (col_params.group.device_type != DEVICE_CPU) return false;
+  switch (col_params.instance.data_type) {
+    case DT_FLOAT:
+    case DT_DOUBLE:
+    case DT_INT32:
+    case DT_INT64:
+      break;
+    default:
+      return false;
+  }
+  const Tensor& input = ctx->input(0);
+  return input.NumElements() > 0 && input.TotalBytes() < threshold_bytes_;
+}
+
+void CollectiveFusion::Enqueue(OpKernelContext* ctx,
+                               const CollectiveParams& col_params,
+                               const string& exec_key,
+                               const StatusCallback& done) {
+  const int rank = col_params.default_rank;
+  const string& device_name = col_params.instance.device_names[rank];
+  Device* device = nullptr;
+  Status status = dev_mgr_->LookupDevice(device_name, &device);
+  if (!status.ok()) {
+    done(status);
+    return;
+  }
+  const string key = strings::StrCat(
+      col_params.group.group_key, ":",
+      DataTypeString(col_params.instance.data_type), ":",
+      OpName(col_params.merge_op), ":", OpName(col_params.final_op));
+  Queue* queue = nullptr;
+  {
+    mutex_lock l(mu_);
+    status = status_;
+    if (status.ok()) {
+      std::unique_ptr<Queue>& q = queues_[strings::StrCat(device_name, key)];
+      if (!q) {
+        q.reset(new Queue);
+        q->key = key;
+        q->device = device;
+        q->is_leader = (rank == 0);
+      }
+      q->pending.push_back(
+          {ctx, &col_params, Hash64(exec_key.data(), exec_key.size()), done});
+      queue = q.get();
+    }
+  }
+  if (!status.ok()) {
+    done(status);
+    return;
+  }
+  Advance(queue);
+}
+
+void CollectiveFusion::StartAbort(const Status& s) {
+  std::vector<Entry> entries;
+  {
+    mutex_lock l(mu_);
+    status_ = s;
+    for (auto& it : queues_) {
+      Queue* queue = it.second.get();
+      for (Entry& e : queue->pending) entries.push_back(std::move(e));
+      queue->pending.clear();
+      queue->have_plan = false;
+    }
+  }
+  for (Entry& e : entries) e.done(s);
+}
+
+void CollectiveFusion::Advance(Queue* queue) {
+  std::unique_ptr<Batch> batch(new Batch);
+  int64 seq = 0;
+  OpKernelContext* recv_ctx = nullptr;
+  const CollectiveParams* recv_col_params = nullptr;
+  {
+    mutex_lock l(mu_);
+    std::vector<Entry>& pending = queue->pending;
+    if (queue->is_leader) {
+      if (queue->busy || pending.empty()) return;
+      // Take collectives in the order they arrived, up to the threshold.
+      int64 bytes = 0;
+      size_t num_entries = 0;
+      while (num_entries < pending.size() &&
+             num_entries < static_cast<size_t>(kMaxFusedCollectives)) {
+        const int64 entry_bytes =
+            pending[num_entries].ctx->input(0).TotalBytes();
+        if (num_entries > 0 && bytes + entry_bytes > threshold_bytes_) break;
+        bytes += entry_bytes;
+        ++num_entries;
+      }
+      batch->entries.assign(
+          std::make_move_iterator(pending.begin()),
+          std::make_move_iterator(pending.begin() + num_entries));
+      pending.erase(pending.begin(), pending.begin() + num_entries);
+      seq = queue->num_batches++;
+      queue->busy = true;
+    } else if (!queue->busy) {
+      if (pending.empty()) return;
+      recv_ctx = pending.front().ctx;
+      recv_col_params = pending.front().col_params;
+      seq = queue->num_batches++;
+      queue->busy = true;
+    } else {
+      if (!queue->have_plan) return;
+      // Join the batch once all of its collectives are pending here.
+      std::vector<size_t> indices;
+      for (uint64 id : queue->plan) {
+        size_t i = 0;
+        while (i < pending.size() &&
+               (pending[i].id != id || std::find(indices.begin(), indices.end(),
+                                                 i) != indices.end())) {
+          ++i;
+        }
+        if (i == pending.size()) return;
+        indices.push_back(i);
+      }
+      for (size_t i : indices) batch->entries.push_back(std::move(pending[i]));
+      std::sort(indices.begin(), indices.end());
+      for (auto it = indices.rbegin(); it != indices.rend(); ++it) {
+        pending.erase(pending.begin() + *it);
+      }
+      queue->have_plan = false;
+      seq = queue->num_batches - 1;
+    }
+  }
+  if (recv_ctx) {
+    RecvPlan(queue, seq, recv_ctx, *recv_col_params);
+    return;
+  }
+  batch->exec_key = strings::StrCat(queue->key, ":fused:", seq);
+  if (queue->is_leader) SendPlan(queue, seq, *batch);
+  RunBatch(queue, batch.release());
+}
+
+string CollectiveFusion::PlanKey(const Queue& queue, int64 seq,
+                                 int rank) const {
+  return strings::StrCat("fusion_plan:", queue.key, ":", seq, ":", rank);
+}
+
+void CollectiveFusion::SendPlan(Queue* queue, int64 seq, const Batch& batch) {
+  const Entry& first = batch.entries[0];
+  const CollectiveParams& col_params = *first.col_params;
+  std::shared_ptr<Tensor> plan(
+      new Tensor(DT_INT64, TensorShape({kMaxFusedCollectives + 1})));
+  auto plan_flat = plan->flat<int64>();
+  plan_flat(0) = batch.entries.size();
+  for (size_t i = 0; i < batch.entries.size(); ++i) {
+    plan_flat(i + 1) = static_cast<int64>(batch.entries[i].id);
+  }
+  CollectiveExecutor* col_exec = col_exec_;
+  for (int rank = 1; rank < col_params.group.group_size; ++rank) {
+    col_exec_->PostToPeer(col_params.instance.device_names[rank],
+                          col_params.instance.task_names[rank],
+                          PlanKey(*queue, seq, rank), queue->device,
+                          first.ctx->op_device_context(),
+                          AllocatorAttributes(), plan.get(),
+                          queue->device->attributes().locality(),
+                          [col_exec, plan](const Status& s) {
+                            // Without the plan the other members never join
+                            // the fused reduction, which would then wait for
+                            // them forever, so fail the step instead.
+                            if (!s.ok()) col_exec->StartAbort(s);
+                          });
+  }
+}
+
+void CollectiveFusion::RecvPlan(Queue* queue, int64 seq, OpKernelContext* ctx,
+                                const CollectiveParams& col_params) {
+  Tensor* plan = new Tensor(DT_INT64, TensorShape({kMaxFusedCollectives + 1}));
+  col_exec_->RecvFromPeer(
+      col_params.instance.device_names[0], col_params.instance.task_names[0],
+      col_params.task.is_local[0],
+      PlanKey(*queue, seq, col_params.default_rank), queue->device,
+      ctx->op_device_context(), AllocatorAttributes(), plan,
+      queue->device->attributes().locality(),
+      [this, queue, plan](const Status& s) {
+        std::vector<Entry> failed;
+        {
+          mutex_lock l(mu_);
+          if (s.ok()) {
+            auto plan_flat = plan->flat<int64>();
+            queue->plan.clear();
+            for (int64 i = 1; i <= plan_flat(0); ++i) {
+              queue->plan.push_back(static_cast<uint64>(plan_flat(i)));
+            }
+            queue->have_plan = true;
+          } else {
+            failed.swap(queue->pending);
+            queue->busy = false;
+          }
+        }
+        delete plan;
+        if (s.ok()) {
+          Advance(queue);
+        } else {
+          for (Entry& e : failed) e.done(s);
+        }
+      });
+}
+
+void CollectiveFusion::RunBatch(Queue* queue, Batch* batch) {
+  const Entry& first = batch->entries[0];
+  const CollectiveParams& col_params = *first.col_params;
+  int64 total_elts = 0;
+  for (const Entry& e : batch->entries) {
+    total_elts += e.ctx->input(0).NumElements();
+  }
+  Status status = first.ctx->allocate_temp(
+      col_params.instance.data_type, TensorShape({total_elts}), &batch->fused);
+  if (!status.ok()) {
+    FinishBatch(queue, batch, status);
+    return;
+  }
+  char* dst = static_cast<char*>(DMAHelper::base(&batch->fused));
+  for (const Entry& e : batch->entries) {
+    StringPiece src = e.ctx->input(0).tensor_data();
+    memcpy(dst, src.data(), src.size());
+    dst += src.size();
+  }
+  VLOG(1) << "Fusing " << batch->entries.size() << " collectives of "
+          << col_params.instance.device_names[col_params.default_rank]
+          << " into " << batch->exec_key << " with " << total_elts
+          << " elements";
+  reduce_fn_(first.ctx, col_params, batch->exec_key, &batch->fused,
+             &batch->fused, [this, queue, batch](const Status& s) {
+               FinishBatch(queue, batch, s);
+             });
+}
+
+void CollectiveFusion::FinishBatch(Queue* queue, Batch* batch,
+                                   const Status& s) {
+  if (s.ok()) {
+    const char* src = static_cast<const char*>(DMAHelper::base(&batch->fused));
+    for (const Entry& e : batch->entries) {
+      Tensor* output = e.ctx->mutable_output(0);
+      memcpy(DMAHelper::base(output), src, output->TotalBytes());
+      src += output->TotalBytes();
+    }
+  }
+  std::vector<Entry> entries;
+  entries.swap(batch->entries);
+  delete batch;
+  {
+    mutex_lock l(mu_);
+    queue->busy = false;
+  }
+  // Start the next batch before the done callbacks, after which this
+  // object may be deleted along with its CollectiveExecutor.
+  Advance(queue);
+  for (Entry& e : entries) e.done(s);
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,136 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_FUSION_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_FUSION_H_
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+class Device;
+class DeviceMgr;
+
+// Fuses small REDUCTION_COLLECTIVEs that are pending at the same time on
+// a device into a single reduction of a contiguous buffer, so that they
+// pay the latency of the reduction algorithm once.
+//
+// Collectives are compatible, i.e. share a queue, if they run on the
+// same device in the same group with the same data type, merge_op and
+// final_op.  Every member of the group must fuse the same collectives in
+// the same order, so the member with default rank 0 decides each batch
+// from the collectives pending on it and sends the list to the other
+// members before starting the fused reduction.  They wait until all
+// listed collectives are pending locally before joining.  A queue starts
+// a new batch only when its previous one is done, so collectives issued
+// while a fused reduction is in flight accumulate into the next one.
+//
+// This requires that all members issue the same collectives, which is
+// already required for them to complete, and that a collective does not
+// depend on the result of another one that is pending on the leader at
+// the same time, which holds when all members run the same graph.
+class CollectiveFusion {
+ public:
+  // Reduces 'input' into 'output' as BaseCollectiveExecutor::ExecuteAsync
+  // would reduce the input of the Op of 'ctx' into its output.
+  typedef std::function<void(OpKernelContext* ctx,
+                             const CollectiveParams& col_params,
+                             const string& exec_key, const Tensor* input,
+                             Tensor* output, const StatusCallback& done)>
+      ReduceFn;
+
+  CollectiveFusion(CollectiveExecutor* col_exec, const DeviceMgr* dev_mgr,
+                   int64 threshold_bytes, ReduceFn reduce_fn);
+
+  ~CollectiveFusion();
+
+  // Returns true if the collective of 'ctx' with 'col_params' may be
+  // fused, which every member of its group decides alike.
+  bool CanFuse(OpKernelContext* ctx, const CollectiveParams& col_params) const;
+
+  // Queues the collective of 'ctx' for a fused reduction and calls 'done'
+  // when that is complete.  'exec_key' identifies the collective among
+  // the members of the group.
+  void Enqueue(OpKernelContext* ctx, const CollectiveParams& col_params,
+               const string& exec_key, const StatusCallback& done);
+
+  // Fails all queued collectives and those enqueued later.
+  void StartAbort(const Status& s);
+
+ private:
+  // A collective waiting to be fused.
+  struct Entry {
+    OpKernelContext* ctx;
+    const CollectiveParams* col_params;
+    uint64 id;  // Hash of the exec_key, equal in all members.
+    StatusCallback done;
+  };
+
+  // Collectives fused into one reduction.
+  struct Batch {
+    string exec_key;
+    std::vector<Entry> entries;
+    Tensor fused;
+  };
+
+  // A queue of compatible collectives.  Guarded by mu_.
+  struct Queue {
+    string key;  // Equal in all members of the group.
+    Device* device = nullptr;
+    bool is_leader = false;
+    // True from the start of a batch, on non-leaders from the request for
+    // its plan, until the batch is done.
+    bool busy = false;
+    int64 num_batches = 0;  // Started, or on non-leaders requested.
+    std::vector<Entry> pending;
+    // Non-leaders only: the ids of the batch received from the leader,
+    // while not all of them are pending yet.
+    bool have_plan = false;
+    std::vector<uint64> plan;
+  };
+
+  // Starts the next step of 'queue' that is possible: a new batch on the
+  // leader, the request for the next plan on other members, or the
+  // reduction of a planned batch whose collectives are all pending.
+  void Advance(Queue* queue);
+  // Sends the plan of 'batch' from the leader to all other members, and
+  // aborts the CollectiveExecutor if that fails.
+  void SendPlan(Queue* queue, int64 seq, const Batch& batch);
+  // Receives the plan of batch 'seq' from the leader.
+  void RecvPlan(Queue* queue, int64 seq, OpKernelContext* ctx,
+                const CollectiveParams& col_params);
+  // Runs the fused reduction of 'batch', then scatters the result.
+  void RunBatch(Queue* queue, Batch* batch);
+  void FinishBatch(Queue* queue, Batch* batch, const Status& s);
+  string PlanKey(const Queue& queue, int64 seq, int rank) const;
+
+  CollectiveExecutor* col_exec_;  // Not owned
+  const DeviceMgr* dev_mgr_;      // Not owned
+  const int64 threshold_bytes_;
+  const ReduceFn reduce_fn_;
+
+  mutex mu_;
+  Status status_ GUARDED_BY(mu_);
+  std::unordered_map<string, std::unique_ptr<Queue>> queues_ GUARDED_BY(mu_);
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_FUSION_H_
@@ -0,0 +1,383 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/collective_fusion.h"
+
+#include <unordered_map>
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/device_resolver_local.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/common_runtime/test_collective_executor_mgr.h"
+#include "tensorflow/core/common_runtime/threadpool_device.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+static int64 kStepId = 123;
+
+std::unique_ptr<OpKernel> GetKernel(const NodeDef& node, DeviceBase* device) {
+  Status status;
+  std::unique_ptr<OpKernel> k = CreateOpKernel(
+      DEVICE_CPU, device, device->GetAllocator(AllocatorAttributes()), node,
+      TF_GRAPH_DEF_VERSION, &status);
+  TF_CHECK_OK(status);
+  return k;
+}
+
+// Runs CollectiveFusion for a group of CPU devices in one process with a
+// fake reduction, which sums the values of all members and completes
+// only once the test opens its gate.
+class CollectiveFusionTest : public ::testing::Test {
+ protected:
+  // The state of one collective Op on one device.
+  struct OpInstance {
+    OpKernelContext::Params params;
+    gtl::InlinedVector<TensorValue, 4> inputs;
+    gtl::InlinedVector<AllocatorAttributes, 4> input_aa;
+    gtl::InlinedVector<DeviceContext*, 4> input_dc;
+    int forward_from = 0;
+    AllocatorAttributes output_attr;
+    std::unique_ptr<OpKernel> kernel;
+    std::unique_ptr<OpKernelContext> ctx;
+    Tensor input;
+    string exec_key;
+    Status status;
+  };
+
+  // Also aborts the fusion under test and the fake reductions, like
+  // BaseCollectiveExecutor does with its own CollectiveFusion.
+  class TestCollectiveExecutor : public BaseCollectiveExecutor {
+   public:
+    TestCollectiveExecutor(CollectiveFusionTest* test,
+                           CollectiveExecutorMgrInterface* cem,
+                           PerStepCollectiveRemoteAccess* remote_access,
+                           const DeviceMgr* dev_mgr)
+        : BaseCollectiveExecutor(cem, remote_access, kStepId, dev_mgr),
+          test_(test) {}
+
+    void StartAbort(const Status& s) override {
+      BaseCollectiveExecutor::StartAbort(s);
+      test_->Abort(s);
+    }
+
+   private:
+    CollectiveFusionTest* test_;
+  };
+
+  ~CollectiveFusionTest() override {
+    ops_.clear();
+    if (col_exec_) col_exec_->Unref();
+  }
+
+  void Init(int num_devices, int64 threshold_bytes) {
+    std::vector<Device*> local_devices;
+    SessionOptions sess_opts;
+    sess_opts.env = Env::Default();
+    Bytes mem_limit(4 << 20);
+    DeviceLocality dev_locality;
+    for (int di = 0; di < num_devices; ++di) {
+      local_devices.push_back(new ThreadPoolDevice(
+          sess_opts, strings::StrCat("/job:worker/replica:0/task:0/cpu:", di),
+          mem_limit, dev_locality, cpu_allocator()));
+    }
+    dev_mgr_.reset(new DeviceMgr(local_devices));
+    dev_resolver_.reset(new DeviceResolverLocal(dev_mgr_.get()));
+    col_exec_ = new TestCollectiveExecutor(
+        this, &col_exec_mgr_,
+        new CollectiveRemoteAccessLocal(dev_mgr_.get(), dev_resolver_.get(),
+                                        kStepId),
+        dev_mgr_.get());
+    fusion_.reset(new CollectiveFusion(
+        col_exec_, dev_mgr_.get(), threshold_bytes,
+        [this](OpKernelContext* ctx, const CollectiveParams& col_params,
+               const string& exec_key, const Tensor* input, Tensor* output,
+               const StatusCallback& done) {
+          FakeReduce(col_params, exec_key, input, output, done);
+        }));
+    for (int di = 0; di < num_devices; ++di) {
+      CollectiveParams* cp = new CollectiveParams;
+      cp->name = "test_collective";
+      cp->group.group_key = 7;
+      cp->group.group_size = num_devices;
+      cp->group.device_type = DEVICE_CPU;
+      cp->instance.type = REDUCTION_COLLECTIVE;
+      cp->instance.data_type = DT_FLOAT;
+      for (int dj = 0; dj < num_devices; ++dj) {
+        cp->instance.device_names.push_back(
+            strings::StrCat("/job:worker/replica:0/task:0/cpu:", dj));
+        cp->instance.task_names.push_back("/job:worker/replica:0/task:0");
+        cp->task.is_local.push_back(true);
+      }
+      cp->default_rank = di;
+      Device* device = nullptr;
+      TF_CHECK_OK(
+          dev_mgr_->LookupDevice(cp->instance.device_names[di], &device));
+      NodeDef add_def;
+      TF_CHECK_OK(NodeDefBuilder("add", "Add")
+                      .Attr("T", DT_FLOAT)
+                      .Input(FakeInput(DT_FLOAT))
+                      .Input(FakeInput(DT_FLOAT))
+                      .Finalize(&add_def));
+      cp->merge_op = GetKernel(add_def, device);
+      col_params_.emplace_back(cp);
+    }
+  }
+
+  // Prepares collective 'op' of device 'rank', whose input has 'len'
+  // elements of value rank + op.
+  void AddOp(int rank, int op, int len) {
+    if (ops_.size() <= static_cast<size_t>(rank)) ops_.resize(rank + 1);
+    std::vector<std::unique_ptr<OpInstance>>& device_ops = ops_[rank];
+    if (device_ops.size() <= static_cast<size_t>(op)) {
+      device_ops.resize(op + 1);
+    }
+    Device* device = nullptr;
+    TF_CHECK_OK(dev_mgr_->LookupDevice(
+        col_params_[rank]->instance.device_names[rank], &device));
+    OpInstance* oi = new OpInstance;
+    device_ops[op].reset(oi);
+    oi->input = Tensor(DT_FLOAT, TensorShape({len}));
+    oi->input.flat<float>().setConstant(rank + op);
+    oi->exec_key = strings::StrCat(100 + op, ":0:0");
+    NodeDef node_def;
+    TF_CHECK_OK(NodeDefBuilder(strings::StrCat("reduce_", rank, "_", op),
+                               "CollectiveReduce")
+                    .Attr("T", DT_FLOAT)
+                    .Attr("merge_op", "Add")
+                    .Attr("final_op", "Id")
+                    .Attr("group_size", col_params_[rank]->group.group_size)
+                    .Attr("group_key", col_params_[rank]->group.group_key)
+                    .Attr("instance_key", 100 + op)
+                    .Attr("subdiv_offsets", std::vector<int32>())
+                    .Input(FakeInput(DT_FLOAT))
+                    .Finalize(&node_def));
+    oi->kernel = GetKernel(node_def, device);
+    oi->params.step_id = kStepId;
+    oi->params.device = device;
+    oi->inputs.push_back(TensorValue(&oi->input));
+    oi->params.inputs = &oi->inputs;
+    oi->input_aa.push_back(AllocatorAttributes());
+    oi->params.input_alloc_attrs = &oi->input_aa;
+    oi->input_dc.push_back(nullptr);
+    oi->params.input_device_contexts = &oi->input_dc;
+    oi->params.forward_from_array = &oi->forward_from;
+    oi->params.output_attr_array = &oi->output_attr;
+    oi->params.op_kernel = oi->kernel.get();
+    oi->ctx.reset(new OpKernelContext(&oi->params, 1));
+    Tensor* output = nullptr;
+    TF_CHECK_OK(oi->ctx->allocate_output(0, oi->input.shape(), &output));
+  }
+
+  void Enqueue(int rank, int op, BlockingCounter* counter) {
+    OpInstance* oi = ops_[rank][op].get();
+    ASSERT_TRUE(fusion_->CanFuse(oi->ctx.get(), *col_params_[rank]));
+    fusion_->Enqueue(oi->ctx.get(), *col_params_[rank], oi->exec_key,
+                     [oi, counter](const Status& s) {
+                       oi->status = s;
+                       counter->DecrementCount();
+                     });
+  }
+
+  // Sums the inputs of all members of a fused reduction into their
+  // outputs, after gate_ is open.
+  void FakeReduce(const CollectiveParams& col_params, const string& exec_key,
+                  const Tensor* input, Tensor* output,
+                  const StatusCallback& done) {
+    mutex_lock l(mu_);
+    ++num_reductions_;
+    if (!abort_status_.ok()) {
+      const Status s = abort_status_;
+      SchedClosure([done, s] { done(s); });
+      return;
+    }
+    Reduction& r = reductions_[exec_key];
+    if (r.outputs.empty()) {
+      r.sum = Tensor(DT_FLOAT, input->shape());
+      r.sum.flat<float>().setZero();
+    }
+    ASSERT_EQ(r.sum.NumElements(), input->NumElements());
+    r.sum.flat<float>() += input->flat<float>();
+    r.outputs.push_back(output);
+    r.dones.push_back(done);
+    if (r.outputs.size() ==
+        static_cast<size_t>(col_params.group.group_size)) {
+      Reduction* done_r = new Reduction(std::move(r));
+      reductions_.erase(exec_key);
+      SchedClosure([this, done_r] {
+        gate_.WaitForNotification();
+        for (Tensor* t : done_r->outputs) {
+          t->flat<float>() = done_r->sum.flat<float>();
+        }
+        for (const StatusCallback& d : done_r->dones) d(Status::OK());
+        delete done_r;
+      });
+    }
+  }
+
+  // Fails the fake reductions which are waiting for other members, and
+  // all later ones.
+  void Abort(const Status& s) {
+    if (fusion_) fusion_->StartAbort(s);
+    std::unordered_map<string, Reduction> reductions;
+    {
+      mutex_lock l(mu_);
+      abort_status_ = s;
+      reductions.swap(reductions_);
+    }
+    for (auto& it : reductions) {
+      for (const StatusCallback& d : it.second.dones) d(s);
+    }
+  }
+
+  struct Reduction {
+    Tensor sum;
+    std::vector<Tensor*> outputs;
+    std::vector<StatusCallback> dones;
+  };
+
+  TestCollectiveExecutorMgr col_exec_mgr_;
+  CollectiveExecutor* col_exec_ = nullptr;
+  std::unique_ptr<DeviceResolverLocal> dev_resolver_;
+  std::unique_ptr<DeviceMgr> dev_mgr_;
+  std::vector<std::unique_ptr<CollectiveParams>> col_params_;
+  std::unique_ptr<CollectiveFusion> fusion_;
+  std::vector<std::vector<std::unique_ptr<OpInstance>>> ops_;
+  Notification gate_;
+  mutex mu_;
+  int num_reductions_ GUARDED_BY(mu_) = 0;
+  std::unordered_map<string, Reduction> reductions_ GUARDED_BY(mu_);
+  Status abort_status_ GUARDED_BY(mu_);
+};
+
+TEST_F(CollectiveFusionTest, FusesPendingReductions) {
+  const int kNumDevices = 4;
+  const int kNumOps = 10;
+  Init(kNumDevices, 1 << 20);
+  for (int rank = 0; rank < kNumDevices; ++rank) {
+    for (int op = 0; op < kNumOps; ++op) {
+      AddOp(rank, op, 3 * op + 1);
+    }
+  }
+  BlockingCounter counter(kNumDevices * kNumOps);
+  // The other members issue their collectives in the opposite order of
+  // the leader, and before it.
+  for (int rank = 1; rank < kNumDevices; ++rank) {
+    for (int op = kNumOps - 1; op >= 0; --op) {
+      Enqueue(rank, op, &counter);
+    }
+  }
+  // The first collective of the leader starts a batch of its own, while
+  // the others accumulate until it is done.
+  for (int op = 0; op < kNumOps; ++op) {
+    Enqueue(0, op, &counter);
+  }
+  gate_.Notify();
+  counter.Wait();
+  {
+    mutex_lock l(mu_);
+    EXPECT_EQ(2 * kNumDevices, num_reductions_);
+  }
+  const float rank_sum = kNumDevices * (kNumDevices - 1) / 2;
+  for (int rank = 0; rank < kNumDevices; ++rank) {
+    for (int op = 0; op < kNumOps; ++op) {
+      OpInstance* oi = ops_[rank][op].get();
+      TF_EXPECT_OK(oi->status);
+      const Tensor& output = *oi->ctx->mutable_output(0);
+      ASSERT_EQ(3 * op + 1, output.NumElements());
+      for (int i = 0; i < output.NumElements(); ++i) {
+        EXPECT_EQ(rank_sum + kNumDevices * op, output.flat<float>()(i))
+            << "rank " << rank << " op " << op << " index " << i;
+      }
+    }
+  }
+}
+
+TEST_F(CollectiveFusionTest, SplitsAtThreshold) {
+  const int kNumDevices = 3;
+  const int kNumOps = 9;
+  // Each input has 64 bytes, so a fused reduction holds up to 4 of them.
+  Init(kNumDevices, 256);
+  for (int rank = 0; rank < kNumDevices; ++rank) {
+    for (int op = 0; op < kNumOps; ++op) {
+      AddOp(rank, op, 16);
+    }
+  }
+  BlockingCounter counter(kNumDevices * kNumOps);
+  for (int rank = kNumDevices - 1; rank >= 0; --rank) {
+    for (int op = 0; op < kNumOps; ++op) {
+      Enqueue(rank, op, &counter);
+    }
+  }
+  gate_.Notify();
+  counter.Wait();
+  {
+    mutex_lock l(mu_);
+    // Batches of 1, 4 and 4 collectives.
+    EXPECT_EQ(3 * kNumDevices, num_reductions_);
+  }
+  for (int rank = 0; rank < kNumDevices; ++rank) {
+    for (int op = 0; op < kNumOps; ++op) {
+      OpInstance* oi = ops_[rank][op].get();
+      TF_EXPECT_OK(oi->status);
+      EXPECT_EQ(3 + kNumDevices * op,
+                oi->ctx->mutable_output(0)->flat<float>()(0));
+    }
+  }
+}
+
+TEST_F(CollectiveFusionTest, AbortFailsPending) {
+  Init(2, 1 << 20);
+  AddOp(1, 0, 4);
+  AddOp(1, 1, 4);
+  BlockingCounter counter(2);
+  Enqueue(1, 0, &counter);
+  Enqueue(1, 1, &counter);
+  fusion_->StartAbort(errors::Internal("Deliberate failure"));
+  col_exec_->StartAbort(errors::Internal("Deliberate failure"));
+  counter.Wait();
+  EXPECT_EQ("Deliberate failure", ops_[1][0]->status.error_message());
+  EXPECT_EQ("Deliberate failure", ops_[1][1]->status.error_message());
+  gate_.Notify();
+}
+
+TEST_F(CollectiveFusionTest, FailedPlanAbortsStep) {
+  Init(2, 1 << 20);
+  AddOp(0, 0, 4);
+  AddOp(1, 0, 4);
+  // The leader can't post the plan of its batch.
+  col_exec_->remote_access()->buf_rendezvous()->StartAbort(
+      errors::Internal("Deliberate failure"));
+  BlockingCounter counter(2);
+  Enqueue(0, 0, &counter);
+  Enqueue(1, 0, &counter);
+  counter.Wait();
+  EXPECT_EQ("Deliberate failure", ops_[0][0]->status.error_message());
+  EXPECT_EQ("Deliberate failure", ops_[1][0]->status.error_message());
+  gate_.Notify();
+}
+
+}  // namespace
+}  // namespace tensorflow
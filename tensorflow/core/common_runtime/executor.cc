@@ -452,6 +452,25 @@ Status InferAllocAttr(const Node* n, const Node* dst,
                       const DeviceNameUtils::ParsedName& local_dev_name,
                       AllocatorAttributes* attr);
 
+// Returns true if each input of `n` reserved in `forward_input` is the only
+// use of output 0 of the node named `producer`.
+bool ReservedInputsAreDead(const Node* n, const std::vector<int>& forward_input,
+                           const string& producer) {
+  for (int j = 0; j < forward_input.size(); j += 2) {
+    const Edge* in_edge = nullptr;
+    if (!n->input_edge(forward_input[j], &in_edge).ok() ||
+        in_edge->src()->name() != producer || in_edge->src_output() != 0) {
+      return false;
+    }
+    int num_uses = 0;
+    for (const Edge* e : in_edge->src()->out_edges()) {
+      if (e->src_output() == in_edge->src_output()) ++num_uses;
+    }
+    if (num_uses != 1) return false;
+  }
+  return true;
+}
+
 GraphView::~GraphView() {
   static_assert(std::is_trivially_destructible<AllocatorAttributes>::value,
                 "Update code if AllocatorAttributes gains a destructor");
@@ -571,6 +590,20 @@ char* GraphView::InitializeNode(char* ptr, const Node* n) {
     std::vector<int> forward_input;
     Status fwd_status =
         GetNodeAttr(n->attrs(), "_forward_input", &forward_input);
+    // Set by optimizers that reserve an input because it is the only use of
+    // output 0 of the named producer. The rewrites that follow them (e.g.
+    // tfdbg, partitioning) may have added consumers of that output, so the
+    // reservations are dropped unless they still hold in the final graph.
+    string forward_input_producer;
+    if (fwd_status.ok() &&
+        GetNodeAttr(n->attrs(), "_forward_input_producer",
+                    &forward_input_producer)
+            .ok() &&
+        !ReservedInputsAreDead(n, forward_input, forward_input_producer)) {
+      fwd_status = errors::FailedPrecondition(
+          "Dropped the _forward_input reservations of ", n->name());
+      VLOG(1) << fwd_status.error_message();
+    }
     std::vector<int> scoped_allocator_attrs;
     Status sa_status =
         GetNodeAttr(n->attrs(), "_scoped_allocator", &scoped_allocator_attrs);
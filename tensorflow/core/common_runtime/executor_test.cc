@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 
 #include <algorithm>
+#include <atomic>
 
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
@@ -26,6 +27,7 @@ limitations under the License.
 #include "tensorflow/core/framework/step_stats.pb.h"
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/graph/graph_constructor.h"
+#include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/lib/strings/strcat.h"
@@ -410,6 +412,127 @@ TEST_F(ExecutorTest, RecvInvalidRefDtype) {
   rendez->Unref();
 }
 
+// A CPU device which, like a GPU device with several compute streams, has
+// the executor record the tensors accessed by each kernel, and which counts
+// the allocations made by the kernels.
+class RecordingCpuDevice : public Device {
+ public:
+  explicit RecordingCpuDevice(Device* cpu)
+      : Device(cpu->env(), cpu->attributes()), cpu_(cpu) {}
+
+  bool RequiresRecordingAccessedTensors() const override { return true; }
+  const CpuWorkerThreads* tensorflow_cpu_worker_threads() const override {
+    return cpu_->tensorflow_cpu_worker_threads();
+  }
+  const Eigen::ThreadPoolDevice* eigen_cpu_device() override {
+    return cpu_->eigen_cpu_device();
+  }
+  Allocator* GetAllocator(AllocatorAttributes attr) override {
+    return &allocator_;
+  }
+  Status MakeTensorFromProto(const TensorProto& tensor_proto,
+                             const AllocatorAttributes alloc_attrs,
+                             Tensor* tensor) override {
+    return cpu_->MakeTensorFromProto(tensor_proto, alloc_attrs, tensor);
+  }
+  Status Sync() override { return cpu_->Sync(); }
+
+  int num_allocations() const { return allocator_.num_allocations; }
+
+ private:
+  struct CountingAllocator : public Allocator {
+    string Name() override { return "counting"; }
+    void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+      ++num_allocations;
+      return cpu_allocator()->AllocateRaw(alignment, num_bytes);
+    }
+    void DeallocateRaw(void* ptr) override {
+      cpu_allocator()->DeallocateRaw(ptr);
+    }
+    std::atomic<int> num_allocations{0};
+  };
+
+  std::unique_ptr<Device> cpu_;
+  CountingAllocator allocator_;
+};
+
+// Returns the number of allocations made to compute b = neg1(neg0(a)), or -1
+// if a result is wrong. Unless 'producer' is empty, "neg1" reserves its input
+// for its output and names 'producer' as its producer. If 'fetch_neg0', the
+// output of "neg0" is also sent.
+int NumAllocationsOfDoubleNegation(const string& producer, bool fetch_neg0) {
+  RecordingCpuDevice* device = new RecordingCpuDevice(DeviceFactory::NewDevice(
+      "CPU", {}, "/job:localhost/replica:0/task:0"));
+  std::unique_ptr<Graph> g(new Graph(OpRegistry::Global()));
+  auto in = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  Node* neg0;
+  TF_CHECK_OK(NodeBuilder("neg0", "Neg").Input(in).Finalize(g.get(), &neg0));
+  Node* neg1;
+  TF_CHECK_OK(NodeBuilder("neg1", "Neg").Input(neg0).Finalize(g.get(), &neg1));
+  if (!producer.empty()) {
+    neg1->AddAttr("_forward_input", std::vector<int>({0, 0}));
+    neg1->AddAttr("_forward_input_producer", producer);
+  }
+  if (fetch_neg0) {
+    test::graph::Send(g.get(), neg0, "c", BOB, 1, ALICE);
+  }
+  test::graph::Send(g.get(), neg1, "b", BOB, 1, ALICE);
+
+  const int version = g->versions().producer();
+  LocalExecutorParams params;
+  params.device = device;
+  params.create_kernel = [device, version](const NodeDef& ndef,
+                                           OpKernel** kernel) {
+    return CreateNonCachedKernel(device, nullptr, ndef, version, kernel);
+  };
+  params.delete_kernel = [](OpKernel* kernel) {
+    DeleteNonCachedKernel(kernel);
+  };
+  Executor* exec = nullptr;
+  TF_CHECK_OK(NewLocalExecutor(params, std::move(g), &exec));
+
+  Rendezvous* rendez = NewLocalRendezvous();
+  Rendezvous::Args args;
+  Tensor a(DT_FLOAT, TensorShape({16}));
+  a.flat<float>().setConstant(2.0);
+  TF_CHECK_OK(rendez->Send(Key(ALICE, kIncarnation, BOB, "a"), args, a, false));
+  a = Tensor();
+  Executor::Args exec_args;
+  exec_args.rendezvous = rendez;
+  exec_args.runner = [](std::function<void()> fn) { fn(); };
+  TF_CHECK_OK(exec->Run(exec_args));
+  Tensor b;
+  bool is_dead = false;
+  TF_CHECK_OK(
+      rendez->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &b, &is_dead));
+  bool correct = b.flat<float>()(0) == 2.0;
+  if (fetch_neg0) {
+    Tensor c;
+    TF_CHECK_OK(
+        rendez->Recv(Key(BOB, kIncarnation, ALICE, "c"), args, &c, &is_dead));
+    correct = correct && c.flat<float>()(0) == -2.0;
+  }
+  const int num_allocations = device->num_allocations();
+  rendez->Unref();
+  delete exec;
+  delete device;
+  return correct ? num_allocations : -1;
+}
+
+TEST(ExecutorForwardInputTest, ReservationSavesAnAllocation) {
+  // The recorded reference to the input of "neg1" defeats the run-time
+  // forwarding, but not a reservation.
+  EXPECT_EQ(2, NumAllocationsOfDoubleNegation("", false));
+  EXPECT_EQ(1, NumAllocationsOfDoubleNegation("neg0", false));
+}
+
+TEST(ExecutorForwardInputTest, DropsInvalidatedReservations) {
+  // The reserved input does not come from the named producer.
+  EXPECT_EQ(2, NumAllocationsOfDoubleNegation("a", false));
+  // The reserved input is also sent, so it must not be overwritten.
+  EXPECT_EQ(2, NumAllocationsOfDoubleNegation("neg0", true));
+}
+
 // Create a graph that is 'depth' deep. At each level, fan-in and fan-out a
 // maximum of 'width' nodes. All nodes are no-ops and all dependencies are
 // control dependencies.
@@ -25,16 +25,16 @@ namespace tensorflow {
 class DeviceMgr;
 
 // Ring-algorithm implementation of collective all-reduce.
-class RingReducer {
+class RingReducer : public CollectiveReducer {
  public:
   RingReducer(CollectiveExecutor* col_exec, const DeviceMgr* dev_mgr,
               OpKernelContext* ctx, OpKernelContext::Params* op_params,
               const CollectiveParams& col_params, const string& exec_key,
               int64 step_id, const Tensor* input, Tensor* output);
 
-  virtual ~RingReducer();
+  ~RingReducer() override;
 
-  void Run(StatusCallback done);
+  void Run(StatusCallback done) override;
 
  private:
   // Called when a bad status is received that implies we should terminate
@@ -46,23 +46,6 @@ class RingReducer {
                       Tensor* input);
   bool RunAsyncParts();
 
-  // Used for executing a sub-operation, e.g. a merge_op instance, with
-  // an OpKernelContext based on the one passed into this Op.
-  class SubContext {
-   public:
-    OpKernelContext::Params sub_params_;
-    gtl::InlinedVector<TensorValue, 4> sub_inputs_;
-    gtl::InlinedVector<AllocatorAttributes, 4> sub_input_attr_;
-    gtl::InlinedVector<DeviceContext*, 4> sub_input_dc_;
-    // Used only for Binary and Unary Ops for which we require
-    // the calculation to be in-place on the first input.
-    int forward_from_ = 0;
-    OpKernelContext* sub_ctx_;
-    SubContext(OpKernelContext* ctx, OpKernelContext::Params* params,
-               OpKernel* op, Tensor* output, Tensor* input);
-    ~SubContext() { delete sub_ctx_; }
-  };
-
   // Current status of a RingField
   enum RingFieldAction {
     RF_INIT = 0,    // Just initialized for a pass
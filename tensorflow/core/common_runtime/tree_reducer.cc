@@ -0,0 +1,732 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/tree_reducer.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/collective_util.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+// Set true for greater intelligibility of debug mode log messages.
+#define READABLE_KEYS false
+
+namespace tensorflow {
+namespace {
+// Each CollectiveOp implementation is free to define its own
+// BufRendezvous key format.  This function produces the key used by
+// TreeReducer.
+string TreeReduceBufKey(const string& exec_key, int tag, int source_rank,
+                        int dest_rank) {
+  if (READABLE_KEYS) {
+    return strings::StrCat("tred(", exec_key, "):tag(", tag, "):srcrank(",
+                           source_rank, "):dstrank(", dest_rank, ")");
+  } else {
+    return strings::StrCat(exec_key, ":t", tag, ":", source_rank, ":",
+                           dest_rank);
+  }
+}
+
+// The double binary tree divides each half of the tensor into segments
+// of about this size, up to kMaxTreeSegments, which are pipelined
+// through the tree.
+const int64 kTreeSegmentBytes = 64 << 10;
+const int kMaxTreeSegments = 32;
+
+typedef TreeReducer::Action Action;
+
+// Returns the largest power of 2 not greater than n >= 1.
+int LargestPowerOfTwo(int n) {
+  int p = 1;
+  while (p * 2 <= n) p *= 2;
+  return p;
+}
+
+// Appends an Action unless its range is empty.  Both ends of a transfer
+// compute the same range, so both skip it.
+void AddAction(Action::Kind kind, int peer, int tag, int chunk_begin,
+               int chunk_end, std::vector<Action>* actions) {
+  if (chunk_begin >= chunk_end) return;
+  actions->push_back({kind, peer, tag, chunk_begin, chunk_end});
+}
+
+// Generates the recursive halving reduce-scatter and recursive doubling
+// all-gather of chunks [begin, end) among 'members', a list of default
+// ranks, for the member at position 'index'.
+//
+// If the number of members N is not a power of two, with P the largest
+// power of two below N, the first 2 * (N - P) members form pairs.  The
+// first of each pair sends its value to the second before the
+// reduce-scatter and receives the result after the all-gather, so that
+// only P members take part in between.  Those are numbered by their
+// virtual rank, and the members with virtual ranks v and v ^ m exchange
+// halves of their current range in the step with mask m.
+class HalvingDoubling {
+ public:
+  HalvingDoubling(const std::vector<int>& members, int index, int begin,
+                  int end, int tag_base, std::vector<Action>* actions)
+      : members_(members),
+        index_(index),
+        begin_(begin),
+        end_(end),
+        tag_base_(tag_base),
+        actions_(actions),
+        pow2_(LargestPowerOfTwo(members.size())),
+        extra_(members.size() - pow2_),
+        num_steps_(0),
+        owned_begin_(begin),
+        owned_end_(begin) {
+    for (int p = pow2_; p > 1; p /= 2) ++num_steps_;
+    if (index_ < 2 * extra_) {
+      vrank_ = (index_ % 2 == 0) ? -1 : index_ / 2;
+    } else {
+      vrank_ = index_ - extra_;
+    }
+  }
+
+  // Appends the reduce-scatter, after which the member holds the
+  // reduction of chunks [owned_begin(), owned_end()).  That range is
+  // empty for members paired off before the halving.
+  void ReduceScatter() {
+    owned_begin_ = begin_;
+    owned_end_ = end_;
+    if (vrank_ < 0) {
+      AddAction(Action::SEND, members_[index_ + 1], tag_base_, begin_, end_,
+                actions_);
+      owned_end_ = owned_begin_;
+      return;
+    }
+    if (index_ < 2 * extra_) {
+      AddAction(Action::RECV_REDUCE, members_[index_ - 1], tag_base_, begin_,
+                end_, actions_);
+    }
+    int step = 0;
+    for (int mask = pow2_ / 2; mask > 0; mask /= 2, ++step) {
+      const int peer = members_[VirtualToIndex(vrank_ ^ mask)];
+      const int tag = tag_base_ + 1 + step;
+      const int mid = owned_begin_ + (owned_end_ - owned_begin_) / 2;
+      if ((vrank_ & mask) == 0) {
+        AddAction(Action::SEND, peer, tag, mid, owned_end_, actions_);
+        AddAction(Action::RECV_REDUCE, peer, tag, owned_begin_, mid, actions_);
+        owned_end_ = mid;
+      } else {
+        AddAction(Action::SEND, peer, tag, owned_begin_, mid, actions_);
+        AddAction(Action::RECV_REDUCE, peer, tag, mid, owned_end_, actions_);
+        owned_begin_ = mid;
+      }
+    }
+  }
+
+  // Appends the all-gather, after which the member holds all of
+  // chunks [begin, end) as held by their owners.
+  void AllGather() {
+    const int last_tag = tag_base_ + num_tags() - 1;
+    if (vrank_ < 0) {
+      AddAction(Action::RECV, members_[index_ + 1], last_tag, begin_, end_,
+                actions_);
+      return;
+    }
+    // Replay the halving to recover the range held before each step.
+    std::vector<std::pair<int, int>> ranges;
+    int range_begin = begin_;
+    int range_end = end_;
+    for (int mask = pow2_ / 2; mask > 0; mask /= 2) {
+      ranges.emplace_back(range_begin, range_end);
+      const int mid = range_begin + (range_end - range_begin) / 2;
+      if ((vrank_ & mask) == 0) {
+        range_end = mid;
+      } else {
+        range_begin = mid;
+      }
+    }
+    for (int step = num_steps_ - 1; step >= 0; --step) {
+      const int mask = pow2_ >> (step + 1);
+      const int peer = members_[VirtualToIndex(vrank_ ^ mask)];
+      const int tag = tag_base_ + 1 + num_steps_ + step;
+      const int outer_begin = ranges[step].first;
+      const int outer_end = ranges[step].second;
+      AddAction(Action::SEND, peer, tag, range_begin, range_end, actions_);
+      if (range_begin == outer_begin) {
+        AddAction(Action::RECV, peer, tag, range_end, outer_end, actions_);
+      } else {
+        AddAction(Action::RECV, peer, tag, outer_begin, range_begin, actions_);
+      }
+      range_begin = outer_begin;
+      range_end = outer_end;
+    }
+    if (index_ < 2 * extra_) {
+      AddAction(Action::SEND, members_[index_ - 1], last_tag, begin_, end_,
+                actions_);
+    }
+  }
+
+  int owned_begin() const { return owned_begin_; }
+  int owned_end() const { return owned_end_; }
+
+  // Number of tags used, starting from tag_base.
+  int num_tags() const { return 2 * num_steps_ + 2; }
+
+ private:
+  int VirtualToIndex(int vrank) const {
+    return (vrank < extra_) ? (2 * vrank + 1) : (vrank + extra_);
+  }
+
+  const std::vector<int>& members_;
+  const int index_;
+  const int begin_;
+  const int end_;
+  const int tag_base_;
+  std::vector<Action>* actions_;
+  const int pow2_;
+  const int extra_;
+  int num_steps_;
+  int vrank_;
+  int owned_begin_;
+  int owned_end_;
+};
+
+// Computes the links of position 'pos' in a binary tree over the
+// positions [0, n), rooted at 0, in which the odd positions are the
+// leaves.  A position whose lowest set bit is b has the parent pos - b or
+// pos + b, and the children pos - b/2 and pos + b/2.  Where a parent or
+// right child would be out of range the nearest position in range of the
+// same direction is linked instead.  Sets *parent to -1 for the root.
+void BinaryTreeLinks(int n, int pos, int* parent, std::vector<int>* children) {
+  int bit = 1;
+  while (bit < n && (pos & bit) == 0) bit <<= 1;
+  *parent = -1;
+  if (pos != 0) {
+    *parent = (pos ^ bit) | (bit << 1);
+    if (*parent >= n) *parent = pos ^ bit;
+    if (bit > 1) children->push_back(pos - bit / 2);
+  }
+  for (int low_bit = bit / 2; low_bit > 0; low_bit /= 2) {
+    if (pos + low_bit < n) {
+      children->push_back(pos + low_bit);
+      break;
+    }
+  }
+}
+
+void BuildRecursiveHalvingSchedule(int group_size, int rank,
+                                   TreeReducer::Schedule* schedule) {
+  schedule->num_chunks = LargestPowerOfTwo(group_size);
+  std::vector<int> members(group_size);
+  for (int i = 0; i < group_size; ++i) members[i] = i;
+  HalvingDoubling hd(members, rank, 0, schedule->num_chunks, 0,
+                     &schedule->actions);
+  hd.ReduceScatter();
+  AddAction(Action::FINALIZE, -1, 0, hd.owned_begin(), hd.owned_end(),
+            &schedule->actions);
+  hd.AllGather();
+}
+
+// Each of the two trees reduces one half of the tensor to its root and
+// then broadcasts the result back down.  The second tree shifts all
+// positions by one, so the leaves of one tree, at odd positions, are the
+// inner nodes of the other, and every device but the last of an odd
+// sized group forwards data in only one of them.
+void BuildDoubleBinaryTreeSchedule(int group_size, int rank,
+                                   int64 tensor_bytes,
+                                   TreeReducer::Schedule* schedule) {
+  const int num_segments = static_cast<int>(std::max<int64>(
+      1, std::min<int64>(kMaxTreeSegments, tensor_bytes / kTreeSegmentBytes)));
+  schedule->num_chunks = 2 * num_segments;
+  for (int tree = 0; tree < 2; ++tree) {
+    int parent;
+    std::vector<int> children;
+    BinaryTreeLinks(group_size, (rank + tree) % group_size, &parent,
+                    &children);
+    // Convert positions back to ranks.
+    if (parent >= 0) parent = (parent + group_size - tree) % group_size;
+    for (int& child : children) {
+      child = (child + group_size - tree) % group_size;
+    }
+    for (int segment = 0; segment < num_segments; ++segment) {
+      const int chunk = tree * num_segments + segment;
+      const int reduce_tag = 2 * chunk;
+      const int broadcast_tag = 2 * chunk + 1;
+      for (int child : children) {
+        AddAction(Action::RECV_REDUCE, child, reduce_tag, chunk, chunk + 1,
+                  &schedule->actions);
+      }
+      if (parent >= 0) {
+        AddAction(Action::SEND, parent, reduce_tag, chunk, chunk + 1,
+                  &schedule->actions);
+        AddAction(Action::RECV, parent, broadcast_tag, chunk, chunk + 1,
+                  &schedule->actions);
+      } else {
+        AddAction(Action::FINALIZE, -1, 0, chunk, chunk + 1,
+                  &schedule->actions);
+      }
+      for (int child : children) {
+        AddAction(Action::SEND, child, broadcast_tag, chunk, chunk + 1,
+                  &schedule->actions);
+      }
+    }
+  }
+}
+
+// A reduce-scatter among the devices of each task divides the tensor into
+// one shard per local device.  The devices of equal local rank in all
+// tasks then all-reduce their shard, and finally an all-gather within
+// each task reassembles the tensor.
+Status BuildHierarchicalSchedule(const CollectiveParams& col_params, int rank,
+                                 TreeReducer::Schedule* schedule) {
+  // Group the devices by task, in the order in which tasks first appear.
+  std::vector<std::vector<int>> task_devices;
+  std::unordered_map<string, int> task_index;
+  const std::vector<string>& task_names = col_params.instance.task_names;
+  for (int i = 0; i < static_cast<int>(task_names.size()); ++i) {
+    auto it = task_index.emplace(task_names[i], task_devices.size()).first;
+    if (it->second == static_cast<int>(task_devices.size())) {
+      task_devices.emplace_back();
+    }
+    task_devices[it->second].push_back(i);
+  }
+  const int num_tasks = task_devices.size();
+  const int devices_per_task = task_devices[0].size();
+  for (const std::vector<int>& devices : task_devices) {
+    if (static_cast<int>(devices.size()) != devices_per_task) {
+      return errors::InvalidArgument(
+          "HIERARCHICAL_REDUCE requires the same number of devices in every "
+          "task, but ",
+          col_params.name, " has tasks with ", devices_per_task, " and ",
+          devices.size(), " devices");
+    }
+  }
+  const int task = task_index[task_names[rank]];
+  const std::vector<int>& local_devices = task_devices[task];
+  const int local_rank =
+      std::find(local_devices.begin(), local_devices.end(), rank) -
+      local_devices.begin();
+  std::vector<int> peer_devices(num_tasks);
+  for (int t = 0; t < num_tasks; ++t) {
+    peer_devices[t] = task_devices[t][local_rank];
+  }
+
+  schedule->num_chunks =
+      LargestPowerOfTwo(devices_per_task) * LargestPowerOfTwo(num_tasks);
+  HalvingDoubling local(local_devices, local_rank, 0, schedule->num_chunks, 0,
+                        &schedule->actions);
+  local.ReduceScatter();
+  HalvingDoubling cross(peer_devices, task, local.owned_begin(),
+                        local.owned_end(), local.num_tags(),
+                        &schedule->actions);
+  cross.ReduceScatter();
+  AddAction(Action::FINALIZE, -1, 0, cross.owned_begin(), cross.owned_end(),
+            &schedule->actions);
+  cross.AllGather();
+  local.AllGather();
+  return Status::OK();
+}
+
+// True if 'b' must wait for the earlier 'a' of the same Schedule.
+bool Conflicts(const Action& a, const Action& b) {
+  const bool overlap =
+      a.chunk_begin < b.chunk_end && b.chunk_begin < a.chunk_end;
+  return overlap && (a.kind != Action::SEND || b.kind != Action::SEND);
+}
+
+}  // namespace
+
+string TreeReducer::Action::DebugString() const {
+  static const char* kKindNames[] = {"SEND", "RECV", "RECV_REDUCE",
+                                     "FINALIZE"};
+  return strings::StrCat(kKindNames[kind], " peer=", peer, " tag=", tag,
+                         " chunks=[", chunk_begin, ", ", chunk_end, ")");
+}
+
+/*static*/
+Status TreeReducer::BuildSchedule(ReduceAlgorithm algorithm,
+                                  const CollectiveParams& col_params, int rank,
+                                  int64 tensor_bytes, Schedule* schedule) {
+  const int group_size = col_params.group.group_size;
+  if (rank < 0 || rank >= group_size) {
+    return errors::Internal("Invalid rank ", rank, " in group of size ",
+                            group_size);
+  }
+  schedule->actions.clear();
+  switch (algorithm) {
+    case RECURSIVE_HALVING_REDUCE:
+      BuildRecursiveHalvingSchedule(group_size, rank, schedule);
+      return Status::OK();
+    case DOUBLE_BINARY_TREE_REDUCE:
+      BuildDoubleBinaryTreeSchedule(group_size, rank, tensor_bytes, schedule);
+      return Status::OK();
+    case HIERARCHICAL_REDUCE:
+      return BuildHierarchicalSchedule(col_params, rank, schedule);
+    default:
+      return errors::Internal("TreeReducer does not implement algorithm ",
+                              algorithm);
+  }
+}
+
+void TreeReducer::PCQueue::Enqueue(int action_idx) {
+  mutex_lock l(pcq_mu_);
+  deque_.push_back(action_idx);
+  if (waiter_count_ > 0) {
+    cv_.notify_one();
+  }
+}
+
+int TreeReducer::PCQueue::Dequeue() {
+  mutex_lock l(pcq_mu_);
+  if (deque_.empty()) {
+    ++waiter_count_;
+    while (deque_.empty()) {
+      cv_.wait(l);
+    }
+    --waiter_count_;
+  }
+  int action_idx = deque_.front();
+  deque_.pop_front();
+  return action_idx;
+}
+
+TreeReducer::TreeReducer(CollectiveExecutor* col_exec, const DeviceMgr* dev_mgr,
+                         OpKernelContext* ctx,
+                         OpKernelContext::Params* op_params,
+                         const CollectiveParams& col_params,
+                         const string& exec_key, int64 step_id,
+                         ReduceAlgorithm algorithm, const Tensor* input,
+                         Tensor* output)
+    : col_exec_(col_exec),
+      dev_mgr_(dev_mgr),
+      ctx_(ctx),
+      op_params_(op_params),
+      col_params_(col_params),
+      exec_key_(exec_key),
+      input_(input),
+      output_(output),
+      rank_(col_params.default_rank),
+      step_id_(step_id),
+      group_size_(col_params.group.group_size),
+      algorithm_(algorithm),
+      done_(nullptr),
+      device_(nullptr),
+      device_name_(
+          col_params_.instance.device_names[col_params_.default_rank]) {
+  CHECK_GT(group_size_, 0);
+  CHECK_NE(algorithm_, RING_REDUCE);
+}
+
+TreeReducer::~TreeReducer() {
+  // The group size tensor is only prepared once the CollectiveAdapter
+  // exists.
+  if (ca_) group_size_tensor_ready_.WaitForNotification();
+}
+
+void TreeReducer::Run(StatusCallback done) {
+  done_ = std::move(done);
+  CHECK(dev_mgr_);
+  Status status = dev_mgr_->LookupDevice(device_name_, &device_);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to find device " << device_name_;
+    done_(status);
+    return;
+  }
+  device_locality_ = device_->attributes().locality();
+
+  status = BuildSchedule(algorithm_, col_params_, rank_, input_->TotalBytes(),
+                         &schedule_);
+  if (!status.ok()) {
+    done_(status);
+    return;
+  }
+  if (VLOG_IS_ON(2)) {
+    string buf;
+    for (const Action& action : schedule_.actions) {
+      strings::StrAppend(&buf, "\n", action.DebugString());
+    }
+    VLOG(2) << "TreeReducer::Run for device " << device_name_
+            << " algorithm " << algorithm_ << " num_chunks "
+            << schedule_.num_chunks << " schedule:" << buf;
+  }
+
+  // Start by copying input to output if they're not already the same, i.e. if
+  // we're not computing in-place on the input tensor.
+  if ((input_ != output_) &&
+      (DMAHelper::base(input_) != DMAHelper::base(output_))) {
+    // We are running in a blockable thread and the callback can't block so
+    // just wait here on the copy.
+    Notification note;
+    CollectiveRemoteAccessLocal::MemCpyAsync(
+        ctx_->input_device_context(0), ctx_->op_device_context(), device_,
+        device_, ctx_->input_alloc_attr(0), ctx_->output_alloc_attr(0), input_,
+        output_, [&note, &status](const Status& s) {
+          status.Update(s);
+          note.Notify();
+        });
+    note.WaitForNotification();
+    if (!status.ok()) {
+      done_(status);
+      return;
+    }
+  }
+
+  AllocatorAttributes attr = ctx_->output_alloc_attr(0);
+  ca_.reset(MakeCollectiveAdapter(output_, schedule_.num_chunks,
+                                  device_->GetAllocator(attr)));
+  if (col_params_.final_op) {
+    Tensor group_size_val = ca_->Scalar(group_size_);
+    if (col_params_.group.device_type != "CPU") {
+      group_size_tensor_ =
+          ca_->Scalar(device_->GetAllocator(ctx_->input_alloc_attr(0)));
+      DeviceContext* op_dev_ctx = ctx_->op_device_context();
+      op_dev_ctx->CopyCPUTensorToDevice(&group_size_val, device_,
+                                        &group_size_tensor_,
+                                        [this](const Status& s) {
+                                          if (!s.ok()) {
+                                            StartAbort(s);
+                                          }
+                                          group_size_tensor_ready_.Notify();
+                                        });
+    } else {
+      group_size_tensor_ = group_size_val;
+      group_size_tensor_ready_.Notify();
+    }
+  } else {
+    group_size_tensor_ready_.Notify();
+  }
+  Finish(RunActions());
+}
+
+void TreeReducer::StartAbort(const Status& s) {
+  // In abort mode we stop issuing additional ProvideBuf
+  // and ConsumeBuf calls, but we need to wait for all of the
+  // outstanding callbacks to be invoked before quitting.
+  bool abort_started = false;
+  {
+    mutex_lock l(status_mu_);
+    if (status_.ok()) {
+      LOG(ERROR) << "Aborting TreeReduce with " << s;
+      abort_started = true;
+      status_.Update(s);
+    }
+  }
+  // If this is the initial entry to abort mode then invoke StartAbort
+  // on the CollectiveExecutor that invoked us.  That should start
+  // cancellation on all of the outstanding CollectiveRemoteAccess
+  // actions.
+  if (abort_started) {
+    col_exec_->StartAbort(s);
+  }
+}
+
+void TreeReducer::Finish(bool ok) {
+  if (ok) {
+    // Recover the output from the adaptor.
+    ca_->ConsumeFinalValue(output_);
+  }
+  Status s;
+  {
+    mutex_lock l(status_mu_);
+    s = status_;
+  }
+  states_.clear();  // Give up Refs on output tensor.
+  done_(s);
+}
+
+Status TreeReducer::ComputeBinOp(Device* device, OpKernel* op, Tensor* output,
+                                 Tensor* input) {
+  return collective_util::ComputeBinOp(ctx_, op_params_, device, op, output,
+                                       input);
+}
+
+void TreeReducer::DispatchSend(int action_idx, const StatusCallback& done) {
+  const Action& action = schedule_.actions[action_idx];
+  string send_buf_key =
+      TreeReduceBufKey(exec_key_, action.tag, rank_, action.peer);
+  VLOG(3) << "DispatchSend rank=" << rank_ << " send key " << send_buf_key
+          << " chunk " << ca_->TBounds(states_[action_idx].chunk);
+  col_exec_->PostToPeer(col_params_.instance.device_names[action.peer],
+                        col_params_.instance.task_names[action.peer],
+                        send_buf_key, device_, ctx_->op_device_context(),
+                        ctx_->output_alloc_attr(0), &states_[action_idx].chunk,
+                        device_locality_, done);
+}
+
+void TreeReducer::DispatchRecv(int action_idx, Tensor* dst,
+                               const StatusCallback& done) {
+  const Action& action = schedule_.actions[action_idx];
+  string recv_buf_key =
+      TreeReduceBufKey(exec_key_, action.tag, action.peer, rank_);
+  VLOG(3) << "DispatchRecv rank=" << rank_ << " recv key " << recv_buf_key
+          << " into " << ca_->TBounds(*dst);
+  col_exec_->RecvFromPeer(col_params_.instance.device_names[action.peer],
+                          col_params_.instance.task_names[action.peer],
+                          col_params_.task.is_local[action.peer], recv_buf_key,
+                          device_, ctx_->op_device_context(),
+                          ctx_->output_alloc_attr(0), dst, device_locality_,
+                          done);
+}
+
+StatusCallback TreeReducer::ActionDoneCallback(int action_idx,
+                                               PCQueue* queue) {
+  return [this, action_idx, queue](const Status& s) {
+    const bool bad_status = !s.ok();
+    if (bad_status) aborted_ = true;
+    queue->Enqueue(action_idx);
+    if (bad_status) StartAbort(s);
+  };
+}
+
+bool TreeReducer::ReduceAction(int action_idx) {
+  ActionState* state = &states_[action_idx];
+  Status s = ComputeBinOp(device_, col_params_.merge_op.get(), &state->chunk,
+                          &state->tmp_chunk);
+  state->tmp_chunk = Tensor();
+  if (!s.ok()) {
+    aborted_ = true;
+    StartAbort(s);
+    return false;
+  }
+  return true;
+}
+
+bool TreeReducer::FinalizeAction(int action_idx) {
+  if (!col_params_.final_op) return true;
+  group_size_tensor_ready_.WaitForNotification();
+  Status s = ComputeBinOp(device_, col_params_.final_op.get(),
+                          &states_[action_idx].chunk, &group_size_tensor_);
+  if (!s.ok()) {
+    aborted_ = true;
+    StartAbort(s);
+    return false;
+  }
+  return true;
+}
+
+bool TreeReducer::StartAction(int action_idx, PCQueue* queue) {
+  const Action& action = schedule_.actions[action_idx];
+  ActionState* state = &states_[action_idx];
+  // An empty range can result from chunks at the end of a small tensor.
+  // The peer skips it likewise.
+  if (state->chunk.NumElements() == 0) return true;
+  switch (action.kind) {
+    case Action::SEND:
+      ++pending_count_;
+      DispatchSend(action_idx, ActionDoneCallback(action_idx, queue));
+      return false;
+    case Action::RECV:
+      ++pending_count_;
+      DispatchRecv(action_idx, &state->chunk,
+                   ActionDoneCallback(action_idx, queue));
+      return false;
+    case Action::RECV_REDUCE:
+      // The receive was started up front.  If it has not completed yet the
+      // merge happens when it does.
+      return state->recv_done && ReduceAction(action_idx);
+    case Action::FINALIZE:
+      return FinalizeAction(action_idx);
+  }
+  return false;
+}
+
+void TreeReducer::CompleteAction(int action_idx, std::vector<int>* ready) {
+  VLOG(3) << "TreeReducer rank=" << rank_ << " done with "
+          << schedule_.actions[action_idx].DebugString();
+  ++done_count_;
+  for (int dependent : states_[action_idx].dependents) {
+    if (--states_[dependent].pending_deps == 0) {
+      ready->push_back(dependent);
+    }
+  }
+}
+
+bool TreeReducer::RunActions() {
+  // This function orchestrates the Actions of a single device.  It is
+  // entered by a blockable thread that loops within it until all Actions
+  // complete.
+  const int num_actions = schedule_.actions.size();
+  states_.clear();
+  states_.resize(num_actions);
+  done_count_ = 0;
+  pending_count_ = 0;
+  aborted_ = false;
+  PCQueue queue;
+  std::vector<int> ready;
+  for (int i = 0; i < num_actions; ++i) {
+    const Action& action = schedule_.actions[i];
+    ActionState* state = &states_[i];
+    state->chunk = ca_->ChunkRangeAlias(action.chunk_begin, action.chunk_end);
+    CHECK(state->chunk.IsAligned()) << action.DebugString();
+    for (int j = 0; j < i; ++j) {
+      if (Conflicts(schedule_.actions[j], action)) {
+        states_[j].dependents.push_back(i);
+        ++state->pending_deps;
+      }
+    }
+    if (state->pending_deps == 0) ready.push_back(i);
+  }
+  // Receiving into a temporary buffer does not depend on any prior Action,
+  // so all of those receives are started right away.
+  for (int i = 0; i < num_actions; ++i) {
+    ActionState* state = &states_[i];
+    if (schedule_.actions[i].kind == Action::RECV_REDUCE &&
+        state->chunk.NumElements() > 0) {
+      state->tmp_chunk = ca_->TempChunkRange(schedule_.actions[i].chunk_begin,
+                                             schedule_.actions[i].chunk_end);
+      CHECK(state->tmp_chunk.IsAligned()) << schedule_.actions[i].DebugString();
+      ++pending_count_;
+      DispatchRecv(i, &state->tmp_chunk, ActionDoneCallback(i, &queue));
+    }
+  }
+
+  while (!aborted_) {
+    // Start every ready Action.  Those that complete synchronously may
+    // make further Actions ready.
+    while (!ready.empty() && !aborted_) {
+      const int i = ready.back();
+      ready.pop_back();
+      if (StartAction(i, &queue)) CompleteAction(i, &ready);
+    }
+    if (aborted_ || done_count_ == num_actions) break;
+    // Wait for an asynchronous transfer to complete.
+    CHECK_GT(pending_count_, 0);
+    const int i = queue.Dequeue();
+    --pending_count_;
+    if (aborted_) break;
+    if (schedule_.actions[i].kind == Action::RECV_REDUCE) {
+      states_[i].recv_done = true;
+      // If the merge must still wait for earlier Actions, StartAction
+      // performs it once they are done.
+      if (states_[i].pending_deps > 0) continue;
+      if (!ReduceAction(i)) break;
+    }
+    CompleteAction(i, &ready);
+  }
+
+  if (aborted_) {
+    // All of the pending data actions should be aborted; field the
+    // callbacks before quitting.
+    while (pending_count_ > 0) {
+      queue.Dequeue();
+      --pending_count_;
+    }
+  }
+
+  VLOG(2) << this << " rank=" << rank_ << " finish; done " << done_count_
+          << " of " << num_actions << " actions";
+  return !aborted_;
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,158 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_TREE_REDUCER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_TREE_REDUCER_H_
+
+#include <atomic>
+#include <deque>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/device_attributes.pb.h"
+#include "tensorflow/core/lib/core/notification.h"
+
+namespace tensorflow {
+class DeviceMgr;
+
+// Collective all-reduce with O(log N) latency steps, for the
+// RECURSIVE_HALVING_REDUCE, DOUBLE_BINARY_TREE_REDUCE and
+// HIERARCHICAL_REDUCE algorithms.
+//
+// Every device independently computes a Schedule of Actions on ranges
+// of chunks of the tensor from the CollectiveParams.  An Action waits
+// only for the earlier Actions of its Schedule on overlapping chunks, so
+// Actions on disjoint chunks, e.g. the segments of a pipelined tree,
+// proceed concurrently.
+class TreeReducer : public CollectiveReducer {
+ public:
+  TreeReducer(CollectiveExecutor* col_exec, const DeviceMgr* dev_mgr,
+              OpKernelContext* ctx, OpKernelContext::Params* op_params,
+              const CollectiveParams& col_params, const string& exec_key,
+              int64 step_id, ReduceAlgorithm algorithm, const Tensor* input,
+              Tensor* output);
+
+  ~TreeReducer() override;
+
+  void Run(StatusCallback done) override;
+
+  // One step of the Schedule of a device.
+  struct Action {
+    enum Kind {
+      SEND = 0,     // Send the chunks to peer.
+      RECV,         // Overwrite the chunks by the value received from peer.
+      RECV_REDUCE,  // Merge the value received from peer into the chunks.
+      FINALIZE,     // Apply the final_op to the fully reduced chunks.
+    };
+    Kind kind;
+    int peer;         // Default rank of the peer.  Unused by FINALIZE.
+    int tag;          // Identifies a SEND to its RECV or RECV_REDUCE.
+    int chunk_begin;  // The Action covers chunks [chunk_begin, chunk_end).
+    int chunk_end;
+    string DebugString() const;
+  };
+
+  struct Schedule {
+    int num_chunks = 0;  // Number of chunks the tensor is divided into.
+    std::vector<Action> actions;
+  };
+
+  // Computes the Schedule of the device with default rank 'rank' for a
+  // reduction of 'tensor_bytes' bytes with 'algorithm', which must not be
+  // RING_REDUCE.
+  static Status BuildSchedule(ReduceAlgorithm algorithm,
+                              const CollectiveParams& col_params, int rank,
+                              int64 tensor_bytes, Schedule* schedule);
+
+ private:
+  // Called when a bad status is received that implies we should terminate
+  // execution and return a bad status.
+  void StartAbort(const Status& s);
+  void Finish(bool ok);
+  Status ComputeBinOp(Device* device, OpKernel* op, Tensor* output,
+                      Tensor* input);
+  bool RunActions();
+
+  // Progress of a single Action of schedule_.
+  struct ActionState {
+    Tensor chunk;                 // alias to the chunks of the Action
+    Tensor tmp_chunk;             // RECV_REDUCE only: the received value
+    int pending_deps = 0;         // earlier Actions not yet done
+    std::vector<int> dependents;  // later Actions waiting for this one
+    bool recv_done = false;       // RECV_REDUCE only
+  };
+
+  // Producer/Consumer Queue of indices of Actions with a completed
+  // asynchronous transfer.
+  class PCQueue {
+   public:
+    void Enqueue(int action_idx);
+    int Dequeue();
+
+   private:
+    mutex pcq_mu_;
+    condition_variable cv_;
+    int waiter_count_ GUARDED_BY(pcq_mu_) = 0;
+    std::deque<int> deque_ GUARDED_BY(pcq_mu_);
+  };
+
+  // Starts the Action, all of whose dependencies are done, and returns
+  // true if it is done as well, i.e. it had nothing asynchronous to wait
+  // for.
+  bool StartAction(int action_idx, PCQueue* queue);
+  // Marks the Action done and appends the dependents it unblocks to
+  // 'ready'.
+  void CompleteAction(int action_idx, std::vector<int>* ready);
+  // Applies merge_op or final_op to the chunks of the Action.
+  bool ReduceAction(int action_idx);
+  bool FinalizeAction(int action_idx);
+  StatusCallback ActionDoneCallback(int action_idx, PCQueue* queue);
+  void DispatchSend(int action_idx, const StatusCallback& done);
+  void DispatchRecv(int action_idx, Tensor* dst, const StatusCallback& done);
+
+  CollectiveExecutor* col_exec_;        // Not owned
+  const DeviceMgr* dev_mgr_;            // Not owned
+  OpKernelContext* ctx_;                // Not owned
+  OpKernelContext::Params* op_params_;  // Not owned
+  const CollectiveParams& col_params_;
+  const string exec_key_;
+  const Tensor* input_;  // Not owned
+  Tensor* output_;       // Not owned
+  const int rank_;
+  const int64 step_id_;
+  const int group_size_;
+  const ReduceAlgorithm algorithm_;
+  Tensor group_size_tensor_;
+  Notification group_size_tensor_ready_;
+  std::unique_ptr<CollectiveAdapter> ca_;
+  StatusCallback done_;
+  Device* device_;  // The device for which this instance labors
+  const string device_name_;
+  DeviceLocality device_locality_;
+
+  mutex status_mu_;
+  Status status_ GUARDED_BY(status_mu_);
+
+  // Accessed only by the thread running RunActions, except for the
+  // tensors which are also accessed by transfers in flight.
+  Schedule schedule_;
+  std::vector<ActionState> states_;
+  int done_count_ = 0;
+  int pending_count_ = 0;
+  std::atomic<bool> aborted_{false};
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_TREE_REDUCER_H_
@@ -0,0 +1,606 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/tree_reducer.h"
+
+#include <map>
+#include <set>
+#include <tuple>
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/device_resolver_local.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/common_runtime/ring_reducer.h"
+#include "tensorflow/core/common_runtime/test_collective_executor_mgr.h"
+#include "tensorflow/core/common_runtime/threadpool_device.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+typedef TreeReducer::Action Action;
+
+// Returns CollectiveParams for num_tasks tasks of num_devices devices
+// each, as completed by a ParamResolver from the point of view of a
+// single process running all of the devices.
+CollectiveParams MakeParams(int num_tasks, int num_devices) {
+  CollectiveParams cp;
+  cp.name = "test_collective";
+  cp.group.group_key = 5;
+  cp.group.group_size = num_tasks * num_devices;
+  cp.group.num_tasks = num_tasks;
+  cp.group.device_type = DEVICE_CPU;
+  cp.instance.instance_key = 17;
+  cp.instance.type = REDUCTION_COLLECTIVE;
+  cp.instance.same_num_devices_per_task = true;
+  cp.instance.impl_details.subdiv_offsets.push_back(0);
+  cp.instance.impl_details.subdiv_permutations.resize(1);
+  for (int ti = 0; ti < num_tasks; ++ti) {
+    string task_name = strings::StrCat("/job:worker/replica:0/task:", ti);
+    for (int di = 0; di < num_devices; ++di) {
+      cp.instance.device_names.push_back(
+          strings::StrCat(task_name, "/cpu:", di));
+      cp.instance.task_names.push_back(task_name);
+      // This test runs in a single process so is_local is always true.
+      cp.task.is_local.push_back(true);
+      cp.instance.impl_details.subdiv_permutations[0].push_back(
+          ti * num_devices + di);
+    }
+  }
+  return cp;
+}
+
+// Executes the Schedules of all devices of a group sequentially on
+// symbolic values, recording for every chunk which ranks' inputs it has
+// merged and how often it was finalized, and checks that every device
+// ends with every chunk merged from all ranks and finalized once.
+void CheckSchedules(ReduceAlgorithm algorithm, int num_tasks, int num_devices,
+                    int64 tensor_bytes) {
+  const CollectiveParams cp = MakeParams(num_tasks, num_devices);
+  const int group_size = cp.group.group_size;
+  std::vector<TreeReducer::Schedule> schedules(group_size);
+  for (int rank = 0; rank < group_size; ++rank) {
+    TF_ASSERT_OK(TreeReducer::BuildSchedule(algorithm, cp, rank, tensor_bytes,
+                                            &schedules[rank]));
+    ASSERT_EQ(schedules[0].num_chunks, schedules[rank].num_chunks);
+  }
+  const int num_chunks = schedules[0].num_chunks;
+  struct Value {
+    std::vector<bool> ranks;
+    int finalized = 0;
+  };
+  std::vector<std::vector<Value>> values(group_size);
+  for (int rank = 0; rank < group_size; ++rank) {
+    values[rank].resize(num_chunks);
+    for (Value& v : values[rank]) {
+      v.ranks.resize(group_size, false);
+      v.ranks[rank] = true;
+    }
+  }
+  // Sends deliver a copy of their chunks right away, so a device only
+  // ever blocks on a receive.
+  // Keyed by (sender, receiver, tag).
+  typedef std::tuple<int, int, int> TransferKey;
+  std::map<TransferKey, std::pair<const Action*, std::vector<Value>>>
+      in_flight;
+  std::vector<size_t> next_action(group_size, 0);
+  bool progress = true;
+  while (progress) {
+    progress = false;
+    for (int rank = 0; rank < group_size; ++rank) {
+      const std::vector<Action>& actions = schedules[rank].actions;
+      for (; next_action[rank] < actions.size(); ++next_action[rank]) {
+        const Action& a = actions[next_action[rank]];
+        std::vector<Value>& chunks = values[rank];
+        if (a.kind == Action::SEND) {
+          auto key = std::make_tuple(rank, a.peer, a.tag);
+          ASSERT_EQ(0, in_flight.count(key)) << a.DebugString();
+          in_flight[key] = std::make_pair(
+              &a, std::vector<Value>(chunks.begin() + a.chunk_begin,
+                                     chunks.begin() + a.chunk_end));
+        } else if (a.kind == Action::FINALIZE) {
+          for (int c = a.chunk_begin; c < a.chunk_end; ++c) {
+            ++chunks[c].finalized;
+          }
+        } else {
+          auto it = in_flight.find(std::make_tuple(a.peer, rank, a.tag));
+          if (it == in_flight.end()) break;
+          const Action* send = it->second.first;
+          ASSERT_EQ(send->chunk_begin, a.chunk_begin) << a.DebugString();
+          ASSERT_EQ(send->chunk_end, a.chunk_end) << a.DebugString();
+          for (int c = a.chunk_begin; c < a.chunk_end; ++c) {
+            const Value& received = it->second.second[c - a.chunk_begin];
+            if (a.kind == Action::RECV) {
+              chunks[c] = received;
+            } else {
+              EXPECT_EQ(0, chunks[c].finalized + received.finalized);
+              for (int r = 0; r < group_size; ++r) {
+                EXPECT_FALSE(chunks[c].ranks[r] && received.ranks[r])
+                    << "rank " << r << " merged twice into chunk " << c;
+                chunks[c].ranks[r] = chunks[c].ranks[r] || received.ranks[r];
+              }
+            }
+          }
+          in_flight.erase(it);
+        }
+        progress = true;
+      }
+    }
+  }
+  EXPECT_TRUE(in_flight.empty());
+  for (int rank = 0; rank < group_size; ++rank) {
+    ASSERT_EQ(schedules[rank].actions.size(), next_action[rank])
+        << "deadlock at rank " << rank;
+    for (int c = 0; c < num_chunks; ++c) {
+      EXPECT_EQ(1, values[rank][c].finalized) << "rank " << rank << " chunk "
+                                              << c;
+      for (int r = 0; r < group_size; ++r) {
+        EXPECT_TRUE(values[rank][c].ranks[r])
+            << "rank " << rank << " chunk " << c << " is missing " << r;
+      }
+    }
+  }
+}
+
+TEST(TreeReducerScheduleTest, RecursiveHalving) {
+  for (int group_size = 1; group_size <= 33; ++group_size) {
+    CheckSchedules(RECURSIVE_HALVING_REDUCE, 1, group_size, 1024);
+  }
+}
+
+TEST(TreeReducerScheduleTest, DoubleBinaryTree) {
+  for (int group_size = 1; group_size <= 33; ++group_size) {
+    CheckSchedules(DOUBLE_BINARY_TREE_REDUCE, 1, group_size, 1024);
+    CheckSchedules(DOUBLE_BINARY_TREE_REDUCE, 1, group_size, 1 << 20);
+  }
+}
+
+TEST(TreeReducerScheduleTest, Hierarchical) {
+  for (int num_tasks = 1; num_tasks <= 6; ++num_tasks) {
+    for (int num_devices = 1; num_devices <= 6; ++num_devices) {
+      CheckSchedules(HIERARCHICAL_REDUCE, num_tasks, num_devices, 1024);
+    }
+  }
+}
+
+TEST(TreeReducerScheduleTest, DoubleBinaryTreeLeaves) {
+  // Apart from the last rank of an odd sized group, every rank forwards
+  // data, i.e. sends to a child, in only one of the two trees.
+  for (int group_size = 3; group_size <= 33; ++group_size) {
+    const CollectiveParams cp = MakeParams(1, group_size);
+    for (int rank = 0; rank < group_size; ++rank) {
+      TreeReducer::Schedule schedule;
+      TF_ASSERT_OK(TreeReducer::BuildSchedule(DOUBLE_BINARY_TREE_REDUCE, cp,
+                                              rank, 0, &schedule));
+      std::set<int> forwarding_trees;
+      for (const Action& a : schedule.actions) {
+        if (a.kind == Action::RECV_REDUCE) {
+          forwarding_trees.insert(a.chunk_begin * 2 / schedule.num_chunks);
+        }
+      }
+      if (group_size % 2 == 0 || rank != group_size - 1) {
+        EXPECT_GE(1, forwarding_trees.size())
+            << "group_size " << group_size << " rank " << rank;
+      }
+    }
+  }
+}
+
+TEST(TreeReducerScheduleTest, HierarchicalNeedsUniformTasks) {
+  CollectiveParams cp = MakeParams(2, 2);
+  cp.instance.task_names[1] = cp.instance.task_names[2];
+  TreeReducer::Schedule schedule;
+  EXPECT_TRUE(errors::IsInvalidArgument(TreeReducer::BuildSchedule(
+      HIERARCHICAL_REDUCE, cp, 0, 1024, &schedule)));
+}
+
+TEST(ChooseReduceAlgorithmTest, BySizeAndTopology) {
+  const CollectiveParams pair = MakeParams(1, 2);
+  EXPECT_EQ(RING_REDUCE, ChooseReduceAlgorithm(pair, 16));
+  const CollectiveParams flat = MakeParams(1, 16);
+  EXPECT_EQ(RECURSIVE_HALVING_REDUCE, ChooseReduceAlgorithm(flat, 16));
+  EXPECT_EQ(DOUBLE_BINARY_TREE_REDUCE, ChooseReduceAlgorithm(flat, 1 << 20));
+  EXPECT_EQ(RING_REDUCE, ChooseReduceAlgorithm(flat, 64 << 20));
+  const CollectiveParams tasks = MakeParams(4, 1);
+  EXPECT_EQ(RECURSIVE_HALVING_REDUCE, ChooseReduceAlgorithm(tasks, 16));
+  CollectiveParams hosts = MakeParams(4, 4);
+  EXPECT_EQ(HIERARCHICAL_REDUCE, ChooseReduceAlgorithm(hosts, 16));
+  EXPECT_EQ(HIERARCHICAL_REDUCE, ChooseReduceAlgorithm(hosts, 1 << 20));
+  EXPECT_EQ(RING_REDUCE, ChooseReduceAlgorithm(hosts, 64 << 20));
+  hosts.instance.same_num_devices_per_task = false;
+  EXPECT_EQ(RECURSIVE_HALVING_REDUCE, ChooseReduceAlgorithm(hosts, 16));
+}
+
+// Wraps CollectiveRemoteAccessLocal with the ability to return an
+// error status to the N'th action.
+class FailTestRMA : public CollectiveRemoteAccessLocal {
+ public:
+  FailTestRMA(const DeviceMgr* dev_mgr, DeviceResolverInterface* dev_resolver,
+              int64 step_id, int fail_after)
+      : CollectiveRemoteAccessLocal(dev_mgr, dev_resolver, step_id),
+        fail_after_(fail_after) {}
+
+  bool MaybeFail(const StatusCallback& done) {
+    bool fail_now = false;
+    {
+      mutex_lock l(mu_);
+      if (fail_after_ > 0) {
+        fail_now = (--fail_after_ == 0);
+      }
+    }
+    if (fail_now) {
+      done(errors::Internal("Deliberate failure"));
+      return true;
+    }
+    return false;
+  }
+
+  void RecvFromPeer(const string& peer_device, const string& peer_task,
+                    bool peer_is_local, const string& key, Device* to_device,
+                    DeviceContext* to_device_ctx,
+                    const AllocatorAttributes& to_alloc_attr, Tensor* to_tensor,
+                    const DeviceLocality& client_locality,
+                    const StatusCallback& done) override {
+    if (MaybeFail(done)) return;
+    CollectiveRemoteAccessLocal::RecvFromPeer(
+        peer_device, peer_task, peer_is_local, key, to_device, to_device_ctx,
+        to_alloc_attr, to_tensor, client_locality, done);
+  }
+
+  void PostToPeer(const string& peer_device, const string& peer_task,
+                  const string& key, Device* from_device,
+                  DeviceContext* from_device_ctx,
+                  const AllocatorAttributes& from_alloc_attr,
+                  const Tensor* from_tensor,
+                  const DeviceLocality& client_locality,
+                  const StatusCallback& done) override {
+    if (MaybeFail(done)) return;
+    CollectiveRemoteAccessLocal::PostToPeer(
+        peer_device, peer_task, key, from_device, from_device_ctx,
+        from_alloc_attr, from_tensor, client_locality, done);
+  }
+
+  mutex mu_;
+  int fail_after_ GUARDED_BY(mu_);
+};
+
+std::unique_ptr<OpKernel> GetKernel(const NodeDef& node,
+                                    const DeviceType& device_type,
+                                    DeviceBase* device) {
+  Status status;
+  std::unique_ptr<OpKernel> k = CreateOpKernel(
+      device_type, device, device->GetAllocator(AllocatorAttributes()), node,
+      TF_GRAPH_DEF_VERSION, &status);
+  if (!status.ok()) {
+    LOG(FATAL) << status;
+  }
+  return k;
+}
+
+std::unique_ptr<OpKernel> GetBinOp(const string& op, DataType dtype,
+                                   DeviceBase* device) {
+  NodeDef node_def;
+  NodeDefBuilder builder(strings::StrCat(op, "_node"), op);
+  TF_CHECK_OK(builder.Attr("T", dtype)
+                  .Input(FakeInput(dtype))
+                  .Input(FakeInput(dtype))
+                  .Finalize(&node_def));
+  return GetKernel(node_def, DEVICE_CPU, device);
+}
+
+static int64 kStepId = 123;
+
+// Runs collective reductions among num_tasks * num_devices CPU devices in
+// a single process, all of which communicate by a
+// CollectiveRemoteAccessLocal.
+class ReduceHarness {
+ public:
+  ReduceHarness(int num_tasks, int num_devices, DataType dtype,
+                int fail_after)
+      : col_params_(MakeParams(num_tasks, num_devices)) {
+    col_params_.instance.data_type = dtype;
+    std::vector<Device*> local_devices;
+    SessionOptions sess_opts;
+    sess_opts.env = Env::Default();
+    Bytes mem_limit(4 << 20);
+    DeviceLocality dev_locality;
+    for (const string& dev_name : col_params_.instance.device_names) {
+      local_devices.push_back(new ThreadPoolDevice(
+          sess_opts, dev_name, mem_limit, dev_locality, cpu_allocator()));
+    }
+    dev_mgr_.reset(new DeviceMgr(local_devices));
+    dev_resolver_.reset(new DeviceResolverLocal(dev_mgr_.get()));
+    rma_ = new FailTestRMA(dev_mgr_.get(), dev_resolver_.get(), kStepId,
+                           fail_after);
+    col_exec_ = new BaseCollectiveExecutor(&col_exec_mgr_, rma_, kStepId,
+                                           dev_mgr_.get());
+    for (int rank = 0; rank < col_params_.group.group_size; ++rank) {
+      instances_.emplace_back(new DeviceInstance(rank, this));
+    }
+  }
+
+  ~ReduceHarness() {
+    instances_.clear();
+    col_exec_->Unref();
+  }
+
+  // Sets the input of device 'rank' to 'value'.
+  void InitTensor(int rank, const Tensor& value) {
+    instances_[rank]->tensor_ = Tensor(cpu_allocator(), value.dtype(),
+                                       value.shape());
+    CHECK(instances_[rank]->tensor_.CopyFrom(value, value.shape()));
+  }
+
+  // Reduces the inputs of all devices with 'algorithm' and waits for all
+  // devices to finish.  'iteration' distinguishes the executions of the
+  // instance.
+  void Reduce(ReduceAlgorithm algorithm, int iteration) {
+    BlockingCounter counter(instances_.size());
+    for (auto& instance : instances_) {
+      DeviceInstance* di = instance.get();
+      SchedClosure([di, algorithm, iteration, &counter] {
+        di->DoReduce(algorithm, iteration);
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  }
+
+  const Tensor& tensor(int rank) const { return instances_[rank]->tensor_; }
+  const Status& status(int rank) const { return instances_[rank]->status_; }
+
+ private:
+  class DeviceInstance {
+   public:
+    DeviceInstance(int rank, ReduceHarness* parent) : parent_(parent) {
+      col_params_.name = parent_->col_params_.name;
+      col_params_.group = parent_->col_params_.group;
+      col_params_.instance = parent_->col_params_.instance;
+      col_params_.task.is_local = parent_->col_params_.task.is_local;
+      col_params_.default_rank = rank;
+      col_params_.subdiv_rank = {rank};
+      TF_CHECK_OK(parent_->dev_mgr_->LookupDevice(
+          col_params_.instance.device_names[rank], &device_));
+      col_params_.merge_op =
+          GetBinOp("Add", col_params_.instance.data_type, device_);
+      col_params_.final_op =
+          GetBinOp("Div", col_params_.instance.data_type, device_);
+    }
+
+    void DoReduce(ReduceAlgorithm algorithm, int iteration) {
+      // Prepare an OpKernelContext.
+      OpKernelContext::Params op_params;
+      op_params.step_id = kStepId;
+      op_params.device = device_;
+      gtl::InlinedVector<TensorValue, 4> inputs;
+      inputs.push_back(TensorValue(&tensor_));
+      op_params.inputs = &inputs;
+      gtl::InlinedVector<AllocatorAttributes, 4> input_aa(
+          {AllocatorAttributes()});
+      op_params.input_alloc_attrs = &input_aa;
+      DeviceContext* dev_ctx = new DeviceContext;
+      gtl::InlinedVector<DeviceContext*, 4> input_dc({dev_ctx});
+      op_params.input_device_contexts = &input_dc;
+      op_params.op_device_context = dev_ctx;
+      int forward_from = 0;
+      op_params.forward_from_array = &forward_from;
+      AllocatorAttributes generic_alloc_attr;
+      op_params.output_attr_array = &generic_alloc_attr;
+      std::unique_ptr<OpKernel> op = parent_->GetCollectiveReduce(device_);
+      op_params.op_kernel = op.get();
+      OpKernelContext ctx(&op_params, 1);
+
+      // We never actually execute the kernel, so we need to do the
+      // output allocation that it would do, ourselves.
+      Tensor* output_tensor_ptr = nullptr;
+      TF_CHECK_OK(ctx.forward_input_or_allocate_output({0}, 0, tensor_.shape(),
+                                                       &output_tensor_ptr));
+      CHECK_EQ(output_tensor_ptr, ctx.mutable_output(0));
+
+      string exec_key = strings::StrCat(col_params_.instance.instance_key,
+                                        ":0:", iteration);
+      std::unique_ptr<CollectiveReducer> reducer;
+      if (algorithm == RING_REDUCE) {
+        reducer.reset(new RingReducer(parent_->col_exec_,
+                                      parent_->dev_mgr_.get(), &ctx,
+                                      &op_params, col_params_, exec_key,
+                                      kStepId, &tensor_, &tensor_));
+      } else {
+        reducer.reset(new TreeReducer(
+            parent_->col_exec_, parent_->dev_mgr_.get(), &ctx, &op_params,
+            col_params_, exec_key, kStepId, algorithm, &tensor_, &tensor_));
+      }
+      Notification notification;
+      reducer->Run([this, &notification](Status s) {
+        status_ = s;
+        notification.Notify();
+      });
+      notification.WaitForNotification();
+      CHECK(tensor_.CopyFrom(*ctx.mutable_output(0), tensor_.shape()));
+      dev_ctx->Unref();
+    }
+
+    ReduceHarness* parent_;
+    Device* device_;
+    CollectiveParams col_params_;
+    Tensor tensor_;
+    Status status_;
+  };
+
+  std::unique_ptr<OpKernel> GetCollectiveReduce(DeviceBase* device) {
+    mutex_lock l(mu_);
+    NodeDef node_def;
+    NodeDefBuilder builder(
+        strings::StrCat("collective_reduce_", reduce_counter_++),
+        "CollectiveReduce");
+    TF_CHECK_OK(
+        builder.Attr("T", col_params_.instance.data_type)
+            .Attr("merge_op", "Add")
+            .Attr("final_op", "Div")
+            .Attr("group_size", col_params_.group.group_size)
+            .Attr("group_key", col_params_.group.group_key)
+            .Attr("instance_key", col_params_.instance.instance_key)
+            .Attr("subdiv_offsets",
+                  col_params_.instance.impl_details.subdiv_offsets)
+            .Input(FakeInput(col_params_.instance.data_type))
+            .Finalize(&node_def));
+    return GetKernel(node_def, DEVICE_CPU, device);
+  }
+
+  CollectiveParams col_params_;
+  TestCollectiveExecutorMgr col_exec_mgr_;
+  CollectiveExecutor* col_exec_;
+  CollectiveRemoteAccessLocal* rma_;
+  std::unique_ptr<DeviceResolverLocal> dev_resolver_;
+  std::unique_ptr<DeviceMgr> dev_mgr_;
+  std::vector<std::unique_ptr<DeviceInstance>> instances_;
+  mutex mu_;
+  int32 reduce_counter_ GUARDED_BY(mu_) = 0;
+};
+
+template <typename T>
+void RunTest(DataType dtype, ReduceAlgorithm algorithm, int num_tasks,
+             int num_devices, int tensor_len, int fail_after) {
+  ReduceHarness harness(num_tasks, num_devices, dtype, fail_after);
+  const int group_size = num_tasks * num_devices;
+  std::vector<double> expected(tensor_len, 0.0);
+  for (int rank = 0; rank < group_size; ++rank) {
+    Tensor t(dtype, TensorShape({tensor_len}));
+    for (int i = 0; i < tensor_len; ++i) {
+      const int value = rank * 10 + i;
+      t.flat<T>()(i) = static_cast<T>(value);
+      expected[i] += value;
+    }
+    harness.InitTensor(rank, t);
+  }
+  harness.Reduce(algorithm, 0);
+  for (int rank = 0; rank < group_size; ++rank) {
+    if (fail_after > 0) {
+      // Every device terminated with the expected error status.
+      EXPECT_EQ("Deliberate failure", harness.status(rank).error_message());
+      continue;
+    }
+    // Every device computed the same correct reduction value.
+    TF_EXPECT_OK(harness.status(rank));
+    const Tensor& actual = harness.tensor(rank);
+    for (int i = 0; i < tensor_len; ++i) {
+      EXPECT_EQ(static_cast<T>(expected[i] / group_size),
+                actual.flat<T>()(i))
+          << "Mismatch at device " << rank << " index " << i;
+    }
+  }
+}
+
+#define DEF_TEST(B, A, W, D, L, F)                                            \
+  TEST(TreeReducerTest, DaTy##B##_##A##_Wkr##W##_Dev##D##_Len##L##_Abrt##F) { \
+    DataType dtype = DT_##B;                                                  \
+    switch (dtype) {                                                          \
+      case DT_FLOAT: {                                                        \
+        RunTest<float>(dtype, A##_REDUCE, W, D, L, F);                        \
+      } break;                                                                \
+      case DT_DOUBLE: {                                                       \
+        RunTest<double>(dtype, A##_REDUCE, W, D, L, F);                       \
+      } break;                                                                \
+      case DT_INT32: {                                                        \
+        RunTest<int32>(dtype, A##_REDUCE, W, D, L, F);                        \
+      } break;                                                                \
+      case DT_INT64: {                                                        \
+        RunTest<int64>(dtype, A##_REDUCE, W, D, L, F);                        \
+      } break;                                                                \
+      default:                                                                \
+        LOG(FATAL) << "Unimplemented";                                        \
+    }                                                                         \
+  }
+
+// Success tests.  The sums of the inputs are multiples of the group size
+// so that the result is exact for integer types.
+DEF_TEST(FLOAT, RECURSIVE_HALVING, 1, 2, 1, 0)
+DEF_TEST(FLOAT, RECURSIVE_HALVING, 1, 8, 1001, 0)
+DEF_TEST(FLOAT, RECURSIVE_HALVING, 1, 13, 4095, 0)
+DEF_TEST(DOUBLE, RECURSIVE_HALVING, 1, 16, 4096, 0)
+DEF_TEST(INT64, RECURSIVE_HALVING, 1, 6, 1001, 0)
+DEF_TEST(FLOAT, DOUBLE_BINARY_TREE, 1, 2, 1, 0)
+DEF_TEST(FLOAT, DOUBLE_BINARY_TREE, 1, 7, 1001, 0)
+DEF_TEST(FLOAT, DOUBLE_BINARY_TREE, 1, 16, 104599, 0)
+DEF_TEST(INT64, DOUBLE_BINARY_TREE, 1, 12, 100000, 0)
+DEF_TEST(FLOAT, HIERARCHICAL, 2, 4, 128, 0)
+DEF_TEST(FLOAT, HIERARCHICAL, 3, 5, 4095, 0)
+DEF_TEST(DOUBLE, HIERARCHICAL, 4, 8, 9408, 0)
+DEF_TEST(INT64, HIERARCHICAL, 4, 2, 1001, 0)
+
+// Failure tests
+DEF_TEST(FLOAT, RECURSIVE_HALVING, 1, 16, 9408, 7)
+DEF_TEST(FLOAT, DOUBLE_BINARY_TREE, 1, 16, 9408, 11)
+DEF_TEST(FLOAT, HIERARCHICAL, 4, 4, 9408, 5)
+
+// Times an all-reduce of 'tensor_len' floats among 'num_tasks' tasks of
+// 'num_devices' CPU devices each.
+static void BM_Reduce(int iters, ReduceAlgorithm algorithm, int num_tasks,
+                      int num_devices, int tensor_len) {
+  testing::StopTiming();
+  ReduceHarness harness(num_tasks, num_devices, DT_FLOAT, 0);
+  const int group_size = num_tasks * num_devices;
+  Tensor t(DT_FLOAT, TensorShape({tensor_len}));
+  t.flat<float>().setConstant(1.0);
+  for (int rank = 0; rank < group_size; ++rank) {
+    harness.InitTensor(rank, t);
+  }
+  testing::BytesProcessed(static_cast<int64>(iters) * group_size *
+                          tensor_len * sizeof(float));
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    harness.Reduce(algorithm, i);
+  }
+  testing::StopTiming();
+  for (int rank = 0; rank < group_size; ++rank) {
+    TF_CHECK_OK(harness.status(rank));
+  }
+}
+
+#define BM_REDUCE(A, W, D, L)                                  \
+  static void BM_##A##_Wkr##W##_Dev##D##_Len##L(int iters) {   \
+    BM_Reduce(iters, A##_REDUCE, W, D, L);                     \
+  }                                                            \
+  BENCHMARK(BM_##A##_Wkr##W##_Dev##D##_Len##L);
+
+// Latency bound: small tensors on many devices.
+BM_REDUCE(RING, 1, 64, 256)
+BM_REDUCE(RECURSIVE_HALVING, 1, 64, 256)
+BM_REDUCE(DOUBLE_BINARY_TREE, 1, 64, 256)
+BM_REDUCE(RING, 8, 8, 256)
+BM_REDUCE(HIERARCHICAL, 8, 8, 256)
+// Medium sized tensors.
+BM_REDUCE(RING, 1, 32, 65536)
+BM_REDUCE(RECURSIVE_HALVING, 1, 32, 65536)
+BM_REDUCE(DOUBLE_BINARY_TREE, 1, 32, 65536)
+BM_REDUCE(RING, 4, 8, 65536)
+BM_REDUCE(HIERARCHICAL, 4, 8, 65536)
+
+}  // namespace
+}  // namespace tensorflow
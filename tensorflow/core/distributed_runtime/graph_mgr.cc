@@ -274,6 +274,9 @@ Status GraphMgr::InitItem(const string& session, const GraphDef& gdef,
     TF_RETURN_IF_ERROR(
         NewLocalExecutor(params, std::move(subgraph), &unit->root));
   }
+  if (graph_options.variable_prefetch_staleness() > 0) {
+    item->prefetch_cache.reset(new VariablePrefetchCache);
+  }
   return Status::OK();
 }
 
@@ -436,6 +439,26 @@ void GraphMgr::ExecuteAsync(const string& handle, const int64 step_id,
     return;
   }
 
+  if (item->prefetch_cache != nullptr) {
+    // The step may use variable values received by earlier steps, and
+    // receives its own values for later steps before it is done.
+    PrefetchingRendezvous* prefetching =
+        new PrefetchingRendezvous(rendezvous, item->prefetch_cache.get());
+    StartParallelExecutors(
+        handle, step_id, item, prefetching, collector, cost_graph,
+        cancellation_manager,
+        [item, rendezvous, prefetching, done](const Status& s) {
+          prefetching->WhenRefreshed([item, rendezvous, prefetching, done,
+                                      s]() {
+            done(s);
+            prefetching->Unref();
+            rendezvous->Unref();
+            item->Unref();
+          });
+        });
+    return;
+  }
+
   StartParallelExecutors(handle, step_id, item, rendezvous, collector,
                          cost_graph, cancellation_manager,
                          [item, rendezvous, done](const Status& s) {
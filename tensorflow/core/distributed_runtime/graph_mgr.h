@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/executor.h"
 #include "tensorflow/core/common_runtime/process_function_library_runtime.h"
 #include "tensorflow/core/distributed_runtime/message_wrappers.h"
+#include "tensorflow/core/distributed_runtime/prefetching_rendezvous.h"
 #include "tensorflow/core/distributed_runtime/worker_env.h"
 #include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/framework/cost_graph.pb.h"
@@ -135,6 +136,10 @@ class GraphMgr {
     // has a root executor which may call into the runtime library.
     std::vector<ExecutionUnit> units;
 
+    // The variable values received by the steps of the graph, if
+    // GraphOptions.variable_prefetch_staleness is positive.
+    std::unique_ptr<VariablePrefetchCache> prefetch_cache;
+
     // Used to deregister a cost model when cost model is required in graph
     // manager.
     GraphMgr* graph_mgr;
@@ -308,6 +308,39 @@ class DeviceFinder {
   TF_DISALLOW_COPY_AND_ASSIGN(DeviceFinder);
 };
 
+namespace {
+
+// Creates the worker cache of the session-specific cluster in `options`,
+// pings its workers, and returns the devices and workers that a session
+// with `device_filters` uses. The client device is CPU:0 of the master.
+Status FindClusterDevices(
+    const WorkerCacheFactoryOptions& options,
+    const protobuf::RepeatedPtrField<string>& device_filters, MasterEnv* env,
+    std::unique_ptr<WorkerCacheInterface>* worker_cache,
+    std::vector<std::unique_ptr<Device>>* remote_devices,
+    std::unique_ptr<DeviceSet>* device_set,
+    std::vector<string>* filtered_worker_list) {
+  WorkerCacheInterface* cache = nullptr;
+  TF_RETURN_IF_ERROR(env->worker_cache_factory(options, &cache));
+  worker_cache->reset(cache);
+  TF_RETURN_IF_ERROR(DeviceFinder::GetRemoteDevices(device_filters, env, cache,
+                                                    remote_devices));
+  device_set->reset(new DeviceSet);
+  for (auto&& d : *remote_devices) {
+    (*device_set)->AddDevice(d.get());
+    DeviceNameUtils::ParsedName name = d->parsed_name();
+    if (name.job == *options.job_name && name.task == options.task_index &&
+        name.type == "CPU" && name.id == 0) {
+      (*device_set)->set_client_device(d.get());
+    }
+  }
+  DeviceFinder::GetRemoteWorkers(device_filters, env, cache,
+                                 filtered_worker_list);
+  return Status::OK();
+}
+
+}  // namespace
+
 void Master::CreateSession(const CreateSessionRequest* req,
                            CreateSessionResponse* resp, MyClosure done) {
   SchedClosure([this, req, resp, done]() {
@@ -321,7 +354,6 @@ void Master::CreateSession(const CreateSessionRequest* req,
 
     // The following 4 variables are set differently, depending on whether this
     // session uses a client-provided clusterspec or not.
-    WorkerCacheInterface* worker_cache = nullptr;
     // Note: worker_cache_ptr will be null except if this session is using a
     // client-supplied ClusterDef (ClusterSpec propagation).
     std::unique_ptr<WorkerCacheInterface> worker_cache_ptr;
@@ -329,6 +361,7 @@ void Master::CreateSession(const CreateSessionRequest* req,
     // TODO(saeta): Convert to std::make_unique when available.
     std::unique_ptr<std::vector<std::unique_ptr<Device>>> remote_devices(
         new std::vector<std::unique_ptr<Device>>());
+    std::vector<string> filtered_worker_list;
 
     if (req->config().has_cluster_def()) {
       worker_cache_factory_options.cluster_def = &req->config().cluster_def();
@@ -371,29 +404,15 @@ void Master::CreateSession(const CreateSessionRequest* req,
         }
       }
 
-      // Create the worker cache from the computed server_def.
-      status = env_->worker_cache_factory(worker_cache_factory_options,
-                                          &worker_cache);
+      // Create the worker cache from the computed server_def, ping all the
+      // workers and build the list of devices that the session will use.
+      status = FindClusterDevices(
+          worker_cache_factory_options, req->config().device_filters(), env_,
+          &worker_cache_ptr, remote_devices.get(), &device_set,
+          &filtered_worker_list);
       if (!status.ok()) return;
-      worker_cache_ptr = std::unique_ptr<WorkerCacheInterface>(worker_cache);
-      // Ping all the workers and build the list of devices that the
-      // session will use.
-      status =
-          DeviceFinder::GetRemoteDevices(req->config().device_filters(), env_,
-                                         worker_cache, remote_devices.get());
-      if (!status.ok()) return;
-      device_set.reset(new DeviceSet);
-      for (auto&& d : *remote_devices) {
-        device_set->AddDevice(d.get());
-        DeviceNameUtils::ParsedName name = d->parsed_name();
-        if (name.job == *worker_cache_factory_options.job_name &&
-            name.task == worker_cache_factory_options.task_index &&
-            name.type == "CPU" && name.id == 0) {
-          device_set->set_client_device(d.get());
-        }
-      }
     } else {
-      worker_cache = env_->worker_cache;
+      WorkerCacheInterface* worker_cache = env_->worker_cache;
       // Ping all the workers and build the list of devices that the
       // session will use.
       status =
@@ -413,6 +432,8 @@ void Master::CreateSession(const CreateSessionRequest* req,
         }
         num_local_devices++;
       }
+      DeviceFinder::GetRemoteWorkers(req->config().device_filters(), env_,
+                                     worker_cache, &filtered_worker_list);
     }
 
     CHECK(device_set->client_device()) << "No client device found. Missing "
@@ -421,10 +442,6 @@ void Master::CreateSession(const CreateSessionRequest* req,
     SessionOptions options;
     options.config = req->config();
 
-    std::vector<string> filtered_worker_list;
-    DeviceFinder::GetRemoteWorkers(req->config().device_filters(), env_,
-                                   worker_cache, &filtered_worker_list);
-
     MasterSession* session = env_->master_session_factory(
         options, env_, std::move(remote_devices), std::move(worker_cache_ptr),
         std::move(device_set), std::move(filtered_worker_list));
@@ -455,8 +472,11 @@ void Master::ExtendSession(const ExtendSessionRequest* req,
     return;
   }
 
-  SchedClosure([session, req, resp, done]() {
+  SchedClosure([this, session, req, resp, done]() {
     Status status = ValidateExternalGraphDefSyntax(req->graph_def());
+    if (status.ok() && req->has_cluster_def()) {
+      status = UpdateCluster(session, req->cluster_def());
+    }
     if (status.ok()) {
       status = session->Extend(req, resp);
     }
@@ -465,6 +485,29 @@ void Master::ExtendSession(const ExtendSessionRequest* req,
   });
 }
 
+Status Master::UpdateCluster(MasterSession* session,
+                             const ClusterDef& cluster_def) {
+  WorkerCacheFactoryOptions options;
+  TF_RETURN_IF_ERROR(
+      session->WorkerCacheFactoryOptionsForCluster(cluster_def, &options));
+  std::unique_ptr<WorkerCacheInterface> worker_cache;
+  std::unique_ptr<std::vector<std::unique_ptr<Device>>> remote_devices(
+      new std::vector<std::unique_ptr<Device>>());
+  std::unique_ptr<DeviceSet> device_set;
+  std::vector<string> filtered_worker_list;
+  TF_RETURN_IF_ERROR(FindClusterDevices(
+      options, session->config().device_filters(), env_, &worker_cache,
+      remote_devices.get(), &device_set, &filtered_worker_list));
+  if (device_set->client_device() == nullptr) {
+    return errors::InvalidArgument(
+        "The master /job:", *options.job_name, "/task:", options.task_index,
+        " has no CPU:0 device in the cluster ", cluster_def.ShortDebugString());
+  }
+  return session->UpdateCluster(options, std::move(remote_devices),
+                                std::move(worker_cache), std::move(device_set),
+                                std::move(filtered_worker_list));
+}
+
 void Master::PartialRunSetup(const PartialRunSetupRequest* req,
                              PartialRunSetupResponse* resp, MyClosure done) {
   auto session = FindMasterSession(req->session_handle());
@@ -105,6 +105,9 @@ class Master {
   // on the returned MasterSession if not null.
   MasterSession* FindMasterSession(const string& handle);
 
+  // Moves a session created with a ClusterDef to the cluster `cluster_def`.
+  Status UpdateCluster(MasterSession* session, const ClusterDef& cluster_def);
+
   TF_DISALLOW_COPY_AND_ASSIGN(Master);
 };
 
@@ -1153,6 +1153,7 @@ MasterSession::MasterSession(
 MasterSession::~MasterSession() {
   for (const auto& iter : run_graphs_) iter.second->Unref();
   for (const auto& iter : partial_run_graphs_) iter.second->Unref();
+  for (ReffedClientGraph* rcg : retired_graphs_) rcg->Unref();
 }
 
 void MasterSession::UpdateLastAccessTime() {
@@ -1181,15 +1182,22 @@ Status MasterSession::Create(GraphDef* graph_def,
     TF_RETURN_IF_ERROR(GraphExecutionState::MakeForBaseGraph(
         graph_def, execution_options, &execution_state_));
   }
+  if (options.cluster_def) {
+    cluster_def_ = *options.cluster_def;
+    master_job_name_ = *options.job_name;
+    master_task_index_ = options.task_index;
+    protocol_ = *options.protocol;
+  }
   should_delete_worker_sessions_ = true;
-  return CreateWorkerSessions(options);
+  return CreateWorkerSessions(options, get_worker_cache(),
+                              filtered_worker_list_);
 }
 
 Status MasterSession::CreateWorkerSessions(
-    const WorkerCacheFactoryOptions& options) {
-  const std::vector<string> worker_names = filtered_worker_list_;
-  WorkerCacheInterface* worker_cache = get_worker_cache();
-
+    const WorkerCacheFactoryOptions& options,
+    WorkerCacheInterface* worker_cache,
+    const std::vector<string>& worker_names,
+    std::vector<string>* created_workers) {
   struct WorkerGroup {
     // The worker name. (Not owned.)
     const string* name;
@@ -1262,14 +1270,16 @@ Status MasterSession::CreateWorkerSessions(
   done.Wait();
   for (size_t i = 0; i < workers.size(); ++i) {
     status.Update(workers[i].status);
+    if (created_workers != nullptr && workers[i].status.ok()) {
+      created_workers->push_back(worker_names[i]);
+    }
   }
   return status;
 }
 
-Status MasterSession::DeleteWorkerSessions() {
-  WorkerCacheInterface* worker_cache = get_worker_cache();
-  const std::vector<string>& worker_names = filtered_worker_list_;
-
+Status MasterSession::DeleteWorkerSessions(
+    WorkerCacheInterface* worker_cache,
+    const std::vector<string>& worker_names) {
   struct WorkerGroup {
     // The worker name. (Not owned.)
     const string* name;
@@ -1324,6 +1334,7 @@ Status MasterSession::DeleteWorkerSessions() {
 }
 
 Status MasterSession::ListDevices(ListDevicesResponse* resp) const {
+  mutex_lock l(mu_);
   if (worker_cache_) {
     // This is a ClusterSpec-propagated session, and thus env_->local_devices
     // are invalid.
@@ -1353,6 +1364,9 @@ Status MasterSession::Extend(const ExtendSessionRequest* req,
   std::unique_ptr<GraphExecutionState> extended_execution_state;
   {
     mutex_lock l(mu_);
+    while (updating_cluster_ && !closed_) {
+      cluster_updated_.wait(l);
+    }
     if (closed_) {
       return errors::FailedPrecondition("Session is closed.");
     }
@@ -1376,6 +1390,170 @@ Status MasterSession::Extend(const ExtendSessionRequest* req,
   return Status::OK();
 }
 
+Status MasterSession::WorkerCacheFactoryOptionsForCluster(
+    const ClusterDef& cluster_def, WorkerCacheFactoryOptions* options) const {
+  if (!worker_cache_) {
+    return errors::FailedPrecondition(
+        "Only sessions created with ConfigProto.cluster_def can be moved to "
+        "another cluster.");
+  }
+  options->cluster_def = &cluster_def;
+  options->job_name = &master_job_name_;
+  options->task_index = master_task_index_;
+  options->protocol = &protocol_;
+  return Status::OK();
+}
+
+Status MasterSession::UpdateCluster(
+    const WorkerCacheFactoryOptions& options,
+    std::unique_ptr<std::vector<std::unique_ptr<Device>>> remote_devs,
+    std::unique_ptr<WorkerCacheInterface> worker_cache,
+    std::unique_ptr<DeviceSet> device_set,
+    std::vector<string> filtered_worker_list) {
+  UpdateLastAccessTime();
+  std::unique_ptr<GraphExecutionState> execution_state;
+  std::vector<string> added_workers;
+  std::vector<string> staying_workers;
+  std::vector<string> removed_workers;
+  ClusterDef old_cluster_def;
+  WorkerCacheInterface* old_worker_cache;
+  {
+    mutex_lock l(mu_);
+    while (updating_cluster_ && !closed_) {
+      cluster_updated_.wait(l);
+    }
+    if (closed_) {
+      return errors::FailedPrecondition("Session is closed.");
+    }
+    if (!worker_cache_) {
+      return errors::FailedPrecondition(
+          "Only sessions created with ConfigProto.cluster_def can be moved "
+          "to another cluster.");
+    }
+    if (!partial_runs_.empty()) {
+      return errors::FailedPrecondition(
+          "Cannot move a session to another cluster while partial runs are "
+          "pending.");
+    }
+    // Places the graph on the new devices before any worker is contacted.
+    // Stateful nodes stay on their devices, unless those left the cluster.
+    GraphExecutionStateOptions execution_options;
+    execution_options.device_set = device_set.get();
+    execution_options.session_options = &session_opts_;
+    for (const auto& placement : execution_state_->GetStatefulPlacements()) {
+      if (device_set->FindDeviceByName(placement.second) != nullptr) {
+        execution_options.stateful_placements.insert(placement);
+      }
+    }
+    GraphDef graph_def = execution_state_->original_graph_def();
+    TF_RETURN_IF_ERROR(GraphExecutionState::MakeForBaseGraph(
+        &graph_def, execution_options, &execution_state));
+
+    std::unordered_set<string> old_workers(filtered_worker_list_.begin(),
+                                           filtered_worker_list_.end());
+    for (const string& worker : filtered_worker_list) {
+      if (old_workers.count(worker) == 0) {
+        added_workers.push_back(worker);
+      } else {
+        staying_workers.push_back(worker);
+      }
+    }
+    std::unordered_set<string> new_workers(filtered_worker_list.begin(),
+                                           filtered_worker_list.end());
+    for (const string& worker : filtered_worker_list_) {
+      if (new_workers.count(worker) == 0) removed_workers.push_back(worker);
+    }
+    old_cluster_def = cluster_def_;
+    old_worker_cache = worker_cache_.get();
+
+    // New steps, partial runs and extensions wait until the update is done,
+    // so the graph placed above stays current.
+    updating_cluster_ = true;
+    while (num_running_ != 0 && !closed_) {
+      num_running_is_zero_.wait(l);
+    }
+  }
+  auto done_updating = gtl::MakeCleanup([this] {
+    mutex_lock l(mu_);
+    updating_cluster_ = false;
+    cluster_updated_.notify_all();
+  });
+
+  // The RPCs to the workers are issued without holding mu_, so that
+  // Close() and the methods that do not start steps are not blocked.
+  std::vector<string> updated_workers;
+  Status s = CreateWorkerSessions(options, worker_cache.get(),
+                                  filtered_worker_list, &updated_workers);
+  if (s.ok()) {
+    mutex_lock l(mu_);
+    if (closed_) {
+      s = errors::FailedPrecondition("Session is closed.");
+    } else {
+      retired_clusters_.emplace_back();
+      RetiredCluster& retired = retired_clusters_.back();
+      retired.remote_devs = std::move(remote_devs_);
+      retired.worker_cache = std::move(worker_cache_);
+      retired.devices = std::move(devices_);
+      for (RCGMap* rcg_map :
+           {&run_graphs_, &partial_run_graphs_, &callables_}) {
+        ClearRunsTable(&retired_graphs_, rcg_map);
+      }
+
+      remote_devs_ = std::move(remote_devs);
+      worker_cache_ = std::move(worker_cache);
+      devices_ = std::move(device_set);
+      filtered_worker_list_ = std::move(filtered_worker_list);
+      cluster_def_ = *options.cluster_def;
+      // The old execution state will be released outside the lock.
+      execution_state_.swap(execution_state);
+    }
+  }
+
+  if (!s.ok()) {
+    // The session stays on its cluster. The workers that stay in it are
+    // moved back, and the workers that joined are not part of it.
+    std::unordered_set<string> updated(updated_workers.begin(),
+                                       updated_workers.end());
+    std::vector<string> rollback_workers;
+    for (const string& worker : staying_workers) {
+      if (updated.count(worker) != 0) rollback_workers.push_back(worker);
+    }
+    if (!rollback_workers.empty()) {
+      WorkerCacheFactoryOptions old_options;
+      Status rollback_status =
+          WorkerCacheFactoryOptionsForCluster(old_cluster_def, &old_options);
+      if (rollback_status.ok()) {
+        rollback_status = CreateWorkerSessions(old_options, old_worker_cache,
+                                               rollback_workers);
+      }
+      if (!rollback_status.ok()) {
+        LOG(WARNING) << "Error moving session " << handle_
+                     << " back to its cluster on some workers: "
+                     << rollback_status;
+      }
+    }
+    if (!added_workers.empty()) {
+      Status delete_status =
+          DeleteWorkerSessions(worker_cache.get(), added_workers);
+      if (!delete_status.ok()) {
+        LOG(WARNING) << "Error deleting session " << handle_
+                     << " on the workers of the cluster it was not moved to: "
+                     << delete_status;
+      }
+    }
+    return s;
+  }
+  if (!removed_workers.empty()) {
+    // The workers that left the cluster may be gone already.
+    s = DeleteWorkerSessions(old_worker_cache, removed_workers);
+    if (!s.ok()) {
+      LOG(WARNING) << "Error deleting session " << handle_
+                   << " on the workers that left its cluster: " << s;
+    }
+  }
+  return Status::OK();
+}
+
 WorkerCacheInterface* MasterSession::get_worker_cache() const {
   if (worker_cache_) {
     return worker_cache_.get();
@@ -1451,6 +1629,17 @@ Status MasterSession::PartialRunSetup(const PartialRunSetupRequest* req,
 
   string handle = std::to_string(partial_run_handle_counter_.fetch_add(1));
 
+  {
+    mutex_lock l(mu_);
+    while (updating_cluster_ && !closed_) {
+      cluster_updated_.wait(l);
+    }
+    // Counted as running until the partial run is registered, so that the
+    // session does not move to another cluster in the meantime.
+    ++num_running_;
+  }
+  auto cleanup = gtl::MakeCleanup([this] { MarkRunCompletion(); });
+
   ReffedClientGraph* rcg = nullptr;
 
   // Prepare.
@@ -1482,6 +1671,9 @@ Status MasterSession::Run(CallOptions* opts, const RunStepRequestWrapper& req,
   UpdateLastAccessTime();
   {
     mutex_lock l(mu_);
+    while (updating_cluster_ && !closed_) {
+      cluster_updated_.wait(l);
+    }
     if (closed_) {
       return errors::FailedPrecondition("Session is closed.");
     }
@@ -1520,6 +1712,7 @@ Status MasterSession::BuildAndRegisterPartitions(ReffedClientGraph* rcg) {
   };
   popts.flib_def = rcg->client_graph()->flib_def.get();
   popts.get_incarnation = [this](const string& name) -> int64 {
+    mutex_lock l(mu_);
     Device* d = devices_->FindDeviceByName(name);
     if (d == nullptr) {
       return PartitionOptions::kIllegalIncarnation;
@@ -1541,6 +1734,8 @@ Status MasterSession::BuildAndRegisterPartitions(ReffedClientGraph* rcg) {
       return dtype;
     }
   };
+  popts.variable_prefetch_staleness =
+      session_opts_.config.graph_options().variable_prefetch_staleness();
   if (session_opts_.config.graph_options().enable_recv_scheduling()) {
     popts.scheduling_for_recvs = true;
     popts.need_to_record_start_times = true;
@@ -1826,9 +2021,20 @@ Status MasterSession::MakeCallable(const MakeCallableRequest& req,
 
   {
     mutex_lock l(mu_);
+    while (updating_cluster_ && !closed_) {
+      cluster_updated_.wait(l);
+    }
     if (closed_) {
       return errors::FailedPrecondition("Session is closed.");
     }
+    // Counted as running so that the callable is registered on the
+    // cluster it was built for before the session moves to another.
+    ++num_running_;
+  }
+  auto cleanup = gtl::MakeCleanup([this] { MarkRunCompletion(); });
+
+  {
+    mutex_lock l(mu_);
     std::unique_ptr<ClientGraph> client_graph;
     TF_RETURN_IF_ERROR(execution_state_->BuildGraph(opts, &client_graph));
     callable = new ReffedClientGraph(handle_, opts, std::move(client_graph),
@@ -1892,6 +2098,9 @@ Status MasterSession::RunCallable(CallOptions* opts,
   ReffedClientGraph* callable;
   {
     mutex_lock l(mu_);
+    while (updating_cluster_ && !closed_) {
+      cluster_updated_.wait(l);
+    }
     if (closed_) {
       return errors::FailedPrecondition("Session is closed.");
     }
@@ -1945,10 +2154,13 @@ Status MasterSession::Close() {
     ClearRunsTable(&to_unref, &run_graphs_);
     ClearRunsTable(&to_unref, &partial_run_graphs_);
     ClearRunsTable(&to_unref, &callables_);
+    to_unref.insert(to_unref.end(), retired_graphs_.begin(),
+                    retired_graphs_.end());
+    retired_graphs_.clear();
   }
   for (ReffedClientGraph* rcg : to_unref) rcg->Unref();
   if (should_delete_worker_sessions_) {
-    Status s = DeleteWorkerSessions();
+    Status s = DeleteWorkerSessions(get_worker_cache(), filtered_worker_list_);
     if (!s.ok()) {
       LOG(WARNING) << s;
     }
@@ -80,6 +80,40 @@ class MasterSession : public core::RefCounted {
   // Extend() may block the caller thread for a long time.
   Status Extend(const ExtendSessionRequest* req, ExtendSessionResponse* resp);
 
+  // Returns the options from which the worker cache of `cluster_def` is
+  // created, in which the master has the same job and task as in the
+  // cluster of the session. `cluster_def` must outlive `options`.
+  //
+  // Fails unless the session was created with ConfigProto.cluster_def.
+  Status WorkerCacheFactoryOptionsForCluster(
+      const ClusterDef& cluster_def, WorkerCacheFactoryOptions* options) const;
+
+  // Moves this session to a new cluster with the given devices and workers.
+  // (See ExtendSessionRequest.cluster_def in master.proto for details.)
+  //
+  // Creates the session on the workers that joined and moves it on the
+  // workers that stay, which keep their state. The session is deleted on
+  // the workers that left, ignoring errors. The graphs registered for
+  // the previous cluster are kept until the session is closed, so that
+  // variables held by their kernels keep their values.
+  //
+  // Places the graph on the new devices before contacting any worker. Then
+  // waits for the running steps, and makes steps, partial runs, callables
+  // and extensions that start in the meantime wait for the update.
+  //
+  // If the update fails on some worker, the session still uses the previous
+  // cluster, to which the workers that were already updated are moved back,
+  // and the update may be retried.
+  Status UpdateCluster(
+      const WorkerCacheFactoryOptions& options,
+      std::unique_ptr<std::vector<std::unique_ptr<Device>>> remote_devs,
+      std::unique_ptr<WorkerCacheInterface> worker_cache,
+      std::unique_ptr<DeviceSet> device_set,
+      std::vector<string> filtered_worker_list);
+
+  // Returns the configuration of the session.
+  const ConfigProto& config() const { return session_opts_.config; }
+
   // Setup a partial run call.
   Status PartialRunSetup(const PartialRunSetupRequest* req,
                          PartialRunSetupResponse* resp);
@@ -124,7 +158,7 @@ class MasterSession : public core::RefCounted {
 
   // The optional session-specific worker cluster.
   // TODO(saeta): Convert to std::optional when available.
-  const std::unique_ptr<WorkerCacheInterface> worker_cache_;
+  std::unique_ptr<WorkerCacheInterface> worker_cache_;
   // Retrieves either worker_cache_ or the env_->worker_cache as appropriate.
   WorkerCacheInterface* get_worker_cache() const;
 
@@ -133,7 +167,14 @@ class MasterSession : public core::RefCounted {
 
   // The (partial device) names of remote worker tasks that this
   // session will contact.
-  const std::vector<string> filtered_worker_list_;
+  std::vector<string> filtered_worker_list_;
+
+  // The session-specific worker cluster, and the job, task and protocol of
+  // the master in it.
+  ClusterDef cluster_def_;
+  string master_job_name_;
+  int master_task_index_ = 0;
+  string protocol_;
 
   StatsPublisherFactory stats_publisher_factory_;
 
@@ -141,7 +182,7 @@ class MasterSession : public core::RefCounted {
 
   std::atomic<int64> partial_run_handle_counter_ = {0};
 
-  mutex mu_;
+  mutable mutex mu_;
   std::unique_ptr<GraphExecutionState> execution_state_ GUARDED_BY(mu_);
   int64 graph_version_;
 
@@ -157,6 +198,16 @@ class MasterSession : public core::RefCounted {
   int64 next_callable_handle_ GUARDED_BY(mu_) = 0;
   RCGMap callables_ GUARDED_BY(mu_);
 
+  // The state of the clusters replaced by UpdateCluster(), and the graphs
+  // built for them, which may refer to it until the session is closed.
+  struct RetiredCluster {
+    std::unique_ptr<std::vector<std::unique_ptr<Device>>> remote_devs;
+    std::unique_ptr<WorkerCacheInterface> worker_cache;
+    std::unique_ptr<DeviceSet> devices;
+  };
+  std::vector<RetiredCluster> retired_clusters_ GUARDED_BY(mu_);
+  std::vector<ReffedClientGraph*> retired_graphs_ GUARDED_BY(mu_);
+
   struct PerStepState {
     bool collect_costs = false;
     bool collect_timeline = false;
@@ -195,6 +246,11 @@ class MasterSession : public core::RefCounted {
   condition_variable num_running_is_zero_;
   int32 num_running_ GUARDED_BY(mu_) = 0;
 
+  // Set while UpdateCluster() waits for the active steps and moves the
+  // session, during which no new steps start.
+  condition_variable cluster_updated_;
+  bool updating_cluster_ GUARDED_BY(mu_) = false;
+
   bool closed_ GUARDED_BY(mu_) = false;
   bool garbage_collected_ GUARDED_BY(mu_) = false;
 
@@ -215,10 +271,17 @@ class MasterSession : public core::RefCounted {
   // If this session is operating using the new ClusterSpec propagation behavior
   // call this method in order to propagate the cluster membership to all
   // workers.
-  Status CreateWorkerSessions(const WorkerCacheFactoryOptions& server_def);
+  //
+  // If `created_workers` is not null, appends the workers on which the
+  // session was created to it, also if the call fails on others.
+  Status CreateWorkerSessions(const WorkerCacheFactoryOptions& server_def,
+                              WorkerCacheInterface* worker_cache,
+                              const std::vector<string>& worker_names,
+                              std::vector<string>* created_workers = nullptr);
 
   bool should_delete_worker_sessions_ = false;
-  Status DeleteWorkerSessions();
+  Status DeleteWorkerSessions(WorkerCacheInterface* worker_cache,
+                              const std::vector<string>& worker_names);
 
   Status StartStep(const BuildGraphOptions& opts, bool is_partial,
                    ReffedClientGraph** out_rcg, int64* out_count);
@@ -0,0 +1,126 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/prefetching_rendezvous.h"
+
+#include <utility>
+
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+int64 VariablePrefetchCache::StartStep() {
+  mutex_lock l(mu_);
+  return ++num_steps_;
+}
+
+PrefetchingRendezvous::PrefetchingRendezvous(Rendezvous* base,
+                                             VariablePrefetchCache* cache)
+    : base_(base), cache_(cache), step_(cache->StartStep()) {
+  base_->Ref();
+}
+
+PrefetchingRendezvous::~PrefetchingRendezvous() {
+  DCHECK_EQ(num_refreshing_, 0);
+  base_->Unref();
+}
+
+Status PrefetchingRendezvous::Send(const ParsedKey& key, const Args& args,
+                                   const Tensor& val, const bool is_dead) {
+  return base_->Send(key, args, val, is_dead);
+}
+
+void PrefetchingRendezvous::RecvAsync(const ParsedKey& key, const Args& args,
+                                      DoneCallback done) {
+  if (args.prefetch_staleness <= 0) {
+    base_->RecvAsync(key, args, std::move(done));
+    return;
+  }
+  bool hit = false;
+  bool refresh = false;
+  Tensor val;
+  {
+    mutex_lock l(cache_->mu_);
+    VariablePrefetchCache::Entry& entry =
+        cache_->entries_[key.FullKey().ToString()];
+    if (entry.step >= 0 && step_ - entry.step <= args.prefetch_staleness) {
+      hit = true;
+      val = entry.value;
+      refresh = !entry.refreshing;
+      entry.refreshing = true;
+    }
+  }
+  if (!hit) {
+    Fetch(key, args, false, std::move(done));
+    return;
+  }
+  if (refresh) {
+    {
+      mutex_lock l(mu_);
+      ++num_refreshing_;
+    }
+    Fetch(key, args, true, nullptr);
+  }
+  done(Status::OK(), Args(), args, val, false);
+}
+
+void PrefetchingRendezvous::Fetch(const ParsedKey& key, const Args& args,
+                                  bool refresh, DoneCallback done) {
+  Ref();
+  string cache_key = key.FullKey().ToString();
+  base_->RecvAsync(
+      key, args,
+      [this, cache_key, refresh, done](
+          const Status& s, const Args& send_args, const Args& recv_args,
+          const Tensor& val, bool is_dead) {
+        {
+          mutex_lock l(cache_->mu_);
+          VariablePrefetchCache::Entry& entry = cache_->entries_[cache_key];
+          if (refresh) entry.refreshing = false;
+          // Concurrent steps may receive their values out of order.
+          if (s.ok() && !is_dead && step_ > entry.step) {
+            entry.value = val;
+            entry.step = step_;
+          }
+        }
+        if (done) done(s, send_args, recv_args, val, is_dead);
+        if (refresh) {
+          std::function<void()> refreshed;
+          {
+            mutex_lock l(mu_);
+            if (--num_refreshing_ == 0) std::swap(refreshed, refreshed_);
+          }
+          if (refreshed) refreshed();
+        }
+        Unref();
+      });
+}
+
+void PrefetchingRendezvous::StartAbort(const Status& status) {
+  base_->StartAbort(status);
+}
+
+void PrefetchingRendezvous::WhenRefreshed(std::function<void()> done) {
+  {
+    mutex_lock l(mu_);
+    if (num_refreshing_ > 0) {
+      refreshed_ = std::move(done);
+      return;
+    }
+  }
+  done();
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,110 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_PREFETCHING_RENDEZVOUS_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_PREFETCHING_RENDEZVOUS_H_
+
+#include <functional>
+#include <unordered_map>
+
+#include "tensorflow/core/framework/rendezvous.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// The values of variables received by the steps of one registered graph,
+// keyed by rendezvous key, which does not depend on the step. The steps are
+// numbered in the order in which they start, and every value is tagged
+// with the step that received it.
+class VariablePrefetchCache {
+ public:
+  VariablePrefetchCache() {}
+
+  // Returns the number of a new step.
+  int64 StartStep();
+
+ private:
+  friend class PrefetchingRendezvous;
+
+  struct Entry {
+    Tensor value;
+    int64 step = -1;  // The step that received 'value', or -1 if none.
+    bool refreshing = false;
+  };
+
+  mutex mu_;
+  int64 num_steps_ GUARDED_BY(mu_) = 0;
+  std::unordered_map<string, Entry> entries_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(VariablePrefetchCache);
+};
+
+// The rendezvous of one step of a graph, which forwards to the rendezvous
+// 'base' of the step, except for receives whose Args have a positive
+// prefetch_staleness:
+//
+// If 'cache' holds a value received at most prefetch_staleness steps
+// earlier, the receive completes with it immediately. The value of this
+// step is then received from 'base' in the background, unless another step
+// already does so, and replaces the cached value. Otherwise the value of
+// this step is received from 'base' and cached.
+//
+// Background receives belong to the step, since the senders discard their
+// tensors when the step is cleaned up. After the step's executors are done,
+// the caller must call WhenRefreshed() and only report the step as done
+// once it calls back. StartAbort() aborts the background receives as well.
+class PrefetchingRendezvous : public Rendezvous {
+ public:
+  // Takes a reference on 'base'. 'cache' must outlive the rendezvous.
+  PrefetchingRendezvous(Rendezvous* base, VariablePrefetchCache* cache);
+
+  Status Send(const ParsedKey& key, const Args& args, const Tensor& val,
+              const bool is_dead) override;
+
+  void RecvAsync(const ParsedKey& key, const Args& args,
+                 DoneCallback done) override;
+
+  void StartAbort(const Status& status) override;
+
+  // Calls 'done' once no background receive of this step is pending.
+  void WhenRefreshed(std::function<void()> done);
+
+ private:
+  ~PrefetchingRendezvous() override;
+
+  // Receives the value of 'key' in this step from 'base_' and caches it,
+  // then calls 'done' if it is not null.
+  void Fetch(const ParsedKey& key, const Args& args, bool refresh,
+             DoneCallback done);
+
+  Rendezvous* const base_;
+  VariablePrefetchCache* const cache_;  // Not owned.
+  const int64 step_;
+
+  mutex mu_;
+  int num_refreshing_ GUARDED_BY(mu_) = 0;
+  std::function<void()> refreshed_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PrefetchingRendezvous);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_PREFETCHING_RENDEZVOUS_H_
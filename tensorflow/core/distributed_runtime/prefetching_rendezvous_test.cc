@@ -0,0 +1,163 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/prefetching_rendezvous.h"
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+Rendezvous::ParsedKey Key() {
+  Rendezvous::ParsedKey key;
+  TF_CHECK_OK(Rendezvous::ParseKey(
+      Rendezvous::CreateKey("/job:ps/replica:0/task:0/device:CPU:0", 1,
+                            "/job:worker/replica:0/task:0/device:CPU:0", "var",
+                            FrameAndIter(0, 0)),
+      &key));
+  return key;
+}
+
+Tensor V(float value) { return test::AsScalar<float>(value); }
+
+// One step of a graph, whose variable value is sent to the local
+// rendezvous of the step when Send() is called.
+class Step {
+ public:
+  explicit Step(VariablePrefetchCache* cache) : base_(NewLocalRendezvous()) {
+    rendez_ = new PrefetchingRendezvous(base_, cache);
+  }
+
+  ~Step() {
+    rendez_->Unref();
+    base_->Unref();
+  }
+
+  void Send(float value) {
+    TF_ASSERT_OK(base_->Send(Key(), Rendezvous::Args(), V(value), false));
+  }
+
+  // Receives the variable with the given staleness.
+  float Recv(int staleness) {
+    Rendezvous::Args args;
+    args.prefetch_staleness = staleness;
+    Tensor val;
+    bool is_dead;
+    TF_CHECK_OK(rendez_->Recv(Key(), args, &val, &is_dead));
+    return val.scalar<float>()();
+  }
+
+  bool Refreshed() {
+    bool refreshed = false;
+    rendez_->WhenRefreshed([&refreshed]() { refreshed = true; });
+    return refreshed;
+  }
+
+  Rendezvous* base() { return base_; }
+  PrefetchingRendezvous* rendez() { return rendez_; }
+
+ private:
+  Rendezvous* base_;
+  PrefetchingRendezvous* rendez_;
+};
+
+TEST(PrefetchingRendezvousTest, ZeroStalenessIsNotCached) {
+  VariablePrefetchCache cache;
+  for (float value : {1.0f, 2.0f}) {
+    Step step(&cache);
+    step.Send(value);
+    EXPECT_EQ(value, step.Recv(0));
+    EXPECT_TRUE(step.Refreshed());
+  }
+}
+
+TEST(PrefetchingRendezvousTest, UsesValueOfEarlierStep) {
+  VariablePrefetchCache cache;
+  {
+    Step step(&cache);
+    step.Send(1);
+    EXPECT_EQ(1, step.Recv(1));
+  }
+  {
+    // The value of step 2 is received in the background.
+    Step step(&cache);
+    step.Send(2);
+    EXPECT_EQ(1, step.Recv(1));
+    EXPECT_TRUE(step.Refreshed());
+  }
+  {
+    // Step 3 does not wait for its value, but is only done when it arrives.
+    Step step(&cache);
+    EXPECT_EQ(2, step.Recv(1));
+    Notification refreshed;
+    step.rendez()->WhenRefreshed([&refreshed]() { refreshed.Notify(); });
+    EXPECT_FALSE(refreshed.HasBeenNotified());
+    step.Send(3);
+    refreshed.WaitForNotification();
+  }
+  {
+    Step step(&cache);
+    step.Send(4);
+    EXPECT_EQ(3, step.Recv(2));
+  }
+}
+
+TEST(PrefetchingRendezvousTest, ReceivesValueOlderThanStaleness) {
+  VariablePrefetchCache cache;
+  {
+    Step step(&cache);
+    step.Send(1);
+    EXPECT_EQ(1, step.Recv(1));
+  }
+  {
+    // The background receive of step 2 fails.
+    Step step(&cache);
+    EXPECT_EQ(1, step.Recv(1));
+    step.rendez()->StartAbort(errors::Aborted(""));
+    EXPECT_TRUE(step.Refreshed());
+  }
+  {
+    // The cached value is two steps old.
+    Step step(&cache);
+    step.Send(3);
+    EXPECT_EQ(3, step.Recv(1));
+  }
+}
+
+TEST(PrefetchingRendezvousTest, DeadValuesAreNotCached) {
+  VariablePrefetchCache cache;
+  {
+    Step step(&cache);
+    TF_ASSERT_OK(step.base()->Send(Key(), Rendezvous::Args(), Tensor(), true));
+    Rendezvous::Args args;
+    args.prefetch_staleness = 1;
+    Tensor val;
+    bool is_dead = false;
+    TF_ASSERT_OK(step.rendez()->Recv(Key(), args, &val, &is_dead));
+    EXPECT_TRUE(is_dead);
+  }
+  {
+    Step step(&cache);
+    step.Send(2);
+    EXPECT_EQ(2, step.Recv(1));
+  }
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -173,6 +173,25 @@ Status GrpcSession::Extend(const RunOptions& run_options,
   return ExtendImpl(&call_options, graph);
 }
 
+Status GrpcSession::UpdateCluster(const ClusterDef& cluster_def) {
+  CallOptions call_options;
+  call_options.SetTimeout(options_.config.operation_timeout_in_ms());
+  mutex_lock l(mu_);
+  if (handle_.empty()) {
+    return errors::InvalidArgument("A session is not created yet....");
+  }
+  ExtendSessionRequest req;
+  req.set_session_handle(handle_);
+  *req.mutable_cluster_def() = cluster_def;
+  req.set_current_graph_version(current_graph_version_);
+  ExtendSessionResponse resp;
+  Status s = master_->ExtendSession(&call_options, &req, &resp);
+  if (s.ok()) {
+    current_graph_version_ = resp.new_graph_version();
+  }
+  return s;
+}
+
 Status GrpcSession::RunHelper(
     const RunOptions& run_options,
     const std::vector<std::pair<string, Tensor>>& inputs,
@@ -81,6 +81,14 @@ class GrpcSession : public Session {
 
   Status Close() override;
 
+  // Moves a session created with ConfigProto.cluster_def to `cluster_def`,
+  // e.g. after workers joined or left the cluster. The workers that stay
+  // in the cluster keep their state. (See ExtendSessionRequest.cluster_def
+  // in master.proto for details.)
+  //
+  // NOTE: This API is still experimental and may change.
+  Status UpdateCluster(const ClusterDef& cluster_def);
+
   // NOTE: This API is still experimental and may change.
   Status PRunSetup(const std::vector<string>& input_names,
                    const std::vector<string>& output_names,
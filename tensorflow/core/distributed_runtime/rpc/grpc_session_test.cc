@@ -457,6 +457,211 @@ TEST(GrpcSessionTest, LargeTensorSend) {
   TF_CHECK_OK(session->Close());
 }
 
+TEST(GrpcSessionTest, WireCompression) {
+  std::unique_ptr<test::TestCluster> cluster;
+  TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 0), 2, &cluster));
+
+  Graph graph(OpRegistry::Global());
+  Tensor a_tensor = test::AsTensor<float>({1, -2, 3, 4});
+  Node* a = test::graph::Constant(&graph, a_tensor);
+  Node* b = test::graph::Unary(&graph, "Neg", a);
+  GraphDef def;
+  test::graph::ToGraphDef(&graph, &def);
+  SetDevice(&def, a->name(), cluster->devices()[1].name());
+  SetDevice(&def, b->name(), cluster->devices()[0].name());
+  for (NodeDef& node : *def.mutable_node()) {
+    if (node.name() == a->name()) {
+      (*node.mutable_attr())["_wire_compression"].set_s("top_k:0.5");
+    }
+  }
+
+  SessionOptions options = Options(cluster->targets()[0], 1000);
+  // Keep "a" and "b" on separate tasks.
+  options.config.mutable_graph_options()
+      ->mutable_rewrite_options()
+      ->set_constant_folding(RewriterConfig::OFF);
+  std::unique_ptr<Session> session(NewRemote(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_CHECK_OK(session->Create(def));
+  // Each step receives the two largest values, including those that were
+  // held back in the previous step.
+  for (const auto& expected : std::vector<std::vector<float>>{
+           {0, 0, -3, -4}, {0, 4, 0, -4}, {0, 0, -6, -4}}) {
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(session->Run({}, {b->name()}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    test::ExpectTensorEqual<float>(test::AsTensor<float>(expected),
+                                   outputs[0]);
+  }
+  TF_CHECK_OK(session->Close());
+}
+
+TEST(GrpcSessionTest, SharedMemorySendRecv) {
+  std::unique_ptr<test::TestCluster> cluster;
+  TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 0), 2, &cluster));
+
+  // The tasks run on the same host, so a 4 MB tensor sent from the second
+  // to the first is passed in shared memory.
+  Graph graph(OpRegistry::Global());
+  Tensor shape_tensor(DT_INT32, TensorShape({1}));
+  shape_tensor.vec<int32>()(0) = 1 << 20;
+  Node* shape = test::graph::Constant(&graph, shape_tensor);
+  Tensor val_tensor(DT_FLOAT, TensorShape({}));
+  val_tensor.scalar<float>()() = 2.0;
+  Node* val = test::graph::Constant(&graph, val_tensor);
+  Node* fill = test::graph::Binary(&graph, "Fill", shape, val);
+  Node* delayed = test::graph::Delay(&graph, fill, Microseconds(2000000));
+  Tensor axes_tensor(DT_INT32, TensorShape({1}));
+  axes_tensor.vec<int32>()(0) = 0;
+  Node* axes = test::graph::Constant(&graph, axes_tensor);
+  Node* max = test::graph::Reduce(&graph, "Max", fill, axes);
+  Node* delayed_max = test::graph::Reduce(&graph, "Max", delayed, axes);
+  GraphDef def;
+  test::graph::ToGraphDef(&graph, &def);
+  for (Node* n : {shape, val, fill, delayed}) {
+    SetDevice(&def, n->name(), cluster->devices()[1].name());
+  }
+  for (Node* n : {axes, max, delayed_max}) {
+    SetDevice(&def, n->name(), cluster->devices()[0].name());
+  }
+
+  SessionOptions options = Options(cluster->targets()[0], 1000);
+  options.config.mutable_graph_options()
+      ->mutable_rewrite_options()
+      ->set_constant_folding(RewriterConfig::OFF);
+  std::unique_ptr<Session> session(NewRemote(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_CHECK_OK(session->Create(def));
+
+  // Abort a step while its RecvTensor call is pending.  The sender may
+  // still place the tensor in shared memory after the receiver gave up.
+  RunOptions run_options;
+  run_options.set_timeout_in_ms(500);
+  std::vector<Tensor> outputs;
+  EXPECT_FALSE(session
+                   ->Run(run_options, {}, {delayed_max->name()}, {}, &outputs,
+                         nullptr)
+                   .ok());
+
+  // Later steps send more than the shared memory ring holds in total.
+  for (int i = 0; i < 80; ++i) {
+    outputs.clear();
+    TF_CHECK_OK(session->Run({}, {max->name()}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    IsSingleFloatValue(outputs[0], 2.0);
+  }
+  TF_CHECK_OK(session->Close());
+}
+
+TEST(GrpcSessionTest, UpdateCluster) {
+  std::unique_ptr<test::TestCluster> cluster;
+  TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 0), 2, &cluster));
+  const string task0 = "/job:worker/replica:0/task:0/device:CPU:0";
+  const string task1 = "/job:worker/replica:0/task:1/device:CPU:0";
+
+  // var = 1; var += 1, on the first task.
+  GraphDef def;
+  string init_name, inc_name, var_name;
+  {
+    Graph g(OpRegistry::Global());
+    Tensor one(DT_FLOAT, TensorShape({}));
+    one.scalar<float>()() = 1.0;
+    Node* var = test::graph::Var(&g, DT_FLOAT, one.shape());
+    Node* init = test::graph::Assign(&g, var, test::graph::Constant(&g, one));
+    Node* inc = test::graph::Assign(
+        &g, var, test::graph::Add(&g, var, test::graph::Constant(&g, one)));
+    var_name = var->name();
+    init_name = init->name();
+    inc_name = inc->name();
+    test::graph::ToGraphDef(&g, &def);
+  }
+  for (NodeDef& node : *def.mutable_node()) node.set_device(task0);
+
+  // The session starts on the first task only.
+  SessionOptions options = Options(cluster->targets()[0], 1);
+  JobDef* job = options.config.mutable_cluster_def()->add_job();
+  job->set_name("worker");
+  (*job->mutable_tasks())[0] = cluster->targets()[0];
+  std::unique_ptr<GrpcSession> session;
+  TF_CHECK_OK(GrpcSession::Create(options, &session));
+  TF_CHECK_OK(session->Create(def));
+  TF_CHECK_OK(session->Run({}, {}, {init_name}, nullptr));
+  TF_CHECK_OK(session->Run({}, {}, {inc_name}, nullptr));
+
+  // The second task joins.
+  ClusterDef cluster_def = options.config.cluster_def();
+  (*cluster_def.mutable_job(0)->mutable_tasks())[1] = cluster->targets()[1];
+  TF_CHECK_OK(session->UpdateCluster(cluster_def));
+
+  // The variable kept its value on the first task.
+  std::vector<Tensor> outputs;
+  TF_CHECK_OK(session->Run({}, {var_name}, {}, &outputs));
+  ASSERT_EQ(1, outputs.size());
+  IsSingleFloatValue(outputs[0], 2.0);
+
+  // A node on the second task reads it.
+  GraphDef extension;
+  NodeDef* doubled = extension.add_node();
+  doubled->set_name("doubled");
+  doubled->set_op("Add");
+  doubled->add_input(var_name);
+  doubled->add_input(var_name);
+  doubled->set_device(task1);
+  (*doubled->mutable_attr())["T"].set_type(DT_FLOAT);
+  TF_CHECK_OK(session->Extend(extension));
+  CallableOptions callable_options;
+  callable_options.add_fetch("doubled:0");
+  Session::CallableHandle handle;
+  TF_CHECK_OK(session->MakeCallable(callable_options, &handle));
+  TF_CHECK_OK(session->Run({}, {}, {inc_name}, nullptr));
+  outputs.clear();
+  TF_CHECK_OK(session->RunCallable(handle, {}, &outputs, nullptr));
+  ASSERT_EQ(1, outputs.size());
+  IsSingleFloatValue(outputs[0], 6.0);
+  TF_CHECK_OK(session->ReleaseCallable(handle));
+  TF_CHECK_OK(session->Close());
+}
+
+TEST(GrpcSessionTest, VariablePrefetch) {
+  std::unique_ptr<test::TestCluster> cluster;
+  TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 0), 2, &cluster));
+
+  Graph graph(OpRegistry::Global());
+  Tensor zero = test::AsScalar<float>(0);
+  Tensor one = test::AsScalar<float>(1);
+  Node* var = test::graph::Var(&graph, DT_FLOAT, TensorShape({}));
+  Node* init =
+      test::graph::Assign(&graph, var, test::graph::Constant(&graph, zero));
+  Node* inc = test::graph::Assign(
+      &graph, var,
+      test::graph::Add(&graph, var, test::graph::Constant(&graph, one)));
+  Node* read = test::graph::Identity(&graph, var);
+  GraphDef def;
+  test::graph::ToGraphDef(&graph, &def);
+  // The variable lives on task 1 and is read on task 0.
+  for (NodeDef& node : *def.mutable_node()) {
+    node.set_device(cluster->devices()[1].name());
+  }
+  SetDevice(&def, read->name(), cluster->devices()[0].name());
+
+  SessionOptions options = Options(cluster->targets()[0], 1000);
+  options.config.mutable_graph_options()->set_variable_prefetch_staleness(1);
+  std::unique_ptr<Session> session(NewRemote(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_CHECK_OK(session->Create(def));
+  TF_CHECK_OK(session->Run({}, {}, {init->name()}, nullptr));
+  // After the first step, every step reads the value that the variable had
+  // in the previous step.
+  for (float expected : {0, 0, 1, 2}) {
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(session->Run({}, {read->name()}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    IsSingleFloatValue(outputs[0], expected);
+    TF_CHECK_OK(session->Run({}, {}, {inc->name()}, nullptr));
+  }
+  TF_CHECK_OK(session->Close());
+}
+
 TEST(GrpcSessionTest, MultiDevices_String) {
   std::unique_ptr<test::TestCluster> cluster;
   TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 1), 2, &cluster));
@@ -135,8 +135,15 @@ static void EncodeSkeleton(const Tensor& val, io::ProtoEncodeHelper* e) {
 
 void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val,
                               ::grpc::ByteBuffer* result) {
+  EncodeTensorToByteBuffer(is_dead, val, RecvTensorResponse(), result);
+}
+
+void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val,
+                              const RecvTensorResponse& metadata,
+                              ::grpc::ByteBuffer* result) {
   const int kLargeTensorBytes = 1024;
-  RecvTensorResponse response;
+  RecvTensorResponse response(metadata);
+  response.clear_tensor();
   if (is_dead) {
     response.set_is_dead(is_dead);
   }
@@ -51,6 +51,12 @@ void EncodeRecvTensorResponseToByteBuffer(const RecvTensorResponse& proto,
 void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val,
                               ::grpc::ByteBuffer* result);
 
+// As above, but also encodes the fields of "metadata" other than "tensor",
+// "is_dead" and "send_start_micros", e.g. how "val" was compressed.
+void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val,
+                              const RecvTensorResponse& metadata,
+                              ::grpc::ByteBuffer* result);
+
 }  // namespace grpc
 }  // namespace tensorflow
 
@@ -17,6 +17,10 @@ limitations under the License.
 
 #include "grpc++/support/byte_buffer.h"
 #include "grpc++/support/slice.h"
+#include "tensorflow/core/distributed_runtime/rpc/grpc_util.h"
+#include "tensorflow/core/distributed_runtime/tensor_coding.h"
+#include "tensorflow/core/framework/device_attributes.pb.h"
+#include "tensorflow/core/framework/device_base.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
@@ -100,4 +104,80 @@ TEST_F(GrpcTensorCodingTest, Simple) {
 
 TEST_F(GrpcTensorCodingTest, StringTensor) { DoTestForStrings(DT_STRING); }
 
+class DummyDevice : public DeviceBase {
+ public:
+  explicit DummyDevice(Env* env) : DeviceBase(env) {
+    attr_.set_device_type("CPU");
+  }
+
+  const DeviceAttributes& attributes() const override { return attr_; }
+
+  Allocator* GetAllocator(AllocatorAttributes attr) override {
+    return cpu_allocator();
+  }
+
+ private:
+  DeviceAttributes attr_;
+};
+
+// Encodes 't' and decodes it into 'response' as the RecvTensor client
+// does.  Returns true if the decoded tensor shares the memory of 't',
+// which the encoding of large tensors refers to.
+bool DecodeSharesMemory(const Tensor& t, const AllocatorAttributes& attrs) {
+  ::grpc::ByteBuffer buf;
+  grpc::EncodeTensorToByteBuffer(false, t, &buf);
+  DummyDevice cpu_device(Env::Default());
+  TensorResponse response;
+  response.InitAlloc(&cpu_device, attrs);
+  EXPECT_TRUE(GrpcMaybeParseProto(&buf, &response));
+  const Tensor& result = response.tensor();
+  EXPECT_EQ(t.DebugString(), result.DebugString());
+  const bool shared = result.tensor_data().data() == t.tensor_data().data();
+  // The decoded tensor keeps the memory alive after the buffer is gone.
+  Tensor copy = result;
+  buf.Clear();
+  response.Clear();
+  EXPECT_EQ(t.DebugString(), copy.DebugString());
+  return shared;
+}
+
+TEST_F(GrpcTensorCodingTest, DecodeSharesSlices) {
+  Tensor large(DT_FLOAT, TensorShape({64, 64}));
+  test::FillIota<float>(&large, 1.0);
+  EXPECT_TRUE(DecodeSharesMemory(large, AllocatorAttributes()));
+  // Small tensors are copied.
+  Tensor small(DT_FLOAT, TensorShape({16}));
+  test::FillIota<float>(&small, 1.0);
+  EXPECT_FALSE(DecodeSharesMemory(small, AllocatorAttributes()));
+  // Memory for DMA must come from the device's allocator.
+  AllocatorAttributes gpu_compatible;
+  gpu_compatible.set_gpu_compatible(true);
+  EXPECT_FALSE(DecodeSharesMemory(large, gpu_compatible));
+}
+
+// Returns true if a response for a tensor of `dtype` and `shape` whose
+// content is `num_bytes` bytes parses.
+bool ParsesResponse(DataType dtype, const TensorShape& shape, int num_bytes) {
+  RecvTensorResponse proto;
+  proto.mutable_tensor()->set_dtype(dtype);
+  shape.AsProto(proto.mutable_tensor()->mutable_tensor_shape());
+  proto.mutable_tensor()->set_tensor_content(string(num_bytes, '\x01'));
+  const string serialized = proto.SerializeAsString();
+  ::grpc::Slice slice(serialized.data(), serialized.size());
+  ::grpc::ByteBuffer buf(&slice, 1);
+  DummyDevice cpu_device(Env::Default());
+  TensorResponse response;
+  response.InitAlloc(&cpu_device, AllocatorAttributes());
+  return GrpcMaybeParseProto(&buf, &response);
+}
+
+TEST_F(GrpcTensorCodingTest, RejectMalformedTensorContent) {
+  EXPECT_TRUE(ParsesResponse(DT_FLOAT, TensorShape({1024}), 4096));
+  // The content doesn't match the shape.
+  EXPECT_FALSE(ParsesResponse(DT_FLOAT, TensorShape({1024}), 8192));
+  EXPECT_FALSE(ParsesResponse(DT_FLOAT, TensorShape({1024}), 4095));
+  // A type whose values aren't their bytes.
+  EXPECT_FALSE(ParsesResponse(DT_STRING, TensorShape({1024}), 4096));
+}
+
 }  // namespace tensorflow
@@ -15,9 +15,49 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/grpc_util.h"
 #include "tensorflow/core/distributed_runtime/tensor_coding.h"
+#include "tensorflow/core/framework/allocation_description.pb.h"
 
 namespace tensorflow {
 
+namespace {
+// A TensorBuffer aliasing bytes of a received slice, which it keeps alive.
+class GrpcSliceBuffer : public TensorBuffer {
+ public:
+  GrpcSliceBuffer(const ::grpc::Slice& slice, void* data, size_t size)
+      : slice_(slice), data_(data), size_(size) {}
+
+  void* data() const override { return data_; }
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name("grpc_slice");
+  }
+  // The slice may also back other data, e.g. the sent tensor with an
+  // in-process channel, so it must not be forwarded for in-place updates.
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  const ::grpc::Slice slice_;  // Holds a reference.
+  void* const data_;
+  const size_t size_;
+};
+}  // namespace
+
+TensorBuffer* GrpcByteSource::ShareBuffer(const void* data, size_t size) {
+  std::vector<::grpc::Slice> slices;
+  if (!buffer_->Dump(&slices).ok()) {
+    return nullptr;
+  }
+  const uint8* begin = static_cast<const uint8*>(data);
+  for (const ::grpc::Slice& s : slices) {
+    if (s.begin() <= begin && begin + size <= s.end()) {
+      return new GrpcSliceBuffer(s, const_cast<uint8*>(begin), size);
+    }
+  }
+  return nullptr;
+}
+
 ::grpc::Status GrpcMaybeUnparseProto(const protobuf::Message& src,
                                      grpc::ByteBuffer* dst) {
   bool own_buffer;
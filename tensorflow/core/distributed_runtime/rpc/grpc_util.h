@@ -44,6 +44,10 @@ class GrpcByteSource : public TensorResponse::Source {
     return stream_;
   }
 
+  // Shares the bytes if they lie within one of the slices of the buffer,
+  // by holding a reference to that slice.
+  TensorBuffer* ShareBuffer(const void* data, size_t size) override;
+
  private:
   void DeleteStream() {
     if (stream_) {
@@ -25,12 +25,22 @@ limitations under the License.
 #include "tensorflow/core/distributed_runtime/worker_cache_partial.h"
 #include "tensorflow/core/distributed_runtime/worker_interface.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/host_info.h"
 #include "tensorflow/core/platform/mutex.h"
 
 namespace tensorflow {
 
 namespace {
 
+// Returns the host of a "host:port" address, or of "[address]:port" for
+// IPv6, keeping the brackets.
+string HostOf(const string& address) {
+  if (!address.empty() && address[0] == '[') {
+    return address.substr(0, address.find(']') + 1);
+  }
+  return address.substr(0, address.rfind(':'));
+}
+
 class GrpcWorkerCache : public WorkerCachePartial {
  public:
   // TODO(ncteisen): consider adding a config var or flag for this
@@ -42,6 +52,7 @@ class GrpcWorkerCache : public WorkerCachePartial {
       : local_target_(local_target),
         local_worker_(local_worker),
         channel_cache_(channel_cache),
+        hostname_(port::Hostname()),
         threads_(kGrpcWorkerCacheThreadCount),
         next_round_robin_assignment_(0) {}
 
@@ -75,6 +86,12 @@ class GrpcWorkerCache : public WorkerCachePartial {
     }
   }
 
+  bool IsSameHost(const string& target) override {
+    const string host = HostOf(channel_cache_->TranslateTask(target));
+    return host == "localhost" || host == "127.0.0.1" || host == "[::1]" ||
+           host == hostname_;
+  }
+
   void SetLogging(bool v) override { logger_.SetLogging(v); }
 
   void ClearLogs() override { logger_.ClearLogs(); }
@@ -130,6 +147,7 @@ class GrpcWorkerCache : public WorkerCachePartial {
   const string local_target_;
   WorkerInterface* const local_worker_;  // Not owned.
   std::shared_ptr<GrpcChannelCache> channel_cache_;
+  const string hostname_;
   WorkerCacheLogger logger_;
   std::vector<GrpcWorkerCacheThread> threads_;
 
@@ -50,6 +50,14 @@ namespace tensorflow {
 
 namespace {
 
+// Tensors sent to workers on the same host are placed in shared memory if
+// they have at least this many bytes, in a ring of this many bytes.
+const size_t kMinSharedMemoryTensorBytes = 16 << 10;
+const size_t kSharedMemoryRingBytes = 256 << 20;
+// Blocks whose receivers have not started reading them after this long,
+// e.g. because the RecvTensor call was cancelled, are reclaimed.
+const int64 kSharedMemoryLeaseMicros = 60 * 1000 * 1000;
+
 class GrpcWorkerService : public AsyncServiceInterface {
   // TODO(ncteisen): consider adding a config var or flag for this
   static constexpr const size_t kGrpcWorkerServiceThreadCount = 8;
@@ -421,6 +429,210 @@ class GrpcWorkerService : public AsyncServiceInterface {
 GrpcWorker::GrpcWorker(WorkerEnv* worker_env)
     : Worker(worker_env), recv_tensor_recent_request_ids_(100000) {}
 
+void GrpcWorker::EncodeRecvTensorResponse(const RecvTensorRequest& request,
+                                          bool is_dead, const Tensor& val,
+                                          ::grpc::ByteBuffer* response) {
+  if (is_dead ||
+      request.compression().type() == RecvTensorCompression::NONE) {
+    if (!is_dead && EncodeToSharedMemory(request, val, response)) return;
+    grpc::EncodeTensorToByteBuffer(is_dead, val, response);
+    return;
+  }
+  Tensor payload;
+  RecvTensorResponse metadata;
+  std::shared_ptr<CompressionResiduals> residuals =
+      FindCompressionResiduals(request.step_id());
+  if (residuals == nullptr) {
+    // Compress without error feedback.
+    residuals = std::make_shared<CompressionResiduals>();
+  }
+  CompressTensor(request.compression(), val, request.rendezvous_key(),
+                 residuals.get(), &payload, &metadata);
+  grpc::EncodeTensorToByteBuffer(is_dead, payload, metadata, response);
+}
+
+std::shared_ptr<CompressionResiduals> GrpcWorker::FindCompressionResiduals(
+    int64 step_id) {
+  mutex_lock l(residuals_mu_);
+  auto step = step_graphs_.find(step_id);
+  if (step == step_graphs_.end()) return nullptr;
+  std::shared_ptr<CompressionResiduals>& residuals =
+      compression_residuals_[step->second.first][step->second.second];
+  if (residuals == nullptr) {
+    residuals = std::make_shared<CompressionResiduals>();
+  }
+  return residuals;
+}
+
+void GrpcWorker::DeleteWorkerSessionAsync(
+    CallOptions* opts, const DeleteWorkerSessionRequest* request,
+    DeleteWorkerSessionResponse* response, StatusCallback done) {
+  {
+    mutex_lock l(residuals_mu_);
+    compression_residuals_.erase(request->session_handle());
+    for (auto it = step_graphs_.begin(); it != step_graphs_.end();) {
+      if (it->second.first == request->session_handle()) {
+        it = step_graphs_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  Worker::DeleteWorkerSessionAsync(opts, request, response, std::move(done));
+}
+
+void GrpcWorker::DeregisterGraphAsync(const DeregisterGraphRequest* request,
+                                      DeregisterGraphResponse* response,
+                                      StatusCallback done) {
+  {
+    mutex_lock l(residuals_mu_);
+    auto session = compression_residuals_.find(request->session_handle());
+    if (session != compression_residuals_.end()) {
+      session->second.erase(request->graph_handle());
+      if (session->second.empty()) compression_residuals_.erase(session);
+    }
+    const std::pair<string, string> graph(request->session_handle(),
+                                          request->graph_handle());
+    for (auto it = step_graphs_.begin(); it != step_graphs_.end();) {
+      if (it->second == graph) {
+        it = step_graphs_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  Worker::DeregisterGraphAsync(request, response, std::move(done));
+}
+
+void GrpcWorker::RunGraphAsync(CallOptions* opts,
+                               RunGraphRequestWrapper* request,
+                               MutableRunGraphResponseWrapper* response,
+                               StatusCallback done) {
+  {
+    mutex_lock l(residuals_mu_);
+    step_graphs_[request->step_id()] = {request->session_handle(),
+                                        request->graph_handle()};
+  }
+  Worker::RunGraphAsync(opts, request, response, std::move(done));
+}
+
+void GrpcWorker::CleanupGraphAsync(const CleanupGraphRequest* request,
+                                   CleanupGraphResponse* response,
+                                   StatusCallback done) {
+  {
+    mutex_lock l(residuals_mu_);
+    step_graphs_.erase(request->step_id());
+  }
+  {
+    mutex_lock l(shm_mu_);
+    for (auto it = shm_tensors_.begin(); it != shm_tensors_.end();) {
+      if (it->second.step_id == request->step_id()) {
+        it = shm_tensors_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  Worker::CleanupGraphAsync(request, response, std::move(done));
+}
+
+bool GrpcWorker::EncodeToSharedMemory(const RecvTensorRequest& request,
+                                      const Tensor& val,
+                                      ::grpc::ByteBuffer* response) {
+  SharedMemoryTransport transport;
+  if (!request.transport_options().Is<SharedMemoryTransport>() ||
+      !request.transport_options().UnpackTo(&transport) ||
+      !DataTypeCanUseMemcpy(val.dtype()) ||
+      val.TotalBytes() < kMinSharedMemoryTensorBytes) {
+    return false;
+  }
+  const string& host_id = SharedMemoryRing::HostId();
+  if (host_id.empty() || transport.host_id() != host_id) return false;
+  SharedMemoryRing* ring;
+  int64 offset;
+  uint64 sequence;
+  char* data;
+  {
+    mutex_lock l(shm_mu_);
+    if (!shm_ring_ && !shm_ring_failed_) {
+      Status s = SharedMemoryRing::Create(
+          kSharedMemoryRingBytes, kSharedMemoryLeaseMicros, &shm_ring_);
+      if (!s.ok()) {
+        LOG(WARNING) << "Sending tensors over gRPC to workers on this host: "
+                     << s;
+        shm_ring_failed_ = true;
+      }
+    }
+    ring = shm_ring_.get();
+    // If the ring is full, e.g. because receivers are slow or went away
+    // before releasing their tensors, fall back to gRPC.
+    if (ring == nullptr ||
+        !ring->Allocate(val.TotalBytes(), &offset, &sequence, &data)) {
+      return false;
+    }
+    // Keeps a reference to "val" in case the receiver asks for it again.
+    PruneSharedMemoryTensorsLocked();
+    shm_tensors_[sequence] = {request.step_id(), val, false};
+  }
+  StringPiece content = val.tensor_data();
+  memcpy(data, content.data(), content.size());
+
+  RecvTensorResponse proto;
+  proto.mutable_tensor()->set_dtype(val.dtype());
+  val.shape().AsProto(proto.mutable_tensor()->mutable_tensor_shape());
+  proto.set_send_start_micros(Env::Default()->NowMicros());
+  transport.Clear();
+  transport.set_segment(ring->name());
+  transport.set_offset(offset);
+  transport.set_length(content.size());
+  transport.set_sequence(sequence);
+  proto.mutable_transport_options()->PackFrom(transport);
+  grpc::EncodeRecvTensorResponseToByteBuffer(proto, response);
+  return true;
+}
+
+Status GrpcWorker::EncodeSharedMemoryResend(
+    const SharedMemoryTransport& transport, ::grpc::ByteBuffer* response) {
+  Tensor val;
+  {
+    mutex_lock l(shm_mu_);
+    if (shm_ring_ == nullptr || transport.segment() != shm_ring_->name()) {
+      return errors::InvalidArgument("Unknown shared memory segment ",
+                                     transport.segment());
+    }
+    // A receiver only asks again once the block has been reclaimed.
+    PruneSharedMemoryTensorsLocked();
+    auto it = shm_tensors_.find(transport.sequence());
+    if (it == shm_tensors_.end() || !it->second.expired) {
+      return errors::Aborted("Tensor of block ", transport.sequence(),
+                             " in shared memory segment ",
+                             transport.segment(), " is no longer available");
+    }
+    val = std::move(it->second.val);
+    shm_tensors_.erase(it);
+  }
+  grpc::EncodeTensorToByteBuffer(false /* is_dead */, val, response);
+  return Status::OK();
+}
+
+void GrpcWorker::PruneSharedMemoryTensorsLocked() {
+  uint64 reclaimed_before;
+  std::vector<uint64> expired;
+  shm_ring_->CollectReclaimed(&reclaimed_before, &expired);
+  for (uint64 sequence : expired) {
+    auto it = shm_tensors_.find(sequence);
+    if (it != shm_tensors_.end()) it->second.expired = true;
+  }
+  for (auto it = shm_tensors_.begin();
+       it != shm_tensors_.end() && it->first < reclaimed_before;) {
+    if (it->second.expired) {
+      ++it;
+    } else {
+      it = shm_tensors_.erase(it);
+    }
+  }
+}
+
 // GrpcRecvTensorAsync: unlike the other Worker methods, which use protocol
 // buffers for a response object, to avoid extra protocol buffer serialization
 // overhead we generate our response directly into a ::grpc::ByteBuffer object
@@ -434,6 +646,14 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
     done(s);
     return;
   }
+  // The tensor has already been received from the rendezvous if the
+  // request asks for content that was placed in shared memory.
+  SharedMemoryTransport resend;
+  if (request->transport_options().UnpackTo(&resend) &&
+      resend.sequence() != 0) {
+    done(EncodeSharedMemoryResend(resend, response));
+    return;
+  }
 
   const int64 step_id = request->step_id();
   const string& key = request->rendezvous_key();
@@ -456,7 +676,7 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
   opts->SetCancelCallback([this, step_id]() { AbortStep(step_id); });
   env_->rendezvous_mgr->RecvLocalAsync(
       step_id, parsed,
-      [opts, response, done, src_dev, request](
+      [this, opts, response, done, src_dev, request](
           const Status& status, const Rendezvous::Args& send_args,
           const Rendezvous::Args& recv_args, const Tensor& val,
           const bool is_dead) {
@@ -483,10 +703,10 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
                   << " gpu_info: " << src_dev->tensorflow_gpu_device_info();
               // "val" is on an accelerator device. Uses the device_context to
               // fill the copy on host.
-              StatusCallback copy_ready = [response, done, copy,
+              StatusCallback copy_ready = [this, request, response, done, copy,
                                            is_dead](const Status& s) {
                 // The value is now ready to be returned on the wire.
-                grpc::EncodeTensorToByteBuffer(is_dead, *copy, response);
+                EncodeRecvTensorResponse(*request, is_dead, *copy, response);
                 done(s);
                 delete copy;
               };
@@ -494,7 +714,7 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
               send_dev_context->CopyDeviceTensorToCPU(
                   &val, request->rendezvous_key(), src_dev, copy, copy_ready);
             } else {
-              grpc::EncodeTensorToByteBuffer(is_dead, val, response);
+              EncodeRecvTensorResponse(*request, is_dead, val, response);
               done(Status::OK());
             }
           }
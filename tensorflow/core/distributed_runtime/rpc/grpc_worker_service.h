@@ -16,8 +16,17 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_WORKER_SERVICE_H_
 #define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_WORKER_SERVICE_H_
 
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
 #include "tensorflow/core/distributed_runtime/recent_request_ids.h"
+#include "tensorflow/core/distributed_runtime/shared_memory_ring.h"
+#include "tensorflow/core/distributed_runtime/tensor_compression.h"
 #include "tensorflow/core/distributed_runtime/worker.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/mutex.h"
 
 namespace grpc {
 class ByteBuffer;
@@ -27,6 +36,7 @@ class ServerBuilder;
 namespace tensorflow {
 
 class AsyncServiceInterface;
+class SharedMemoryTransport;
 struct WorkerEnv;
 struct WorkerSession;
 
@@ -46,10 +56,81 @@ class GrpcWorker : public Worker {
   virtual void RecvBufAsync(CallOptions* opts, const RecvBufRequest* request,
                             RecvBufResponse* response, StatusCallback done);
 
+  // The following track the graph that runs each step, and drop the
+  // compression state of graphs and sessions when they are deleted.
+  void DeleteWorkerSessionAsync(CallOptions* opts,
+                                const DeleteWorkerSessionRequest* request,
+                                DeleteWorkerSessionResponse* response,
+                                StatusCallback done) override;
+
+  void DeregisterGraphAsync(const DeregisterGraphRequest* request,
+                            DeregisterGraphResponse* response,
+                            StatusCallback done) override;
+
+  void RunGraphAsync(CallOptions* opts, RunGraphRequestWrapper* request,
+                     MutableRunGraphResponseWrapper* response,
+                     StatusCallback done) override;
+
+  void CleanupGraphAsync(const CleanupGraphRequest* request,
+                         CleanupGraphResponse* response,
+                         StatusCallback done) override;
+
   WorkerEnv* env();
 
  private:
+  // Encodes "val" into "response", compressed if "request" asks for it.
+  void EncodeRecvTensorResponse(const RecvTensorRequest& request,
+                                bool is_dead, const Tensor& val,
+                                ::grpc::ByteBuffer* response);
+
+  // Places the content of "val" in shared memory and encodes the rest of
+  // it into "response", if "request" comes from the same host.  Returns
+  // false if "val" has to be sent in "response".
+  bool EncodeToSharedMemory(const RecvTensorRequest& request,
+                            const Tensor& val, ::grpc::ByteBuffer* response);
+
+  // Encodes the tensor that was placed in shared memory as "transport"
+  // into "response", if a receiver asks for it again because the lease of
+  // that memory expired.
+  Status EncodeSharedMemoryResend(const SharedMemoryTransport& transport,
+                                  ::grpc::ByteBuffer* response);
+
+  // Drops the tensors placed in shared memory that cannot be asked for
+  // again, because their memory was released by their receiver.
+  void PruneSharedMemoryTensorsLocked() EXCLUSIVE_LOCKS_REQUIRED(shm_mu_);
+
+  // Returns the error feedback state of the TOP_K compressed edges of the
+  // graph that runs "step_id", or nullptr if the step isn't running.
+  std::shared_ptr<CompressionResiduals> FindCompressionResiduals(
+      int64 step_id);
+
   RecentRequestIds recv_tensor_recent_request_ids_;
+
+  // Error feedback state of TOP_K compressed edges, by session handle and
+  // graph handle, since graphs reuse edge names.
+  mutex residuals_mu_;
+  std::unordered_map<
+      string,
+      std::unordered_map<string, std::shared_ptr<CompressionResiduals>>>
+      compression_residuals_ GUARDED_BY(residuals_mu_);
+  // The session handle and graph handle of the running steps, until they are
+  // cleaned up.
+  std::unordered_map<int64, std::pair<string, string>> step_graphs_
+      GUARDED_BY(residuals_mu_);
+
+  // Holds tensors sent to receivers on the same host, created on demand.
+  mutex shm_mu_;
+  std::unique_ptr<SharedMemoryRing> shm_ring_ GUARDED_BY(shm_mu_);
+  bool shm_ring_failed_ GUARDED_BY(shm_mu_) = false;
+  // The tensors placed in shm_ring_, by the sequence numbers of their
+  // blocks, until their blocks are reclaimed, and the ones whose lease
+  // expired until their steps are cleaned up.
+  struct SharedMemoryTensor {
+    int64 step_id;
+    Tensor val;
+    bool expired;
+  };
+  std::map<uint64, SharedMemoryTensor> shm_tensors_ GUARDED_BY(shm_mu_);
 };
 
 std::unique_ptr<GrpcWorker> NewGrpcWorker(WorkerEnv* worker_env);
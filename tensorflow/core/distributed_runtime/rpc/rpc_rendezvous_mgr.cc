@@ -22,7 +22,9 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/distributed_runtime/request_id.h"
+#include "tensorflow/core/distributed_runtime/shared_memory_ring.h"
 #include "tensorflow/core/distributed_runtime/tensor_coding.h"
+#include "tensorflow/core/distributed_runtime/tensor_compression.h"
 #include "tensorflow/core/distributed_runtime/worker_cache.h"
 #include "tensorflow/core/distributed_runtime/worker_interface.h"
 #include "tensorflow/core/framework/types.h"
@@ -32,11 +34,14 @@ limitations under the License.
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/transport_options.pb.h"
 
 namespace tensorflow {
 
 namespace {
 
+class RpcRecvTensorCall;
+
 class RpcRemoteRendezvous : public BaseRemoteRendezvous {
  public:
   RpcRemoteRendezvous(const WorkerEnv* env, int64 step_id)
@@ -50,6 +55,10 @@ class RpcRemoteRendezvous : public BaseRemoteRendezvous {
  private:
   ~RpcRemoteRendezvous() override {}
 
+  // Completes "call" once its response has arrived, or starts it again if
+  // the content of the tensor has to be resent.
+  void RecvDone(RpcRecvTensorCall* call);
+
   TF_DISALLOW_COPY_AND_ASSIGN(RpcRemoteRendezvous);
 };
 
@@ -117,6 +126,72 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
 
   bool is_dead() const { return resp_.metadata().is_dead(); }
 
+  // Copies the content of the received tensor from shared memory if the
+  // sender placed it there, and releases that memory.  Returns Unavailable
+  // if the sender has reclaimed the memory, see PrepareResend().
+  Status CopyFromSharedMemory() {
+    const protobuf::Any& options = resp_.metadata().transport_options();
+    if (!options.Is<SharedMemoryTransport>()) return Status::OK();
+    SharedMemoryTransport transport;
+    if (!options.UnpackTo(&transport)) {
+      return errors::Internal("Invalid shared memory transport options");
+    }
+    std::shared_ptr<SharedMemoryRing> ring;
+    TF_RETURN_IF_ERROR(GetSharedMemoryRing(transport.segment(), &ring));
+    // Shares the buffer of the received tensor.
+    Tensor t = resp_.tensor();
+    const char* content;
+    Status s = ring->Get(transport.offset(), transport.sequence(),
+                         transport.length(), &content);
+    if (s.ok() && t.TotalBytes() != static_cast<size_t>(transport.length())) {
+      s = errors::Internal("Received ", transport.length(), " bytes for ",
+                           t.DebugString());
+    }
+    if (s.ok()) memcpy(DMAHelper::base(&t), content, t.TotalBytes());
+    ring->Release(transport.offset(), transport.sequence());
+    return s;
+  }
+
+  // Releases the shared memory holding the content of a response that
+  // arrived for a call that failed anyway, e.g. because it was aborted.
+  void ReleaseSharedMemory() {
+    SharedMemoryTransport transport;
+    if (!resp_.metadata().transport_options().UnpackTo(&transport) ||
+        transport.segment().empty()) {
+      return;
+    }
+    std::shared_ptr<SharedMemoryRing> ring;
+    if (GetSharedMemoryRing(transport.segment(), &ring).ok()) {
+      ring->Release(transport.offset(), transport.sequence());
+    }
+  }
+
+  // Asks the sender to send the content of a tensor it placed in shared
+  // memory over RPC instead, once the lease of that memory expired before
+  // it was read.  Returns false if the content was not in shared memory or
+  // has already been requested again.
+  bool PrepareResend() {
+    SharedMemoryTransport transport;
+    if (!resp_.metadata().transport_options().UnpackTo(&transport) ||
+        transport.sequence() == 0) {
+      return false;
+    }
+    SharedMemoryTransport resend;
+    resend.set_segment(transport.segment());
+    resend.set_sequence(transport.sequence());
+    req_.mutable_transport_options()->PackFrom(resend);
+    req_.set_request_id(GetUniqueRequestId());
+    resp_.Clear();
+    return true;
+  }
+
+  // Decompresses the received tensor into *val if the sender compressed it.
+  Status DecompressTensor(Tensor* val) const {
+    *val = resp_.tensor();
+    return ::tensorflow::DecompressTensor(
+        resp_.metadata(), dst_device_->GetAllocator(alloc_attrs_), val);
+  }
+
   Device* dst_device() const { return dst_device_; }
   const Rendezvous::Args& recv_args() const { return recv_args_; }
   const Rendezvous::DoneCallback& done() const { return done_; }
@@ -229,6 +304,14 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
   if (s.ok()) {
     s = sess->device_mgr()->LookupDevice(parsed.dst_device, &dst_device);
   }
+  // Compressed tensors are decompressed on the host, so compression is only
+  // requested for tensors received into host memory.
+  RecvTensorCompression compression;
+  if (s.ok() && !recv_args.wire_compression.empty() &&
+      (dst_device->device_type() == DEVICE_CPU ||
+       recv_args.alloc_attrs.on_host())) {
+    s = ParseWireCompression(recv_args.wire_compression, &compression);
+  }
   if (!s.ok()) {
     if (rwi != nullptr) {
       sess->worker_cache->ReleaseWorker(call->src_worker_, rwi);
@@ -240,24 +323,51 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
 
   call->Init(rwi, step_id_, parsed.FullKey(), recv_args.alloc_attrs, dst_device,
              recv_args, std::move(done));
+  if (compression.type() != RecvTensorCompression::NONE) {
+    *call->req_.mutable_compression() = compression;
+  } else if ((dst_device->device_type() == DEVICE_CPU ||
+              recv_args.alloc_attrs.on_host()) &&
+             !SharedMemoryRing::HostId().empty() &&
+             sess->worker_cache->IsSameHost(call->src_worker_)) {
+    // Let a sender on the same host pass the content in shared memory,
+    // which is copied into the host memory of the received tensor.
+    SharedMemoryTransport transport;
+    transport.set_host_id(SharedMemoryRing::HostId());
+    call->req_.mutable_transport_options()->PackFrom(transport);
+  }
 
   // Record "call" in active_ so that it can be aborted cleanly.
   RegisterCall(call);
 
   // Start "call".
   Ref();
-  call->Start([this, call]() {
-    // Removes "call" from active_. Prevent StartAbort().
-    DeregisterCall(call);
-    // If StartAbort was called prior to DeregisterCall, then the
-    // current status should be bad.
-    Status s = call->status();
-    call->done()(s, Args(), call->recv_args(), call->tensor(), call->is_dead());
-    session()->worker_cache->ReleaseWorker(call->src_worker_, call->wi_);
-    call->wi_ = nullptr;
-    get_call_freelist()->Release(call, session()->worker_cache.get());
-    Unref();
-  });
+  call->Start([this, call]() { RecvDone(call); });
+}
+
+void RpcRemoteRendezvous::RecvDone(RpcRecvTensorCall* call) {
+  // Removes "call" from active_. Prevent StartAbort().
+  DeregisterCall(call);
+  // If StartAbort was called prior to DeregisterCall, then the
+  // current status should be bad.
+  Status s = call->status();
+  Tensor val;
+  if (s.ok() && !call->is_dead()) {
+    s = call->CopyFromSharedMemory();
+    if (errors::IsUnavailable(s) && call->PrepareResend()) {
+      // The sender still holds the tensor, so receive it like any other.
+      RegisterCall(call);
+      call->Start([this, call]() { RecvDone(call); });
+      return;
+    }
+    if (s.ok()) s = call->DecompressTensor(&val);
+  } else {
+    call->ReleaseSharedMemory();
+  }
+  call->done()(s, Args(), call->recv_args(), val, call->is_dead());
+  session()->worker_cache->ReleaseWorker(call->src_worker_, call->wi_);
+  call->wi_ = nullptr;
+  get_call_freelist()->Release(call, session()->worker_cache.get());
+  Unref();
 }
 
 }  // namespace
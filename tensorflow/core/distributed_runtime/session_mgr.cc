@@ -57,6 +57,14 @@ Status SessionMgr::CreateSession(const string& session,
     return errors::InvalidArgument("Session must be non-empty.");
   }
 
+  auto it = sessions_.find(session);
+  if (it != sessions_.end()) {
+    if (server_def.cluster().job().empty()) {
+      return Status::OK();
+    }
+    return UpdateSessionLocked(it->second.get(), server_def);
+  }
+
   WorkerCacheInterface* worker_cache = nullptr;
   string worker_name;
   if (server_def.cluster().job().empty()) {
@@ -105,6 +113,24 @@ Status SessionMgr::CreateSession(const string& session,
   return Status::OK();
 }
 
+Status SessionMgr::UpdateSessionLocked(WorkerSession* worker_session,
+                                       const ServerDef& server_def) {
+  const string worker_name = WorkerNameFromServerDef(server_def);
+  if (worker_name != worker_session->worker_name) {
+    return errors::InvalidArgument(
+        "Cannot update session ", worker_session->session_name,
+        " of worker ", worker_session->worker_name, " to worker ", worker_name,
+        ".");
+  }
+  WorkerCacheInterface* worker_cache = nullptr;
+  TF_RETURN_IF_ERROR(worker_cache_factory_(server_def, &worker_cache));
+  if (worker_cache != nullptr && default_worker_cache_ != nullptr) {
+    worker_cache->SetLogging(this->is_logging_active_);
+  }
+  return worker_session->UpdateWorkerCache(
+      std::unique_ptr<WorkerCacheInterface>(worker_cache));
+}
+
 Status SessionMgr::DeleteSession(const string& session) {
   mutex_lock l(mu_);
   auto it = sessions_.find(session);
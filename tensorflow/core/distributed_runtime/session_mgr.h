@@ -46,6 +46,11 @@ class SessionMgr {
   ~SessionMgr() {}
 
   // Allocates state for a new session.
+  //
+  // If the session already exists and `server_def` has a cluster, the
+  // session is moved to that cluster instead: the worker cache is replaced,
+  // while the devices, resources and registered graphs of the session are
+  // kept. `server_def` must name the same worker as before.
   Status CreateSession(const string& session, const ServerDef& server_def,
                        bool isolate_session_state);
 
@@ -87,6 +92,10 @@ class SessionMgr {
 
   const WorkerCacheFactory worker_cache_factory_;
 
+  Status UpdateSessionLocked(WorkerSession* worker_session,
+                             const ServerDef& server_def)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
   Status WorkerSessionForSessionLocked(
       const string& session_handle, std::shared_ptr<WorkerSession>* out_session)
       EXCLUSIVE_LOCKS_REQUIRED(mu_);
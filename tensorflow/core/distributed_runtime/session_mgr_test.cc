@@ -56,8 +56,10 @@ class SessionMgrTest : public ::testing::Test {
 
   std::unique_ptr<DeviceMgr> device_mgr_;
   WorkerEnv env_;
+  int num_worker_caches_ = 0;
   SessionMgr::WorkerCacheFactory factory_ =
-      [](const ServerDef& server_def, WorkerCacheInterface** worker_cache) {
+      [this](const ServerDef& server_def, WorkerCacheInterface** worker_cache) {
+        ++num_worker_caches_;
         *worker_cache = nullptr;  // Set to null to make debugging easier.
         return Status::OK();
       };
@@ -141,6 +143,39 @@ TEST_F(SessionMgrTest, CreateSessionIsolateSessionState) {
   EXPECT_NE(devices_3[0]->resource_manager(), devices_4[0]->resource_manager());
 }
 
+TEST_F(SessionMgrTest, CreateExistingSessionUpdatesCluster) {
+  ServerDef server_def;
+  server_def.set_job_name("worker");
+  server_def.set_task_index(0);
+  auto job = server_def.mutable_cluster()->add_job();
+  job->set_name("worker");
+  job->mutable_tasks()->insert({0, "localhost:3333"});
+
+  string session_handle = "test_session_handle";
+  TF_EXPECT_OK(mgr_.CreateSession(session_handle, server_def, true));
+  EXPECT_EQ(1, num_worker_caches_);
+  std::shared_ptr<WorkerSession> session;
+  TF_EXPECT_OK(mgr_.WorkerSessionForSession(session_handle, &session));
+  ResourceMgr* resource_mgr =
+      session->device_mgr()->ListDevices()[0]->resource_manager();
+
+  // A worker joins the cluster.
+  job->mutable_tasks()->insert({1, "localhost:4444"});
+  TF_EXPECT_OK(mgr_.CreateSession(session_handle, server_def, true));
+  EXPECT_EQ(2, num_worker_caches_);
+  std::shared_ptr<WorkerSession> updated_session;
+  TF_EXPECT_OK(mgr_.WorkerSessionForSession(session_handle, &updated_session));
+  EXPECT_EQ(session, updated_session);
+  EXPECT_EQ(resource_mgr,
+            session->device_mgr()->ListDevices()[0]->resource_manager());
+
+  // The session cannot move to another worker.
+  server_def.set_task_index(1);
+  Status s = mgr_.CreateSession(session_handle, server_def, true);
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+  TF_EXPECT_OK(mgr_.DeleteSession(session_handle));
+}
+
 TEST_F(SessionMgrTest, LegacySession) {
   ServerDef server_def;
   string session_handle = "";
@@ -0,0 +1,455 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/shared_memory_ring.h"
+
+#include <atomic>
+#include <unordered_map>
+
+#include "tensorflow/core/platform/platform.h"
+
+#if !defined(PLATFORM_WINDOWS)
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+#endif
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/host_info.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+namespace {
+// Alignment of the blocks and of their data.
+const size_t kAlignment = 64;
+// Size of the segment header, which precedes the ring.
+const size_t kSegmentHeaderBytes = kAlignment;
+const uint64 kMagic = 0x676e6972666674ULL;  // "tffring"
+
+// The state of a block is kFree, or its sequence number shifted left by
+// kSequenceShift and combined with kAllocated or kReading.
+const uint64 kFree = 0;
+const uint64 kAllocated = 1;
+const uint64 kReading = 2;
+const uint64 kStateMask = 3;
+const int kSequenceShift = 2;
+
+struct SegmentHeader {
+  uint64 magic;
+  uint64 capacity;
+};
+
+size_t RoundUp(size_t n) {
+  return (n + kAlignment - 1) / kAlignment * kAlignment;
+}
+}  // namespace
+
+// Precedes the data of every block in the ring.  Padding at the end of
+// the ring is a free block without data.
+struct SharedMemoryRing::BlockHeader {
+  std::atomic<uint64> state;
+  // The process that marked the block as being read, or 0 until it has
+  // set it.
+  std::atomic<int64> reader_pid;
+  uint64 size;  // Including this header.
+  // Only used by the producer.
+  uint64 allocated_micros;
+  uint64 sequence;  // 0 for padding.
+};
+
+SharedMemoryRing::SharedMemoryRing(const string& name, char* base,
+                                   size_t mapped_size, bool is_producer,
+                                   int64 lease_micros)
+    : name_(name),
+      base_(base),
+      mapped_size_(mapped_size),
+      capacity_(mapped_size - kSegmentHeaderBytes),
+      is_producer_(is_producer),
+      lease_micros_(lease_micros) {
+  static_assert(sizeof(BlockHeader) <= kAlignment,
+                "BlockHeader does not fit before the data of a block");
+}
+
+#if defined(PLATFORM_WINDOWS)
+
+namespace {
+int64 CurrentPid() { return 0; }
+bool ProcessExited(int64 pid) { return false; }
+bool ProducerExited(const string& name) { return false; }
+}  // namespace
+
+Status SharedMemoryRing::Create(size_t capacity, int64 lease_micros,
+                                std::unique_ptr<SharedMemoryRing>* ring) {
+  return errors::Unimplemented("Shared memory rings are not supported");
+}
+
+Status SharedMemoryRing::Open(const string& name,
+                              std::unique_ptr<SharedMemoryRing>* ring) {
+  return errors::Unimplemented("Shared memory rings are not supported");
+}
+
+void SharedMemoryRing::RemoveStaleSegments() {}
+
+SharedMemoryRing::~SharedMemoryRing() {}
+
+const string& SharedMemoryRing::HostId() {
+  static const string* host_id = new string;
+  return *host_id;
+}
+
+#else
+
+namespace {
+int64 CurrentPid() { return getpid(); }
+
+bool ProcessExited(int64 pid) { return kill(pid, 0) != 0 && errno == ESRCH; }
+
+// Identifies the PID namespace of this process, in which the process IDs
+// of segment names and block readers are meaningful.
+uint64 PidNamespace() {
+  struct stat st;
+  if (stat("/proc/self/ns/pid", &st) != 0) return 0;
+  return st.st_ino;
+}
+
+// Segments are named /tf_ring_<PID namespace>_<producer PID>_<random>.
+string SegmentPrefix() {
+  return strings::StrCat("tf_ring_", PidNamespace(), "_");
+}
+
+// Returns true if 'name', without the leading slash, is the name of a
+// segment created in this PID namespace, and sets *pid to its producer.
+bool ParseSegmentName(StringPiece name, uint64* pid) {
+  return str_util::ConsumePrefix(&name, SegmentPrefix()) &&
+         str_util::ConsumeLeadingDigits(&name, pid) &&
+         str_util::ConsumePrefix(&name, "_");
+}
+
+bool ProducerExited(const string& name) {
+  StringPiece rest(name);
+  uint64 pid;
+  return str_util::ConsumePrefix(&rest, "/") && ParseSegmentName(rest, &pid) &&
+         ProcessExited(pid);
+}
+}  // namespace
+
+void SharedMemoryRing::RemoveStaleSegments() {
+  DIR* dir = opendir("/dev/shm");
+  if (dir == nullptr) return;
+  while (const struct dirent* entry = readdir(dir)) {
+    uint64 pid;
+    if (!ParseSegmentName(entry->d_name, &pid) || !ProcessExited(pid)) {
+      continue;
+    }
+    const string name = strings::StrCat("/", entry->d_name);
+    if (shm_unlink(name.c_str()) == 0) {
+      LOG(INFO) << "Removed shared memory segment " << name
+                << " of exited process " << pid;
+    }
+  }
+  closedir(dir);
+}
+
+Status SharedMemoryRing::Create(size_t capacity, int64 lease_micros,
+                                std::unique_ptr<SharedMemoryRing>* ring) {
+  capacity = capacity / kAlignment * kAlignment;
+  if (capacity == 0) {
+    return errors::InvalidArgument("Shared memory ring capacity too small");
+  }
+  static const bool removed_stale_segments = []() {
+    RemoveStaleSegments();
+    return true;
+  }();
+  (void)removed_stale_segments;
+  const string name = strings::StrCat("/", SegmentPrefix(), getpid(), "_",
+                                      strings::Hex(random::New64()));
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    return errors::Unavailable("Cannot create shared memory segment ", name,
+                               ": ", strerror(errno));
+  }
+  // Pages of the segment are only allocated when they are first written,
+  // and a write for which the filesystem has no room raises SIGBUS, so
+  // reserve them all now.  Leave room for other users of the filesystem.
+  struct statvfs fs;
+  if (fstatvfs(fd, &fs) == 0) {
+    const uint64 room = static_cast<uint64>(fs.f_bavail) * fs.f_frsize / 2;
+    const uint64 max_capacity =
+        room > kSegmentHeaderBytes
+            ? (room - kSegmentHeaderBytes) / kAlignment * kAlignment
+            : 0;
+    if (max_capacity < capacity) capacity = max_capacity;
+  }
+  const size_t mapped_size = kSegmentHeaderBytes + capacity;
+  int error = 0;
+  if (capacity == 0) {
+    error = ENOSPC;
+  } else if (ftruncate(fd, mapped_size) != 0) {
+    error = errno;
+  }
+#if defined(__linux__)
+  if (error == 0) error = posix_fallocate(fd, 0, mapped_size);
+#endif
+  void* base = MAP_FAILED;
+  if (error == 0) {
+    base = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                0);
+    if (base == MAP_FAILED) error = errno;
+  }
+  close(fd);
+  if (base == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    return errors::Unavailable("Cannot allocate shared memory segment ", name,
+                               " of ", mapped_size, " bytes: ",
+                               strerror(error));
+  }
+  SegmentHeader* header = static_cast<SegmentHeader*>(base);
+  header->magic = kMagic;
+  header->capacity = capacity;
+  ring->reset(new SharedMemoryRing(name, static_cast<char*>(base),
+                                   mapped_size, true, lease_micros));
+  return Status::OK();
+}
+
+Status SharedMemoryRing::Open(const string& name,
+                              std::unique_ptr<SharedMemoryRing>* ring) {
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    return errors::Unavailable("Cannot open shared memory segment ", name,
+                               ": ", strerror(errno));
+  }
+  struct stat st;
+  void* base = MAP_FAILED;
+  if (fstat(fd, &st) == 0 &&
+      st.st_size >= static_cast<off_t>(kSegmentHeaderBytes + kAlignment)) {
+    base =
+        mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  const int error = errno;
+  close(fd);
+  if (base == MAP_FAILED) {
+    return errors::Unavailable("Cannot map shared memory segment ", name, ": ",
+                               strerror(error));
+  }
+  const SegmentHeader* header = static_cast<const SegmentHeader*>(base);
+  if (header->magic != kMagic || header->capacity + kSegmentHeaderBytes !=
+                                     static_cast<size_t>(st.st_size)) {
+    munmap(base, st.st_size);
+    return errors::InvalidArgument(name, " is not a shared memory ring");
+  }
+  ring->reset(new SharedMemoryRing(name, static_cast<char*>(base),
+                                   st.st_size, false, 0));
+  return Status::OK();
+}
+
+SharedMemoryRing::~SharedMemoryRing() {
+  munmap(base_, mapped_size_);
+  if (is_producer_) shm_unlink(name_.c_str());
+}
+
+const string& SharedMemoryRing::HostId() {
+  static const string* host_id = []() {
+    // Containers on one host may have separate shared memory filesystems
+    // and PID namespaces.
+    struct stat st;
+    if (stat("/dev/shm", &st) != 0) return new string;
+    return new string(strings::StrCat(port::Hostname(), ":", st.st_dev, ":",
+                                      st.st_ino, ":", PidNamespace()));
+  }();
+  return *host_id;
+}
+
+#endif  // defined(PLATFORM_WINDOWS)
+
+SharedMemoryRing::BlockHeader* SharedMemoryRing::header(size_t pos) const {
+  return reinterpret_cast<BlockHeader*>(base_ + kSegmentHeaderBytes + pos);
+}
+
+SharedMemoryRing::BlockHeader* SharedMemoryRing::BlockAt(int64 offset) const {
+  const int64 first = kSegmentHeaderBytes + kAlignment;
+  if (offset < first || (offset - kSegmentHeaderBytes) % kAlignment != 0 ||
+      offset > static_cast<int64>(mapped_size_)) {
+    return nullptr;
+  }
+  return reinterpret_cast<BlockHeader*>(base_ + offset - kAlignment);
+}
+
+bool SharedMemoryRing::Allocate(size_t size, int64* offset, uint64* sequence,
+                                char** data) {
+  CHECK(is_producer_);
+  const size_t block_size = kAlignment + RoundUp(size);
+  if (block_size > capacity_) return false;
+  mutex_lock l(mu_);
+  ReclaimLocked();
+  if (used_ > 0 && head_ == tail_) return false;
+  if (head_ >= tail_) {
+    // The free space is [head_, capacity_) followed by [0, tail_).
+    if (capacity_ - head_ < block_size) {
+      if (tail_ < block_size) return false;
+      PushBlockLocked(capacity_ - head_, kFree);
+    }
+  } else if (tail_ - head_ < block_size) {
+    return false;
+  }
+  *sequence = next_sequence_++;
+  *data = PushBlockLocked(block_size,
+                          (*sequence << kSequenceShift) | kAllocated);
+  *offset = *data - base_;
+  return true;
+}
+
+void SharedMemoryRing::CollectReclaimed(uint64* reclaimed_before,
+                                        std::vector<uint64>* expired) {
+  CHECK(is_producer_);
+  mutex_lock l(mu_);
+  ReclaimLocked();
+  *reclaimed_before = reclaimed_before_;
+  expired->insert(expired->end(), expired_.begin(), expired_.end());
+  expired_.clear();
+}
+
+char* SharedMemoryRing::PushBlockLocked(size_t size, uint64 state) {
+  BlockHeader* h = header(head_);
+  h->size = size;
+  h->allocated_micros = Env::Default()->NowMicros();
+  h->sequence = state >> kSequenceShift;
+  h->reader_pid.store(0, std::memory_order_relaxed);
+  h->state.store(state, std::memory_order_release);
+  char* data = reinterpret_cast<char*>(h) + kAlignment;
+  head_ += size;
+  if (head_ == capacity_) head_ = 0;
+  used_ += size;
+  return data;
+}
+
+void SharedMemoryRing::ReclaimLocked() {
+  const int64 now = Env::Default()->NowMicros();
+  while (used_ > 0) {
+    BlockHeader* h = header(tail_);
+    uint64 state = h->state.load(std::memory_order_acquire);
+    if (state != kFree) {
+      bool reclaim;
+      if ((state & kStateMask) == kAllocated) {
+        // Nobody has started reading the block, e.g. because the message
+        // carrying its location was lost.
+        reclaim =
+            now - static_cast<int64>(h->allocated_micros) >= lease_micros_;
+      } else {
+        const int64 pid = h->reader_pid.load(std::memory_order_relaxed);
+        reclaim = pid != 0 && ProcessExited(pid);
+      }
+      // Fails if the consumer started reading or released the block in
+      // the meantime, which the next call handles.
+      if (!reclaim || !h->state.compare_exchange_strong(
+                          state, kFree, std::memory_order_acq_rel)) {
+        break;
+      }
+      if ((state & kStateMask) == kAllocated) expired_.push_back(h->sequence);
+    }
+    if (h->sequence != 0) reclaimed_before_ = h->sequence + 1;
+    tail_ += h->size;
+    if (tail_ == capacity_) tail_ = 0;
+    used_ -= h->size;
+  }
+  if (used_ == 0) {
+    head_ = tail_ = 0;
+    reclaimed_before_ = next_sequence_;
+  }
+}
+
+Status SharedMemoryRing::Get(int64 offset, uint64 sequence, int64 length,
+                             const char** data) {
+  BlockHeader* h = BlockAt(offset);
+  if (h == nullptr || length < 0 ||
+      offset + length > static_cast<int64>(mapped_size_)) {
+    return errors::InvalidArgument("Invalid block at ", offset, " of length ",
+                                   length, " in shared memory segment ",
+                                   name_);
+  }
+  uint64 state = (sequence << kSequenceShift) | kAllocated;
+  if (!h->state.compare_exchange_strong(
+          state, (sequence << kSequenceShift) | kReading,
+          std::memory_order_acq_rel)) {
+    return errors::Unavailable("Block ", sequence, " at ", offset,
+                               " in shared memory segment ", name_,
+                               " has been released or reclaimed");
+  }
+  // The producer does not change a block that is being read.  Only now is
+  // 'h' known to be the header of a block rather than the data of another.
+  if (kAlignment + length > h->size) {
+    h->state.store((sequence << kSequenceShift) | kAllocated,
+                   std::memory_order_release);
+    return errors::InvalidArgument("No block of length ", length, " at ",
+                                   offset, " in shared memory segment ",
+                                   name_);
+  }
+  h->reader_pid.store(CurrentPid(), std::memory_order_relaxed);
+  *data = base_ + offset;
+  return Status::OK();
+}
+
+void SharedMemoryRing::Release(int64 offset, uint64 sequence) {
+  BlockHeader* h = BlockAt(offset);
+  if (h == nullptr) {
+    LOG(ERROR) << "Releasing invalid block at " << offset
+               << " in shared memory segment " << name_;
+    return;
+  }
+  uint64 state = h->state.load(std::memory_order_acquire);
+  while (state != kFree && (state >> kSequenceShift) == sequence) {
+    if (h->state.compare_exchange_weak(state, kFree,
+                                       std::memory_order_acq_rel)) {
+      return;
+    }
+  }
+}
+
+Status GetSharedMemoryRing(const string& name,
+                           std::shared_ptr<SharedMemoryRing>* ring) {
+  static mutex* mu = new mutex;
+  static auto* rings =
+      new std::unordered_map<string, std::shared_ptr<SharedMemoryRing>>;
+  mutex_lock l(*mu);
+  auto it = rings->find(name);
+  if (it == rings->end()) {
+    // Producers that exited, e.g. workers that were restarted, send nothing
+    // more, so unmap their segments once their last blocks are read.
+    for (auto r = rings->begin(); r != rings->end();) {
+      if (ProducerExited(r->first)) {
+        r = rings->erase(r);
+      } else {
+        ++r;
+      }
+    }
+    std::unique_ptr<SharedMemoryRing> r;
+    TF_RETURN_IF_ERROR(SharedMemoryRing::Open(name, &r));
+    it = rings->emplace(name, std::move(r)).first;
+  }
+  *ring = it->second;
+  return Status::OK();
+}
+
+}  // namespace tensorflow
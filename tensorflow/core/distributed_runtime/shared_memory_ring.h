@@ -0,0 +1,152 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_SHARED_MEMORY_RING_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_SHARED_MEMORY_RING_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// A ring buffer in a POSIX shared memory segment, through which one
+// process (the producer) passes byte strings to other processes on the
+// same host (the consumers).
+//
+// The producer creates the segment and allocates blocks from it in ring
+// order.  It tells a consumer where a block is through some other channel,
+// e.g. an RPC response, so the ring itself needs no notifications.  The
+// consumer maps the segment, marks the block as being read, copies it and
+// releases it, all through a state word in its header, which is the only
+// state the two sides share.  The producer reclaims released blocks in
+// allocation order when it next allocates.
+//
+// A block whose consumer never reads it, e.g. because the RPC carrying its
+// location was cancelled, is reclaimed once its lease expires; a consumer
+// that gets to it afterwards fails to read it.  A block being read by a
+// process that has exited is reclaimed too.  Until then such a block holds
+// up reclaiming the blocks after it, and the producer's allocations fail
+// once the ring is full.  Callers are expected to fall back to another
+// transport in that case, and may also resend the content of blocks whose
+// lease expired, see CollectReclaimed().
+//
+// The data of every block is aligned to 64 bytes, like the buffers of
+// tensors.
+class SharedMemoryRing {
+ public:
+  // Creates a new segment with room for 'capacity' bytes of blocks,
+  // including their headers, which is unlinked when *ring is destroyed.
+  // The capacity is reduced to half of the free space of the shared memory
+  // filesystem if needed, and all of it is reserved up front.  Blocks that
+  // are not being read 'lease_micros' after their allocation are reclaimed.
+  // The first call in a process also calls RemoveStaleSegments().
+  static Status Create(size_t capacity, int64 lease_micros,
+                       std::unique_ptr<SharedMemoryRing>* ring);
+
+  // Unlinks the segments left behind by producers on this host that exited
+  // without destroying their ring, e.g. because they crashed.  Processes
+  // that still map them are not affected.
+  static void RemoveStaleSegments();
+
+  // Maps the segment named 'name' of another process as a consumer.
+  static Status Open(const string& name,
+                     std::unique_ptr<SharedMemoryRing>* ring);
+
+  ~SharedMemoryRing();
+
+  const string& name() const { return name_; }
+
+  // Producer only: reserves a block for 'size' bytes and sets *offset to
+  // the offset of its data in the segment, *sequence to the number that
+  // identifies the block and *data to the data.  Returns false if there is
+  // not enough unreleased space in the ring.  Thread safe.
+  bool Allocate(size_t size, int64* offset, uint64* sequence, char** data);
+
+  // Producer only: sets *reclaimed_before to a sequence number such that
+  // all the blocks allocated before it have been reclaimed, and appends the
+  // sequence numbers of the blocks among them whose lease expired since the
+  // last call to *expired.  Thread safe.
+  void CollectReclaimed(uint64* reclaimed_before, std::vector<uint64>* expired);
+
+  // Marks the block at 'offset' allocated as 'sequence' as being read, so
+  // that its lease no longer expires, and sets *data to its first 'length'
+  // bytes.  Fails if the block has been released or reclaimed.
+  Status Get(int64 offset, uint64 sequence, int64 length, const char** data);
+
+  // Releases the block at 'offset' allocated as 'sequence', whether or not
+  // it is being read, so that it may be reused by the producer.  Does
+  // nothing if the block has already been released or reclaimed.  Does not
+  // access any memory past the header of the block.
+  void Release(int64 offset, uint64 sequence);
+
+  // Returns a string identifying this host and its shared memory
+  // filesystem, which is equal in two processes if and only if segments
+  // created by one can be opened by the other.  Returns an empty string
+  // if shared memory is not supported.
+  static const string& HostId();
+
+ private:
+  struct BlockHeader;
+
+  SharedMemoryRing(const string& name, char* base, size_t mapped_size,
+                   bool is_producer, int64 lease_micros);
+
+  // Returns the header of the block whose data starts at 'offset', or
+  // nullptr if no block can start there.
+  BlockHeader* BlockAt(int64 offset) const;
+  // Advances tail_ over the blocks that have been released, whose lease
+  // has expired or whose reader has exited.
+  void ReclaimLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Starts a block of 'size' bytes, including its header, at head_ in
+  // 'state', which holds its sequence number unless it is padding.
+  char* PushBlockLocked(size_t size, uint64 state)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  BlockHeader* header(size_t pos) const;
+
+  const string name_;
+  char* const base_;  // Start of the mapping.
+  const size_t mapped_size_;
+  const size_t capacity_;  // Bytes in the ring after the segment header.
+  const bool is_producer_;
+  const int64 lease_micros_;
+
+  // Producer state: blocks are allocated at head_ and reclaimed from
+  // tail_, which are positions in the ring.
+  mutex mu_;
+  size_t head_ GUARDED_BY(mu_) = 0;
+  size_t tail_ GUARDED_BY(mu_) = 0;
+  size_t used_ GUARDED_BY(mu_) = 0;  // Bytes between tail_ and head_.
+  uint64 next_sequence_ GUARDED_BY(mu_) = 1;
+  uint64 reclaimed_before_ GUARDED_BY(mu_) = 1;
+  std::vector<uint64> expired_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SharedMemoryRing);
+};
+
+// Returns the consumer mapping of the segment named 'name', which is
+// opened on the first call and kept open until its producer exits.
+Status GetSharedMemoryRing(const string& name,
+                           std::shared_ptr<SharedMemoryRing>* ring);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_SHARED_MEMORY_RING_H_
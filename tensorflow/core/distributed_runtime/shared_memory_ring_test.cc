@@ -0,0 +1,220 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/shared_memory_ring.h"
+
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+const int64 kNoLease = kint64max;
+
+// Runs 'fn' in a child process, which exits with status 0 unless 'fn'
+// exits itself.
+void RunInChild(const std::function<void()>& fn) {
+  const pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    fn();
+    _exit(0);
+  }
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+}
+
+TEST(SharedMemoryRingTest, ConsumerReadsAndReleases) {
+  std::unique_ptr<SharedMemoryRing> producer;
+  TF_ASSERT_OK(SharedMemoryRing::Create(4096, kNoLease, &producer));
+  std::shared_ptr<SharedMemoryRing> consumer;
+  TF_ASSERT_OK(GetSharedMemoryRing(producer->name(), &consumer));
+  std::shared_ptr<SharedMemoryRing> again;
+  TF_ASSERT_OK(GetSharedMemoryRing(producer->name(), &again));
+  EXPECT_EQ(consumer, again);
+
+  int64 offset;
+  uint64 sequence;
+  char* data;
+  ASSERT_TRUE(producer->Allocate(6, &offset, &sequence, &data));
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(data) % 64);
+  memcpy(data, "shared", 6);
+  const char* read;
+  EXPECT_FALSE(consumer->Get(offset, sequence, 1000, &read).ok());
+  EXPECT_FALSE(consumer->Get(offset + 1, sequence, 5, &read).ok());
+  EXPECT_FALSE(consumer->Get(1 << 20, sequence, 6, &read).ok());
+  EXPECT_FALSE(consumer->Get(offset, sequence + 1, 6, &read).ok());
+  TF_ASSERT_OK(consumer->Get(offset, sequence, 6, &read));
+  // The consumer has its own mapping of the segment.
+  EXPECT_NE(data, read);
+  EXPECT_EQ("shared", string(read, 6));
+  consumer->Release(offset, sequence);
+  EXPECT_FALSE(consumer->Get(offset, sequence, 6, &read).ok());
+}
+
+TEST(SharedMemoryRingTest, ReclaimsInOrderAndWraps) {
+  // Blocks of 100 bytes take 192 bytes with their headers.
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(1024, kNoLease, &ring));
+  std::vector<int64> offsets;
+  std::vector<uint64> sequences;
+  int64 offset;
+  uint64 sequence;
+  char* data;
+  while (ring->Allocate(100, &offset, &sequence, &data)) {
+    offsets.push_back(offset);
+    sequences.push_back(sequence);
+  }
+  ASSERT_EQ(5, offsets.size());
+  EXPECT_FALSE(ring->Allocate(1025, &offset, &sequence, &data));
+
+  // A released block is only reused once the blocks before it are.
+  ring->Release(offsets[1], sequences[1]);
+  EXPECT_FALSE(ring->Allocate(100, &offset, &sequence, &data));
+  ring->Release(offsets[0], sequences[0]);
+  // The 64 bytes at the end of the ring are skipped.
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_TRUE(ring->Allocate(100, &offset, &sequence, &data));
+    EXPECT_EQ(offsets[i], offset);
+    offsets.push_back(offset);
+    sequences.push_back(sequence);
+  }
+  EXPECT_FALSE(ring->Allocate(100, &offset, &sequence, &data));
+
+  // An empty ring starts over.
+  for (int i = 2; i < 7; ++i) ring->Release(offsets[i], sequences[i]);
+  ASSERT_TRUE(ring->Allocate(900, &offset, &sequence, &data));
+  EXPECT_EQ(offsets[0], offset);
+}
+
+TEST(SharedMemoryRingTest, ReclaimsBlocksWhoseLeaseExpired) {
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(1024, 0, &ring));
+  int64 first_offset, offset;
+  uint64 first_sequence, sequence;
+  char* data;
+  ASSERT_TRUE(ring->Allocate(900, &first_offset, &first_sequence, &data));
+  // The first block was never read, so its memory is reused.
+  ASSERT_TRUE(ring->Allocate(900, &offset, &sequence, &data));
+  EXPECT_EQ(first_offset, offset);
+  EXPECT_NE(first_sequence, sequence);
+  const char* read;
+  EXPECT_FALSE(ring->Get(first_offset, first_sequence, 900, &read).ok());
+  // Releasing the first block does not release the second.
+  ring->Release(first_offset, first_sequence);
+  TF_ASSERT_OK(ring->Get(offset, sequence, 900, &read));
+
+  // A block that is being read is not reclaimed.
+  int64 other_offset;
+  uint64 other_sequence;
+  EXPECT_FALSE(ring->Allocate(900, &other_offset, &other_sequence, &data));
+  ring->Release(offset, sequence);
+  EXPECT_TRUE(ring->Allocate(900, &other_offset, &other_sequence, &data));
+
+  // The second block was released after reading, so it is not reported as
+  // expired. With a zero lease the third block expires immediately.
+  uint64 reclaimed_before;
+  std::vector<uint64> expired;
+  ring->CollectReclaimed(&reclaimed_before, &expired);
+  EXPECT_EQ(other_sequence + 1, reclaimed_before);
+  EXPECT_EQ(std::vector<uint64>({first_sequence, other_sequence}), expired);
+  expired.clear();
+  ring->CollectReclaimed(&reclaimed_before, &expired);
+  EXPECT_TRUE(expired.empty());
+}
+
+TEST(SharedMemoryRingTest, ReclaimsBlocksOfExitedReaders) {
+  std::unique_ptr<SharedMemoryRing> producer;
+  TF_ASSERT_OK(SharedMemoryRing::Create(1024, kNoLease, &producer));
+  int64 offset;
+  uint64 sequence;
+  char* data;
+  ASSERT_TRUE(producer->Allocate(900, &offset, &sequence, &data));
+  const string name = producer->name();
+  RunInChild([&name, offset, sequence]() {
+    std::unique_ptr<SharedMemoryRing> consumer;
+    const char* read;
+    if (!SharedMemoryRing::Open(name, &consumer).ok() ||
+        !consumer->Get(offset, sequence, 900, &read).ok()) {
+      _exit(1);
+    }
+    // Exits without releasing the block.
+    _exit(0);
+  });
+  // The child exited while reading the block.
+  int64 next_offset;
+  ASSERT_TRUE(producer->Allocate(900, &next_offset, &sequence, &data));
+  EXPECT_EQ(offset, next_offset);
+}
+
+TEST(SharedMemoryRingTest, RemovesSegmentsOfExitedProducers) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  RunInChild([&fds]() {
+    std::unique_ptr<SharedMemoryRing> ring;
+    if (!SharedMemoryRing::Create(4096, kNoLease, &ring).ok()) _exit(1);
+    const string& name = ring->name();
+    if (write(fds[1], name.data(), name.size()) !=
+        static_cast<ssize_t>(name.size())) {
+      _exit(1);
+    }
+    // Exits without destroying the ring.
+    _exit(0);
+  });
+  close(fds[1]);
+  char buf[256];
+  const ssize_t n = read(fds[0], buf, sizeof(buf));
+  close(fds[0]);
+  ASSERT_GT(n, 0);
+  const string name(buf, n);
+
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Open(name, &ring));
+  std::shared_ptr<SharedMemoryRing> consumer;
+  TF_ASSERT_OK(GetSharedMemoryRing(name, &consumer));
+  std::weak_ptr<SharedMemoryRing> stale = consumer;
+  consumer.reset();
+  SharedMemoryRing::RemoveStaleSegments();
+  EXPECT_FALSE(SharedMemoryRing::Open(name, &ring).ok());
+
+  // The consumer mapping is dropped when another segment is opened.
+  std::unique_ptr<SharedMemoryRing> producer;
+  TF_ASSERT_OK(SharedMemoryRing::Create(4096, kNoLease, &producer));
+  EXPECT_FALSE(stale.expired());
+  TF_ASSERT_OK(GetSharedMemoryRing(producer->name(), &consumer));
+  EXPECT_TRUE(stale.expired());
+}
+
+TEST(SharedMemoryRingTest, OpenFailsForUnknownSegment) {
+  std::unique_ptr<SharedMemoryRing> ring;
+  EXPECT_FALSE(SharedMemoryRing::Open("/tf_ring_does_not_exist", &ring).ok());
+}
+
+TEST(SharedMemoryRingTest, HostIdIsStable) {
+  EXPECT_FALSE(SharedMemoryRing::HostId().empty());
+  EXPECT_EQ(SharedMemoryRing::HostId(), SharedMemoryRing::HostId());
+}
+
+}  // namespace
+}  // namespace tensorflow
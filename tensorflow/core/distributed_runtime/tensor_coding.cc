@@ -20,16 +20,24 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
+#include "tensorflow/core/lib/core/notification.h"
 
 namespace tensorflow {
 
 TensorResponse::Source::~Source() {}
 
+TensorBuffer* TensorResponse::Source::ShareBuffer(const void* data,
+                                                  size_t size) {
+  return nullptr;
+}
+
 void TensorResponse::Clear() {
   on_host_ = false;
+  share_source_ = false;
   device_ = nullptr;
   alloc_attrs_ = AllocatorAttributes();
   allocator_ = nullptr;
+  host_allocator_ = nullptr;
   already_used_ = false;
   ClearTensor();
 }
@@ -48,6 +56,17 @@ void TensorResponse::InitAlloc(DeviceBase* d, const AllocatorAttributes& aa) {
     on_host_ = true;
   }
   allocator_ = device_->GetAllocator(alloc_attrs_);
+  // Memory that will be used for DMA must come from allocator_.
+  share_source_ = on_host_ && !alloc_attrs_.gpu_compatible() &&
+                  !alloc_attrs_.nic_compatible();
+  const DeviceBase::GpuDeviceInfo* gpu_info =
+      device_->tensorflow_gpu_device_info();
+  if (!on_host_ && gpu_info != nullptr && gpu_info->default_context) {
+    AllocatorAttributes host_attrs;
+    host_attrs.set_on_host(true);
+    host_attrs.set_gpu_compatible(true);
+    host_allocator_ = device_->GetAllocator(host_attrs);
+  }
 }
 
 Status TensorResponse::InitFrom(RecvTensorResponse* response) {
@@ -79,6 +98,9 @@ void TensorResponse::InitPartial(const RecvTensorResponse& response) {
 }
 
 Status TensorResponse::ParseFrom(Source* source) {
+  if (host_allocator_ != nullptr) {
+    return ParseToDevice(source);
+  }
   if (!on_host_) {
     protobuf::io::CodedInputStream input(source->contents());
     input.SetTotalBytesLimit(INT_MAX, INT_MAX);  // Unlimited
@@ -107,6 +129,46 @@ Status TensorResponse::ParseFrom(Source* source) {
   return errors::InvalidArgument("Cannot parse tensor from response");
 }
 
+Status TensorResponse::ParseToDevice(Source* source) {
+  // Decode the content straight into pinned host memory and copy that to
+  // the device, rather than parsing it into a TensorProto first.
+  ClearTensor();
+  Allocator* device_allocator = allocator_;
+  allocator_ = host_allocator_;
+  const bool parsed = ParseFast(source);
+  allocator_ = device_allocator;
+  if (!parsed) {
+    // E.g. DT_VARIANT or DT_STRING, which the device copies differently.
+    ClearTensor();
+    protobuf::io::CodedInputStream input(source->contents());
+    input.SetTotalBytesLimit(INT_MAX, INT_MAX);  // Unlimited
+    if (!meta_.ParseFromCodedStream(&input) || !input.ConsumedEntireMessage()) {
+      return errors::InvalidArgument("Cannot parse tensor from response");
+    }
+    Status s =
+        device_->MakeTensorFromProto(meta_.tensor(), alloc_attrs_, &tensor_);
+    // Reduce memory usage for big tensors.
+    {
+      TensorProto empty;
+      meta_.mutable_tensor()->Swap(&empty);
+    }
+    meta_.clear_tensor();
+    return s;
+  }
+  Tensor host_tensor = std::move(tensor_);
+  tensor_ = Tensor(allocator_, host_tensor.dtype(), host_tensor.shape());
+  Notification n;
+  Status status;
+  device_->tensorflow_gpu_device_info()->default_context->CopyCPUTensorToDevice(
+      &host_tensor, static_cast<Device*>(device_), &tensor_,
+      [&n, &status](const Status& s) {
+        status = s;
+        n.Notify();
+      });
+  n.WaitForNotification();
+  return status;
+}
+
 // Define some helper routines for decoding protocol buffer wire format data
 namespace {
 // We only need some of the wiretype values for this code
@@ -143,8 +205,44 @@ bool ReadNestedMessage(protobuf::io::CodedInputStream* input,
 
 }  // namespace
 
+bool TensorResponse::ShareTensorContent(protobuf::io::CodedInputStream* input,
+                                        Source* source,
+                                        const TensorProto& tensor_meta,
+                                        int num_bytes) {
+  // Small tensors are copied, as they are by the encoder, rather than
+  // keep alive all of a larger block of received data.
+  const int kMinSharedTensorBytes = 1024;
+  if (!share_source_ || num_bytes <= kMinSharedTensorBytes) return false;
+  // Only the bytes of memcpy-able types can be shared, and the content has
+  // to match the shape before a tensor is built over it.
+  const DataType dtype = tensor_meta.dtype();
+  if (!DataTypeCanUseMemcpy(dtype) ||
+      !TensorShape::IsValid(tensor_meta.tensor_shape())) {
+    return false;
+  }
+  const TensorShape shape(tensor_meta.tensor_shape());
+  const int64 element_size = DataTypeSize(dtype);
+  if (element_size <= 0 || num_bytes % element_size != 0 ||
+      num_bytes / element_size != shape.num_elements()) {
+    return false;
+  }
+  const void* data;
+  int size;
+  if (!input->GetDirectBufferPointer(&data, &size) || size < num_bytes) {
+    return false;
+  }
+  TensorBuffer* buf = source->ShareBuffer(data, num_bytes);
+  if (buf == nullptr) return false;
+  Tensor t(dtype, shape, buf);
+  buf->Unref();
+  if (!t.IsAligned()) return false;
+  tensor_ = std::move(t);
+  return input->Skip(num_bytes);
+}
+
 bool TensorResponse::ParseTensorSubmessage(
-    protobuf::io::CodedInputStream* input, TensorProto* tensor_meta) {
+    protobuf::io::CodedInputStream* input, Source* source,
+    TensorProto* tensor_meta) {
   bool seen_tensor_content = false;
   while (true) {
     auto p = input->ReadTagWithCutoff(127);
@@ -194,13 +292,13 @@ bool TensorResponse::ParseTensorSubmessage(
         int num_bytes;
         if (!ReadVarintSizeAsInt(input, &num_bytes)) return false;
         seen_tensor_content = true;
+        // Avoid the copy if the data is contiguous and properly aligned in
+        // memory the Source can share.
+        if (ShareTensorContent(input, source, *tensor_meta, num_bytes)) break;
         TensorShape shape(tensor_meta->tensor_shape());
         Tensor t(allocator_, tensor_meta->dtype(), shape);
         StringPiece buf = t.tensor_data();
         if (static_cast<size_t>(num_bytes) != buf.size()) return false;
-        // TODO(jeff,sanjay): Figure out a way to avoid this copy if
-        // the underlying ZeroCopyInputStream data is properly aligned
-        // and compatible with what allocator_ wants.
         if (!input->ReadRaw(const_cast<char*>(buf.data()), num_bytes))
           return false;
         tensor_ = std::move(t);
@@ -234,7 +332,7 @@ bool TensorResponse::ParseFast(Source* source) {
         std::pair<protobuf::io::CodedInputStream::Limit, int> p =
             input.IncrementRecursionDepthAndPushLimit(length);
         if (p.second < 0 ||
-            !ParseTensorSubmessage(&input, meta_.mutable_tensor())) {
+            !ParseTensorSubmessage(&input, source, meta_.mutable_tensor())) {
           return false;
         }
         if (!input.DecrementRecursionDepthAndPopLimit(p.first)) {
@@ -260,6 +358,34 @@ bool TensorResponse::ParseFast(Source* source) {
           return false;
         break;
       }
+      case RecvTensorResponse::kCompressionTypeFieldNumber: {
+        uint32 v;
+        if ((wt != WIRETYPE_VARINT) || !input.ReadVarint32(&v)) return false;
+        meta_.set_compression_type(
+            static_cast<RecvTensorCompression::Type>(static_cast<int>(v)));
+        break;
+      }
+      case RecvTensorResponse::kCompressedTensorShapeFieldNumber: {
+        if ((wt != WIRETYPE_LENGTH_DELIMITED) ||
+            !ReadNestedMessage(&input,
+                               meta_.mutable_compressed_tensor_shape()))
+          return false;
+        break;
+      }
+      case RecvTensorResponse::kCompressedOffsetDeltasFieldNumber: {
+        // Packed encoding, as written by proto3 serializers.
+        if (wt != WIRETYPE_LENGTH_DELIMITED) return false;
+        int length;
+        if (!ReadVarintSizeAsInt(&input, &length)) return false;
+        protobuf::io::CodedInputStream::Limit limit = input.PushLimit(length);
+        while (input.BytesUntilLimit() > 0) {
+          protobuf_uint64 v;
+          if (!input.ReadVarint64(&v)) return false;
+          meta_.add_compressed_offset_deltas(static_cast<int64>(v));
+        }
+        input.PopLimit(limit);
+        break;
+      }
       default: {
         // Unknown tag, so don't handle we can't handle on the fast path
         return false;
@@ -27,6 +27,7 @@ namespace tensorflow {
 
 class Allocator;
 class DeviceBase;
+class TensorBuffer;
 class TensorProto;
 
 // TensorResponse can be used as the destination of an RPC that returns
@@ -64,6 +65,13 @@ class TensorResponse {
     // Ownership of the returned stream is retained by the Source and
     // should not be deleted by the caller.
     virtual ::tensorflow::protobuf::io::ZeroCopyInputStream* contents() = 0;
+
+    // Returns a new TensorBuffer aliasing the 'size' bytes at 'data', which
+    // keeps them alive after the Source is destroyed, if 'data' was
+    // returned by the stream of the latest contents() call and the bytes
+    // lie in one block of memory the Source can share.  Otherwise returns
+    // nullptr and ParseFrom copies the bytes.  The default never shares.
+    virtual TensorBuffer* ShareBuffer(const void* data, size_t size);
   };
 
   // Parse the RecvTensorResponse encoded in the data yielded by
@@ -89,14 +97,23 @@ class TensorResponse {
 
  private:
   bool ParseTensorSubmessage(protobuf::io::CodedInputStream* input,
-                             TensorProto* tensor_meta);
+                             Source* source, TensorProto* tensor_meta);
+  bool ShareTensorContent(protobuf::io::CodedInputStream* input,
+                          Source* source, const TensorProto& tensor_meta,
+                          int num_bytes);
   bool ParseFast(Source* source);
   bool ParseSlow(Source* source);
+  Status ParseToDevice(Source* source);
 
   bool on_host_ = false;
+  // True if the tensor may alias memory of the Source.
+  bool share_source_ = false;
   DeviceBase* device_ = nullptr;
   AllocatorAttributes alloc_attrs_;
   Allocator* allocator_ = nullptr;
+  // For device memory tensors of a GPU: the pinned host memory allocator
+  // to decode into before the copy to the device.
+  Allocator* host_allocator_ = nullptr;
   bool already_used_ = false;
   Tensor tensor_;
   RecvTensorResponse meta_;
@@ -19,6 +19,7 @@ limitations under the License.
 #include "tensorflow/core/framework/device_base.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
@@ -156,6 +157,35 @@ TEST_F(TensorResponseTest, Simple) {
 
 TEST_F(TensorResponseTest, StringTensor) { DoTestForStrings(DT_STRING); }
 
+TEST_F(TensorResponseTest, CompressionMetadata) {
+  Tensor values = test::AsTensor<float>({1.0, -2.0, 3.0});
+  RecvTensorResponse proto;
+  values.AsProtoTensorContent(proto.mutable_tensor());
+  proto.set_compression_type(RecvTensorCompression::TOP_K);
+  TensorShape({2, 5}).AsProto(proto.mutable_compressed_tensor_shape());
+  for (int64 delta : {1, 3, 400}) {
+    proto.add_compressed_offset_deltas(delta);
+  }
+  string encoded;
+  proto.AppendToString(&encoded);
+
+  StringSource source(&encoded, 1024);
+  TensorResponse response;
+  DummyDevice cpu_device(Env::Default());
+  response.InitAlloc(&cpu_device, AllocatorAttributes());
+  TF_ASSERT_OK(response.ParseFrom(&source));
+
+  const RecvTensorResponse& meta = response.metadata();
+  EXPECT_EQ(RecvTensorCompression::TOP_K, meta.compression_type());
+  EXPECT_EQ("[2,5]",
+            TensorShape(meta.compressed_tensor_shape()).DebugString());
+  ASSERT_EQ(3, meta.compressed_offset_deltas_size());
+  EXPECT_EQ(1, meta.compressed_offset_deltas(0));
+  EXPECT_EQ(3, meta.compressed_offset_deltas(1));
+  EXPECT_EQ(400, meta.compressed_offset_deltas(2));
+  test::ExpectTensorEqual<float>(values, response.tensor());
+}
+
 string MakeFloatTensorTestCase(int num_elems) {
   std::vector<int8> v(num_elems);
   for (int i = 0; i < num_elems; i++) {
@@ -0,0 +1,235 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/tensor_compression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include "tensorflow/core/framework/bfloat16.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+
+namespace tensorflow {
+
+Status ParseWireCompression(StringPiece spec,
+                            RecvTensorCompression* compression) {
+  compression->Clear();
+  if (spec.empty()) {
+    return Status::OK();
+  }
+  if (spec == "bfloat16") {
+    compression->set_type(RecvTensorCompression::BFLOAT16);
+    return Status::OK();
+  }
+  if (spec == "float16") {
+    compression->set_type(RecvTensorCompression::FLOAT16);
+    return Status::OK();
+  }
+  StringPiece fraction_str = spec;
+  float fraction;
+  if (str_util::ConsumePrefix(&fraction_str, "top_k:") &&
+      strings::safe_strtof(fraction_str, &fraction) && fraction > 0 &&
+      fraction <= 1) {
+    compression->set_type(RecvTensorCompression::TOP_K);
+    compression->set_top_k_fraction(fraction);
+    return Status::OK();
+  }
+  return errors::InvalidArgument(
+      "Invalid wire compression \"", spec,
+      "\"; expected \"bfloat16\", \"float16\" or \"top_k:<fraction>\" with a "
+      "fraction in (0, 1].");
+}
+
+void CompressionResiduals::WithResidual(
+    const string& edge, const std::function<void(Tensor*)>& fn) {
+  std::shared_ptr<Residual> residual;
+  {
+    mutex_lock l(mu_);
+    std::shared_ptr<Residual>& entry = residuals_[edge];
+    if (entry == nullptr) {
+      entry = std::make_shared<Residual>();
+    }
+    residual = entry;
+  }
+  mutex_lock l(residual->mu);
+  fn(&residual->value);
+}
+
+void CompressionResiduals::Clear() {
+  mutex_lock l(mu_);
+  residuals_.clear();
+}
+
+namespace {
+
+// Orders NaNs above all other magnitudes so that the order is strict weak.
+float Magnitude(float value) {
+  return std::isnan(value) ? std::numeric_limits<float>::infinity()
+                           : std::abs(value);
+}
+
+void CompressTopK(float fraction, const Tensor& val, Tensor* residual,
+                  Tensor* payload, RecvTensorResponse* metadata) {
+  if (!residual->IsInitialized() || residual->shape() != val.shape()) {
+    *residual = Tensor(DT_FLOAT, val.shape());
+    residual->flat<float>().setZero();
+  }
+  // The residual now holds everything that has not been sent yet.
+  auto pending = residual->flat<float>();
+  pending += val.flat<float>();
+
+  const int64 n = pending.size();
+  const int64 k = std::min(
+      n, std::max<int64>(1, static_cast<int64>(std::ceil(fraction * n))));
+  std::vector<int64> offsets(n);
+  std::iota(offsets.begin(), offsets.end(), 0);
+  if (k < n) {
+    std::nth_element(offsets.begin(), offsets.begin() + k, offsets.end(),
+                     [&pending](int64 a, int64 b) {
+                       const float magnitude_a = Magnitude(pending(a));
+                       const float magnitude_b = Magnitude(pending(b));
+                       return magnitude_a > magnitude_b ||
+                              (magnitude_a == magnitude_b && a < b);
+                     });
+    offsets.resize(k);
+    std::sort(offsets.begin(), offsets.end());
+  }
+
+  Tensor values(DT_FLOAT, TensorShape({k}));
+  auto values_flat = values.flat<float>();
+  int64 previous_offset = 0;
+  for (int64 i = 0; i < k; ++i) {
+    const int64 offset = offsets[i];
+    values_flat(i) = pending(offset);
+    pending(offset) = 0;
+    metadata->add_compressed_offset_deltas(offset - previous_offset);
+    previous_offset = offset;
+  }
+  val.shape().AsProto(metadata->mutable_compressed_tensor_shape());
+  metadata->set_compression_type(RecvTensorCompression::TOP_K);
+  *payload = values;
+}
+
+}  // namespace
+
+void CompressTensor(const RecvTensorCompression& compression, const Tensor& val,
+                    const string& edge, CompressionResiduals* residuals,
+                    Tensor* payload, RecvTensorResponse* metadata) {
+  *payload = val;
+  if (val.dtype() != DT_FLOAT) {
+    return;
+  }
+  switch (compression.type()) {
+    case RecvTensorCompression::BFLOAT16: {
+      Tensor compressed(DT_BFLOAT16, val.shape());
+      FloatToBFloat16(val.flat<float>().data(),
+                      compressed.flat<bfloat16>().data(), val.NumElements());
+      metadata->set_compression_type(RecvTensorCompression::BFLOAT16);
+      *payload = compressed;
+      break;
+    }
+    case RecvTensorCompression::FLOAT16: {
+      Tensor compressed(DT_HALF, val.shape());
+      compressed.flat<Eigen::half>() =
+          val.flat<float>().template cast<Eigen::half>();
+      metadata->set_compression_type(RecvTensorCompression::FLOAT16);
+      *payload = compressed;
+      break;
+    }
+    case RecvTensorCompression::TOP_K: {
+      residuals->WithResidual(edge, [&](Tensor* residual) {
+        CompressTopK(compression.top_k_fraction(), val, residual, payload,
+                     metadata);
+      });
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+Status DecompressTensor(const RecvTensorResponse& metadata,
+                        Allocator* allocator, Tensor* val) {
+  switch (metadata.compression_type()) {
+    case RecvTensorCompression::NONE:
+      return Status::OK();
+    case RecvTensorCompression::BFLOAT16: {
+      if (val->dtype() != DT_BFLOAT16) {
+        return errors::InvalidArgument("Expected a bfloat16 tensor, got ",
+                                       DataTypeString(val->dtype()));
+      }
+      Tensor decompressed(allocator, DT_FLOAT, val->shape());
+      BFloat16ToFloat(val->flat<bfloat16>().data(),
+                      decompressed.flat<float>().data(), val->NumElements());
+      *val = decompressed;
+      return Status::OK();
+    }
+    case RecvTensorCompression::FLOAT16: {
+      if (val->dtype() != DT_HALF) {
+        return errors::InvalidArgument("Expected a half tensor, got ",
+                                       DataTypeString(val->dtype()));
+      }
+      Tensor decompressed(allocator, DT_FLOAT, val->shape());
+      decompressed.flat<float>() =
+          val->flat<Eigen::half>().template cast<float>();
+      *val = decompressed;
+      return Status::OK();
+    }
+    case RecvTensorCompression::TOP_K: {
+      const int64 k = metadata.compressed_offset_deltas_size();
+      if (val->dtype() != DT_FLOAT || val->dims() != 1 ||
+          val->NumElements() != k) {
+        return errors::InvalidArgument("Expected ", k,
+                                       " top-k values, got a tensor of type ",
+                                       DataTypeString(val->dtype()),
+                                       " and shape ",
+                                       val->shape().DebugString());
+      }
+      TF_RETURN_IF_ERROR(
+          TensorShape::IsValidShape(metadata.compressed_tensor_shape()));
+      Tensor decompressed(allocator, DT_FLOAT,
+                          TensorShape(metadata.compressed_tensor_shape()));
+      auto decompressed_flat = decompressed.flat<float>();
+      decompressed_flat.setZero();
+      const auto values = val->flat<float>();
+      int64 offset = 0;
+      for (int64 i = 0; i < k; ++i) {
+        const int64 delta = metadata.compressed_offset_deltas(i);
+        offset += delta;
+        if ((i > 0 && delta <= 0) || offset < 0 ||
+            offset >= decompressed_flat.size()) {
+          return errors::InvalidArgument("Invalid top-k offset ", offset,
+                                         " for a tensor of shape ",
+                                         decompressed.shape().DebugString());
+        }
+        decompressed_flat(offset) = values(i);
+      }
+      *val = decompressed;
+      return Status::OK();
+    }
+    default:
+      return errors::Unimplemented("Unknown tensor compression ",
+                                   metadata.compression_type());
+  }
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,94 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_TENSOR_COMPRESSION_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_TENSOR_COMPRESSION_H_
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/protobuf/worker.pb.h"
+
+namespace tensorflow {
+
+// Lossy wire compression of DT_FLOAT tensors returned by RecvTensor.
+//
+// Compression is requested per edge by the receiver: the "_wire_compression"
+// attr of a node is copied by graph partitioning to the Recv nodes of its
+// outputs, and from there into Rendezvous::Args::wire_compression. The
+// attr is one of "bfloat16", "float16" or "top_k:<fraction>", e.g.
+// "top_k:0.01".
+
+// Parses a "_wire_compression" attr value into *compression. An empty
+// spec means no compression.
+Status ParseWireCompression(StringPiece spec,
+                            RecvTensorCompression* compression);
+
+// The values held back by TOP_K compression, keyed by edge. Thread-safe.
+class CompressionResiduals {
+ public:
+  CompressionResiduals() {}
+
+  // Calls fn with exclusive access to the residual of `edge`. The residual
+  // is an empty tensor the first time an edge is seen.
+  void WithResidual(const string& edge,
+                    const std::function<void(Tensor*)>& fn);
+
+  // Drops all residuals.
+  void Clear();
+
+ private:
+  struct Residual {
+    mutex mu;
+    Tensor value GUARDED_BY(mu);
+  };
+
+  mutex mu_;
+  std::unordered_map<string, std::shared_ptr<Residual>> residuals_
+      GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(CompressionResiduals);
+};
+
+// Compresses `val` for sending as requested by `compression`. On return
+// *payload holds the tensor to send and the compression fields of *metadata
+// describe how to decompress it. Tensors that are not DT_FLOAT, and
+// requests for no compression, give a payload that shares `val`'s buffer
+// and leave *metadata unchanged.
+//
+// TOP_K compression adds the residual of `edge` in `residuals` to `val`
+// before selecting the values to send, and stores the values that were not
+// sent back as the new residual. If the residual has a different shape than
+// `val` it is discarded.
+void CompressTensor(const RecvTensorCompression& compression, const Tensor& val,
+                    const string& edge, CompressionResiduals* residuals,
+                    Tensor* payload, RecvTensorResponse* metadata);
+
+// Replaces the received *val by its decompressed value, allocated with
+// `allocator`, if `metadata` says that it was compressed.
+Status DecompressTensor(const RecvTensorResponse& metadata,
+                        Allocator* allocator, Tensor* val);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_TENSOR_COMPRESSION_H_
@@ -0,0 +1,137 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/tensor_compression.h"
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+// Compresses "val" and decompresses the result.
+Tensor RoundTrip(const RecvTensorCompression& compression, const Tensor& val,
+                 CompressionResiduals* residuals) {
+  Tensor payload;
+  RecvTensorResponse metadata;
+  CompressTensor(compression, val, "edge", residuals, &payload, &metadata);
+  TF_CHECK_OK(DecompressTensor(metadata, cpu_allocator(), &payload));
+  return payload;
+}
+
+TEST(TensorCompressionTest, ParseWireCompression) {
+  RecvTensorCompression compression;
+  TF_EXPECT_OK(ParseWireCompression("", &compression));
+  EXPECT_EQ(RecvTensorCompression::NONE, compression.type());
+  TF_EXPECT_OK(ParseWireCompression("bfloat16", &compression));
+  EXPECT_EQ(RecvTensorCompression::BFLOAT16, compression.type());
+  TF_EXPECT_OK(ParseWireCompression("float16", &compression));
+  EXPECT_EQ(RecvTensorCompression::FLOAT16, compression.type());
+  TF_EXPECT_OK(ParseWireCompression("top_k:0.25", &compression));
+  EXPECT_EQ(RecvTensorCompression::TOP_K, compression.type());
+  EXPECT_FLOAT_EQ(0.25, compression.top_k_fraction());
+
+  EXPECT_FALSE(ParseWireCompression("top_k:0", &compression).ok());
+  EXPECT_FALSE(ParseWireCompression("top_k:1.5", &compression).ok());
+  EXPECT_FALSE(ParseWireCompression("top_k", &compression).ok());
+  EXPECT_FALSE(ParseWireCompression("int8", &compression).ok());
+}
+
+TEST(TensorCompressionTest, HalfPrecision) {
+  CompressionResiduals residuals;
+  // All values are exactly representable in both formats.
+  Tensor val = test::AsTensor<float>({1.0, -0.5, 256.0, 0.0}, {2, 2});
+  RecvTensorCompression compression;
+  compression.set_type(RecvTensorCompression::BFLOAT16);
+  test::ExpectTensorEqual<float>(val, RoundTrip(compression, val, &residuals));
+  compression.set_type(RecvTensorCompression::FLOAT16);
+  test::ExpectTensorEqual<float>(val, RoundTrip(compression, val, &residuals));
+
+  // Precision is lost beyond the 8 significant bits of bfloat16.
+  compression.set_type(RecvTensorCompression::BFLOAT16);
+  Tensor precise = test::AsTensor<float>({1.0f + 1.0f / 1024});
+  test::ExpectTensorEqual<float>(test::AsTensor<float>({1.0}),
+                                 RoundTrip(compression, precise, &residuals));
+}
+
+TEST(TensorCompressionTest, OnlyFloatsAreCompressed) {
+  CompressionResiduals residuals;
+  Tensor val = test::AsTensor<int32>({1, 2, 3});
+  RecvTensorCompression compression;
+  compression.set_type(RecvTensorCompression::BFLOAT16);
+  Tensor payload;
+  RecvTensorResponse metadata;
+  CompressTensor(compression, val, "edge", &residuals, &payload, &metadata);
+  EXPECT_EQ(RecvTensorCompression::NONE, metadata.compression_type());
+  test::ExpectTensorEqual<int32>(val, payload);
+}
+
+TEST(TensorCompressionTest, TopKWithErrorFeedback) {
+  CompressionResiduals residuals;
+  RecvTensorCompression compression;
+  compression.set_type(RecvTensorCompression::TOP_K);
+  compression.set_top_k_fraction(0.5);
+  Tensor val = test::AsTensor<float>({1.0, -2.0, 3.0, 4.0}, {2, 2});
+
+  // The two values of largest magnitude are sent.
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({0.0, 0.0, 3.0, 4.0}, {2, 2}),
+      RoundTrip(compression, val, &residuals));
+  // The held back values are added to the next tensor: {2, -4, 3, 4}.
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({0.0, -4.0, 0.0, 4.0}, {2, 2}),
+      RoundTrip(compression, val, &residuals));
+  // Residual {2, 0, 3, 0} plus val: {3, -2, 6, 4}.
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({0.0, 0.0, 6.0, 4.0}, {2, 2}),
+      RoundTrip(compression, val, &residuals));
+
+  // A tensor of a new shape on the same edge starts without a residual.
+  Tensor other = test::AsTensor<float>({1.0, 5.0});
+  test::ExpectTensorEqual<float>(test::AsTensor<float>({0.0, 5.0}),
+                                 RoundTrip(compression, other, &residuals));
+}
+
+TEST(TensorCompressionTest, TopKEncodesOffsetDeltas) {
+  CompressionResiduals residuals;
+  RecvTensorCompression compression;
+  compression.set_type(RecvTensorCompression::TOP_K);
+  compression.set_top_k_fraction(0.375);
+  Tensor val =
+      test::AsTensor<float>({0.0, 9.0, 0.0, 0.0, -8.0, 0.0, 0.0, 7.0});
+  Tensor payload;
+  RecvTensorResponse metadata;
+  CompressTensor(compression, val, "edge", &residuals, &payload, &metadata);
+  test::ExpectTensorEqual<float>(test::AsTensor<float>({9.0, -8.0, 7.0}),
+                                 payload);
+  ASSERT_EQ(3, metadata.compressed_offset_deltas_size());
+  EXPECT_EQ(1, metadata.compressed_offset_deltas(0));
+  EXPECT_EQ(3, metadata.compressed_offset_deltas(1));
+  EXPECT_EQ(3, metadata.compressed_offset_deltas(2));
+}
+
+TEST(TensorCompressionTest, InvalidTopKOffsetsAreRejected) {
+  RecvTensorResponse metadata;
+  metadata.set_compression_type(RecvTensorCompression::TOP_K);
+  TensorShape({4}).AsProto(metadata.mutable_compressed_tensor_shape());
+  metadata.add_compressed_offset_deltas(2);
+  metadata.add_compressed_offset_deltas(2);
+  Tensor val = test::AsTensor<float>({1.0, 2.0});
+  EXPECT_FALSE(DecompressTensor(metadata, cpu_allocator(), &val).ok());
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -70,6 +70,10 @@ class WorkerCacheInterface {
                                       DeviceLocality* locality,
                                       StatusCallback done) = 0;
 
+  // Returns true if "target" names a task on the same host as this one,
+  // which may then exchange tensors with it through shared memory.
+  virtual bool IsSameHost(const string& target) { return false; }
+
   // Start/stop logging activity.
   virtual void SetLogging(bool active) {}
 
@@ -71,6 +71,12 @@ class WorkerCacheWrapper : public WorkerCacheInterface {
     return wrapped_->GetDeviceLocalityAsync(device, locality, std::move(done));
   }
 
+  // Returns true if "target" names a task on the same host as this one,
+  // which may then exchange tensors with it through shared memory.
+  virtual bool IsSameHost(const string& target) {
+    return wrapped_->IsSameHost(target);
+  }
+
   // Start/stop logging activity.
   virtual void SetLogging(bool active) { wrapped_->SetLogging(active); }
 
@@ -14,12 +14,18 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/distributed_runtime/worker_session.h"
 
+#include "tensorflow/core/lib/core/errors.h"
+
 namespace tensorflow {
 
 namespace {
 
 // A private cache that wraps worker_cache and allows reuse of
 // WorkerInterface objects.
+//
+// The wrapped cache can be replaced when the cluster of the session
+// changes. The replaced caches and their workers are kept until the
+// WorkerFreeListCache is deleted, since pending calls may still use them.
 class WorkerFreeListCache : public WorkerCacheInterface {
  public:
   explicit WorkerFreeListCache(std::unique_ptr<WorkerCacheInterface> w)
@@ -29,10 +35,25 @@ class WorkerFreeListCache : public WorkerCacheInterface {
     for (auto& p : workers_) {
       wrapped_->ReleaseWorker(p.first, p.second.worker);
     }
+    for (auto& retired : retired_) {
+      for (auto& p : retired.workers) {
+        retired.wrapped->ReleaseWorker(p.first, p.second.worker);
+      }
+    }
+  }
+
+  // Replaces the wrapped cache by 'w'. Workers created afterwards are
+  // obtained from 'w'.
+  void Update(std::unique_ptr<WorkerCacheInterface> w) {
+    mutex_lock l(mu_);
+    retired_.emplace_back();
+    retired_.back().wrapped = std::move(wrapped_);
+    retired_.back().workers.swap(workers_);
+    wrapped_ = std::move(w);
   }
 
   void ListWorkers(std::vector<string>* workers) const override {
-    wrapped_->ListWorkers(workers);
+    wrapped()->ListWorkers(workers);
   }
 
   WorkerInterface* CreateWorker(const string& target) override {
@@ -55,24 +76,32 @@ class WorkerFreeListCache : public WorkerCacheInterface {
 
   bool GetDeviceLocalityNonBlocking(const string& device,
                                     DeviceLocality* locality) override {
-    return wrapped_->GetDeviceLocalityNonBlocking(device, locality);
+    return wrapped()->GetDeviceLocalityNonBlocking(device, locality);
   }
 
   void GetDeviceLocalityAsync(const string& device, DeviceLocality* locality,
                               StatusCallback done) override {
-    wrapped_->GetDeviceLocalityAsync(device, locality, done);
+    wrapped()->GetDeviceLocalityAsync(device, locality, done);
+  }
+
+  bool IsSameHost(const string& target) override {
+    return wrapped()->IsSameHost(target);
   }
 
-  void SetLogging(bool active) override { wrapped_->SetLogging(active); }
+  void SetLogging(bool active) override { wrapped()->SetLogging(active); }
 
-  void ClearLogs() override { wrapped_->ClearLogs(); }
+  void ClearLogs() override { wrapped()->ClearLogs(); }
 
   bool RetrieveLogs(int64 step_id, StepStats* ss) override {
-    return wrapped_->RetrieveLogs(step_id, ss);
+    return wrapped()->RetrieveLogs(step_id, ss);
   }
 
  private:
-  std::unique_ptr<WorkerCacheInterface> wrapped_;
+  // Returns the current wrapped cache, which stays valid after an Update().
+  WorkerCacheInterface* wrapped() const {
+    mutex_lock l(mu_);
+    return wrapped_.get();
+  }
 
   // Information kept per created WorkerInterface.
   struct WorkerState {
@@ -80,9 +109,17 @@ class WorkerFreeListCache : public WorkerCacheInterface {
     // TODO(jeff,sanjay): Add reference count if we support eviction.
   };
 
+  // A wrapped cache replaced by Update(), and the workers created from it.
+  struct RetiredCache {
+    std::unique_ptr<WorkerCacheInterface> wrapped;
+    std::unordered_map<string, WorkerState> workers;
+  };
+
   // TODO(jeff,sanjay): Eviction when the map becomes too big.
-  mutex mu_;
+  mutable mutex mu_;
+  std::unique_ptr<WorkerCacheInterface> wrapped_ GUARDED_BY(mu_);
   std::unordered_map<string, WorkerState> workers_ GUARDED_BY(mu_);
+  std::vector<RetiredCache> retired_ GUARDED_BY(mu_);
 };
 
 }  // namespace
@@ -125,6 +162,18 @@ WorkerSession::WorkerSession(const string& session_name,
       device_mgr_(nullptr),
       borrowed_device_mgr_(borrowed_device_mgr) {}
 
+Status WorkerSession::UpdateWorkerCache(
+    std::unique_ptr<WorkerCacheInterface> new_worker_cache) {
+  if (session_name.empty()) {
+    return errors::InvalidArgument(
+        "The worker cache of the legacy session cannot be updated.");
+  }
+  // The constructors always wrap the worker cache in a WorkerFreeListCache.
+  static_cast<WorkerFreeListCache*>(worker_cache.get())
+      ->Update(std::move(new_worker_cache));
+  return Status::OK();
+}
+
 WorkerSession::~WorkerSession() {
   if (graph_mgr) {
     Status s = graph_mgr->DeregisterAll();
@@ -22,6 +22,7 @@ limitations under the License.
 #include "tensorflow/core/distributed_runtime/cluster_function_library_runtime.h"
 #include "tensorflow/core/distributed_runtime/graph_mgr.h"
 #include "tensorflow/core/distributed_runtime/worker_cache.h"
+#include "tensorflow/core/lib/core/status.h"
 
 namespace tensorflow {
 
@@ -67,6 +68,13 @@ struct WorkerSession {
       std::unique_ptr<WorkerCacheInterface> worker_cache,
       DeviceMgr* borrowed_device_mgr, std::unique_ptr<GraphMgr> graph_mgr);
 
+  // Replaces the worker cache of the session, when the cluster of the
+  // session changes. The devices, resources and registered graphs of the
+  // session are kept. Workers obtained from the previous cache stay valid
+  // until the session is deleted.
+  Status UpdateWorkerCache(
+      std::unique_ptr<WorkerCacheInterface> new_worker_cache);
+
   ~WorkerSession();
 
  private:
@@ -15,7 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/framework/rendezvous.h"
 
-#include <deque>
+#include <atomic>
 #include <functional>
 #include <utility>
 #include <vector>
@@ -155,41 +155,49 @@ class LocalRendezvousImpl : public Rendezvous {
     uint64 key_hash = KeyHash(key.FullKey());
     VLOG(2) << "Send " << this << " " << key_hash << " " << key.FullKey();
 
-    mu_.lock();
-    if (!status_.ok()) {
+    Shard* shard = GetShard(key_hash);
+    shard->mu.lock();
+    if (aborted_.load(std::memory_order_relaxed)) {
       // Rendezvous has been aborted.
-      Status s = status_;
-      mu_.unlock();
-      return s;
+      shard->mu.unlock();
+      return GetStatus();
     }
 
-    ItemQueue* queue = &table_[key_hash];
-    if (queue->empty() || queue->front()->IsSendValue()) {
+    auto it = shard->table.find(key_hash);
+    if (it == shard->table.end() || it->second.head->IsSendValue()) {
       // There is no waiter for this message. Append the message
       // into the queue. The waiter will pick it up when arrives.
       // Only send-related fields need to be filled.
-      Item* item = new Item;
+      Item* item = shard->NewItem();
       item->value = val;
       item->is_dead = is_dead;
       item->send_args = send_args;
       if (item->send_args.device_context) {
         item->send_args.device_context->Ref();
       }
-      queue->push_back(item);
-      mu_.unlock();
+      if (it == shard->table.end()) {
+        shard->table[key_hash].Push(item);
+      } else {
+        it->second.Push(item);
+      }
+      shard->mu.unlock();
       return Status::OK();
     }
 
-    // There is an earliest waiter to consume this message.
-    Item* item = queue->front();
-    queue->pop_front();
-    mu_.unlock();
+    // There is an earliest waiter to consume this message.  Takes its
+    // closure and arguments and recycles the item before releasing the lock.
+    Item* item = it->second.Pop();
+    if (it->second.empty()) shard->table.erase(it);
+    DoneCallback waiter = std::move(item->waiter);
+    Args recv_args = item->recv_args;
+    item->recv_args.device_context = nullptr;
+    shard->FreeItem(item);
+    shard->mu.unlock();
 
     // Notify the waiter by invoking its done closure, outside the
     // lock.
-    DCHECK(!item->IsSendValue());
-    item->waiter(Status::OK(), send_args, item->recv_args, val, is_dead);
-    delete item;
+    waiter(Status::OK(), send_args, recv_args, val, is_dead);
+    if (recv_args.device_context) recv_args.device_context->Unref();
     return Status::OK();
   }
 
@@ -198,57 +206,76 @@ class LocalRendezvousImpl : public Rendezvous {
     uint64 key_hash = KeyHash(key.FullKey());
     VLOG(2) << "Recv " << this << " " << key_hash << " " << key.FullKey();
 
-    mu_.lock();
-    if (!status_.ok()) {
+    Shard* shard = GetShard(key_hash);
+    shard->mu.lock();
+    if (aborted_.load(std::memory_order_relaxed)) {
       // Rendezvous has been aborted.
-      Status s = status_;
-      mu_.unlock();
-      done(s, Args(), recv_args, Tensor(), false);
+      shard->mu.unlock();
+      done(GetStatus(), Args(), recv_args, Tensor(), false);
       return;
     }
 
-    ItemQueue* queue = &table_[key_hash];
-    if (queue->empty() || !queue->front()->IsSendValue()) {
+    auto it = shard->table.find(key_hash);
+    if (it == shard->table.end() || !it->second.head->IsSendValue()) {
       // There is no message to pick up.
       // Only recv-related fields need to be filled.
-      Item* item = new Item;
+      Item* item = shard->NewItem();
       item->waiter = std::move(done);
       item->recv_args = recv_args;
       if (item->recv_args.device_context) {
         item->recv_args.device_context->Ref();
       }
-      queue->push_back(item);
-      mu_.unlock();
+      if (it == shard->table.end()) {
+        shard->table[key_hash].Push(item);
+      } else {
+        it->second.Push(item);
+      }
+      shard->mu.unlock();
       return;
     }
 
     // A message has already arrived and is queued in the table under
-    // this key.  Consumes the message and invokes the done closure.
-    Item* item = queue->front();
-    queue->pop_front();
-    mu_.unlock();
+    // this key.  Consumes the message, recycles its item and invokes the
+    // done closure.  This is the common case of a producer that runs ahead
+    // of its consumer, and takes a single lock acquisition.
+    Item* item = it->second.Pop();
+    if (it->second.empty()) shard->table.erase(it);
+    Tensor value = std::move(item->value);
+    const bool value_is_dead = item->is_dead;
+    Args send_args = item->send_args;
+    item->send_args.device_context = nullptr;
+    shard->FreeItem(item);
+    shard->mu.unlock();
 
     // Invokes the done() by invoking its done closure, outside scope
     // of the table lock.
-    DCHECK(item->IsSendValue());
-    done(Status::OK(), item->send_args, recv_args, item->value, item->is_dead);
-    delete item;
+    done(Status::OK(), send_args, recv_args, value, value_is_dead);
+    if (send_args.device_context) send_args.device_context->Unref();
   }
 
   void StartAbort(const Status& status) override {
     CHECK(!status.ok());
-    Table table;
     {
-      mutex_lock l(mu_);
+      mutex_lock l(status_mu_);
       status_.Update(status);
-      table_.swap(table);
     }
-    for (auto& p : table) {
-      for (Item* item : p.second) {
-        if (!item->IsSendValue()) {
-          item->waiter(status, Args(), Args(), Tensor(), false);
+    // Every Send() or RecvAsync() that locks a shard after it has been swept
+    // below sees aborted_, and every item queued before is swept.
+    aborted_.store(true, std::memory_order_relaxed);
+    for (Shard& shard : shards_) {
+      Table table;
+      {
+        mutex_lock l(shard.mu);
+        shard.table.swap(table);
+      }
+      for (auto& p : table) {
+        while (!p.second.empty()) {
+          Item* item = p.second.Pop();
+          if (!item->IsSendValue()) {
+            item->waiter(status, Args(), Args(), Tensor(), false);
+          }
+          delete item;
         }
-        delete item;
       }
     }
   }
@@ -262,6 +289,7 @@ class LocalRendezvousImpl : public Rendezvous {
     bool is_dead = false;
     Args send_args;
     Args recv_args;
+    Item* next = nullptr;
 
     ~Item() {
       if (send_args.device_context) {
@@ -281,22 +309,106 @@ class LocalRendezvousImpl : public Rendezvous {
     return Hash64(k.data(), k.size());
   }
 
-  // By invariant, the item queue under each key is of the form
+  // A FIFO queue of items linked through Item::next.  By invariant, the
+  // item queue under each key is of the form
   //   [item.IsSendValue()]* meaning each item is a sent message.
   // or
   //   [!item.IsSendValue()]* meaning each item is a waiter.
-  //
-  // TODO(zhifengc): consider a better queue impl than std::deque.
-  typedef std::deque<Item*> ItemQueue;
+  // Empty queues are removed from the table.
+  struct ItemQueue {
+    Item* head = nullptr;
+    Item* tail = nullptr;
+
+    bool empty() const { return head == nullptr; }
+    void Push(Item* item) {
+      if (tail == nullptr) {
+        head = item;
+      } else {
+        tail->next = item;
+      }
+      tail = item;
+    }
+    Item* Pop() {
+      Item* item = head;
+      head = item->next;
+      if (head == nullptr) tail = nullptr;
+      item->next = nullptr;
+      return item;
+    }
+  };
   typedef gtl::FlatMap<uint64, ItemQueue> Table;
 
-  // TODO(zhifengc): shard table_.
-  mutex mu_;
-  Table table_ GUARDED_BY(mu_);
-  Status status_ GUARDED_BY(mu_);
+  // The table is split into shards by key hash, each with its own lock, so
+  // that transfers between different pairs of devices rarely contend.  Each
+  // shard recycles up to kMaxFreeItems items to avoid an allocation per
+  // transfer.
+  static const int kNumShards = 16;
+  static const int kMaxFreeItems = 64;
+
+  struct Shard {
+    mutex mu;
+    Table table GUARDED_BY(mu);
+    Item* free_items GUARDED_BY(mu) = nullptr;
+    int num_free_items GUARDED_BY(mu) = 0;
+
+    Item* NewItem() EXCLUSIVE_LOCKS_REQUIRED(mu) {
+      if (free_items == nullptr) return new Item;
+      Item* item = free_items;
+      free_items = item->next;
+      item->next = nullptr;
+      --num_free_items;
+      return item;
+    }
+
+    // REQUIRES: The waiter and the device contexts of 'item' have been
+    // moved out.
+    void FreeItem(Item* item) EXCLUSIVE_LOCKS_REQUIRED(mu) {
+      if (num_free_items >= kMaxFreeItems) {
+        delete item;
+        return;
+      }
+      item->waiter = nullptr;
+      item->value = Tensor();
+      item->is_dead = false;
+      item->send_args = Args();
+      item->recv_args = Args();
+      item->next = free_items;
+      free_items = item;
+      ++num_free_items;
+    }
+
+    ~Shard() {
+      while (free_items != nullptr) {
+        Item* item = free_items;
+        free_items = item->next;
+        delete item;
+      }
+    }
+  };
+
+  Shard* GetShard(uint64 key_hash) {
+    // The table of each shard hashes the low bits of the key hash.
+    return &shards_[(key_hash >> 32) % kNumShards];
+  }
+
+  Status GetStatus() {
+    mutex_lock l(status_mu_);
+    return status_;
+  }
+
+  Shard shards_[kNumShards];
+  // Set once status_ is not OK.  Read under the lock of a shard.
+  std::atomic<bool> aborted_{false};
+  mutex status_mu_;
+  Status status_ GUARDED_BY(status_mu_);
 
   ~LocalRendezvousImpl() override {
-    if (!table_.empty()) {
+    bool empty = true;
+    for (Shard& shard : shards_) {
+      mutex_lock l(shard.mu);
+      empty = empty && shard.table.empty();
+    }
+    if (!empty) {
       StartAbort(errors::Cancelled("LocalRendezvousImpl deleted"));
     }
   }
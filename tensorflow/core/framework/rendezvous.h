@@ -48,6 +48,14 @@ class Rendezvous : public core::RefCounted {
   struct Args {
     DeviceContext* device_context = nullptr;
     AllocatorAttributes alloc_attrs;
+    // Lossy compression that a remote sender may apply to the tensor, from
+    // the "_wire_compression" attr of the Recv node. Empty for lossless
+    // transfer. Only interpreted by remote rendezvous implementations.
+    string wire_compression;
+    // If > 0, the receiver may be given a value of the tensor from one of
+    // this many earlier steps, from the "_prefetch_staleness" attr of the
+    // Recv node. Only interpreted by remote rendezvous implementations.
+    int32 prefetch_staleness = 0;
   };
 
   // Constructs a rendezvous key for the tensor of "name" sent from
@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
@@ -272,6 +273,31 @@ TEST_F(LocalRendezvousTest, AbortThenRecvOrSend) {
       errors::IsAborted(rendez_->Recv(KeyFoo(), args, &val, &val_dead)));
 }
 
+TEST_F(LocalRendezvousTest, AbortCancelsWaitersOfAllKeys) {
+  static const int N = 100;
+  BlockingState state;
+  state.counter = N;
+  for (int i = 0; i < N; ++i) {
+    rendez_->RecvAsync(
+        MakeKey(strings::StrCat(i)), Rendezvous::Args(),
+        [&state](const Status& status, const Rendezvous::Args& sender_args,
+                 const Rendezvous::Args& recver_args, const Tensor& val,
+                 const bool val_dead) {
+          EXPECT_TRUE(errors::IsAborted(status));
+          mutex_lock l(state.lock);
+          if (--state.counter == 0) state.done.Notify();
+        });
+  }
+  // Queued sends are dropped too.
+  TF_ASSERT_OK(rendez_->Send(KeyFoo(), Rendezvous::Args(), V("x"), false));
+  rendez_->StartAbort(errors::Aborted(""));
+  state.done.WaitForNotification();
+  Tensor val;
+  bool val_dead;
+  EXPECT_TRUE(errors::IsAborted(
+      rendez_->Recv(KeyFoo(), Rendezvous::Args(), &val, &val_dead)));
+}
+
 class DummyDeviceContext : public DeviceContext {
  public:
   explicit DummyDeviceContext(int stream_id) : stream_id_(stream_id) {}
@@ -324,6 +350,39 @@ void BM_SendRecv(int iters) {
 }
 BENCHMARK(BM_SendRecv);
 
+// Each of 'threads' threads sends and receives iters / threads tensors
+// under its own key, so that the threads only contend on the rendezvous.
+void BM_SendRecvContended(int iters, int threads) {
+  testing::StopTiming();
+  Rendezvous* rendez = NewLocalRendezvous();
+  std::vector<Rendezvous::ParsedKey> keys;
+  for (int t = 0; t < threads; ++t) {
+    keys.push_back(MakeKey(strings::StrCat("key", t)));
+  }
+  Tensor orig = V("val");
+  BlockingCounter done(threads);
+  thread::ThreadPool* pool =
+      new thread::ThreadPool(Env::Default(), "test", threads);
+  testing::StartTiming();
+  for (int t = 0; t < threads; ++t) {
+    pool->Schedule([rendez, &keys, &orig, &done, iters, threads, t]() {
+      Tensor val(DT_STRING, TensorShape({}));
+      bool is_dead = false;
+      Rendezvous::Args args;
+      for (int i = t; i < iters; i += threads) {
+        TF_CHECK_OK(rendez->Send(keys[t], args, orig, is_dead));
+        TF_CHECK_OK(rendez->Recv(keys[t], args, &val, &is_dead));
+      }
+      done.DecrementCount();
+    });
+  }
+  done.Wait();
+  testing::StopTiming();
+  delete pool;
+  rendez->Unref();
+}
+BENCHMARK(BM_SendRecvContended)->Arg(1)->Arg(4)->Arg(16);
+
 void BM_PingPong(int iters) {
   CHECK_GT(iters, 0);
   thread::ThreadPool* pool = new thread::ThreadPool(Env::Default(), "test", 1);
@@ -41,6 +41,7 @@ class TensorBuffer;
 class TensorCApi;
 class TensorDescription;
 class TensorProto;
+class TensorResponse;
 class VariantTensorData;
 namespace batch_util {
 Status CopyElementToSlice(Tensor element, Tensor* parent, int64 index);
@@ -501,6 +502,8 @@ class Tensor {
 
   friend class NumpyTensorBuffer;  // For access to the private constructor
                                    // taking the buffer.
+  friend class TensorResponse;     // For access to the private constructor
+                                   // taking the buffer.
 
   // Creates a tensor with the input datatype, shape and buf.
   //
@@ -235,6 +235,21 @@ NodeDef* AddSend(const PartitionOptions& opts, const GraphInfo& g_info,
   return send;
 }
 
+// Returns true if "src" outputs the value of a variable: a Variable or
+// VariableV2 node, a ReadVariableOp, or an Identity (e.g. "var/read") of a
+// Variable or VariableV2 node.
+bool IsVariableRead(const Node* src) {
+  if (src->IsVariable() || src->type_string() == "ReadVariableOp") {
+    return true;
+  }
+  if (src->IsIdentity()) {
+    for (const Edge* in : src->in_edges()) {
+      if (!in->IsControlEdge()) return in->src()->IsVariable();
+    }
+  }
+  return false;
+}
+
 NodeDef* AddRecv(const PartitionOptions& opts, const GraphInfo& g_info,
                  GraphDef* gdef, const Edge* edge, NodeDef** real_recv,
                  Status* status) {
@@ -263,6 +278,19 @@ NodeDef* AddRecv(const PartitionOptions& opts, const GraphInfo& g_info,
   SetSendRecvAttrs(opts, edge, &recv_builder);
   recv_builder.Device(dst->assigned_device_name())
       .Attr("tensor_type", cast_dtype);
+  // The receiver requests the wire compression chosen for the source.
+  string wire_compression;
+  if (!edge->IsControlEdge() &&
+      GetNodeAttr(src->attrs(), "_wire_compression", &wire_compression).ok()) {
+    recv_builder.Attr("_wire_compression", wire_compression);
+  }
+  // Only values received from another task are worth prefetching.
+  if (opts.variable_prefetch_staleness > 0 && !edge->IsControlEdge() &&
+      IsVariableRead(src) &&
+      !DeviceNameUtils::IsSameAddressSpace(src->assigned_device_name(),
+                                           dst->assigned_device_name())) {
+    recv_builder.Attr("_prefetch_staleness", opts.variable_prefetch_staleness);
+  }
   NodeDef* recv = gdef->add_node();
   *status = recv_builder.Finalize(recv);
   if (!status->ok()) return nullptr;
@@ -66,6 +66,11 @@ struct PartitionOptions {
   typedef std::function<DataType(const Edge*)> ShouldCastFunc;
   ShouldCastFunc should_cast = nullptr;
 
+  // If > 0, Recv nodes that receive the value of a variable from another
+  // task are marked with a "_prefetch_staleness" attr of this value, which
+  // allows the receiver to use a value received in an earlier step.
+  int32 variable_prefetch_staleness = 0;
+
   // Schedule the execution of the recvs based on their start times
   // computed by some scheduling algorithm. The recvs are divided into
   // epochs based on their start times. A recv is enabled only when
@@ -15,12 +15,16 @@ limitations under the License.
 
 #include "tensorflow/core/grappler/costs/graph_properties.h"
 
+#include <algorithm>
+#include <functional>
+#include <map>
 #include <queue>
 #include <unordered_map>
 #include <unordered_set>
 #include "tensorflow/core/framework/common_shape_fns.h"
 #include "tensorflow/core/framework/function.pb.h"
 #include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/graph/graph_constructor.h"
@@ -29,7 +33,11 @@ limitations under the License.
 #include "tensorflow/core/grappler/op_types.h"
 #include "tensorflow/core/grappler/utils.h"
 #include "tensorflow/core/grappler/utils/topological_sort.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/cpu_info.h"
 
 namespace tensorflow {
 namespace grappler {
@@ -40,6 +48,17 @@ using shape_inference::InferenceContext;
 using shape_inference::ShapeAndType;
 using shape_inference::ShapeHandle;
 
+// Input tensors with more elements, e.g. weights, are only part of the
+// signature of a node in the shape inference cache when its shape function
+// doesn't read them, and longer signatures aren't cached.
+constexpr int64 kMaxSignatureTensorSize = 64;
+constexpr int kMaxSignatureSize = 2048;
+// The cache is reset when it grows larger.
+constexpr int kMaxShapeInferenceCacheSize = 1 << 14;
+
+// Smaller graphs are inferred on a single thread.
+constexpr int kMinNodesForParallelInference = 1024;
+
 template <typename Handle>
 struct HashHandle {
   std::size_t operator()(const Handle& h) const { return h.Handle(); }
@@ -343,8 +362,122 @@ void VerboseLogUnknownDimensionSources(
   }
 }
 
+// Assigns the weakly connected components of the graph to at most
+// `max_partitions` partitions of balanced sizes. No shape propagates from a
+// partition to another, so they can be inferred independently. Returns the
+// number of partitions and the partition of each node in `partitions`.
+int PartitionIndependentSubgraphs(const GraphDef& graph, int max_partitions,
+                                  std::vector<int>* partitions) {
+  const int num_nodes = graph.node_size();
+  std::unordered_map<string, int> node_index;
+  node_index.reserve(num_nodes);
+  for (int i = 0; i < num_nodes; ++i) {
+    node_index[graph.node(i).name()] = i;
+  }
+  std::vector<int> parent(num_nodes);
+  for (int i = 0; i < num_nodes; ++i) {
+    parent[i] = i;
+  }
+  auto find = [&parent](int i) {
+    while (parent[i] != i) {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+    return i;
+  };
+  for (int i = 0; i < num_nodes; ++i) {
+    for (const string& input : graph.node(i).input()) {
+      auto it = node_index.find(NodeName(input));
+      if (it != node_index.end()) {
+        parent[find(it->second)] = find(i);
+      }
+    }
+  }
+
+  std::unordered_map<int, int> component_sizes;
+  for (int i = 0; i < num_nodes; ++i) {
+    ++component_sizes[find(i)];
+  }
+  std::vector<std::pair<int, int>> components;  // (size, root)
+  components.reserve(component_sizes.size());
+  for (const auto& component : component_sizes) {
+    components.emplace_back(component.second, component.first);
+  }
+  std::sort(components.begin(), components.end(),
+            std::greater<std::pair<int, int>>());
+
+  // Assign the largest remaining component to the smallest partition.
+  const int num_partitions =
+      std::min<int>(max_partitions, std::max<int>(1, components.size()));
+  std::vector<int> partition_sizes(num_partitions, 0);
+  std::unordered_map<int, int> root_partition;
+  for (const auto& component : components) {
+    const int partition =
+        std::min_element(partition_sizes.begin(), partition_sizes.end()) -
+        partition_sizes.begin();
+    partition_sizes[partition] += component.first;
+    root_partition[component.second] = partition;
+  }
+  partitions->resize(num_nodes);
+  for (int i = 0; i < num_nodes; ++i) {
+    (*partitions)[i] = root_partition[find(i)];
+  }
+  return num_partitions;
+}
+
+// Returns the threads shared by all the parallel shape inferences, which are
+// only started by the first one.
+thread::ThreadPool* ShapeInferenceThreadPool() {
+  static thread::ThreadPool* const pool = new thread::ThreadPool(
+      Env::Default(), "infer_shapes", port::NumSchedulableCPUs());
+  return pool;
+}
+
 }  // namespace
 
+ShapeInferenceCache* ShapeInferenceCache::Global() {
+  static ShapeInferenceCache* cache = new ShapeInferenceCache;
+  return cache;
+}
+
+bool ShapeInferenceCache::Lookup(const string& signature, Entry* entry) {
+  mutex_lock l(mu_);
+  auto it = entries_.find(signature);
+  if (it == entries_.end()) {
+    ++num_misses_;
+    return false;
+  }
+  ++num_hits_;
+  *entry = it->second;
+  return true;
+}
+
+void ShapeInferenceCache::Insert(const string& signature, const Entry& entry) {
+  mutex_lock l(mu_);
+  if (entries_.size() >= kMaxShapeInferenceCacheSize) {
+    VLOG(1) << "Resetting the shape inference cache";
+    entries_.clear();
+  }
+  entries_[signature] = entry;
+}
+
+void ShapeInferenceCache::Clear() {
+  mutex_lock l(mu_);
+  entries_.clear();
+  num_hits_ = 0;
+  num_misses_ = 0;
+}
+
+int64 ShapeInferenceCache::num_hits() const {
+  mutex_lock l(mu_);
+  return num_hits_;
+}
+
+int64 ShapeInferenceCache::num_misses() const {
+  mutex_lock l(mu_);
+  return num_misses_;
+}
+
 // Queue of nodes to process. Nodes can be enqueued in any order, but will be
 // dequeued in (roughly) topological order. Propagating shapes following a
 // topological ordering isn't required for correctness but helps speed things up
@@ -408,6 +541,9 @@ class SymbolicShapeRefiner {
     DataTypeVector output_types;
     std::unique_ptr<InferenceContext> inference_context;
     std::vector<ShapeHandle> output_tensors_as_shapes;
+    // The inputs read as partial shapes by the shape function whose outputs
+    // were taken from the shape inference cache.
+    std::vector<bool> requested_input_tensors_as_shapes;
   };
 
   NodeContext* GetNodeContext(const NodeDef* node) {
@@ -531,8 +667,9 @@ class SymbolicShapeRefiner {
                                     c->inference_context->output(src_output));
 
         if (!*refined &&
-            inference_context->requested_input_tensor_as_partial_shape(
-                dst_input)) {
+            (inference_context->requested_input_tensor_as_partial_shape(
+                 dst_input) ||
+             node_context->requested_input_tensors_as_shapes[dst_input])) {
           // The input value may have changed. Since we have no way to know if
           // that's indeed the case, err on the safe side.
           *refined = true;
@@ -711,6 +848,7 @@ class SymbolicShapeRefiner {
         graph_def_version_, node, node_ctx.op_data->op_def, input_shapes,
         input_tensors, input_tensors_as_shapes,
         std::move(input_handle_shapes_and_types)));
+    node_ctx.requested_input_tensors_as_shapes.assign(num_inputs, false);
     const Status s = node_ctx.inference_context->construction_status();
     if (!s.ok()) {
       node_ctx.inference_context.reset(nullptr);
@@ -894,8 +1032,20 @@ class SymbolicShapeRefiner {
       return c->inference_context->Run(shape_inference::UnknownShape);
     }
 
-    TF_RETURN_IF_ERROR(
-        c->inference_context->Run(c->op_data->shape_inference_fn));
+    string signature;
+    std::vector<bool> input_tensors_in_signature;
+    const bool cacheable =
+        GetSignature(node, *c, &signature, &input_tensors_in_signature);
+    ShapeInferenceCache::Entry entry;
+    if (cacheable && ShapeInferenceCache::Global()->Lookup(signature, &entry)) {
+      TF_RETURN_IF_ERROR(SetCachedOutputShapes(entry, c));
+    } else {
+      TF_RETURN_IF_ERROR(
+          c->inference_context->Run(c->op_data->shape_inference_fn));
+      if (cacheable) {
+        CacheOutputShapes(signature, input_tensors_in_signature, *c);
+      }
+    }
 
     Status status = Status::OK();
     if (is_fed) {
@@ -909,6 +1059,159 @@ class SymbolicShapeRefiner {
     return status;
   }
 
+  // Appends the dimensions of a fully defined shape to `signature`. Returns
+  // false if the shape isn't fully defined.
+  static bool AppendShape(InferenceContext* ic, ShapeHandle shape,
+                          string* signature) {
+    if (!ic->FullyDefined(shape)) {
+      return false;
+    }
+    strings::StrAppend(signature, "[");
+    for (int d = 0; d < ic->Rank(shape); ++d) {
+      strings::StrAppend(signature, ic->Value(ic->Dim(shape, d)), ",");
+    }
+    strings::StrAppend(signature, "]");
+    return true;
+  }
+
+  // Computes the signature of the node in the shape inference cache, i.e.
+  // everything its shape function can read: its op, attributes, input shapes
+  // and input tensors. Returns false if the node can't be cached, e.g. if an
+  // input shape isn't fully defined, since the symbolic dimensions are
+  // specific to this graph. The large input tensors are left out of the
+  // signature, and marked in `input_tensors_in_signature`.
+  bool GetSignature(const NodeDef& node, const NodeContext& c,
+                    string* signature,
+                    std::vector<bool>* input_tensors_in_signature) const {
+    for (const DataType type : c.input_types) {
+      if (type == DT_RESOURCE || type == DT_VARIANT) {
+        return false;
+      }
+    }
+    for (const DataType type : c.output_types) {
+      if (type == DT_RESOURCE || type == DT_VARIANT) {
+        return false;
+      }
+    }
+    strings::StrAppend(signature, graph_def_version_, ";", node.op(), ";");
+    std::map<string, const AttrValue*> attrs;
+    for (const auto& attr : node.attr()) {
+      // Don't serialize large attributes, e.g. the values of constants.
+      if (attr.second.ByteSizeLong() > kMaxSignatureSize) {
+        return false;
+      }
+      attrs[attr.first] = &attr.second;
+    }
+    for (const auto& attr : attrs) {
+      string serialized;
+      if (!SerializeToStringDeterministic(*attr.second, &serialized)) {
+        return false;
+      }
+      strings::StrAppend(signature, attr.first, "=", serialized.size(), ":",
+                         serialized, ";");
+      if (signature->size() > kMaxSignatureSize) {
+        return false;
+      }
+    }
+
+    InferenceContext* ic = c.inference_context.get();
+    const auto& input_tensors_as_shapes = ic->input_tensors_as_shapes();
+    input_tensors_in_signature->assign(ic->num_inputs(), false);
+    for (int i = 0; i < ic->num_inputs(); ++i) {
+      if (!AppendShape(ic, ic->input(i), signature)) {
+        return false;
+      }
+      const Tensor* tensor = ic->input_tensor(i);
+      if (tensor == nullptr) {
+        strings::StrAppend(signature, "-");
+      } else if (tensor->NumElements() > kMaxSignatureTensorSize) {
+        strings::StrAppend(signature, "+");
+      } else {
+        TensorProto proto;
+        tensor->AsProtoTensorContent(&proto);
+        string serialized;
+        proto.SerializeToString(&serialized);
+        strings::StrAppend(signature, "=", serialized.size(), ":", serialized);
+        (*input_tensors_in_signature)[i] = true;
+      }
+      // Shapes of unknown rank are ignored by the shape functions.
+      ShapeHandle shape;
+      if (i < input_tensors_as_shapes.size()) {
+        shape = input_tensors_as_shapes[i];
+      }
+      if (!ic->RankKnown(shape)) {
+        strings::StrAppend(signature, "-");
+      } else if (!AppendShape(ic, shape, signature)) {
+        return false;
+      }
+      strings::StrAppend(signature, ";");
+    }
+    return signature->size() <= kMaxSignatureSize;
+  }
+
+  // Caches the output shapes that the shape function of the node just
+  // inferred, unless they depend on more than the signature.
+  void CacheOutputShapes(const string& signature,
+                         const std::vector<bool>& input_tensors_in_signature,
+                         const NodeContext& c) const {
+    InferenceContext* ic = c.inference_context.get();
+    ShapeInferenceCache::Entry entry;
+    for (int i = 0; i < ic->num_inputs(); ++i) {
+      if (ic->requested_input_tensor(i) && ic->input_tensor(i) != nullptr &&
+          !input_tensors_in_signature[i]) {
+        return;
+      }
+      entry.requested_input_tensors_as_shapes.push_back(
+          ic->requested_input_tensor_as_partial_shape(i));
+    }
+    for (int i = 0; i < ic->num_outputs(); ++i) {
+      if (ic->output_handle_shapes_and_types(i) != nullptr) {
+        return;
+      }
+      const ShapeHandle shape = ic->output(i);
+      if (!ic->RankKnown(shape)) {
+        entry.output_shapes.emplace_back();
+        continue;
+      }
+      // The unknown dimensions of the outputs may be shared, e.g. between the
+      // outputs of Unique, which the cache can't represent.
+      if (!ic->FullyDefined(shape)) {
+        return;
+      }
+      std::vector<int64> dims(ic->Rank(shape));
+      for (int d = 0; d < dims.size(); ++d) {
+        dims[d] = ic->Value(ic->Dim(shape, d));
+      }
+      entry.output_shapes.emplace_back(dims);
+    }
+    ShapeInferenceCache::Global()->Insert(signature, entry);
+  }
+
+  Status SetCachedOutputShapes(const ShapeInferenceCache::Entry& entry,
+                               NodeContext* c) {
+    InferenceContext* ic = c->inference_context.get();
+    if (entry.output_shapes.size() != ic->num_outputs() ||
+        entry.requested_input_tensors_as_shapes.size() != ic->num_inputs()) {
+      return errors::Internal("Invalid shape inference cache entry for ",
+                              ic->num_inputs(), " inputs and ",
+                              ic->num_outputs(), " outputs");
+    }
+    for (int i = 0; i < ic->num_outputs(); ++i) {
+      ShapeHandle shape;
+      TF_RETURN_IF_ERROR(
+          ic->MakeShapeFromPartialTensorShape(entry.output_shapes[i], &shape));
+      // Keep the current handle if the shape didn't change, so that the
+      // fanout of the node isn't refined again.
+      if (!ic->RankKnown(ic->output(i)) ||
+          !EquivalentShapes(ic->output(i), shape)) {
+        ic->set_output(i, shape);
+      }
+    }
+    c->requested_input_tensors_as_shapes =
+        entry.requested_input_tensors_as_shapes;
+    return Status::OK();
+  }
+
  private:
   const GraphView& graph_;
   int graph_def_version_;
@@ -1281,26 +1584,71 @@ Status GraphProperties::InferStatically(bool assume_valid_feeds) {
     }
   }
 
-  SymbolicShapeRefiner refiner(graph_view, fed_ports);
+  // Split the graph into independent subgraphs, whose shapes are propagated
+  // in parallel by separate refiners.
+  const int num_nodes = item_.graph.node_size();
+  int num_partitions = 1;
+  std::vector<int> partitions(num_nodes, 0);
+  if (num_nodes >= kMinNodesForParallelInference) {
+    num_partitions = PartitionIndependentSubgraphs(
+        item_.graph, port::NumSchedulableCPUs(), &partitions);
+  }
+  std::unordered_map<const NodeDef*, int> node_partitions;
+  node_partitions.reserve(num_nodes);
+  for (int i = 0; i < num_nodes; ++i) {
+    node_partitions[&item_.graph.node(i)] = partitions[i];
+  }
 
-  TopoQueue new_shapes(topo_order);
+  std::vector<std::unique_ptr<SymbolicShapeRefiner>> refiners;
+  std::vector<std::unique_ptr<TopoQueue>> new_shapes;
+  for (int i = 0; i < num_partitions; ++i) {
+    refiners.emplace_back(new SymbolicShapeRefiner(graph_view, fed_ports));
+    new_shapes.emplace_back(new TopoQueue(topo_order));
+  }
   // Also seed the propagation of shapes in the fanout of primary inputs.
   for (const NodeDef* node : primary_inputs) {
-    new_shapes.push(node);
+    new_shapes[node_partitions[node]]->push(node);
   }
   // Also seed the propagation of shapes in the fanout of fed nodes.
   for (const NodeDef* node : fed_nodes) {
-    new_shapes.push(node);
+    new_shapes[node_partitions[node]]->push(node);
   }
   // Propagate shapes normally.
-  TF_RETURN_IF_ERROR(
-      PropagateShapes(&refiner, &new_shapes, resource_handles, num_loops));
+  std::vector<Status> statuses(num_partitions);
+  auto propagate = [&](int i) {
+    statuses[i] = PropagateShapes(refiners[i].get(), new_shapes[i].get(),
+                                  resource_handles, num_loops);
+  };
+  // Waiting for the pool from one of its own threads could deadlock, so a
+  // nested inference runs on the calling thread.
+  if (num_partitions > 1 &&
+      ShapeInferenceThreadPool()->CurrentThreadId() < 0) {
+    VLOG(1) << "Inferring the shapes of " << num_partitions
+            << " independent subgraphs in parallel";
+    BlockingCounter counter(num_partitions - 1);
+    for (int i = 1; i < num_partitions; ++i) {
+      ShapeInferenceThreadPool()->Schedule([&propagate, &counter, i]() {
+        propagate(i);
+        counter.DecrementCount();
+      });
+    }
+    propagate(0);
+    counter.Wait();
+  } else {
+    for (int i = 0; i < num_partitions; ++i) {
+      propagate(i);
+    }
+  }
+  for (const Status& status : statuses) {
+    TF_RETURN_IF_ERROR(status);
+  }
 
   // Track shapes globally across the graph.
   SymbolicShapeManager shape_manager;
   bool found_error = false;
-  for (const NodeDef& node : item_.graph.node()) {
-    auto node_ctx = refiner.GetContext(&node);
+  for (int i = 0; i < num_nodes; ++i) {
+    const NodeDef& node = item_.graph.node(i);
+    auto node_ctx = refiners[partitions[i]]->GetContext(&node);
     if (!node_ctx) {
       continue;
     }
@@ -1330,9 +1678,10 @@ Status GraphProperties::InferStatically(bool assume_valid_feeds) {
     }
   }
 
-  for (const NodeDef& node : item_.graph.node()) {
+  for (int node_index = 0; node_index < num_nodes; ++node_index) {
+    const NodeDef& node = item_.graph.node(node_index);
     VLOG(3) << "Filling in graph properties for node: " << node.name();
-    auto ctx = refiner.GetNodeContext(&node);
+    auto ctx = refiners[partitions[node_index]]->GetNodeContext(&node);
     if (!ctx) {
       continue;
     }
@@ -18,10 +18,13 @@ limitations under the License.
 
 #include <unordered_map>
 #include <vector>
+#include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/shape_inference.h"
 #include "tensorflow/core/grappler/clusters/cluster.h"
 #include "tensorflow/core/grappler/costs/op_performance_data.pb.h"
 #include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
 
 namespace tensorflow {
 
@@ -30,6 +33,37 @@ namespace grappler {
 class SymbolicShapeRefiner;
 class TopoQueue;
 
+// Caches the output shapes that shape functions infer for nodes whose input
+// shapes are fully defined, keyed by the signature of the node: its op,
+// attributes, input shapes, and the values of the small input tensors. The
+// cache is shared by all the GraphProperties of the process, so that the
+// shape functions of such nodes run once for all the optimizer passes of a
+// session and for all the sessions that load the same graph.
+class ShapeInferenceCache {
+ public:
+  struct Entry {
+    // Fully defined shapes, or shapes of unknown rank.
+    std::vector<PartialTensorShape> output_shapes;
+    // The inputs that the shape function read as partial shapes.
+    std::vector<bool> requested_input_tensors_as_shapes;
+  };
+
+  static ShapeInferenceCache* Global();
+
+  bool Lookup(const string& signature, Entry* entry);
+  void Insert(const string& signature, const Entry& entry);
+  void Clear();
+
+  int64 num_hits() const;
+  int64 num_misses() const;
+
+ private:
+  mutable mutex mu_;
+  std::unordered_map<string, Entry> entries_ GUARDED_BY(mu_);
+  int64 num_hits_ GUARDED_BY(mu_) = 0;
+  int64 num_misses_ GUARDED_BY(mu_) = 0;
+};
+
 // Infer OpInfo::TensorProperties for graph nodes inputs/outputs.
 //
 // Typical use case, is to infer tensor properties from a graph, before doing
@@ -46,6 +80,8 @@ class GraphProperties {
   // However, it can help infer shapes in the fanout of fed nodes (even though
   // the correctness of these shapes can't be guaranteed), so in some cases
   // (such as simulation or scheduling) it makes sense of keep these shapes.
+  // The shapes of the independent subgraphs of large graphs are inferred in
+  // parallel.
   Status InferStatically(bool assume_valid_feeds);
   // Infer the shape by running the graph on the specified cluster and recording
   // the shapes of the processed tensors.
@@ -985,6 +985,96 @@ TEST_F(GraphPropertiesTest, StridedSlicesOfShapes) {
   EXPECT_EQ(shape_a.dim(1).size(), shape_o2.dim(0).size());
 }
 
+TEST_F(GraphPropertiesTest, ShapeInferenceCache) {
+  ShapeInferenceCache* cache = ShapeInferenceCache::Global();
+  cache->Clear();
+
+  auto build_item = [](const Tensor& shape, GrapplerItem* item) {
+    tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+    Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                                ops::Placeholder::Shape({4, 8}));
+    Output w = ops::Const(s.WithOpName("w"), 1.0f, {8, 2});
+    Output matmul = ops::MatMul(s.WithOpName("matmul"), x, w);
+    Output relu = ops::Relu(s.WithOpName("relu"), matmul);
+    Output reshape = ops::Reshape(s.WithOpName("reshape"), relu,
+                                  ops::Const(s.WithOpName("shape"),
+                                             Input::Initializer(shape)));
+    TF_CHECK_OK(s.ToGraphDef(&item->graph));
+  };
+
+  GrapplerItem item;
+  build_item(test::AsTensor<int32>({8}), &item);
+  GraphProperties properties(item);
+  TF_CHECK_OK(properties.InferStatically(false));
+  EXPECT_LT(0, cache->num_misses());
+
+  // The shapes of the same graph are taken from the cache.
+  const int64 num_hits = cache->num_hits();
+  GraphProperties cached_properties(item);
+  TF_CHECK_OK(cached_properties.InferStatically(false));
+  EXPECT_LE(num_hits + 3, cache->num_hits());
+  for (const string& node : {"matmul", "relu", "reshape"}) {
+    EXPECT_EQ(PropToString(properties.GetOutputProperties(node).at(0)),
+              PropToString(cached_properties.GetOutputProperties(node).at(0)))
+        << node;
+  }
+  EXPECT_EQ("float: [8]",
+            PropToString(cached_properties.GetOutputProperties("reshape")[0]));
+
+  // The values of the input tensors read by the shape function are part of
+  // the signature of the node.
+  GrapplerItem other_item;
+  build_item(test::AsTensor<int32>({2, 4}), &other_item);
+  GraphProperties other_properties(other_item);
+  TF_CHECK_OK(other_properties.InferStatically(false));
+  EXPECT_EQ("float: [4,2]",
+            PropToString(other_properties.GetOutputProperties("relu")[0]));
+  EXPECT_EQ("float: [2,4]",
+            PropToString(other_properties.GetOutputProperties("reshape")[0]));
+}
+
+TEST_F(GraphPropertiesTest, IndependentSubgraphs) {
+  // Large enough for the subgraphs to be inferred in parallel.
+  const int kNumSubgraphs = 4;
+  const int kNumNodesPerSubgraph = 300;
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  for (int i = 0; i < kNumSubgraphs; ++i) {
+    Output x = ops::Placeholder(
+        s.WithOpName(strings::StrCat("x", i)), DT_FLOAT,
+        ops::Placeholder::Shape(PartialTensorShape({-1, i + 1})));
+    Output y = x;
+    for (int j = 0; j < kNumNodesPerSubgraph; ++j) {
+      y = ops::Tanh(s.WithOpName(strings::StrCat("y", i, "_", j)), y);
+    }
+  }
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  GraphProperties properties(item);
+  TF_CHECK_OK(properties.InferStatically(false));
+
+  std::vector<int64> batch_dims;
+  for (int i = 0; i < kNumSubgraphs; ++i) {
+    const auto shape_x =
+        properties.GetOutputProperties(strings::StrCat("x", i)).at(0).shape();
+    const auto shape_y = properties
+                             .GetOutputProperties(strings::StrCat(
+                                 "y", i, "_", kNumNodesPerSubgraph - 1))
+                             .at(0)
+                             .shape();
+    ASSERT_EQ(2, shape_x.dim_size());
+    ASSERT_EQ(2, shape_y.dim_size());
+    EXPECT_GT(-1, shape_x.dim(0).size());
+    EXPECT_EQ(shape_x.dim(0).size(), shape_y.dim(0).size());
+    EXPECT_EQ(i + 1, shape_y.dim(1).size());
+    // The symbolic dimensions of the subgraphs are distinct.
+    for (const int64 batch_dim : batch_dims) {
+      EXPECT_NE(batch_dim, shape_x.dim(0).size());
+    }
+    batch_dims.push_back(shape_x.dim(0).size());
+  }
+}
+
 }  // namespace
 }  // namespace grappler
 }  // namespace tensorflow
@@ -0,0 +1,153 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/costs/op_cost_calibration.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/grappler/costs/robust_stats.h"
+#include "tensorflow/core/grappler/costs/utils.h"
+#include "tensorflow/core/lib/core/bits.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+// Returns the size of a tensor in bytes, or -1 if its shape isn't known.
+int64 TensorSize(const OpInfo::TensorProperties& tensor) {
+  if (tensor.shape().unknown_rank()) return -1;
+  int64 num_elements = 1;
+  for (const auto& dim : tensor.shape().dim()) {
+    if (dim.size() < 0) return -1;
+    num_elements *= dim.size();
+  }
+  return num_elements * DataTypeSize(BaseType(tensor.dtype()));
+}
+
+}  // namespace
+
+int OpSizeBucket(const OpInfo& op_info) {
+  // Only the inputs are counted: the outputs of the measured ops are unknown.
+  int64 total_size = 0;
+  for (const auto& tensor : op_info.inputs()) {
+    const int64 size = TensorSize(tensor);
+    if (size < 0) return -1;
+    total_size += size;
+  }
+  return total_size <= 0 ? 0 : Log2Floor64(total_size);
+}
+
+OpCostCalibrator::OpCostCalibrator() {}
+
+void OpCostCalibrator::AddOpPerformance(
+    const OpPerformanceList& op_performance) {
+  for (const OpPerformance& perf : op_performance.op_performance()) {
+    // Measured time in nanoseconds.
+    const int64 measured = perf.compute_cost();
+    if (measured <= 0) continue;
+
+    OpContext op_context;
+    op_context.name = perf.node();
+    op_context.op_info = perf.op();
+    const Costs estimate = estimator_.PredictCosts(op_context);
+    const int64 estimated = estimate.execution_time.count();
+    // An inaccurate estimate doesn't reflect the op, so scaling it wouldn't
+    // carry over to other shapes.
+    if (estimate.inaccurate || estimated <= 0) continue;
+
+    const double log_ratio =
+        std::log(static_cast<double>(measured) / estimated);
+    const string& op = perf.op().op();
+    const string& device_type = perf.op().device().type();
+    const int bucket = OpSizeBucket(perf.op());
+    if (bucket >= 0) {
+      log_ratios_[Key(op, device_type, bucket)].push_back(log_ratio);
+    }
+    log_ratios_[Key(op, device_type, -1)].push_back(log_ratio);
+    log_ratios_[Key("", device_type, -1)].push_back(log_ratio);
+  }
+}
+
+void OpCostCalibrator::AddCostGraph(const CostGraphDef& cost_graph,
+                                    const GraphDef& graph) {
+  AddOpPerformance(CostGraphToOpPerformanceData(cost_graph, graph));
+}
+
+OpCostCalibration OpCostCalibrator::Fit(int min_samples) const {
+  OpCostCalibration calibration;
+  for (const auto& samples : log_ratios_) {
+    if (samples.second.size() < std::max<size_t>(min_samples, 1)) continue;
+    RobustStats stats(samples.second);
+    OpCostCalibration::Entry* entry = calibration.add_entry();
+    entry->set_op(std::get<0>(samples.first));
+    entry->set_device_type(std::get<1>(samples.first));
+    entry->set_size_bucket(std::get<2>(samples.first));
+    entry->set_scale(std::exp(stats.mean()));
+    entry->set_num_samples(samples.second.size());
+  }
+  return calibration;
+}
+
+CalibratedOpLevelCostEstimator::CalibratedOpLevelCostEstimator(
+    const OpCostCalibration& calibration) {
+  for (const auto& entry : calibration.entry()) {
+    if (entry.scale() > 0) {
+      scales_[std::make_tuple(entry.op(), entry.device_type(),
+                              entry.size_bucket())] = entry.scale();
+    }
+  }
+}
+
+Status CalibratedOpLevelCostEstimator::LoadFromFile(
+    Env* env, const string& filename,
+    std::unique_ptr<CalibratedOpLevelCostEstimator>* estimator) {
+  OpCostCalibration calibration;
+  TF_RETURN_IF_ERROR(ReadBinaryProto(env, filename, &calibration));
+  estimator->reset(new CalibratedOpLevelCostEstimator(calibration));
+  return Status::OK();
+}
+
+double CalibratedOpLevelCostEstimator::GetScale(const OpInfo& op_info) const {
+  const string& device_type = op_info.device().type();
+  const int bucket = OpSizeBucket(op_info);
+  if (bucket >= 0) {
+    auto it = scales_.find(std::make_tuple(op_info.op(), device_type, bucket));
+    if (it != scales_.end()) return it->second;
+  }
+  auto it = scales_.find(std::make_tuple(op_info.op(), device_type, -1));
+  if (it != scales_.end()) return it->second;
+  it = scales_.find(std::make_tuple(string(), device_type, -1));
+  if (it != scales_.end()) return it->second;
+  return 1.0;
+}
+
+Costs CalibratedOpLevelCostEstimator::PredictCosts(
+    const OpContext& op_context) const {
+  Costs costs = OpLevelCostEstimator::PredictCosts(op_context);
+  const double scale = GetScale(op_context.op_info);
+  if (scale != 1.0) {
+    costs.execution_time =
+        Costs::Duration(costs.execution_time.count() * scale);
+    costs.compute_time = Costs::Duration(costs.compute_time.count() * scale);
+    costs.memory_time = Costs::Duration(costs.memory_time.count() * scale);
+  }
+  return costs;
+}
+
+}  // end namespace grappler
+}  // end namespace tensorflow
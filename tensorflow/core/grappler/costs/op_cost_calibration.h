@@ -0,0 +1,94 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_COSTS_OP_COST_CALIBRATION_H_
+#define TENSORFLOW_CORE_GRAPPLER_COSTS_OP_COST_CALIBRATION_H_
+
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include "tensorflow/core/framework/cost_graph.pb.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/grappler/costs/op_level_cost_estimator.h"
+#include "tensorflow/core/grappler/costs/op_performance_data.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Returns the size bucket of an op for OpCostCalibration, i.e. the log2 of the
+// total size of its inputs in bytes, or -1 if a size is unknown.
+int OpSizeBucket(const OpInfo& op_info);
+
+// Fits an OpCostCalibration to measured op execution times, e.g. the cost
+// graphs collected by a MeasuringCostEstimator or a CostModelManager.
+//
+// Every measurement is compared to the estimate of an uncalibrated
+// OpLevelCostEstimator for the same op, and the scale of each op type, device
+// type and size bucket is the robust mean of the ratios, in log space.
+class OpCostCalibrator {
+ public:
+  OpCostCalibrator();
+
+  // Adds the measured execution time (compute_cost) of each op.
+  void AddOpPerformance(const OpPerformanceList& op_performance);
+  // Adds the measured execution time of the nodes of `graph`, as reported in
+  // the cost graph of a run.
+  void AddCostGraph(const CostGraphDef& cost_graph, const GraphDef& graph);
+
+  // Returns the calibration fitted to the measurements, with an entry for
+  // every key with at least `min_samples` measurements.
+  OpCostCalibration Fit(int min_samples) const;
+
+ private:
+  // (op, device type, size bucket).
+  typedef std::tuple<string, string, int> Key;
+
+  OpLevelCostEstimator estimator_;
+  // Logs of the ratios of measured to estimated execution times.
+  std::map<Key, std::vector<double>> log_ratios_;
+};
+
+// An OpLevelCostEstimator whose estimates are scaled by an OpCostCalibration,
+// for use with an AnalyticalCostEstimator. An op uses the most specific entry
+// that matches it: its op type and size bucket, its op type, or its device
+// type. Ops without a matching entry keep the uncalibrated estimate.
+class CalibratedOpLevelCostEstimator : public OpLevelCostEstimator {
+ public:
+  explicit CalibratedOpLevelCostEstimator(
+      const OpCostCalibration& calibration);
+  ~CalibratedOpLevelCostEstimator() override {}
+
+  // Reads an OpCostCalibration written with WriteBinaryProto.
+  static Status LoadFromFile(
+      Env* env, const string& filename,
+      std::unique_ptr<CalibratedOpLevelCostEstimator>* estimator);
+
+  Costs PredictCosts(const OpContext& op_context) const override;
+
+  // Returns the scale of the estimate of an op, 1 if it isn't calibrated.
+  double GetScale(const OpInfo& op_info) const;
+
+ private:
+  std::map<std::tuple<string, string, int>, double> scales_;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_COSTS_OP_COST_CALIBRATION_H_
@@ -0,0 +1,144 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/costs/op_cost_calibration.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+void DescribeMatrix(int rows, int columns, OpInfo* op_info) {
+  auto input = op_info->add_inputs();
+  input->set_dtype(DT_FLOAT);
+  input->mutable_shape()->add_dim()->set_size(rows);
+  input->mutable_shape()->add_dim()->set_size(columns);
+}
+
+OpInfo DescribeMatMul(int m, int n, int k, const string& device_type) {
+  OpInfo op_info;
+  op_info.set_op("MatMul");
+  auto device = op_info.mutable_device();
+  device->set_type(device_type);
+  device->set_num_cores(10);
+  device->set_bandwidth(10000000);  // 10000000 KB/s = 10 GB/s
+  device->set_frequency(1000);      // 1000 Mhz = 1 GHz
+  DescribeMatrix(m, k, &op_info);
+  DescribeMatrix(k, n, &op_info);
+  return op_info;
+}
+
+int64 Estimate(const OpLevelCostEstimator& estimator, const OpInfo& op_info) {
+  OpContext op_context;
+  op_context.op_info = op_info;
+  return estimator.PredictCosts(op_context).execution_time.count();
+}
+
+// Returns measurements of MatMuls of the given sizes, which ran `slowdown`
+// times slower than estimated.
+OpPerformanceList MeasureMatMuls(const std::vector<int>& sizes,
+                                 double slowdown) {
+  OpLevelCostEstimator estimator;
+  OpPerformanceList measurements;
+  for (int size : sizes) {
+    OpPerformance* perf = measurements.add_op_performance();
+    *perf->mutable_op() = DescribeMatMul(size, size, size, "CPU");
+    perf->set_compute_cost(Estimate(estimator, perf->op()) * slowdown);
+  }
+  return measurements;
+}
+
+TEST(OpCostCalibrationTest, SizeBucket) {
+  // Two 16x16 float matrices are 2KB.
+  EXPECT_EQ(11, OpSizeBucket(DescribeMatMul(16, 16, 16, "CPU")));
+  OpInfo unknown = DescribeMatMul(16, 16, 16, "CPU");
+  unknown.mutable_inputs(0)->mutable_shape()->mutable_dim(0)->set_size(-1);
+  EXPECT_EQ(-1, OpSizeBucket(unknown));
+}
+
+TEST(OpCostCalibrationTest, FitScales) {
+  OpCostCalibrator calibrator;
+  calibrator.AddOpPerformance(MeasureMatMuls({128, 128, 1024}, 5.0));
+
+  const OpCostCalibration calibration = calibrator.Fit(1);
+  std::map<std::tuple<string, string, int>, OpCostCalibration::Entry> entries;
+  for (const auto& entry : calibration.entry()) {
+    entries[std::make_tuple(entry.op(), entry.device_type(),
+                            entry.size_bucket())] = entry;
+  }
+  const int small = OpSizeBucket(DescribeMatMul(128, 128, 128, "CPU"));
+  const int large = OpSizeBucket(DescribeMatMul(1024, 1024, 1024, "CPU"));
+  ASSERT_EQ(4, entries.size());
+  EXPECT_EQ(2, entries[std::make_tuple("MatMul", "CPU", small)].num_samples());
+  EXPECT_EQ(1, entries[std::make_tuple("MatMul", "CPU", large)].num_samples());
+  EXPECT_EQ(3, entries[std::make_tuple("MatMul", "CPU", -1)].num_samples());
+  EXPECT_EQ(3, entries[std::make_tuple("", "CPU", -1)].num_samples());
+  for (const auto& entry : entries) {
+    EXPECT_NEAR(5.0, entry.second.scale(), 1e-3);
+  }
+
+  // Single measurements are dropped.
+  EXPECT_EQ(3, calibrator.Fit(2).entry_size());
+}
+
+TEST(OpCostCalibrationTest, CalibratedEstimates) {
+  OpCostCalibration calibration;
+  auto* entry = calibration.add_entry();
+  entry->set_op("MatMul");
+  entry->set_device_type("CPU");
+  entry->set_size_bucket(OpSizeBucket(DescribeMatMul(128, 128, 128, "CPU")));
+  entry->set_scale(5.0);
+  entry = calibration.add_entry();
+  entry->set_op("MatMul");
+  entry->set_device_type("CPU");
+  entry->set_size_bucket(-1);
+  entry->set_scale(3.0);
+  entry = calibration.add_entry();
+  entry->set_device_type("CPU");
+  entry->set_size_bucket(-1);
+  entry->set_scale(2.0);
+
+  // Round trip through a file.
+  const string filename =
+      io::JoinPath(testing::TmpDir(), "op_cost_calibration.pb");
+  TF_ASSERT_OK(WriteBinaryProto(Env::Default(), filename, calibration));
+  std::unique_ptr<CalibratedOpLevelCostEstimator> calibrated;
+  TF_ASSERT_OK(CalibratedOpLevelCostEstimator::LoadFromFile(
+      Env::Default(), filename, &calibrated));
+
+  OpLevelCostEstimator estimator;
+  // Matching size bucket.
+  OpInfo op_info = DescribeMatMul(128, 128, 128, "CPU");
+  EXPECT_EQ(5.0, calibrated->GetScale(op_info));
+  EXPECT_NEAR(5.0 * Estimate(estimator, op_info),
+              Estimate(*calibrated, op_info), 1);
+  // Other size bucket.
+  op_info = DescribeMatMul(512, 512, 512, "CPU");
+  EXPECT_EQ(3.0, calibrated->GetScale(op_info));
+  EXPECT_NEAR(3.0 * Estimate(estimator, op_info),
+              Estimate(*calibrated, op_info), 1);
+  // Other op.
+  op_info.set_op("BatchMatMul");
+  EXPECT_EQ(2.0, calibrated->GetScale(op_info));
+  // Other device.
+  op_info = DescribeMatMul(128, 128, 128, "GPU");
+  EXPECT_EQ(1.0, calibrated->GetScale(op_info));
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -16,6 +16,7 @@ limitations under the License.
 #include <memory>
 
 #include "tensorflow/core/grappler/devices.h"
+#include "tensorflow/core/grappler/clusters/cluster.h"
 #include "tensorflow/core/platform/byte_order.h"
 #include "tensorflow/core/platform/cpu_info.h"
 
@@ -70,5 +71,13 @@ int64 AvailableGPUMemory(int gpu_id) {
 
 int GetNumAvailableLogicalCPUCores() { return port::NumSchedulableCPUs(); }
 
+bool ClusterHasGpu(const Cluster* cluster) {
+  if (cluster == nullptr) return GetNumAvailableGPUs() > 0;
+  for (const auto& device : cluster->GetDevices()) {
+    if (device.second.type() == "GPU") return true;
+  }
+  return false;
+}
+
 }  // end namespace grappler
 }  // end namespace tensorflow
@@ -25,6 +25,8 @@ limitations under the License.
 namespace tensorflow {
 namespace grappler {
 
+class Cluster;
+
 // Get the number of available GPUs whose number of multiprocessors is no less
 // than 8.
 int GetNumAvailableGPUs();
@@ -36,6 +38,10 @@ int64 AvailableGPUMemory(int gpu_id);
 // Get the number of logical CPU cores (aka hyperthreads) available.
 int GetNumAvailableLogicalCPUCores();
 
+// Returns true if `cluster` has a GPU device, or if there is an available GPU
+// on this machine when `cluster` is null.
+bool ClusterHasGpu(const Cluster* cluster);
+
 }  // end namespace grappler
 }  // end namespace tensorflow
 
@@ -24,6 +24,7 @@ limitations under the License.
 
 #include "tensorflow/core/framework/attr_value.pb.h"
 #include "tensorflow/core/framework/attr_value_util.h"
+#include "tensorflow/core/framework/function.pb.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/node_def_util.h"
 #include "tensorflow/core/framework/op.h"
@@ -40,8 +41,10 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
 #include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/platform/tensor_coding.h"
 #include "tensorflow/core/util/device_name_utils.h"
 #include "tensorflow/core/util/saved_tensor_slice_util.h"
@@ -2584,6 +2587,55 @@ bool UniqueNodes::SameNode(const NodeDef& node1, const NodeDef& node2) const {
 
 namespace {
 
+// Loop invariants enter a frame through constant Enter nodes, which compute
+// the same value when they have the same input and frame.
+bool IsConstantEnter(const NodeDef& node) {
+  bool is_constant = false;
+  return IsEnter(node) && GetNodeAttr(node, "is_constant", &is_constant).ok() &&
+         is_constant;
+}
+
+bool IsFunctionFreeOfSideEffect(const FunctionDef& func) {
+  if (func.signature().is_stateful()) {
+    return false;
+  }
+  for (const NodeDef& node : func.node_def()) {
+    if (!IsFreeOfSideEffect(node)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Renames the functions called by `node`, either as its op or in its
+// attributes. Returns true if the node was modified.
+bool RenameFunctionCalls(const std::unordered_map<string, string>& renames,
+                         NodeDef* node) {
+  bool modified = false;
+  auto rename = [&renames, &modified](NameAttrList* func) {
+    auto it = renames.find(func->name());
+    if (it != renames.end()) {
+      func->set_name(it->second);
+      modified = true;
+    }
+  };
+  auto it = renames.find(node->op());
+  if (it != renames.end()) {
+    node->set_op(it->second);
+    modified = true;
+  }
+  for (auto& attr : *node->mutable_attr()) {
+    if (attr.second.has_func()) {
+      rename(attr.second.mutable_func());
+    } else if (attr.second.has_list()) {
+      for (NameAttrList& func : *attr.second.mutable_list()->mutable_func()) {
+        rename(&func);
+      }
+    }
+  }
+  return modified;
+}
+
 bool FeedsInPlaceOp(const SimpleGraphView& graph_view, const NodeDef& node) {
   const std::unordered_set<string> op_types_to_traverse = {
       node.op(),    "Identity", "IdentityN", "Reshape",
@@ -2605,7 +2657,10 @@ bool ArithmeticOptimizer::CanDedup(const NodeDef& node) const {
   if (nodes_to_preserve_.find(node.name()) != nodes_to_preserve_.end()) {
     return false;
   }
-  if (IsEnter(node) || IsExit(node)) {
+  if (IsEnter(node)) {
+    return IsConstantEnter(node);
+  }
+  if (IsExit(node)) {
     return false;
   }
   if (node.device().find("SPU") != string::npos) {
@@ -2615,9 +2670,71 @@ bool ArithmeticOptimizer::CanDedup(const NodeDef& node) const {
   if (IsAssert(node)) {
     return true;
   }
+  if (side_effect_free_functions_.count(node.op()) > 0) {
+    return true;
+  }
   return IsFreeOfSideEffect(node);
 }
 
+void ArithmeticOptimizer::DedupFunctions() {
+  FunctionDefLibrary* library = optimized_graph_->mutable_library();
+  side_effect_free_functions_.clear();
+  // Functions with a gradient are kept apart, since the gradient is looked up
+  // by function name.
+  std::unordered_set<string> functions_with_gradient;
+  for (const GradientDef& gradient : library->gradient()) {
+    functions_with_gradient.insert(gradient.function_name());
+  }
+
+  // Maps each duplicated function to the first identical one.
+  std::unordered_map<string, string> renames;
+  std::unordered_map<uint64, std::vector<std::pair<string, string>>>
+      unique_functions;
+  for (const FunctionDef& func : library->function()) {
+    const string& name = func.signature().name();
+    if (IsFunctionFreeOfSideEffect(func)) {
+      side_effect_free_functions_.insert(name);
+    }
+    if (functions_with_gradient.count(name) > 0) {
+      continue;
+    }
+    FunctionDef unnamed_func = func;
+    unnamed_func.mutable_signature()->clear_name();
+    string serialized;
+    if (!SerializeToStringDeterministic(unnamed_func, &serialized)) {
+      continue;
+    }
+    auto& candidates = unique_functions[Fingerprint64(serialized)];
+    bool found = false;
+    for (const auto& candidate : candidates) {
+      if (candidate.second == serialized) {
+        VLOG(3) << "Function " << name << " is a duplicate of "
+                << candidate.first;
+        renames[name] = candidate.first;
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      candidates.emplace_back(name, std::move(serialized));
+    }
+  }
+  if (renames.empty()) {
+    return;
+  }
+
+  // The duplicated functions are kept in the library, since they may be
+  // referenced from outside of the graph.
+  for (NodeDef& node : *optimized_graph_->mutable_node()) {
+    RenameFunctionCalls(renames, &node);
+  }
+  for (FunctionDef& func : *library->mutable_function()) {
+    for (NodeDef& node : *func.mutable_node_def()) {
+      RenameFunctionCalls(renames, &node);
+    }
+  }
+}
+
 void ArithmeticOptimizer::DedupComputations() {
   bool stop = true;
   SimpleGraphView graph_view;
@@ -2823,6 +2940,7 @@ Status ArithmeticOptimizer::Optimize(Cluster* /*cluster*/,
   node_map_.reset(new NodeMap(optimized_graph_));
 
   if (options_.dedup_computations) {
+    DedupFunctions();
     DedupComputations();
   }
 
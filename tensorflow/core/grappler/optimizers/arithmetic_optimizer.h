@@ -91,6 +91,10 @@ class ArithmeticOptimizer : public GraphOptimizer {
   // Dedup redundant nodes in the graph.
   void DedupComputations();
 
+  // Redirects the calls to the functions of the library that are identical to
+  // another one, so that DedupComputations can merge the calls.
+  void DedupFunctions();
+
   // Forward the control dependencies anchored on src_nodes to the target_nodes.
   void ForwardControlDependencies(NodeDef* target_node,
                                   const std::vector<const NodeDef*>& src_nodes);
@@ -121,6 +125,8 @@ class ArithmeticOptimizer : public GraphOptimizer {
 
   bool fetch_nodes_known_ = false;
   std::unordered_set<string> nodes_to_preserve_;
+  // The functions of the library which have no side effect.
+  std::unordered_set<string> side_effect_free_functions_;
   std::unique_ptr<NodeMap> node_map_;
   std::unique_ptr<GraphProperties> graph_properties_;
   GraphDef* optimized_graph_ = nullptr;  // Not owned.
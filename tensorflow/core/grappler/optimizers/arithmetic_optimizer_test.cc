@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/grappler/optimizers/arithmetic_optimizer.h"
 #include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/function_testlib.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/grappler/grappler_item.h"
@@ -310,6 +311,72 @@ TEST_F(ArithmeticOptimizerTest, OpDedupping) {
   test::ExpectTensorNear<double>(tensors_expected[0], tensors[0], 1e-6);
 }
 
+TEST_F(ArithmeticOptimizerTest, OpDeduppingConstantEnter) {
+  using test::function::NDef;
+  auto enter = [](const string& name, bool is_constant) {
+    return NDef(name, "Enter", {"x"},
+                {{"T", DT_FLOAT},
+                 {"frame_name", "loop"},
+                 {"is_constant", is_constant},
+                 {"parallel_iterations", 10}});
+  };
+  GrapplerItem item;
+  item.graph = test::function::GDef(
+      {NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+       enter("invariant1", true), enter("invariant2", true),
+       enter("variant1", false), enter("variant2", false),
+       NDef("sum", "AddN", {"invariant1", "invariant2", "variant1", "variant2"},
+            {{"T", DT_FLOAT}, {"N", 4}})},
+      {});
+  item.fetch = {"sum"};
+
+  ArithmeticOptimizer optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // Only the loop invariants are deduped.
+  NodeMap node_map(&output);
+  EXPECT_EQ(nullptr, node_map.GetNode("invariant2"));
+  EXPECT_NE(nullptr, node_map.GetNode("variant2"));
+  const NodeDef* sum = node_map.GetNode("sum");
+  ASSERT_NE(nullptr, sum);
+  EXPECT_EQ("invariant1", sum->input(1));
+}
+
+TEST_F(ArithmeticOptimizerTest, OpDeduppingFunctionCalls) {
+  using test::function::NDef;
+  FunctionDef x_times_two_copy = test::function::XTimesTwo();
+  x_times_two_copy.mutable_signature()->set_name("XTimesTwoCopy");
+  GrapplerItem item;
+  item.graph = test::function::GDef(
+      {NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+       NDef("y1", "XTimesTwo", {"x"}, {{"T", DT_FLOAT}}),
+       NDef("y2", "XTimesTwoCopy", {"x"}, {{"T", DT_FLOAT}}),
+       NDef("z", "Add", {"y1", "y2"}, {{"T", DT_FLOAT}})},
+      {test::function::XTimesTwo(), x_times_two_copy});
+  item.fetch = {"z"};
+
+  auto x_t = GenerateRandomTensor<DT_FLOAT>(TensorShape({2, 2}));
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, {{"x", x_t}});
+  EXPECT_EQ(1, tensors_expected.size());
+
+  ArithmeticOptimizer optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // The calls to the identical functions are merged.
+  NodeMap node_map(&output);
+  EXPECT_EQ(nullptr, node_map.GetNode("y2"));
+  const NodeDef* z = node_map.GetNode("z");
+  ASSERT_NE(nullptr, z);
+  EXPECT_EQ("y1", z->input(0));
+  EXPECT_EQ("y1", z->input(1));
+
+  auto tensors = EvaluateNodes(output, item.fetch, {{"x", x_t}});
+  EXPECT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-6);
+}
+
 TEST_F(ArithmeticOptimizerTest, OpDeduppingAssertAndCheckNumerics) {
   tensorflow::Scope s = tensorflow::Scope::NewRootScope();
   Output p = ops::Placeholder(s, DT_BOOL, ops::Placeholder::Shape({}));
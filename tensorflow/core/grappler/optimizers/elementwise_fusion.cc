@@ -0,0 +1,279 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/elementwise_fusion.h"
+
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/devices.h"
+#include "tensorflow/core/grappler/graph_view.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/optimizers/symbolic_shapes.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/grappler/utils/topological_sort.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+// Bounds the size of the program of a fused node.
+constexpr int kMaxFusedOps = 64;
+
+// Returns the number of inputs of the elementwise ops supported by the
+// _FusedElementwise kernel, or 0 for other ops.
+int FusibleArity(const NodeDef& node) {
+  static const auto* const kArity = new std::unordered_map<string, int>({
+      {"Abs", 1},     {"Exp", 1},
+      {"Log", 1},     {"Neg", 1},
+      {"Reciprocal", 1},
+      {"Relu", 1},    {"Rsqrt", 1},
+      {"Sigmoid", 1}, {"Sqrt", 1},
+      {"Square", 1},  {"Tanh", 1},
+      {"Add", 2},     {"Div", 2},
+      {"RealDiv", 2}, {"Maximum", 2},
+      {"Minimum", 2}, {"Mul", 2},
+      {"SquaredDifference", 2},
+      {"Sub", 2},
+  });
+  auto it = kArity->find(node.op());
+  return it == kArity->end() ? 0 : it->second;
+}
+
+bool IsScalarShape(const TensorShapeProto& shape) {
+  return !shape.unknown_rank() && shape.dim_size() == 0;
+}
+
+DataType GetType(const NodeDef& node) {
+  auto it = node.attr().find("T");
+  return it == node.attr().end() ? DT_INVALID : it->second.type();
+}
+
+// Returns true if the node can be evaluated by a _FusedElementwise kernel:
+// every input must be a scalar or have the (known) shape of the output.
+bool IsFusible(const NodeDef& node, const GraphProperties& properties,
+               bool has_gpu) {
+  const int arity = FusibleArity(node);
+  if (arity == 0 || NumNonControlInputs(node) != arity) return false;
+  const DataType type = GetType(node);
+  if (type != DT_FLOAT && type != DT_DOUBLE) return false;
+  if (!IsOnCpu(node, has_gpu)) return false;
+
+  const auto& outputs = properties.GetOutputProperties(node.name());
+  const auto& inputs = properties.GetInputProperties(node.name());
+  if (outputs.size() != 1 || inputs.size() != arity) return false;
+  const TensorShapeProto& shape = outputs[0].shape();
+  if (!ShapeIsSymbolicallyDefined(shape) || IsScalarShape(shape)) {
+    return false;
+  }
+  for (const auto& input : inputs) {
+    if (!IsScalarShape(input.shape()) &&
+        !ShapesSymbolicallyEqual(input.shape(), shape)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns the name of the tensor read by a regular input, without ":0".
+string TensorName(const string& input) {
+  int position;
+  const string name = ParseNodeName(input, &position);
+  return position == 0 ? name : strings::StrCat(name, ":", position);
+}
+
+// A subgraph of elementwise ops whose only result is the output of its root.
+struct Fusion {
+  const NodeDef* root = nullptr;
+  std::unordered_set<const NodeDef*> nodes;
+};
+
+// Grows the fusion of `root` towards its inputs: a producer joins the fusion
+// if it is fusible, computes a tensor of the shape of the root, and all its
+// consumers are already in the fusion. Since only the root has consumers
+// outside the fusion, replacing the fusion by one node can't create a cycle.
+void GrowFusion(const NodeDef* root, const GraphView& graph,
+                const GraphProperties& properties,
+                const std::unordered_set<string>& nodes_to_preserve,
+                const std::unordered_set<const NodeDef*>& fusible,
+                const std::unordered_set<const NodeDef*>& fused,
+                Fusion* fusion) {
+  const TensorShapeProto& shape =
+      properties.GetOutputProperties(root->name())[0].shape();
+  fusion->root = root;
+  fusion->nodes.insert(root);
+  std::vector<const NodeDef*> ready = {root};
+  while (!ready.empty() && fusion->nodes.size() < kMaxFusedOps) {
+    const NodeDef* node = ready.back();
+    ready.pop_back();
+    for (int i = 0; i < NumNonControlInputs(*node); ++i) {
+      const NodeDef* producer = graph.GetNode(NodeName(node->input(i)));
+      if (producer == nullptr || fusible.count(producer) == 0 ||
+          fused.count(producer) > 0 || fusion->nodes.count(producer) > 0 ||
+          nodes_to_preserve.count(producer->name()) > 0 ||
+          producer->device() != root->device() ||
+          GetType(*producer) != GetType(*root) ||
+          NumNonControlInputs(*producer) != producer->input_size() ||
+          !ShapesSymbolicallyEqual(
+              properties.GetOutputProperties(producer->name())[0].shape(),
+              shape)) {
+        continue;
+      }
+      bool consumers_fused = true;
+      for (const auto& fanout : graph.GetFanouts(*producer, true)) {
+        if (fanout.port_id < 0 || fusion->nodes.count(fanout.node) == 0) {
+          consumers_fused = false;
+          break;
+        }
+      }
+      // Otherwise the producer is reconsidered once its other consumers have
+      // joined the fusion, if they do.
+      if (!consumers_fused) continue;
+      fusion->nodes.insert(producer);
+      ready.push_back(producer);
+      if (fusion->nodes.size() >= kMaxFusedOps) break;
+    }
+  }
+}
+
+// Creates the _FusedElementwise node computing `fusion`, named after its root.
+void AddFusedNode(const Fusion& fusion, const GraphView& graph,
+                  GraphDef* optimized_graph) {
+  const NodeDef& root = *fusion.root;
+  std::vector<string> inputs;
+  std::unordered_map<string, int> input_registers;
+  std::unordered_map<const NodeDef*, int> node_registers;
+  std::vector<const NodeDef*> program;
+
+  // Orders the fused nodes such that each one follows its producers.
+  std::unordered_set<const NodeDef*> visited;
+  std::function<void(const NodeDef*)> visit = [&](const NodeDef* node) {
+    if (!visited.insert(node).second) return;
+    for (int i = 0; i < NumNonControlInputs(*node); ++i) {
+      const NodeDef* producer = graph.GetNode(NodeName(node->input(i)));
+      if (fusion.nodes.count(producer) > 0) {
+        visit(producer);
+      } else {
+        const string input = TensorName(node->input(i));
+        if (input_registers.emplace(input, inputs.size()).second) {
+          inputs.push_back(input);
+        }
+      }
+    }
+    program.push_back(node);
+  };
+  visit(&root);
+  for (int i = 0; i < program.size(); ++i) {
+    node_registers[program[i]] = inputs.size() + i;
+  }
+
+  NodeDef* fused = optimized_graph->add_node();
+  fused->set_name(root.name());
+  fused->set_op("_FusedElementwise");
+  fused->set_device(root.device());
+  for (const string& input : inputs) {
+    *fused->add_input() = input;
+  }
+  for (const string& input : root.input()) {
+    if (IsControlInput(input)) *fused->add_input() = input;
+  }
+  auto* attr = fused->mutable_attr();
+  (*attr)["T"] = root.attr().at("T");
+  (*attr)["N"].set_i(inputs.size());
+  auto* opcodes = (*attr)["opcodes"].mutable_list();
+  auto* operands = (*attr)["operands"].mutable_list();
+  for (const NodeDef* node : program) {
+    opcodes->add_s(node->op());
+    for (int i = 0; i < NumNonControlInputs(*node); ++i) {
+      const NodeDef* producer = graph.GetNode(NodeName(node->input(i)));
+      if (fusion.nodes.count(producer) > 0) {
+        operands->add_i(node_registers[producer]);
+      } else {
+        operands->add_i(input_registers[TensorName(node->input(i))]);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+Status ElementwiseFusion::Optimize(Cluster* cluster, const GrapplerItem& item,
+                                   GraphDef* optimized_graph) {
+  *optimized_graph->mutable_library() = item.graph.library();
+  *optimized_graph->mutable_versions() = item.graph.versions();
+
+  GraphProperties properties(item);
+  TF_RETURN_IF_ERROR(properties.InferStatically(false));
+  GraphView graph(const_cast<GraphDef*>(&item.graph));
+
+  const bool has_gpu = ClusterHasGpu(cluster);
+
+  std::unordered_set<const NodeDef*> fusible;
+  for (const NodeDef& node : item.graph.node()) {
+    if (IsFusible(node, properties, has_gpu)) fusible.insert(&node);
+  }
+
+  // Visits the consumers before their producers, so that each fusion starts
+  // from the last node of a chain and is as large as possible.
+  std::unordered_map<const NodeDef*, int> topo_order;
+  TF_RETURN_IF_ERROR(
+      ComputeTopologicalOrder(item.graph, &topo_order, nullptr));
+  std::vector<const NodeDef*> roots(fusible.begin(), fusible.end());
+  std::sort(roots.begin(), roots.end(),
+            [&topo_order](const NodeDef* a, const NodeDef* b) {
+              return topo_order[a] > topo_order[b];
+            });
+
+  const std::unordered_set<string> nodes_to_preserve = item.NodesToPreserve();
+  std::unordered_set<const NodeDef*> fused;
+  std::unordered_map<const NodeDef*, Fusion> fusions;
+  for (const NodeDef* root : roots) {
+    if (fused.count(root) > 0) continue;
+    Fusion fusion;
+    GrowFusion(root, graph, properties, nodes_to_preserve, fusible, fused,
+               &fusion);
+    if (fusion.nodes.size() < 2) continue;
+    fused.insert(fusion.nodes.begin(), fusion.nodes.end());
+    fusions[root] = std::move(fusion);
+  }
+
+  for (const NodeDef& node : item.graph.node()) {
+    auto it = fusions.find(&node);
+    if (it != fusions.end()) {
+      AddFusedNode(it->second, graph, optimized_graph);
+    } else if (fused.count(&node) == 0) {
+      *optimized_graph->add_node() = node;
+    }
+  }
+  return Status::OK();
+}
+
+void ElementwiseFusion::Feedback(Cluster* /*cluster*/,
+                                 const GrapplerItem& /*item*/,
+                                 const GraphDef& /*optimized_graph*/,
+                                 double /*result*/) {
+  // Nothing to do for ElementwiseFusion.
+}
+
+}  // end namespace grappler
+}  // end namespace tensorflow
@@ -0,0 +1,46 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_ELEMENTWISE_FUSION_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_ELEMENTWISE_FUSION_H_
+
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Replaces maximal subgraphs of elementwise ops (e.g. Mul, Add, Sigmoid) on
+// CPU by a single _FusedElementwise node, which evaluates them in one pass
+// over memory instead of one pass and one allocation per op. The inputs of
+// each fused op must be scalars or have the shape of its output, so no other
+// broadcasting is needed.
+class ElementwiseFusion : public GraphOptimizer {
+ public:
+  ElementwiseFusion() {}
+  ~ElementwiseFusion() override {}
+
+  string name() const override { return "elementwise_fusion"; };
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimized_graph, double result) override;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_ELEMENTWISE_FUSION_H_
@@ -0,0 +1,176 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/elementwise_fusion.h"
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+class ElementwiseFusionTest : public GrapplerTest {
+ protected:
+  tensorflow::Scope CpuScope() {
+    return tensorflow::Scope::NewRootScope().WithDevice(
+        "/job:localhost/replica:0/task:0/device:CPU:0");
+  }
+
+  // Checks that `output` computes the fetch of `item` like the original
+  // graph, for a random feed of placeholder "x" of the given shape.
+  void ExpectSameResults(const GrapplerItem& item, const GraphDef& output,
+                         const TensorShape& shape) {
+    Tensor x = GenerateRandomTensor<DT_FLOAT>(shape);
+    auto expected = EvaluateNodes(item.graph, item.fetch, {{"x", x}});
+    auto tensors = EvaluateNodes(output, item.fetch, {{"x", x}});
+    ASSERT_EQ(expected.size(), tensors.size());
+    for (int i = 0; i < tensors.size(); ++i) {
+      test::ExpectTensorNear<float>(expected[i], tensors[i], 1e-5);
+    }
+  }
+};
+
+TEST_F(ElementwiseFusionTest, FuseGatingChain) {
+  tensorflow::Scope s = CpuScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({4, 1000}));
+  Output w = ops::Const(s.WithOpName("w"), 0.01f);
+  Output b = ops::Const(s.WithOpName("b"), -2.0f);
+  Output scaled = ops::Mul(s.WithOpName("scaled"), x, w);
+  Output biased = ops::Add(s.WithOpName("biased"), scaled, b);
+  Output gate = ops::Sigmoid(s.WithOpName("gate"), biased);
+  Output gated = ops::Mul(s.WithOpName("gated"), gate, x);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"gated"};
+
+  ElementwiseFusion optimizer;
+  GraphDef output;
+  TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(4, output.node_size());
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "gated") {
+      EXPECT_EQ("_FusedElementwise", node.op());
+      ASSERT_EQ(3, node.input_size());
+      EXPECT_EQ("x", node.input(0));
+      EXPECT_EQ("w", node.input(1));
+      EXPECT_EQ("b", node.input(2));
+      const auto& opcodes = node.attr().at("opcodes").list();
+      ASSERT_EQ(4, opcodes.s_size());
+      EXPECT_EQ("Mul", opcodes.s(0));
+      EXPECT_EQ("Add", opcodes.s(1));
+      EXPECT_EQ("Sigmoid", opcodes.s(2));
+      EXPECT_EQ("Mul", opcodes.s(3));
+      const auto& operands = node.attr().at("operands").list();
+      ASSERT_EQ(7, operands.i_size());
+      EXPECT_EQ(0, operands.i(0));
+      EXPECT_EQ(1, operands.i(1));
+      EXPECT_EQ(3, operands.i(2));
+      EXPECT_EQ(2, operands.i(3));
+      EXPECT_EQ(4, operands.i(4));
+      EXPECT_EQ(5, operands.i(5));
+      EXPECT_EQ(0, operands.i(6));
+      ++found;
+    }
+  }
+  EXPECT_EQ(1, found);
+
+  ExpectSameResults(item, output, {4, 1000});
+}
+
+TEST_F(ElementwiseFusionTest, FuseDiamond) {
+  tensorflow::Scope s = CpuScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({3, 5}));
+  Output square = ops::Square(s.WithOpName("square"), x);
+  Output tanh = ops::Tanh(s.WithOpName("tanh"), square);
+  Output neg = ops::Neg(s.WithOpName("neg"), square);
+  Output sum = ops::Add(s.WithOpName("sum"), tanh, neg);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"sum"};
+
+  ElementwiseFusion optimizer;
+  GraphDef output;
+  TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(2, output.node_size());
+  EXPECT_EQ(1, CountOpNodes(output, "_FusedElementwise"));
+
+  ExpectSameResults(item, output, {3, 5});
+}
+
+TEST_F(ElementwiseFusionTest, KeepOpsWithOtherConsumers) {
+  tensorflow::Scope s = CpuScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({8}));
+  Output exp = ops::Exp(s.WithOpName("exp"), x);
+  Output relu = ops::Relu(s.WithOpName("relu"), exp);
+  Output log = ops::Log(s.WithOpName("log"), relu);
+  Output total = ops::Sum(s.WithOpName("total"), exp, {0});
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"log", "total"};
+
+  ElementwiseFusion optimizer;
+  GraphDef output;
+  TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // Exp is also read by the reduction, so only Relu and Log are fused.
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "exp") {
+      EXPECT_EQ("Exp", node.op());
+    } else if (node.name() == "log") {
+      EXPECT_EQ("_FusedElementwise", node.op());
+      ASSERT_EQ(1, node.input_size());
+      EXPECT_EQ("exp", node.input(0));
+    }
+    EXPECT_NE("relu", node.name());
+  }
+
+  ExpectSameResults(item, output, {8});
+}
+
+TEST_F(ElementwiseFusionTest, DoNotFuseBroadcasts) {
+  tensorflow::Scope s = CpuScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({2, 3}));
+  Output row = ops::Const(s.WithOpName("row"), {1.0f, 2.0f, 3.0f}, {3});
+  Output sum = ops::Add(s.WithOpName("sum"), x, row);
+  Output tanh = ops::Tanh(s.WithOpName("tanh"), sum);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"tanh"};
+
+  ElementwiseFusion optimizer;
+  GraphDef output;
+  TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(0, CountOpNodes(output, "_FusedElementwise"));
+  EXPECT_EQ(4, output.node_size());
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,174 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/input_forwarding.h"
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/graph_view.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/optimizers/symbolic_shapes.h"
+#include "tensorflow/core/grappler/utils.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+// Read by the executor, see GraphView::InitializeNode in executor.cc.
+constexpr char kForwardInputAttr[] = "_forward_input";
+constexpr char kForwardInputProducerAttr[] = "_forward_input_producer";
+constexpr char kScopedAllocatorAttr[] = "_scoped_allocator";
+
+// Returns the number of leading inputs that the kernels of an op can forward
+// to its output 0, or 0 for other ops. Every kernel of these ops on CPU and
+// GPU calls forward_input_or_allocate_output for output 0, as required by a
+// reservation: it's an error to call allocate_output instead.
+int NumForwardableInputs(const NodeDef& node) {
+  static const auto* const kForwardableInputs =
+      new std::unordered_map<string, int>({
+          // Elementwise ops derived from UnaryOp or UnaryElementWiseOp.
+          {"Abs", 1},        {"Ceil", 1},       {"Cos", 1},
+          {"Elu", 1},        {"Exp", 1},        {"Expm1", 1},
+          {"Floor", 1},      {"Log", 1},        {"Log1p", 1},
+          {"Neg", 1},        {"Reciprocal", 1}, {"Relu", 1},
+          {"Relu6", 1},      {"Rint", 1},       {"Round", 1},
+          {"Rsqrt", 1},      {"Selu", 1},       {"Sigmoid", 1},
+          {"Sign", 1},       {"Sin", 1},        {"Sqrt", 1},
+          {"Square", 1},     {"Tanh", 1},
+          // Elementwise ops derived from BinaryOp, SimpleBinaryOp or
+          // BinaryElementWiseOp.
+          {"Add", 2},               {"AddV2", 2},             {"Div", 2},
+          {"EluGrad", 2},           {"Maximum", 2},           {"Minimum", 2},
+          {"Mul", 2},               {"Pow", 2},               {"RealDiv", 2},
+          {"Relu6Grad", 2},         {"ReluGrad", 2},          {"SeluGrad", 2},
+          {"SigmoidGrad", 2},       {"SquaredDifference", 2}, {"Sub", 2},
+          {"TanhGrad", 2},
+          // Other ops which compute their output in place when possible.
+          {"BiasAdd", 1}, {"Softmax", 1},
+      });
+  auto it = kForwardableInputs->find(node.op());
+  return it == kForwardableInputs->end() ? 0 : it->second;
+}
+
+// Returns true if output 0 of the node is always a buffer that nothing else
+// refers to: the kernels of these ops either allocate it, or forward an input
+// whose reference count is one or which was reserved by this optimizer. This
+// excludes e.g. constants, variables, feeds and ops like Identity or Reshape
+// whose output aliases their input.
+bool HasPrivateOutput(const NodeDef& node) {
+  static const auto* const kAllocatingOps = new std::unordered_set<string>({
+      "BatchMatMul", "Conv2D", "MatMul",
+  });
+  return NumForwardableInputs(node) > 0 ||
+         kAllocatingOps->count(node.op()) > 0;
+}
+
+// Other types can live in host memory on devices, e.g. int32 on GPU, and the
+// memory types of a reserved input and of the output must match.
+bool IsForwardableType(DataType type) {
+  return type == DT_HALF || type == DT_FLOAT || type == DT_DOUBLE;
+}
+
+// Returns true if the buffer of the input of `node` at `port` can be reserved
+// for its output: the input has the shape and type of the output, and is the
+// only use of output 0 of a producer on the same device. The input is then
+// dead once `node` runs.
+bool CanForwardInput(const NodeDef& node, int port,
+                     const OpInfo::TensorProperties& input,
+                     const OpInfo::TensorProperties& output,
+                     const GraphView& graph,
+                     const std::unordered_set<string>& nodes_to_preserve) {
+  if (input.dtype() != output.dtype() ||
+      !ShapesSymbolicallyEqual(input.shape(), output.shape())) {
+    return false;
+  }
+  const GraphView::OutputPort fanin =
+      graph.GetRegularFanin(GraphView::InputPort(&node, port));
+  const NodeDef* producer = fanin.node;
+  if (producer == nullptr || fanin.port_id != 0 ||
+      !HasPrivateOutput(*producer) || producer->device() != node.device() ||
+      nodes_to_preserve.count(producer->name()) > 0) {
+    return false;
+  }
+  // A second use of the tensor, even by `node` itself, keeps it alive.
+  return graph.GetFanout(fanin).size() == 1;
+}
+
+}  // namespace
+
+Status InputForwarding::Optimize(Cluster* /*cluster*/, const GrapplerItem& item,
+                                 GraphDef* optimized_graph) {
+  *optimized_graph = item.graph;
+
+  GraphProperties properties(item);
+  TF_RETURN_IF_ERROR(properties.InferStatically(false));
+  GraphView graph(optimized_graph);
+  const std::unordered_set<string> nodes_to_preserve = item.NodesToPreserve();
+
+  int num_reserved = 0;
+  for (NodeDef& node : *optimized_graph->mutable_node()) {
+    const int num_candidates = NumForwardableInputs(node);
+    if (num_candidates == 0 || node.attr().count(kForwardInputAttr) > 0 ||
+        node.attr().count(kScopedAllocatorAttr) > 0) {
+      continue;
+    }
+    const auto& outputs = properties.GetOutputProperties(node.name());
+    const auto& inputs = properties.GetInputProperties(node.name());
+    if (outputs.empty() || inputs.size() < num_candidates ||
+        NumNonControlInputs(node) < num_candidates) {
+      continue;
+    }
+    const OpInfo::TensorProperties& output = outputs[0];
+    if (!IsForwardableType(output.dtype()) ||
+        !ShapeIsSymbolicallyDefined(output.shape())) {
+      continue;
+    }
+    for (int port = 0; port < num_candidates; ++port) {
+      if (CanForwardInput(node, port, inputs[port], output, graph,
+                          nodes_to_preserve)) {
+        AttrValue forward_input;
+        forward_input.mutable_list()->add_i(port);
+        forward_input.mutable_list()->add_i(0);
+        (*node.mutable_attr())[kForwardInputAttr] = forward_input;
+        // Consumers added by later rewrites (e.g. tfdbg) keep the input
+        // alive, so the executor checks that it is still the only use of the
+        // producer before honoring the reservation.
+        (*node.mutable_attr())[kForwardInputProducerAttr].set_s(
+            NodeName(node.input(port)));
+        ++num_reserved;
+        break;
+      }
+    }
+  }
+  VLOG(1) << "Reserved the input buffers of " << num_reserved
+          << " nodes for their output";
+  return Status::OK();
+}
+
+void InputForwarding::Feedback(Cluster* /*cluster*/,
+                               const GrapplerItem& /*item*/,
+                               const GraphDef& /*optimized_graph*/,
+                               double /*result*/) {
+  // Nothing to do for InputForwarding.
+}
+
+}  // end namespace grappler
+}  // end namespace tensorflow
@@ -0,0 +1,55 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_INPUT_FORWARDING_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_INPUT_FORWARDING_H_
+
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Reserves the buffer of an input of elementwise ops (e.g. Relu, Add, Tanh)
+// for their output with the "_forward_input" attribute, when static analysis
+// proves that the input is dead once the op runs: the input is the only use
+// of a tensor freshly allocated by an op on the same device, and has the
+// (symbolic) shape and type of the output. No other input may then claim
+// that output buffer, and the kernel computes its output in place.
+//
+// The reservation skips the run-time reference count check, which fails on
+// devices that record the tensors accessed by each kernel (e.g. GPUs with
+// several compute streams). It names the producer in "_forward_input_producer"
+// and the executor drops it unless the input is still the only use of that
+// producer's output in the final graph: a consumer added afterwards (e.g. by
+// tfdbg or graph partitioning) makes the input live again. This optimizer
+// runs after all the others so that this is rare.
+class InputForwarding : public GraphOptimizer {
+ public:
+  InputForwarding() {}
+  ~InputForwarding() override {}
+
+  string name() const override { return "input_forwarding"; };
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimized_graph, double result) override;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_INPUT_FORWARDING_H_
@@ -0,0 +1,183 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/input_forwarding.h"
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+class InputForwardingTest : public GrapplerTest {
+ protected:
+  // Returns the reserved input of each node, -1 if none.
+  static std::map<string, int> ForwardedInputs(const GraphDef& graph) {
+    std::map<string, int> forwarded;
+    for (const NodeDef& node : graph.node()) {
+      auto it = node.attr().find("_forward_input");
+      if (it == node.attr().end()) {
+        forwarded[node.name()] = -1;
+        continue;
+      }
+      EXPECT_EQ(2, it->second.list().i_size()) << node.name();
+      EXPECT_EQ(0, it->second.list().i(1)) << node.name();
+      const int port = it->second.list().i(0);
+      auto producer = node.attr().find("_forward_input_producer");
+      EXPECT_TRUE(producer != node.attr().end() &&
+                  producer->second.s() == NodeName(node.input(port)))
+          << node.name();
+      forwarded[node.name()] = port;
+    }
+    return forwarded;
+  }
+};
+
+TEST_F(InputForwardingTest, ReserveDeadInputs) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({-1, 16}));
+  Output w = ops::Const(s.WithOpName("w"), 0.5f, {16, 16});
+  Output b = ops::Const(s.WithOpName("b"), 1.0f, {16});
+  Output matmul = ops::MatMul(s.WithOpName("matmul"), x, w);
+  Output bias = ops::BiasAdd(s.WithOpName("bias"), matmul, b);
+  Output relu = ops::Relu(s.WithOpName("relu"), bias);
+  Output sub = ops::Sub(s.WithOpName("sub"), b, relu);
+
+  GrapplerItem item;
+  item.fetch = {"sub"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  InputForwarding optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  auto forwarded = ForwardedInputs(output);
+  EXPECT_EQ(-1, forwarded["matmul"]);
+  EXPECT_EQ(0, forwarded["bias"]);
+  EXPECT_EQ(0, forwarded["relu"]);
+  // The first input is broadcast.
+  EXPECT_EQ(1, forwarded["sub"]);
+
+  Tensor x_t = GenerateRandomTensor<DT_FLOAT>(TensorShape({8, 16}));
+  auto expected = EvaluateNodes(item.graph, item.fetch, {{"x", x_t}});
+  auto tensors = EvaluateNodes(output, item.fetch, {{"x", x_t}});
+  ASSERT_EQ(1, expected.size());
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(expected[0], tensors[0], 1e-5);
+}
+
+TEST_F(InputForwardingTest, ConsumerAddedAfterwards) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({-1, 16}));
+  Output exp = ops::Exp(s.WithOpName("exp"), x);
+  Output neg = ops::Neg(s.WithOpName("neg"), exp);
+
+  GrapplerItem item;
+  item.fetch = {"neg"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  InputForwarding optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_EQ(0, ForwardedInputs(output)["neg"]);
+
+  // Reads the reserved input, like a tfdbg debug node would. The executor
+  // drops the reservation, so "neg" must not overwrite "exp".
+  NodeDef* copy = output.add_node();
+  copy->set_name("copy");
+  copy->set_op("Identity");
+  copy->add_input("exp");
+  (*copy->mutable_attr())["T"].set_type(DT_FLOAT);
+
+  Tensor x_t = GenerateRandomTensor<DT_FLOAT>(TensorShape({8, 16}));
+  auto expected = EvaluateNodes(item.graph, {"exp", "neg"}, {{"x", x_t}});
+  auto tensors = EvaluateNodes(output, {"copy", "neg"}, {{"x", x_t}});
+  ASSERT_EQ(2, expected.size());
+  ASSERT_EQ(2, tensors.size());
+  test::ExpectTensorNear<float>(expected[0], tensors[0], 1e-5);
+  test::ExpectTensorNear<float>(expected[1], tensors[1], 1e-5);
+}
+
+TEST_F(InputForwardingTest, KeepLiveInputs) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({4, 4}));
+  // Reads a feed.
+  Output exp = ops::Exp(s.WithOpName("exp"), x);
+  // Reads a tensor which is also read by "mul".
+  Output tanh = ops::Tanh(s.WithOpName("tanh"), exp);
+  Output mul = ops::Mul(s.WithOpName("mul"), exp, tanh);
+  // Reads the same tensor twice.
+  Output square = ops::Mul(s.WithOpName("square"), mul, mul);
+  // Reads a fetched tensor.
+  Output neg = ops::Neg(s.WithOpName("neg"), square);
+  // Reads a tensor which might alias another one.
+  Output reshape = ops::Reshape(s.WithOpName("reshape"), neg, {16});
+  Output relu = ops::Relu(s.WithOpName("relu"), reshape);
+  // Reads a tensor which might live in host memory.
+  Output cast = ops::Cast(s.WithOpName("cast"), relu, DT_INT32);
+  Output isquare = ops::Square(s.WithOpName("isquare"), cast);
+  Output abs = ops::Abs(s.WithOpName("abs"), isquare);
+
+  GrapplerItem item;
+  item.fetch = {"square", "abs"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  InputForwarding optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  auto forwarded = ForwardedInputs(output);
+  for (const string& node :
+       {"exp", "tanh", "square", "neg", "relu", "isquare", "abs"}) {
+    EXPECT_EQ(-1, forwarded[node]) << node;
+  }
+  // Only the output of "tanh" is dead after "mul".
+  EXPECT_EQ(1, forwarded["mul"]);
+}
+
+TEST_F(InputForwardingTest, KeepExistingReservations) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({4, 4}));
+  Output exp = ops::Exp(s.WithOpName("exp"), x);
+  Output log = ops::Log(s.WithOpName("log"), exp);
+
+  GrapplerItem item;
+  item.fetch = {"log"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  for (NodeDef& node : *item.graph.mutable_node()) {
+    if (node.name() == "log") {
+      (*node.mutable_attr())["_scoped_allocator"].mutable_list()->add_i(0);
+    }
+  }
+
+  InputForwarding optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_EQ(-1, ForwardedInputs(output)["log"]);
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -14,8 +14,10 @@ limitations under the License.
 ==============================================================================*/
 
 #include "tensorflow/core/grappler/optimizers/loop_optimizer.h"
+#include "tensorflow/cc/ops/control_flow_ops_internal.h"
 #include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/inputs/trivial_test_graph_input_yielder.h"
 #include "tensorflow/core/grappler/utils.h"
@@ -73,6 +75,10 @@ class LoopOptimizerTest : public GrapplerTest {
     DisableAllStages(optimizer);
     optimizer->options_.enable_stack_push_removal = true;
   }
+
+  bool LoopInvariantNodeMotionEnabled(const LoopOptimizer& optimizer) const {
+    return optimizer.options_.enable_loop_invariant_node_motion;
+  }
 };
 
 TEST_F(LoopOptimizerTest, Basic) {
@@ -123,6 +129,85 @@ TEST_F(LoopOptimizerTest, Basic) {
   EXPECT_EQ(frames.at(node_map->GetNode("VariantAdd")).back(), 0);
 }
 
+TEST_F(LoopOptimizerTest, AggressiveHoistsLoopInvariants) {
+  EXPECT_FALSE(LoopInvariantNodeMotionEnabled(LoopOptimizer()));
+  EXPECT_FALSE(
+      LoopInvariantNodeMotionEnabled(LoopOptimizer(RewriterConfig::ON)));
+
+  // acc = 0; for (i = 0; i < 3; ++i) acc += Cast(Reshape(x, [4])), where the
+  // Reshape and the Cast only depend on loop invariants.
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  const string frame = "while/while_context";
+  auto constant = ops::internal::Enter::IsConstant(true);
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_INT32);
+  Output x_enter = ops::internal::Enter(s.WithOpName("x_enter"), x, frame,
+                                        constant);
+  Output shape_enter = ops::internal::Enter(
+      s.WithOpName("shape_enter"), ops::Const(s.WithOpName("shape"), {4}),
+      frame, constant);
+  Output limit_enter = ops::internal::Enter(
+      s.WithOpName("limit_enter"), ops::Const(s.WithOpName("limit"), 3),
+      frame, constant);
+  Output one_enter = ops::internal::Enter(
+      s.WithOpName("one_enter"), ops::Const(s.WithOpName("one"), 1), frame,
+      constant);
+  Output i_enter = ops::internal::Enter(
+      s.WithOpName("i_enter"), ops::Const(s.WithOpName("i_init"), 0), frame);
+  Output acc_enter = ops::internal::Enter(
+      s.WithOpName("acc_enter"),
+      ops::Const(s.WithOpName("acc_init"), {0.0f, 0.0f, 0.0f, 0.0f}), frame);
+  // The second inputs of the merges are replaced by the back edges below.
+  ops::Merge i_merge(s.WithOpName("i_merge"), {i_enter, i_enter});
+  ops::Merge acc_merge(s.WithOpName("acc_merge"), {acc_enter, acc_enter});
+  Output less = ops::Less(s.WithOpName("less"), i_merge.output, limit_enter);
+  Output loop_cond = ops::LoopCond(s.WithOpName("loop_cond"), less);
+  ops::Switch i_switch(s.WithOpName("i_switch"), i_merge.output, loop_cond);
+  ops::Switch acc_switch(s.WithOpName("acc_switch"), acc_merge.output,
+                         loop_cond);
+  Output reshape = ops::Reshape(s.WithOpName("reshape"), x_enter, shape_enter);
+  Output cast = ops::Cast(s.WithOpName("cast"), reshape, DT_FLOAT);
+  Output i_add = ops::Add(s.WithOpName("i_add"), i_switch.output_true,
+                          one_enter);
+  Output acc_add =
+      ops::Add(s.WithOpName("acc_add"), acc_switch.output_true, cast);
+  ops::NextIteration(s.WithOpName("i_next"), i_add);
+  ops::NextIteration(s.WithOpName("acc_next"), acc_add);
+  ops::internal::Exit(s.WithOpName("i_exit"), i_switch.output_false);
+  ops::internal::Exit(s.WithOpName("acc_exit"), acc_switch.output_false);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  for (NodeDef& node : *item.graph.mutable_node()) {
+    if (node.name() == "i_merge") node.set_input(1, "i_next");
+    if (node.name() == "acc_merge") node.set_input(1, "acc_next");
+  }
+  item.fetch = {"acc_exit"};
+
+  LoopOptimizer optimizer(RewriterConfig::AGGRESSIVE);
+  EXPECT_TRUE(LoopInvariantNodeMotionEnabled(optimizer));
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  std::unordered_map<const NodeDef*, std::vector<int>> frames;
+  int num_frames;
+  NodeMap node_map(&output);
+  TF_EXPECT_OK(IdentifyFrames(output, &frames, &num_frames));
+  EXPECT_EQ(1, num_frames);
+  EXPECT_EQ(0, frames.at(node_map.GetNode("reshape")).size());
+  EXPECT_EQ(0, frames.at(node_map.GetNode("cast")).size());
+  EXPECT_EQ(1, frames.at(node_map.GetNode("acc_add")).size());
+
+  Tensor x_t(DT_INT32, TensorShape({2, 2}));
+  test::FillValues<int32>(&x_t, {1, -2, 3, 4});
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, {{"x", x_t}});
+  auto tensors = EvaluateNodes(output, item.fetch, {{"x", x_t}});
+  ASSERT_EQ(1, tensors_expected.size());
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({3.0f, -6.0f, 9.0f, 12.0f}), tensors_expected[0]);
+  test::ExpectTensorEqual<float>(tensors_expected[0], tensors[0]);
+}
+
 TEST_F(LoopOptimizerTest, Const) {
   GraphDef graph;
   AddSimpleNode("In", "Identity", {}, &graph);
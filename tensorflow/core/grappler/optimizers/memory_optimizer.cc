@@ -28,6 +28,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/clusters/virtual_cluster.h"
 #include "tensorflow/core/grappler/costs/graph_memory.h"
 #include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/costs/op_level_cost_estimator.h"
 #include "tensorflow/core/grappler/graph_view.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/op_types.h"
@@ -37,6 +38,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/utils/topological_sort.h"
 #include "tensorflow/core/grappler/utils/traversal.h"
 #include "tensorflow/core/lib/math/math_util.h"
+#include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/protobuf/rewriter_config.pb.h"
 
 namespace tensorflow {
@@ -49,6 +51,17 @@ const char* kRecomputeTriggerNodePrefix = "RecomputeTrigger";
 // recomputed.
 const char* kRecomputeHint = "_recompute_hint";
 
+// Nodes whose inputs we may want to recompute. This matches node names that
+// contain recomputation_targets_name_scope as a name scope, meaning it either
+// begins with or contains the name scope. Defaults to "gradients/" which will
+// match any node names that begins with "gradients/" or contains
+// "/gradients/".
+bool IsRecomputationTarget(const string& recomputation_targets_name_scope,
+                           const NodeDef& node) {
+  return node.name().find(recomputation_targets_name_scope) == 0 ||
+         node.name().find("/" + recomputation_targets_name_scope) != -1;
+}
+
 // Ops which we wouldn't mind recomputing to save memory.
 // TODO(allenl): Replace this list with a cost model.
 std::unordered_set<string> GetCheapToRecomputeOps() {
@@ -440,13 +453,7 @@ void RecomputationRewritingPass(RewriterConfig::MemOptType optimization_level,
   }
   std::function<bool(const NodeDef&)> is_target =
       [&recomputation_targets_name_scope](const NodeDef& node) {
-        // Nodes whose inputs we may want to recompute. This matches node names
-        // that contain recomputation_targets_name_scope as a name scope,
-        // meaning it either begins with or contains the name scope.
-        // Defaults to "gradients/" which will match any node names that begins
-        // with "gradients/" or contains "/gradients/".
-        return node.name().find(recomputation_targets_name_scope) == 0 ||
-               node.name().find("/" + recomputation_targets_name_scope) != -1;
+        return IsRecomputationTarget(recomputation_targets_name_scope, node);
       };
 
   if (optimization_level == RewriterConfig::RECOMPUTATION_HEURISTICS ||
@@ -941,6 +948,47 @@ struct MemInfo {
   bool operator<(const MemInfo& other) const { return fitness < other.fitness; }
 };
 
+// Simulates the execution of the item on the devices of the cluster, and
+// returns the completion time of each node.
+static bool EstimateOpCompletionTimes(
+    Cluster* cluster, const GrapplerItem& item,
+    std::unordered_map<string, Costs::NanoSeconds>* op_completion_times) {
+  VirtualCluster vcluster(cluster->GetDevices());
+  if (!vcluster.Provision().ok()) {
+    return false;
+  }
+  if (!vcluster.Initialize(item).ok()) {
+    return false;
+  }
+  RunMetadata metadata;
+  Status s = vcluster.Run(item.graph, item.feed, item.fetch, &metadata);
+  if (!s.ok() && s.code() != error::RESOURCE_EXHAUSTED) {
+    return false;
+  }
+
+  for (const auto& dev_stats : metadata.step_stats().dev_stats()) {
+    for (const auto& node_stats : dev_stats.node_stats()) {
+      Costs::NanoSeconds exec_time =
+          Costs::NanoSeconds(1) +
+          Costs::MicroSeconds(node_stats.all_start_micros() +
+                              node_stats.op_end_rel_micros());
+      op_completion_times->emplace(node_stats.node_name(), exec_time);
+    }
+  }
+  return true;
+}
+
+// Returns the time at which the peak memory usage of a device is reached.
+static Costs::Duration GetPeakTime(const GraphMemory::MemoryUsage& mem_usage) {
+  Costs::Duration peak_time = -1;
+  for (const auto& live_tensor : mem_usage.live_tensors) {
+    if (live_tensor.allocation_time > peak_time) {
+      peak_time = live_tensor.allocation_time;
+    }
+  }
+  return peak_time;
+}
+
 static bool IdentifySwappingCandidates(
     Cluster* cluster, GrapplerItem* item, std::unordered_set<string>* skip_list,
     std::unordered_map<NodeDef*, SwapInfo>* nodes_to_swap) {
@@ -972,37 +1020,10 @@ static bool IdentifySwappingCandidates(
     int64 required_savings = mem_usage.used_memory - prop.memory_size();
 
     std::unordered_map<string, Costs::NanoSeconds> op_completion_times;
-    {
-      VirtualCluster vcluster(cluster->GetDevices());
-      if (!vcluster.Provision().ok()) {
-        return false;
-      }
-      if (!vcluster.Initialize(*item).ok()) {
-        return false;
-      }
-      RunMetadata metadata;
-      Status s = vcluster.Run(item->graph, item->feed, item->fetch, &metadata);
-      if (!s.ok() && s.code() != error::RESOURCE_EXHAUSTED) {
-        return false;
-      }
-
-      for (const auto& dev_stats : metadata.step_stats().dev_stats()) {
-        for (const auto& node_stats : dev_stats.node_stats()) {
-          Costs::NanoSeconds exec_time =
-              Costs::NanoSeconds(1) +
-              Costs::MicroSeconds(node_stats.all_start_micros() +
-                                  node_stats.op_end_rel_micros());
-          op_completion_times.emplace(node_stats.node_name(), exec_time);
-        }
-      }
-    }
-
-    Costs::Duration peak_time = -1;
-    for (const auto& live_tensor : mem_usage.live_tensors) {
-      if (live_tensor.allocation_time > peak_time) {
-        peak_time = live_tensor.allocation_time;
-      }
+    if (!EstimateOpCompletionTimes(cluster, *item, &op_completion_times)) {
+      return false;
     }
+    Costs::Duration peak_time = GetPeakTime(mem_usage);
 
     std::vector<MemInfo> mem_state;
 
@@ -1222,6 +1243,214 @@ bool SwappingPass(RewriterConfig::MemOptType optimization_level,
   return updated_graph;
 }
 
+struct RematerializationCandidate {
+  const NodeDef* node;
+  // The target nodes which use the node after the peak memory usage.
+  std::unordered_set<NodeDef*> uses_left;
+  int64 memory_saved;
+  Costs costs;
+  double fitness;
+
+  bool operator<(const RematerializationCandidate& other) const {
+    return fitness > other.fitness;
+  }
+};
+
+// Recomputes, for the target nodes, the tensors that are live at the peak
+// memory usage of the devices above the memory budget. The tensors which save
+// the most memory per unit of recomputation time are picked first, until the
+// estimated savings bring the peak within the budget. Returns the peak memory
+// usage over all the devices before the rewrite in `peak_memory`.
+static bool RematerializationPass(
+    Cluster* cluster, int64 memory_budget,
+    const string& recomputation_targets_name_scope, GrapplerItem* item,
+    int64* peak_memory, MemoryOptimizer::RematerializationStats* stats) {
+  *peak_memory = -1;
+  // RecomputeSubgraph relies on the topological order of the nodes, and on
+  // NodeDef pointers which the sort invalidates.
+  if (!TopologicalSort(&item->graph).ok()) {
+    return false;
+  }
+  GraphMemory memory(*item);
+  const std::unordered_map<string, DeviceProperties>& devices =
+      cluster->GetDevices();
+  Status s = memory.InferStatically(devices);
+  if (!s.ok()) {
+    VLOG(1) << "Failed to infer memory usage: " << s.error_message();
+    return false;
+  }
+  *peak_memory = memory.GetWorstCaseMemoryUsage();
+
+  std::unordered_map<string, int64> required_savings;
+  for (const auto& device : devices) {
+    const int64 budget =
+        memory_budget > 0 ? memory_budget : device.second.memory_size();
+    const int64 used_memory =
+        memory.GetPeakMemoryUsage(device.first).used_memory;
+    if (budget > 0 && used_memory > budget) {
+      required_savings[device.first] = used_memory - budget;
+    }
+  }
+  if (required_savings.empty()) {
+    return false;
+  }
+
+  std::unordered_map<string, Costs::NanoSeconds> op_completion_times;
+  if (!EstimateOpCompletionTimes(cluster, *item, &op_completion_times)) {
+    return false;
+  }
+  GraphProperties properties(*item);
+  if (!properties.InferStatically(false).ok()) {
+    return false;
+  }
+  std::unordered_set<string> feeds;
+  for (const auto& feed : item->feed) {
+    feeds.insert(NodeName(feed.first));
+  }
+  NodeMap node_map(&item->graph);
+  std::unordered_map<const NodeDef*, int> topological_numbering;
+  for (int node_number = 0; node_number < item->graph.node_size();
+       ++node_number) {
+    topological_numbering[item->graph.mutable_node(node_number)] =
+        item->graph.node_size() - node_number - 1;
+  }
+  OpLevelCostEstimator estimator;
+
+  bool updated_graph = false;
+  for (const auto& device_savings : required_savings) {
+    const string& device = device_savings.first;
+    const DeviceProperties& prop = devices.at(device);
+    const GraphMemory::MemoryUsage& mem_usage =
+        memory.GetPeakMemoryUsage(device);
+    const Costs::Duration peak_time = GetPeakTime(mem_usage);
+
+    std::unordered_set<string> live_tensors;
+    std::unordered_map<string, int64> live_memory;
+    for (const auto& live_tensor : mem_usage.live_tensors) {
+      live_tensors.insert(
+          strings::StrCat(live_tensor.node, ":", live_tensor.output_id));
+      live_memory[live_tensor.node] += live_tensor.memory_used;
+    }
+
+    std::vector<RematerializationCandidate> candidates;
+    for (const auto& node_memory : live_memory) {
+      if (node_memory.second <= 1024) {
+        // Don't bother with small tensors.
+        continue;
+      }
+      const NodeDef* node = node_map.GetNode(node_memory.first);
+      if (node == nullptr || feeds.count(node->name()) > 0 ||
+          IsRecomputationTarget(recomputation_targets_name_scope, *node) ||
+          str_util::StartsWith(node->name(), kRecomputedNodePrefix) ||
+          NumNonControlInputs(*node) == 0 || !IsFreeOfSideEffect(*node)) {
+        continue;
+      }
+      RematerializationCandidate candidate;
+      candidate.node = node;
+      candidate.memory_saved = node_memory.second;
+      // Recomputing the node keeps its inputs alive until the recomputation.
+      const auto& input_props = properties.GetInputProperties(node->name());
+      bool valid = true;
+      for (int i = 0; i < node->input_size() && valid; ++i) {
+        if (IsControlInput(node->input(i))) {
+          continue;
+        }
+        const NodeDef* input = node_map.GetNode(node->input(i));
+        if (input == nullptr ||
+            IsRecomputationTarget(recomputation_targets_name_scope, *input) ||
+            i >= input_props.size()) {
+          valid = false;
+          break;
+        }
+        int position;
+        const string input_name = ParseNodeName(node->input(i), &position);
+        if (live_tensors.count(strings::StrCat(input_name, ":", position)) ==
+            0) {
+          candidate.memory_saved -= EstimateSize(input_props[i]);
+        }
+      }
+      if (!valid || candidate.memory_saved <= 0) {
+        continue;
+      }
+      // The original tensor is freed at the peak only if all of its other uses
+      // are done by then.
+      for (NodeDef* output : node_map.GetOutputs(node->name())) {
+        auto it = op_completion_times.find(output->name());
+        if (it == op_completion_times.end()) {
+          valid = false;
+          break;
+        }
+        if (it->second <= peak_time) {
+          continue;
+        }
+        if (!IsRecomputationTarget(recomputation_targets_name_scope,
+                                   *output)) {
+          valid = false;
+          break;
+        }
+        candidate.uses_left.insert(output);
+      }
+      if (!valid || candidate.uses_left.empty()) {
+        continue;
+      }
+
+      OpContext op_context;
+      op_context.name = node->name();
+      op_context.device_name = device;
+      op_context.op_info.set_op(node->op());
+      *op_context.op_info.mutable_attr() = node->attr();
+      for (const auto& input : input_props) {
+        *op_context.op_info.add_inputs() = input;
+      }
+      for (const auto& output : properties.GetOutputProperties(node->name())) {
+        *op_context.op_info.add_outputs() = output;
+      }
+      *op_context.op_info.mutable_device() = prop;
+      candidate.costs = estimator.PredictCosts(op_context);
+      candidate.fitness =
+          static_cast<double>(candidate.memory_saved) /
+          (candidate.costs.execution_time.count() + 1);
+      candidates.push_back(std::move(candidate));
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+    const double gigaops = estimator.GetDeviceInfo(prop).gigaops;
+    int64 savings_left = device_savings.second;
+    // The savings are estimated assuming the inputs of a recomputed node stay
+    // alive, so don't recompute a node and its inputs in the same pass.
+    std::unordered_set<string> recomputed_nodes;
+    std::unordered_set<string> recomputation_inputs;
+    for (const RematerializationCandidate& candidate : candidates) {
+      if (savings_left <= 0) {
+        break;
+      }
+      if (recomputation_inputs.count(candidate.node->name()) > 0 ||
+          std::any_of(candidate.node->input().begin(),
+                      candidate.node->input().end(),
+                      [&recomputed_nodes](const string& input) {
+                        return recomputed_nodes.count(NodeName(input)) > 0;
+                      })) {
+        continue;
+      }
+      recomputed_nodes.insert(candidate.node->name());
+      for (const string& input : candidate.node->input()) {
+        recomputation_inputs.insert(NodeName(input));
+      }
+      VLOG(1) << "Will recompute " << candidate.node->name() << " to save "
+              << candidate.memory_saved << " bytes";
+      RecomputeSubgraph({candidate.node}, candidate.uses_left, node_map,
+                        topological_numbering, &item->graph);
+      savings_left -= candidate.memory_saved;
+      ++stats->num_recomputed_nodes;
+      // Gigaops are operations per nanosecond.
+      stats->extra_operations +=
+          candidate.costs.compute_time.count() * gigaops;
+      updated_graph = true;
+    }
+  }
+  return updated_graph;
+}
+
 // TODO(rmlarsen): Add distributed TF test.
 Status RelaxAllocatorConstraints(GraphDef* optimized_graph) {
   std::unordered_set<string> devices;
@@ -1299,6 +1528,7 @@ Status RelaxAllocatorConstraints(GraphDef* optimized_graph) {
 Status MemoryOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
                                  GraphDef* optimized_graph) {
   *optimized_graph = item.graph;
+  rematerialization_stats_ = RematerializationStats();
 
   RecomputationRewritingPass(optimization_level_,
                              recomputation_targets_name_scope_, optimized_graph,
@@ -1326,6 +1556,31 @@ Status MemoryOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
       updated_graph |= SwappingPass(optimization_level_, cluster,
                                     &optimized_item, &skip_list);
     }
+
+    if (optimization_level_ == RewriterConfig::REMATERIALIZATION_HEURISTICS &&
+        cluster != nullptr) {
+      int64 peak_memory;
+      updated_graph |= RematerializationPass(
+          cluster, memory_budget_, recomputation_targets_name_scope_,
+          &optimized_item, &peak_memory, &rematerialization_stats_);
+      if (i == 0) {
+        rematerialization_stats_.peak_memory_before = peak_memory;
+      }
+      rematerialization_stats_.peak_memory_after = peak_memory;
+    }
+  }
+  if (rematerialization_stats_.num_recomputed_nodes > 0) {
+    GraphMemory memory(optimized_item);
+    if (memory.InferStatically(cluster->GetDevices()).ok()) {
+      rematerialization_stats_.peak_memory_after =
+          memory.GetWorstCaseMemoryUsage();
+    }
+    VLOG(1) << "Recomputed " << rematerialization_stats_.num_recomputed_nodes
+            << " nodes: peak memory usage "
+            << rematerialization_stats_.peak_memory_before << " -> "
+            << rematerialization_stats_.peak_memory_after << " bytes, "
+            << rematerialization_stats_.extra_operations
+            << " extra operations";
   }
 
   TF_RETURN_IF_ERROR(RelaxAllocatorConstraints(&optimized_item.graph));
@@ -30,13 +30,31 @@ class MemoryOptimizer : public GraphOptimizer {
   // recomputation_targets_name_scope: Name scope for potential outputs of
   //   recomputations. See
   //   RewriterConfig::memory_optimizer_target_node_name_scope.
+  // memory_budget: Peak memory usage per device targeted by the
+  //   rematerialization heuristics, or 0 for the memory size of the devices.
+  //   See RewriterConfig::rematerialization_memory_budget.
   explicit MemoryOptimizer(
       RewriterConfig::MemOptType optimization_level,
-      const string& recomputation_targets_name_scope = "gradients/")
+      const string& recomputation_targets_name_scope = "gradients/",
+      int64 memory_budget = 0)
       : optimization_level_(optimization_level),
-        recomputation_targets_name_scope_(recomputation_targets_name_scope) {}
+        recomputation_targets_name_scope_(recomputation_targets_name_scope),
+        memory_budget_(memory_budget) {}
   ~MemoryOptimizer() override {}
 
+  // What the rematerialization heuristics did in the last call to Optimize.
+  struct RematerializationStats {
+    int num_recomputed_nodes = 0;
+    // Simulated peak memory usage in bytes, over all the devices.
+    int64 peak_memory_before = 0;
+    int64 peak_memory_after = 0;
+    // Estimated number of operations of the recomputed nodes.
+    int64 extra_operations = 0;
+  };
+  const RematerializationStats& rematerialization_stats() const {
+    return rematerialization_stats_;
+  }
+
   string name() const override { return "memory_optimizer"; };
 
   Status Optimize(Cluster* cluster, const GrapplerItem& item,
@@ -48,6 +66,8 @@ class MemoryOptimizer : public GraphOptimizer {
  private:
   RewriterConfig::MemOptType optimization_level_;
   string recomputation_targets_name_scope_;
+  int64 memory_budget_;
+  RematerializationStats rematerialization_stats_;
 };
 
 }  // end namespace grappler
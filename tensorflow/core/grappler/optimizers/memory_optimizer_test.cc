@@ -25,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/utils.h"
 #include "tensorflow/core/grappler/utils/grappler_test.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/str_util.h"
 
 namespace tensorflow {
 namespace grappler {
@@ -440,6 +441,52 @@ TEST_F(MemoryOptimizerTest, AccumulationRewrites) {
   }
 }
 
+TEST_F(MemoryOptimizerTest, RematerializationHeuristics) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice("/cpu:0");
+  Output x = ops::Const(s.WithOpName("x"), 0.5f, {256, 256});
+  Output a1 = ops::Sigmoid(s.WithOpName("a1"), x);
+  Output a2 = ops::Sigmoid(s.WithOpName("a2"), a1);
+  Output a3 = ops::Sigmoid(s.WithOpName("a3"), a2);
+  Output a4 = ops::Sigmoid(s.WithOpName("a4"), a3);
+  Output g4 = ops::Square(s.WithOpName("gradients/g4"), a4);
+  Output g3 = ops::Mul(s.WithOpName("gradients/g3"), g4, a3);
+  Output g2 = ops::Mul(s.WithOpName("gradients/g2"), g3, a2);
+  Output g1 = ops::Mul(s.WithOpName("gradients/g1"), g2, a1);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"gradients/g1"};
+
+  std::unique_ptr<VirtualCluster> cluster(CreateVirtualCluster());
+  MemoryOptimizer optimizer(RewriterConfig::REMATERIALIZATION_HEURISTICS,
+                            "gradients/", /*memory_budget=*/1024);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(cluster.get(), item, &output));
+
+  // Some activations are recomputed for the gradients, from the original
+  // activations and never from the gradients.
+  int num_recomputed = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.op() != "Sigmoid" ||
+        !str_util::StartsWith(node.name(), "Recomputed/")) {
+      continue;
+    }
+    ++num_recomputed;
+    EXPECT_FALSE(str_util::StartsWith(node.input(0), "gradients/"));
+  }
+  const auto& stats = optimizer.rematerialization_stats();
+  EXPECT_LT(0, num_recomputed);
+  EXPECT_EQ(num_recomputed, stats.num_recomputed_nodes);
+  EXPECT_LT(0, stats.peak_memory_before);
+  EXPECT_LT(0, stats.peak_memory_after);
+  EXPECT_LT(0, stats.extra_operations);
+
+  auto tensors_expected = EvaluateFetchNodes(item);
+  GrapplerItem optimized(item, std::move(output));
+  auto tensors = EvaluateFetchNodes(optimized);
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-6);
+}
+
 class RelaxAllocatorConstraintsTest : public GrapplerTest {};
 
 TEST_F(RelaxAllocatorConstraintsTest, SameDevice) {
@@ -17,24 +17,34 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/function.h"
 #include "tensorflow/core/framework/function.pb.h"
 #include "tensorflow/core/framework/versions.pb.h"
+#include "tensorflow/core/grappler/costs/op_cost_calibration.h"
 #include "tensorflow/core/grappler/optimizers/arithmetic_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/auto_parallel.h"
 #include "tensorflow/core/grappler/optimizers/constant_folding.h"
 #include "tensorflow/core/grappler/optimizers/custom_graph_optimizer_registry.h"
 #include "tensorflow/core/grappler/optimizers/debug_stripper.h"
 #include "tensorflow/core/grappler/optimizers/dependency_optimizer.h"
+#include "tensorflow/core/grappler/optimizers/elementwise_fusion.h"
 #include "tensorflow/core/grappler/optimizers/function_optimizer.h"
+#include "tensorflow/core/grappler/optimizers/input_forwarding.h"
 #include "tensorflow/core/grappler/optimizers/layout_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/loop_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/memory_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/model_pruner.h"
+#include "tensorflow/core/grappler/optimizers/placement_optimizer.h"
+#include "tensorflow/core/grappler/optimizers/quantization_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/remapper.h"
 #include "tensorflow/core/grappler/optimizers/scoped_allocator_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/shape_optimizer.h"
 #include "tensorflow/core/grappler/utils/colocation.h"
 #include "tensorflow/core/grappler/utils/functions.h"
 #include "tensorflow/core/grappler/utils/topological_sort.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/fingerprint.h"
 
 namespace tensorflow {
 namespace grappler {
@@ -64,10 +74,42 @@ int NumIterations(const RewriterConfig& cfg) {
              : cfg.meta_optimizer_iterations();
 }
 
+// Returns a fingerprint of the graph, or 0 if it can't be computed.
+uint64 GraphFingerprint(const GraphDef& graph) {
+  string serialized;
+  if (!SerializeToStringDeterministic(graph, &serialized)) return 0;
+  return Fingerprint64(serialized);
+}
+
 // Check if optimizer is allowed to run only once.
 bool IsRunOnceOptimizer(const string& name) {
   return name == "layout" || name == "memory_optimizer" ||
-         name == "loop_optimizer";
+         name == "loop_optimizer" || name == "placement_optimizer" ||
+         name == "quantization_optimizer";
+}
+
+// Uses the op cost calibration of the config, if any.
+GraphOptimizer* NewPlacementOptimizer(const RewriterConfig& cfg) {
+  if (!cfg.op_cost_calibration_file().empty()) {
+    std::unique_ptr<CalibratedOpLevelCostEstimator> estimator;
+    Status status = CalibratedOpLevelCostEstimator::LoadFromFile(
+        Env::Default(), cfg.op_cost_calibration_file(), &estimator);
+    if (status.ok()) return new PlacementOptimizer(estimator.release());
+    LOG(WARNING) << "Failed to load the op cost calibration: " << status;
+  }
+  return new PlacementOptimizer();
+}
+
+// Uses the quantization calibration of the config. Returns nullptr if there is
+// none, since nothing can be quantized without the tensor ranges.
+GraphOptimizer* NewQuantizationOptimizer(const RewriterConfig& cfg) {
+  std::unique_ptr<QuantizationOptimizer> optimizer;
+  Status status = QuantizationOptimizer::LoadFromFile(
+      Env::Default(), cfg.quantization_calibration_file(), &optimizer);
+  if (!status.ok()) {
+    LOG(WARNING) << "Failed to load the quantization calibration: " << status;
+  }
+  return optimizer.release();
 }
 
 }  // namespace
@@ -91,6 +133,10 @@ std::unique_ptr<GraphOptimizer> MetaOptimizer::MakeNewOptimizer(
   MK_OPT("debug_stripper", new DebugStripper());
   MK_OPT("scoped_allocator",
          new ScopedAllocatorOptimizer(cfg_.scoped_allocator_opts()));
+  MK_OPT("elementwise_fusion", new ElementwiseFusion());
+  MK_OPT("placement", NewPlacementOptimizer(cfg_));
+  MK_OPT("input_forwarding", new InputForwarding());
+  MK_OPT("quantization", NewQuantizationOptimizer(cfg_));
 
   return std::unique_ptr<GraphOptimizer>();
 }
@@ -130,6 +176,16 @@ Status MetaOptimizer::InitializeOptimizers(
     optimizers->emplace_back(
         new DependencyOptimizer(cfg_.dependency_optimization()));
   }
+  if (cfg_.elementwise_fusion() == RewriterConfig::ON) {
+    optimizers->emplace_back(new ElementwiseFusion());
+  }
+  if (cfg_.placement_optimization() == RewriterConfig::ON) {
+    optimizers->emplace_back(NewPlacementOptimizer(cfg_));
+  }
+  if (cfg_.quantization() == RewriterConfig::ON) {
+    GraphOptimizer* optimizer = NewQuantizationOptimizer(cfg_);
+    if (optimizer != nullptr) optimizers->emplace_back(optimizer);
+  }
   if (cfg_.layout_optimizer() != RewriterConfig::OFF) {
     optimizers->emplace_back(new LayoutOptimizer());
   }
@@ -137,11 +193,13 @@ Status MetaOptimizer::InitializeOptimizers(
     if (cfg_.memory_optimizer_target_node_name_scope().empty()) {
       optimizers->emplace_back(
           // Use the default target node name prefix "gradients/"
-          new MemoryOptimizer(cfg_.memory_optimization()));
+          new MemoryOptimizer(cfg_.memory_optimization(), "gradients/",
+                              cfg_.rematerialization_memory_budget()));
     } else {
       optimizers->emplace_back(
           new MemoryOptimizer(cfg_.memory_optimization(),
-                              cfg_.memory_optimizer_target_node_name_scope()));
+                              cfg_.memory_optimizer_target_node_name_scope(),
+                              cfg_.rematerialization_memory_budget()));
     }
   }
   if (cfg_.auto_parallel().enable()) {
@@ -152,6 +210,9 @@ Status MetaOptimizer::InitializeOptimizers(
     optimizers->emplace_back(
         new ScopedAllocatorOptimizer(cfg_.scoped_allocator_opts()));
   }
+  if (cfg_.input_forwarding() == RewriterConfig::ON) {
+    optimizers->emplace_back(new InputForwarding());
+  }
   return Status::OK();
 }
 
@@ -219,6 +280,14 @@ Status MetaOptimizer::OptimizeGraph(Cluster* cluster, const GrapplerItem& item,
   GraphOptimizationResult optimization_result(item.id);
   GraphOptimizer* fusion_optimizer = nullptr;
   GraphOptimizer* sa_optimizer = nullptr;
+  GraphOptimizer* forwarding_optimizer = nullptr;
+
+  // When the optimizers run more than once, an optimizer is skipped if no
+  // other optimizer changed the graph since its last run, which would then
+  // be a no-op. Graphs are compared by fingerprint, 0 when it's unknown.
+  const bool track_changes = NumIterations(cfg_) > 1;
+  uint64 fingerprint = track_changes ? GraphFingerprint(*optimized_graph) : 0;
+  std::unordered_map<const GraphOptimizer*, uint64> last_run_fingerprints;
 
   for (int iteration = 0; iteration < NumIterations(cfg_); ++iteration) {
     VLOG(4) << "Starting optimization iteration " << iteration + 1;
@@ -231,14 +300,32 @@ Status MetaOptimizer::OptimizeGraph(Cluster* cluster, const GrapplerItem& item,
         if (sa_optimizer == nullptr) sa_optimizer = optimizer.get();
         continue;
       }
+      if (optimizer->name() == "input_forwarding") {
+        if (forwarding_optimizer == nullptr) {
+          forwarding_optimizer = optimizer.get();
+        }
+        continue;
+      }
       if (optimizer->name() == "xla-fusion") {
         if (fusion_optimizer == nullptr) fusion_optimizer = optimizer.get();
         continue;
       }
+      if (fingerprint != 0 &&
+          last_run_fingerprints[optimizer.get()] == fingerprint) {
+        VLOG(4) << optimizer->name() << ": skipped, graph unchanged";
+        mutex_lock l(mu_);
+        ++optimizer_timings_[optimizer->name()].num_skipped;
+        continue;
+      }
 
       Status status = RunOptimizer(optimizer.get(), cluster, &optimized_item,
                                    optimized_graph, &optimization_result);
-      if (status.ok()) is_optimized = true;
+      if (status.ok()) {
+        is_optimized = true;
+        if (track_changes) fingerprint = GraphFingerprint(*optimized_graph);
+      }
+      // A failed run leaves the graph unchanged, and would fail again.
+      last_run_fingerprints[optimizer.get()] = fingerprint;
     }
   }
 
@@ -254,15 +341,25 @@ Status MetaOptimizer::OptimizeGraph(Cluster* cluster, const GrapplerItem& item,
     if (status.ok()) is_optimized = true;
   }
 
-  // ScopedAllocatorOptimizer must run last.
+  // ScopedAllocatorOptimizer must run last, except for InputForwarding: its
+  // buffer reservations are only useful if no consumer is added afterwards.
   if (sa_optimizer != nullptr) {
     Status status = RunOptimizer(sa_optimizer, cluster, &optimized_item,
                                  optimized_graph, &optimization_result);
     if (status.ok()) is_optimized = true;
   }
+  if (forwarding_optimizer != nullptr) {
+    Status status = RunOptimizer(forwarding_optimizer, cluster,
+                                 &optimized_item, optimized_graph,
+                                 &optimization_result);
+    if (status.ok()) is_optimized = true;
+  }
 
   // Record graph optimization result.
-  optimization_results_.push_back(optimization_result);
+  {
+    mutex_lock l(mu_);
+    optimization_results_.push_back(optimization_result);
+  }
 
   if (is_optimized) {
     TF_RETURN_IF_ERROR(TopologicalSort(optimized_graph));
@@ -286,6 +383,12 @@ Status MetaOptimizer::RunOptimizer(
   Status status =
       optimizer->Optimize(cluster, *optimized_item, optimized_graph);
   uint64 end_us = Env::Default()->NowMicros();
+  {
+    mutex_lock l(mu_);
+    OptimizerTiming& timing = optimizer_timings_[optimizer->name()];
+    ++timing.num_runs;
+    timing.total_us += end_us - start_us;
+  }
 
   string result;
   if (!status.ok()) {
@@ -304,9 +407,77 @@ Status MetaOptimizer::RunOptimizer(
   return status;
 }
 
+Status MetaOptimizer::OptimizeFunctions(
+    Cluster* cluster, const std::vector<const FunctionDef*>& funcs,
+    FunctionLibraryDefinition* flib) {
+  if (funcs.empty()) return Status::OK();
+
+  // Make a GrapplerItem from each FunctionDef.
+  std::vector<GrapplerFunctionItem> func_items(funcs.size());
+  for (int i = 0; i < funcs.size(); ++i) {
+    VLOG(3) << "Optimize function: function=" << funcs[i]->signature().name();
+    TF_RETURN_IF_ERROR(MakeGrapplerFunctionItem(*funcs[i], *flib,
+                                                &func_items[i]));
+  }
+
+  // Optimize function body graphs, which don't depend on each other. Each
+  // OptimizeGraph call creates its own optimizers.
+  std::vector<GraphDef> optimized_func_graphs(funcs.size());
+  std::vector<Status> statuses(funcs.size());
+  auto optimize = [&](int i) {
+    statuses[i] =
+        OptimizeGraph(cluster, func_items[i], &optimized_func_graphs[i]);
+  };
+  const int num_threads =
+      std::min<int>(funcs.size(), port::NumSchedulableCPUs());
+  if (num_threads <= 1) {
+    for (int i = 0; i < funcs.size(); ++i) optimize(i);
+  } else {
+    thread::ThreadPool pool(Env::Default(), "optimize_functions", num_threads);
+    BlockingCounter counter(funcs.size());
+    for (int i = 0; i < funcs.size(); ++i) {
+      pool.Schedule([&optimize, &counter, i]() {
+        optimize(i);
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  }
+
+  // Update the library in the order of the functions, as if they were
+  // optimized one after the other.
+  for (int i = 0; i < funcs.size(); ++i) {
+    TF_RETURN_IF_ERROR(statuses[i]);
+
+    // Function body optimization might have created new specialized
+    // functions for each instantiation context. Add them to the library.
+    for (const FunctionDef& func_def :
+         optimized_func_graphs[i].library().function()) {
+      if (flib->Find(func_def.signature().name()) == nullptr) {
+        TF_RETURN_IF_ERROR(flib->AddFunctionDef(func_def));
+      }
+    }
+
+    // Convert optimized graph back to FunctionDef.
+    FunctionDef optimized_func;
+    func_items[i].SwapFunctionBody(std::move(optimized_func_graphs[i]));
+    TF_RETURN_IF_ERROR(MakeFunctionDef(func_items[i], *flib, &optimized_func));
+
+    // Replace optimized function with a new FunctionDef.
+    const string& func_name = funcs[i]->signature().name();
+    TF_RETURN_IF_ERROR(flib->RemoveFunction(func_name));
+    TF_RETURN_IF_ERROR(flib->AddFunctionDef(optimized_func));
+  }
+  return Status::OK();
+}
+
 Status MetaOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
                                GraphDef* optimized_graph) {
-  optimization_results_.clear();
+  {
+    mutex_lock l(mu_);
+    optimization_results_.clear();
+    optimizer_timings_.clear();
+  }
 
   // 1. Optimize main graph
   TF_RETURN_IF_ERROR(OptimizeGraph(cluster, item, optimized_graph));
@@ -322,6 +493,7 @@ Status MetaOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
   while (optimize_function_library) {
     optimize_function_library = false;
 
+    std::vector<const FunctionDef*> funcs;
     for (const FunctionDef& func : optimized_graph->library().function()) {
       const string& func_name = func.signature().name();
 
@@ -332,40 +504,13 @@ Status MetaOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
       // function call time by caller node attributes).
       if (IsParametrized(func)) continue;
 
-      VLOG(3) << "Optimize function: function=" << func_name;
-
       // Function optimization might specialize nested function calls, so we
       // have to reset the flag and do at least one more pass over the library.
       optimize_function_library = true;
       optimized_funcs.insert(func_name);
-
-      // Make a GrapplerItem from a FunctionDef.
-      GrapplerFunctionItem func_item;
-      TF_RETURN_IF_ERROR(MakeGrapplerFunctionItem(func, flib, &func_item));
-
-      // Optimize function body graph.
-      GraphDef optimized_func_graph;
-      TF_RETURN_IF_ERROR(
-          OptimizeGraph(cluster, func_item, &optimized_func_graph));
-
-      // Function body optimization might have created new specialized
-      // functions for each instantiation context. Add them to the library.
-      for (const FunctionDef& func_def :
-           optimized_func_graph.library().function()) {
-        if (flib.Find(func_def.signature().name()) == nullptr) {
-          TF_RETURN_IF_ERROR(flib.AddFunctionDef(func_def));
-        }
-      }
-
-      // Convert optimized graph back to FunctionDef.
-      FunctionDef optimized_func;
-      func_item.SwapFunctionBody(std::move(optimized_func_graph));
-      TF_RETURN_IF_ERROR(MakeFunctionDef(func_item, flib, &optimized_func));
-
-      // Replace optimized function with a new FunctionDef.
-      TF_RETURN_IF_ERROR(flib.RemoveFunction(func_name));
-      TF_RETURN_IF_ERROR(flib.AddFunctionDef(optimized_func));
+      funcs.push_back(&func);
     }
+    TF_RETURN_IF_ERROR(OptimizeFunctions(cluster, funcs, &flib));
 
     // If optimized at least one function, update the graph library.
     if (optimize_function_library) {
@@ -380,12 +525,26 @@ Status MetaOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
 }
 
 void MetaOptimizer::PrintResult() {
+  mutex_lock l(mu_);
   for (const GraphOptimizationResult& graph_result : optimization_results_) {
     LOG(INFO) << "Optimization results for grappler item: " << graph_result.id;
     for (const OptimizerResult& result : graph_result.results) {
       LOG(INFO) << "  " << result.optimizer_name << ": " << result.result;
     }
   }
+  LOG(INFO) << "Optimizer timings:";
+  for (const auto& timing : optimizer_timings_) {
+    LOG(INFO) << "  " << timing.first << ": "
+              << timing.second.total_us / 1000.0f << "ms in "
+              << timing.second.num_runs << " runs ("
+              << timing.second.num_skipped << " skipped)";
+  }
+}
+
+std::map<string, MetaOptimizer::OptimizerTiming>
+MetaOptimizer::GetOptimizerTimings() const {
+  mutex_lock l(mu_);
+  return optimizer_timings_;
 }
 
 void MetaOptimizer::Feedback(Cluster* cluster, const GrapplerItem& item,
@@ -407,6 +566,10 @@ bool MetaOptimizerEnabled(const RewriterConfig& cfg) {
          cfg.memory_optimization() != RewriterConfig::NO_MEM_OPT ||
          cfg.debug_stripper() == RewriterConfig::ON ||
          cfg.scoped_allocator_optimization() == RewriterConfig::ON ||
+         cfg.elementwise_fusion() == RewriterConfig::ON ||
+         cfg.placement_optimization() == RewriterConfig::ON ||
+         cfg.input_forwarding() == RewriterConfig::ON ||
+         cfg.quantization() == RewriterConfig::ON ||
          !cfg.optimizers().empty() || !cfg.custom_optimizers().empty();
 }
 
@@ -16,10 +16,15 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_META_OPTIMIZER_H_
 #define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_META_OPTIMIZER_H_
 
+#include <map>
+
 #include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/framework/function.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/protobuf/rewriter_config.pb.h"
 
 namespace tensorflow {
@@ -39,6 +44,16 @@ class MetaOptimizer : public GraphOptimizer {
 
   void PrintResult();
 
+  // Time spent in each optimizer, summed over all its runs on the main graph
+  // and the function library.
+  struct OptimizerTiming {
+    int num_runs = 0;
+    // Runs skipped because the graph didn't change since the last run.
+    int num_skipped = 0;
+    uint64 total_us = 0;
+  };
+  std::map<string, OptimizerTiming> GetOptimizerTimings() const;
+
   void Feedback(Cluster* cluster, const GrapplerItem& item,
                 const GraphDef& optimized_graph, double result) override;
 
@@ -54,10 +69,16 @@ class MetaOptimizer : public GraphOptimizer {
       std::vector<std::unique_ptr<GraphOptimizer>>* optimizers) const;
 
   // Run optimization pass over a single GrapplerItem. Meta optimizer might run
-  // multiple such passes: 1) for the main graph 2) for the function library
+  // multiple such passes: 1) for the main graph 2) for the function library.
+  // The function bodies are optimized concurrently.
   Status OptimizeGraph(Cluster* cluster, const GrapplerItem& item,
                        GraphDef* optimized_graph);
 
+  // Optimizes the bodies of `funcs` in parallel, and replaces them in `flib`.
+  Status OptimizeFunctions(Cluster* cluster,
+                           const std::vector<const FunctionDef*>& funcs,
+                           FunctionLibraryDefinition* flib);
+
   DeviceBase* const cpu_device_;  // may be NULL
   RewriterConfig cfg_;
 
@@ -76,7 +97,9 @@ class MetaOptimizer : public GraphOptimizer {
                       GrapplerItem* optimized_item, GraphDef* optimized_graph,
                       GraphOptimizationResult* optimization_result);
 
-  std::vector<GraphOptimizationResult> optimization_results_;
+  mutable mutex mu_;
+  std::vector<GraphOptimizationResult> optimization_results_ GUARDED_BY(mu_);
+  std::map<string, OptimizerTiming> optimizer_timings_ GUARDED_BY(mu_);
 };
 
 bool MetaOptimizerEnabled(const RewriterConfig& cfg);
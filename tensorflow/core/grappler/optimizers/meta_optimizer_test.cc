@@ -64,6 +64,29 @@ bool TestOptimizer::optimized_;
 
 REGISTER_GRAPH_OPTIMIZER(TestOptimizer);
 
+// Returns its input graph unchanged.
+class NoopOptimizer : public CustomGraphOptimizer {
+ public:
+  NoopOptimizer() {}
+  string name() const override { return "noop_optimizer"; }
+
+  Status Init(const tensorflow::RewriterConfig_CustomGraphOptimizer* config =
+                  nullptr) override {
+    return Status::OK();
+  }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override {
+    *optimized_graph = item.graph;
+    return Status::OK();
+  }
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimized_graph, double result) override {}
+};
+
+REGISTER_GRAPH_OPTIMIZER(NoopOptimizer);
+
 class MetaOptimizerTest : public GrapplerTest {};
 
 TEST_F(MetaOptimizerTest, RunsCustomOptimizer) {
@@ -96,6 +119,48 @@ TEST_F(MetaOptimizerTest, RunOptimizersTwice) {
   TF_EXPECT_OK(status);
 }
 
+TEST_F(MetaOptimizerTest, SkipOptimizersOnUnchangedGraph) {
+  TrivialTestGraphInputYielder fake_input(4, 1, 10, false, {"CPU:0"});
+  GrapplerItem item;
+  CHECK(fake_input.NextItem(&item));
+
+  RewriterConfig rewriter_config;
+  rewriter_config.set_meta_optimizer_iterations(RewriterConfig::TWO);
+  rewriter_config.add_optimizers("NoopOptimizer");
+
+  MetaOptimizer optimizer(nullptr, rewriter_config);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // The second iteration would see the graph output by the first one.
+  const auto timings = optimizer.GetOptimizerTimings();
+  ASSERT_EQ(1, timings.count("noop_optimizer"));
+  EXPECT_EQ(1, timings.at("noop_optimizer").num_runs);
+  EXPECT_EQ(1, timings.at("noop_optimizer").num_skipped);
+}
+
+TEST_F(MetaOptimizerTest, RecordOptimizerTimings) {
+  TrivialTestGraphInputYielder fake_input(4, 1, 10, false, {"CPU:0"});
+  GrapplerItem item;
+  CHECK(fake_input.NextItem(&item));
+
+  RewriterConfig rewriter_config;
+  rewriter_config.set_meta_optimizer_iterations(RewriterConfig::ONE);
+  rewriter_config.add_optimizers("pruning");
+  rewriter_config.add_optimizers("NoopOptimizer");
+
+  MetaOptimizer optimizer(nullptr, rewriter_config);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  const auto timings = optimizer.GetOptimizerTimings();
+  EXPECT_EQ(2, timings.size());
+  for (const auto& timing : timings) {
+    EXPECT_EQ(1, timing.second.num_runs) << timing.first;
+    EXPECT_EQ(0, timing.second.num_skipped) << timing.first;
+  }
+}
+
 TEST_F(MetaOptimizerTest, OptimizeFunctionLibrary) {
   using test::function::NDef;
 
@@ -0,0 +1,502 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/placement_optimizer.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/grappler/clusters/cluster.h"
+#include "tensorflow/core/grappler/costs/analytical_cost_estimator.h"
+#include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/costs/virtual_scheduler.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/grappler/utils/topological_sort.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/util/device_name_utils.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+// Fixed cost of a transfer between two devices, in microseconds.
+constexpr double kTransferLatencyUs = 5.0;
+// Bandwidth of the devices that don't report one, in bytes per microsecond.
+constexpr double kDefaultBandwidth = 10000.0;
+// Bounds the number of placements simulated to refine the greedy one.
+constexpr int kMaxRefinementMoves = 256;
+
+// Returns the size of a tensor in bytes, or 0 if it isn't known.
+int64 TensorBytes(const OpInfo::TensorProperties& tensor) {
+  if (tensor.shape().unknown_rank()) return 0;
+  int64 num_elements = 1;
+  for (const auto& dim : tensor.shape().dim()) {
+    if (dim.size() < 0) return 0;
+    num_elements *= dim.size();
+  }
+  return num_elements * DataTypeSize(BaseType(tensor.dtype()));
+}
+
+// Forwards to an OpLevelCostEstimator owned by someone else.
+class UnownedOpLevelCostEstimator : public OpLevelCostEstimator {
+ public:
+  explicit UnownedOpLevelCostEstimator(const OpLevelCostEstimator* estimator)
+      : estimator_(estimator) {}
+
+  Costs PredictCosts(const OpContext& op_context) const override {
+    return estimator_->PredictCosts(op_context);
+  }
+
+ private:
+  const OpLevelCostEstimator* estimator_;
+};
+
+// A list scheduling of the nodes of a graph over a set of devices. The nodes
+// of a colocation group are always assigned to the same device.
+class PlacementSearch {
+ public:
+  PlacementSearch(const GrapplerItem& item, const GraphProperties& properties,
+                  const std::vector<string>& device_names,
+                  const std::vector<DeviceProperties>& devices,
+                  const OpLevelCostEstimator& estimator)
+      : item_(item),
+        properties_(properties),
+        device_names_(device_names),
+        devices_(devices),
+        estimator_(estimator) {}
+
+  Status Init();
+
+  // Assigns each node to the device where it finishes first, in order.
+  void PlaceGreedily();
+  // Moves the most expensive groups between devices while the simulated
+  // schedule gets shorter.
+  void Refine();
+
+  // Simulated step time of the current placement, in microseconds.
+  double makespan() const { return makespan_; }
+
+  // Sets the device of the placed nodes of `graph`.
+  void Apply(GraphDef* graph) const;
+
+ private:
+  struct Edge {
+    int node;
+    // Bytes transferred if the nodes are on different devices.
+    int64 bytes;
+  };
+
+  int FindGroup(int node) {
+    while (group_[node] != node) {
+      group_[node] = group_[group_[node]];
+      node = group_[node];
+    }
+    return node;
+  }
+  void Colocate(int a, int b) { group_[FindGroup(a)] = FindGroup(b); }
+
+  int DeviceOf(int node) const { return group_devices_[group_[node]]; }
+
+  double TransferTime(int64 bytes, int from, int to) const {
+    if (from < 0 || to < 0 || from == to) return 0;
+    return kTransferLatencyUs +
+           bytes / std::min(bandwidth_[from], bandwidth_[to]);
+  }
+
+  // Returns the time at which the inputs of a node are available on a device.
+  double ReadyTime(int node, int device,
+                   const std::vector<double>& finish) const {
+    double ready = 0;
+    for (const Edge& fanin : fanins_[node]) {
+      const double transfer =
+          TransferTime(fanin.bytes, DeviceOf(fanin.node), device);
+      ready = std::max(ready, finish[fanin.node] + transfer);
+    }
+    return ready;
+  }
+
+  // Returns the step time of the current placement.
+  double Simulate() const;
+
+  // Orders the nodes by decreasing length of their critical path to the end
+  // of the graph, with the average costs over the devices.
+  void ComputeOrder();
+
+  const GrapplerItem& item_;
+  const GraphProperties& properties_;
+  const std::vector<string>& device_names_;
+  const std::vector<DeviceProperties>& devices_;
+  const OpLevelCostEstimator& estimator_;
+  // Bytes per microsecond.
+  std::vector<double> bandwidth_;
+
+  // Nodes in topological order.
+  std::vector<const NodeDef*> nodes_;
+  std::vector<std::vector<Edge>> fanins_;
+  std::vector<std::vector<Edge>> fanouts_;
+  // Cost of each node on each allowed device, in microseconds.
+  std::vector<std::vector<double>> costs_;
+  // Colocation group of each node, then the devices allowed for each group.
+  std::vector<int> group_;
+  std::vector<std::vector<bool>> allowed_;
+  // Device of each group, or -1 if it's left unplaced.
+  std::vector<int> group_devices_;
+  // Schedule order of the nodes.
+  std::vector<int> order_;
+  double makespan_ = 0;
+};
+
+Status PlacementSearch::Init() {
+  for (const auto& device : devices_) {
+    // The bandwidth is in KB/s.
+    bandwidth_.push_back(device.bandwidth() > 0
+                             ? device.bandwidth() * 1024.0 / 1e6
+                             : kDefaultBandwidth);
+  }
+  std::vector<DeviceNameUtils::ParsedName> parsed_devices(devices_.size());
+  for (int d = 0; d < devices_.size(); ++d) {
+    if (!DeviceNameUtils::ParseFullName(device_names_[d],
+                                        &parsed_devices[d])) {
+      return errors::InvalidArgument("Invalid device name ", device_names_[d]);
+    }
+  }
+
+  std::unordered_map<const NodeDef*, int> topo_order;
+  TF_RETURN_IF_ERROR(
+      ComputeTopologicalOrder(item_.graph, &topo_order, nullptr));
+  for (const NodeDef& node : item_.graph.node()) {
+    nodes_.push_back(&node);
+  }
+  std::sort(nodes_.begin(), nodes_.end(),
+            [&topo_order](const NodeDef* a, const NodeDef* b) {
+              return topo_order[a] < topo_order[b];
+            });
+  std::unordered_map<string, int> node_index;
+  for (int i = 0; i < nodes_.size(); ++i) {
+    node_index[nodes_[i]->name()] = i;
+  }
+
+  const int num_nodes = nodes_.size();
+  fanins_.resize(num_nodes);
+  fanouts_.resize(num_nodes);
+  costs_.assign(num_nodes, std::vector<double>(devices_.size(), 0));
+  group_.resize(num_nodes);
+  std::iota(group_.begin(), group_.end(), 0);
+  std::vector<std::vector<bool>> node_allowed(
+      num_nodes, std::vector<bool>(devices_.size(), false));
+
+  for (int i = 0; i < num_nodes; ++i) {
+    const NodeDef& node = *nodes_[i];
+
+    // Data and control edges, without the back edges of loops.
+    const auto& outputs = properties_.GetOutputProperties(node.name());
+    for (const string& input : node.input()) {
+      int position;
+      const string producer_name = ParseNodeName(input, &position);
+      auto it = node_index.find(producer_name);
+      if (it == node_index.end() || it->second >= i) continue;
+      const int producer = it->second;
+      int64 bytes = 0;
+      if (position >= 0) {
+        const auto& producer_outputs =
+            properties_.GetOutputProperties(producer_name);
+        if (position < producer_outputs.size()) {
+          const OpInfo::TensorProperties& tensor = producer_outputs[position];
+          bytes = TensorBytes(tensor);
+          // References and resources must stay on the device of the
+          // producer.
+          if (IsRefType(tensor.dtype()) || tensor.dtype() == DT_RESOURCE) {
+            Colocate(i, producer);
+          }
+        }
+      }
+      fanins_[i].push_back({producer, bytes});
+      fanouts_[producer].push_back({i, bytes});
+    }
+
+    // Explicit colocation constraints.
+    auto class_attr = node.attr().find(kColocationAttrName);
+    if (class_attr != node.attr().end()) {
+      for (const string& entry : class_attr->second.list().s()) {
+        StringPiece name(entry);
+        if (!str_util::ConsumePrefix(&name, kColocationGroupPrefix)) continue;
+        auto it = node_index.find(name.ToString());
+        if (it != node_index.end()) Colocate(i, it->second);
+      }
+    }
+
+    // The devices matching the requested one, with a kernel for the node.
+    DeviceNameUtils::ParsedName requested;
+    if (!node.device().empty() &&
+        !DeviceNameUtils::ParseFullName(node.device(), &requested)) {
+      continue;
+    }
+    OpContext op_context;
+    op_context.name = node.name();
+    op_context.op_info.set_op(node.op());
+    *op_context.op_info.mutable_attr() = node.attr();
+    for (const auto& input : properties_.GetInputProperties(node.name())) {
+      *op_context.op_info.add_inputs() = input;
+    }
+    for (const auto& output : outputs) {
+      *op_context.op_info.add_outputs() = output;
+    }
+    for (int d = 0; d < devices_.size(); ++d) {
+      if (!node.device().empty() &&
+          !DeviceNameUtils::IsSpecification(requested, parsed_devices[d])) {
+        continue;
+      }
+      if (!FindKernelDef(DeviceType(devices_[d].type()), node, nullptr,
+                         nullptr)
+               .ok()) {
+        continue;
+      }
+      node_allowed[i][d] = true;
+      op_context.device_name = device_names_[d];
+      *op_context.op_info.mutable_device() = devices_[d];
+      costs_[i][d] =
+          estimator_.PredictCosts(op_context).execution_time.count() / 1e3;
+    }
+  }
+
+  // A group can only go to the devices allowed for all its nodes.
+  allowed_.assign(num_nodes, std::vector<bool>(devices_.size(), true));
+  for (int i = 0; i < num_nodes; ++i) {
+    group_[i] = FindGroup(i);
+    for (int d = 0; d < devices_.size(); ++d) {
+      if (!node_allowed[i][d]) allowed_[group_[i]][d] = false;
+    }
+  }
+  group_devices_.assign(num_nodes, -1);
+  ComputeOrder();
+  return Status::OK();
+}
+
+void PlacementSearch::ComputeOrder() {
+  const int num_nodes = nodes_.size();
+  const double min_bandwidth =
+      *std::min_element(bandwidth_.begin(), bandwidth_.end());
+  // Fraction of the edges that cross devices under a random placement.
+  const double cross_device = 1.0 - 1.0 / devices_.size();
+  std::vector<double> rank(num_nodes, 0);
+  for (int i = num_nodes - 1; i >= 0; --i) {
+    double cost = 0;
+    int num_allowed = 0;
+    for (int d = 0; d < devices_.size(); ++d) {
+      if (allowed_[group_[i]][d]) {
+        cost += costs_[i][d];
+        ++num_allowed;
+      }
+    }
+    double successors = 0;
+    for (const Edge& fanout : fanouts_[i]) {
+      const double transfer =
+          cross_device * (kTransferLatencyUs + fanout.bytes / min_bandwidth);
+      successors = std::max(successors, transfer + rank[fanout.node]);
+    }
+    rank[i] = (num_allowed > 0 ? cost / num_allowed : 0) + successors;
+  }
+  // A node ranks at least as high as its fanouts, and comes first on ties.
+  order_.resize(num_nodes);
+  std::iota(order_.begin(), order_.end(), 0);
+  std::stable_sort(order_.begin(), order_.end(), [&rank](int a, int b) {
+    return rank[a] > rank[b];
+  });
+}
+
+void PlacementSearch::PlaceGreedily() {
+  std::vector<double> finish(nodes_.size(), 0);
+  std::vector<double> available(devices_.size(), 0);
+  for (int i : order_) {
+    const int group = group_[i];
+    int best_device = -1;
+    double best_finish = std::numeric_limits<double>::max();
+    for (int d = 0; d < devices_.size(); ++d) {
+      if (!allowed_[group][d]) continue;
+      if (group_devices_[group] >= 0 && group_devices_[group] != d) continue;
+      const double end =
+          std::max(available[d], ReadyTime(i, d, finish)) + costs_[i][d];
+      if (end < best_finish) {
+        best_device = d;
+        best_finish = end;
+      }
+    }
+    if (best_device < 0) {
+      finish[i] = ReadyTime(i, -1, finish);
+      continue;
+    }
+    group_devices_[group] = best_device;
+    available[best_device] = best_finish;
+    finish[i] = best_finish;
+  }
+  makespan_ = *std::max_element(finish.begin(), finish.end());
+}
+
+double PlacementSearch::Simulate() const {
+  std::vector<double> finish(nodes_.size(), 0);
+  std::vector<double> available(devices_.size(), 0);
+  for (int i : order_) {
+    const int d = DeviceOf(i);
+    if (d < 0) {
+      finish[i] = ReadyTime(i, -1, finish);
+      continue;
+    }
+    finish[i] = std::max(available[d], ReadyTime(i, d, finish)) + costs_[i][d];
+    available[d] = finish[i];
+  }
+  return *std::max_element(finish.begin(), finish.end());
+}
+
+void PlacementSearch::Refine() {
+  // The groups that could move, by decreasing cost on their device.
+  std::unordered_map<int, double> group_costs;
+  for (int i = 0; i < nodes_.size(); ++i) {
+    const int d = DeviceOf(i);
+    if (d < 0) continue;
+    int num_allowed = 0;
+    for (bool allowed : allowed_[group_[i]]) num_allowed += allowed;
+    if (num_allowed > 1) group_costs[group_[i]] += costs_[i][d];
+  }
+  std::vector<int> groups;
+  for (const auto& group_cost : group_costs) {
+    groups.push_back(group_cost.first);
+  }
+  std::sort(groups.begin(), groups.end(), [&group_costs](int a, int b) {
+    return group_costs[a] > group_costs[b] ||
+           (group_costs[a] == group_costs[b] && a < b);
+  });
+
+  int num_moves = 0;
+  bool improved = true;
+  while (improved && num_moves < kMaxRefinementMoves) {
+    improved = false;
+    for (int group : groups) {
+      const int current = group_devices_[group];
+      for (int d = 0; d < devices_.size(); ++d) {
+        if (d == current || !allowed_[group][d]) continue;
+        if (num_moves++ >= kMaxRefinementMoves) return;
+        group_devices_[group] = d;
+        const double makespan = Simulate();
+        if (makespan < makespan_) {
+          makespan_ = makespan;
+          improved = true;
+          break;
+        }
+        group_devices_[group] = current;
+      }
+    }
+  }
+}
+
+void PlacementSearch::Apply(GraphDef* graph) const {
+  std::unordered_map<string, int> devices;
+  for (int i = 0; i < nodes_.size(); ++i) {
+    if (DeviceOf(i) >= 0) devices[nodes_[i]->name()] = DeviceOf(i);
+  }
+  for (NodeDef& node : *graph->mutable_node()) {
+    auto it = devices.find(node.name());
+    if (it != devices.end()) node.set_device(device_names_[it->second]);
+  }
+}
+
+// Returns the step time of `graph` predicted by an AnalyticalCostEstimator.
+Status PredictStepTime(Cluster* cluster, const GrapplerItem& item,
+                       const GraphDef& graph,
+                       const OpLevelCostEstimator& estimator,
+                       Costs::Duration* step_time) {
+  AnalyticalCostEstimator cost_estimator(
+      cluster, new UnownedOpLevelCostEstimator(&estimator),
+      VirtualScheduler::ReadyNodeManagerFactory("FirstReady"),
+      /*use_static_shapes=*/true);
+  TF_RETURN_IF_ERROR(cost_estimator.Initialize(item));
+  Costs costs;
+  TF_RETURN_IF_ERROR(cost_estimator.PredictCosts(graph, nullptr, &costs));
+  *step_time = costs.execution_time;
+  return Status::OK();
+}
+
+}  // namespace
+
+Status PlacementOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
+                                    GraphDef* optimized_graph) {
+  *optimized_graph = item.graph;
+  if (cluster == nullptr) return Status::OK();
+
+  std::vector<string> device_names;
+  for (const auto& device : cluster->GetDevices()) {
+    device_names.push_back(device.first);
+  }
+  if (device_names.size() < 2) return Status::OK();
+  std::sort(device_names.begin(), device_names.end());
+  std::vector<DeviceProperties> devices;
+  for (const string& name : device_names) {
+    devices.push_back(cluster->GetDevices().at(name));
+  }
+
+  GraphProperties properties(item);
+  TF_RETURN_IF_ERROR(properties.InferStatically(false));
+  PlacementSearch search(item, properties, device_names, devices,
+                         *estimator_);
+  TF_RETURN_IF_ERROR(search.Init());
+  search.PlaceGreedily();
+  const double greedy_makespan = search.makespan();
+  search.Refine();
+  VLOG(1) << "Simulated step time of the placement: greedy "
+          << greedy_makespan << "us, refined " << search.makespan() << "us";
+
+  GraphDef placed_graph = item.graph;
+  search.Apply(&placed_graph);
+
+  // Keep the placement only if it's predicted to be faster, including the
+  // transfers the scheduler models between the devices.
+  Costs::Duration original_time;
+  Costs::Duration placed_time;
+  Status status = PredictStepTime(cluster, item, item.graph, *estimator_,
+                                  &original_time);
+  if (status.ok()) {
+    status = PredictStepTime(cluster, item, placed_graph, *estimator_,
+                             &placed_time);
+  }
+  if (!status.ok()) {
+    VLOG(1) << "Keeping the original placement: " << status;
+    return Status::OK();
+  }
+  VLOG(1) << "Predicted step time: original " << original_time.count()
+          << "ns, placed " << placed_time.count() << "ns";
+  if (placed_time < original_time) {
+    optimized_graph->Swap(&placed_graph);
+  }
+  return Status::OK();
+}
+
+void PlacementOptimizer::Feedback(Cluster* /*cluster*/,
+                                  const GrapplerItem& /*item*/,
+                                  const GraphDef& /*optimized_graph*/,
+                                  double /*result*/) {
+  // Nothing to do for PlacementOptimizer.
+}
+
+}  // end namespace grappler
+}  // end namespace tensorflow
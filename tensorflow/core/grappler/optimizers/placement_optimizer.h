@@ -0,0 +1,65 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_PLACEMENT_OPTIMIZER_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_PLACEMENT_OPTIMIZER_H_
+
+#include <memory>
+
+#include "tensorflow/core/grappler/costs/op_level_cost_estimator.h"
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Assigns the nodes of a graph to the devices of the cluster so as to minimize
+// the simulated step time, e.g. across the NUMA nodes of a host, or across CPU
+// and accelerators.
+//
+// Op costs on each device are estimated with an OpLevelCostEstimator, and
+// cross-device transfers cost a fixed latency plus their size over the lower
+// memory bandwidth of the two devices. A greedy list scheduler assigns every
+// node, in order of decreasing critical path to the end of the graph, to the
+// device where it would finish first, and the most expensive nodes are then
+// moved between devices while that shortens the simulated schedule. The
+// placement is kept only if an AnalyticalCostEstimator predicts it is faster
+// than the original one.
+//
+// Requested devices, colocation groups and reference or resource edges are
+// honored, and a node is only assigned to devices with a kernel for it.
+class PlacementOptimizer : public GraphOptimizer {
+ public:
+  PlacementOptimizer() : estimator_(new OpLevelCostEstimator()) {}
+  // Takes ownership of the estimator, e.g. a CalibratedOpLevelCostEstimator.
+  explicit PlacementOptimizer(OpLevelCostEstimator* estimator)
+      : estimator_(estimator) {}
+  ~PlacementOptimizer() override {}
+
+  string name() const override { return "placement_optimizer"; };
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimized_graph, double result) override;
+
+ private:
+  std::unique_ptr<OpLevelCostEstimator> estimator_;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_PLACEMENT_OPTIMIZER_H_
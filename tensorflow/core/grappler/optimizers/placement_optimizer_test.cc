@@ -0,0 +1,151 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/placement_optimizer.h"
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/grappler/clusters/virtual_cluster.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+constexpr char kCpu0[] = "/job:localhost/replica:0/task:0/cpu:0";
+constexpr char kCpu1[] = "/job:localhost/replica:0/task:0/cpu:1";
+
+class PlacementOptimizerTest : public GrapplerTest {
+ protected:
+  // Two CPUs, e.g. the NUMA nodes of a host.
+  static std::unique_ptr<VirtualCluster> CreateVirtualCluster() {
+    DeviceProperties cpu_device;
+    cpu_device.set_type("CPU");
+    cpu_device.set_frequency(1000);
+    cpu_device.set_num_cores(4);
+    cpu_device.set_bandwidth(10000000);  // 10000000 KB/s = 10 GB/s
+    std::unordered_map<string, DeviceProperties> devices;
+    devices[kCpu0] = cpu_device;
+    devices[kCpu1] = cpu_device;
+    return std::unique_ptr<VirtualCluster>(new VirtualCluster(devices));
+  }
+
+  // Adds a chain of 3 MatMuls of 256x256 matrices, named <prefix>1 to 3.
+  static Output MatMulChain(const Scope& s, const string& prefix) {
+    Output x = ops::Placeholder(
+        s.WithOpName(prefix), DT_FLOAT,
+        ops::Placeholder::Shape(PartialTensorShape({256, 256})));
+    for (int i = 1; i <= 3; ++i) {
+      x = ops::MatMul(s.WithOpName(strings::StrCat(prefix, i)), x, x);
+    }
+    return x;
+  }
+
+  static std::map<string, string> Devices(const GraphDef& graph) {
+    std::map<string, string> devices;
+    for (const NodeDef& node : graph.node()) {
+      devices[node.name()] = node.device();
+    }
+    return devices;
+  }
+};
+
+TEST_F(PlacementOptimizerTest, SingleDevice) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  MatMulChain(s, "a");
+  GrapplerItem item;
+  item.fetch = {"a3"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  DeviceProperties cpu_device;
+  cpu_device.set_type("CPU");
+  VirtualCluster cluster({{kCpu0, cpu_device}});
+
+  PlacementOptimizer optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(&cluster, item, &output));
+  CompareGraphs(item.graph, output);
+}
+
+TEST_F(PlacementOptimizerTest, SplitIndependentChains) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  MatMulChain(s, "a");
+  MatMulChain(s, "b");
+  GrapplerItem item;
+  item.fetch = {"a3", "b3"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  std::unique_ptr<VirtualCluster> cluster(CreateVirtualCluster());
+  PlacementOptimizer optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(cluster.get(), item, &output));
+
+  // Each chain runs on its own CPU.
+  auto devices = Devices(output);
+  EXPECT_EQ(item.graph.node_size(), output.node_size());
+  EXPECT_NE(devices["a3"], devices["b3"]);
+  for (const string& prefix : {"a", "b"}) {
+    const string& device = devices[strings::StrCat(prefix, 3)];
+    EXPECT_TRUE(device == kCpu0 || device == kCpu1) << device;
+    EXPECT_EQ(device, devices[prefix]);
+    EXPECT_EQ(device, devices[strings::StrCat(prefix, 1)]);
+    EXPECT_EQ(device, devices[strings::StrCat(prefix, 2)]);
+  }
+}
+
+TEST_F(PlacementOptimizerTest, KeepRequestedDevices) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  MatMulChain(s.WithDevice(kCpu0), "a");
+  MatMulChain(s, "b");
+  GrapplerItem item;
+  item.fetch = {"a3", "b3"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  std::unique_ptr<VirtualCluster> cluster(CreateVirtualCluster());
+  PlacementOptimizer optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(cluster.get(), item, &output));
+
+  // The unplaced nodes default to the first CPU, so b moves to the second.
+  auto devices = Devices(output);
+  for (const string& node : {"a", "a1", "a2", "a3"}) {
+    EXPECT_EQ(kCpu0, devices[node]);
+  }
+  EXPECT_EQ(kCpu1, devices["b3"]);
+}
+
+TEST_F(PlacementOptimizerTest, KeepColocatedNodesTogether) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output a = MatMulChain(s, "a");
+  Output b = MatMulChain(s, "b");
+  Output c = ops::AddN(s.WithOpName("c").ColocateWith(a), {a, b});
+  GrapplerItem item;
+  item.fetch = {"c"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  std::unique_ptr<VirtualCluster> cluster(CreateVirtualCluster());
+  PlacementOptimizer optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(cluster.get(), item, &output));
+
+  auto devices = Devices(output);
+  EXPECT_EQ(devices["a3"], devices["c"]);
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,600 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define EIGEN_USE_THREADS
+
+#include "tensorflow/core/grappler/optimizers/quantization_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_set>
+
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/grappler/devices.h"
+#include "tensorflow/core/grappler/graph_view.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/grappler/utils/topological_sort.h"
+#include "tensorflow/core/kernels/quantization_utils.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+constexpr char kPrefix[] = "QuantizationOptimizer";
+
+// Returns the name of the tensor read by a regular input, without ":0".
+string TensorName(const string& input) {
+  int position;
+  const string name = ParseNodeName(input, &position);
+  return position == 0 ? name : strings::StrCat(name, ":", position);
+}
+
+// Returns a node name derived from a tensor name.
+string NodeNameForTensor(const string& tensor, const string& suffix) {
+  int position;
+  const string name = ParseNodeName(tensor, &position);
+  return position == 0
+             ? AddPrefixToNodeName(name, strings::StrCat(kPrefix, "/", suffix))
+             : AddPrefixToNodeName(strings::StrCat(name, "_", position),
+                                   strings::StrCat(kPrefix, "/", suffix));
+}
+
+bool IsNhwc(const NodeDef& node) {
+  auto it = node.attr().find("data_format");
+  return it == node.attr().end() || it->second.s() == "NHWC";
+}
+
+bool IsMatMulOrConv(const NodeDef& node) {
+  return node.op() == "MatMul" || node.op() == "Conv2D";
+}
+
+// Returns true if the quantized op produces a 32 bit result, which must be
+// requantized to eight bits.
+bool HasWideOutput(const NodeDef& node) {
+  return IsMatMulOrConv(node) || node.op() == "BiasAdd";
+}
+
+bool IsRelu(const NodeDef& node) {
+  return node.op() == "Relu" || node.op() == "Relu6";
+}
+
+// Returns true if the node is an op with a quantized kernel on CPU that takes
+// and returns the same tensors, in a layout the kernel supports.
+bool HasQuantizedKernel(const NodeDef& node, bool has_gpu) {
+  static const auto* const kNumInputs = new std::unordered_map<string, int>({
+      {"AvgPool", 1}, {"BiasAdd", 2}, {"Conv2D", 2}, {"MatMul", 2},
+      {"MaxPool", 1}, {"Relu", 1},    {"Relu6", 1},
+  });
+  auto it = kNumInputs->find(node.op());
+  if (it == kNumInputs->end() || NumNonControlInputs(node) != it->second) {
+    return false;
+  }
+  auto type = node.attr().find("T");
+  if (type == node.attr().end() || type->second.type() != DT_FLOAT) {
+    return false;
+  }
+  if (!IsOnCpu(node, has_gpu) || !IsNhwc(node)) return false;
+  if (node.op() == "Conv2D") {
+    auto dilations = node.attr().find("dilations");
+    if (dilations != node.attr().end()) {
+      for (int64 dilation : dilations->second.list().i()) {
+        if (dilation != 1) return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool IsFloatConst(const NodeDef& node) {
+  if (node.op() != "Const") return false;
+  auto dtype = node.attr().find("dtype");
+  return dtype != node.attr().end() && dtype->second.type() == DT_FLOAT;
+}
+
+// Widens a range to include 0, which the quantized ops require, and to a
+// non-empty interval, like the quantize_weights graph transform.
+void AdjustRange(float* min, float* max) {
+  *min = std::min(*min, 0.0f);
+  *max = std::max(*max, 0.0f);
+  if (*min == *max) {
+    if (std::abs(*min) < 0.000001f) {
+      *max = *min + 1.0f;
+    } else if (*min > 0) {
+      *max = 2.0f * *min;
+    } else {
+      *max = *min / 2.0f;
+    }
+  }
+}
+
+void SetType(const string& name, DataType type, NodeDef* node) {
+  (*node->mutable_attr())[name].set_type(type);
+}
+
+void CopyAttr(const NodeDef& from, const string& name, NodeDef* to) {
+  auto it = from.attr().find(name);
+  if (it != from.attr().end()) (*to->mutable_attr())[name] = it->second;
+}
+
+// Disjoint sets of nodes, for the regions.
+class Regions {
+ public:
+  const NodeDef* Find(const NodeDef* node) {
+    auto it = parents_.find(node);
+    if (it == parents_.end() || it->second == node) return node;
+    const NodeDef* root = Find(it->second);
+    parents_[node] = root;
+    return root;
+  }
+  void Merge(const NodeDef* a, const NodeDef* b) {
+    parents_[Find(a)] = Find(b);
+  }
+
+ private:
+  std::unordered_map<const NodeDef*, const NodeDef*> parents_;
+};
+
+// A quantized tensor, as the names of the tensors of its eight bit values and
+// of its float range.
+struct QuantizedTensor {
+  string value;
+  string min;
+  string max;
+};
+
+// Emits the quantized graph.
+class QuantizedGraphBuilder {
+ public:
+  QuantizedGraphBuilder(
+      const std::unordered_map<string, std::pair<float, float>>& ranges,
+      GraphDef* graph,
+      QuantizationOptimizer::QuantizationStats* stats)
+      : ranges_(ranges), graph_(graph), stats_(stats) {}
+
+  // Returns the quantized version of a regular input of `consumer`.
+  QuantizedTensor GetQuantizedInput(const string& input,
+                                    const NodeDef& producer,
+                                    const NodeDef& consumer) {
+    const string tensor = TensorName(input);
+    auto it = quantized_.find(tensor);
+    if (it != quantized_.end()) return it->second;
+
+    QuantizedTensor quantized;
+    if (IsFloatConst(producer)) {
+      QuantizeConst(producer, &quantized);
+    } else {
+      std::pair<float, float> range = ranges_.at(tensor);
+      AdjustRange(&range.first, &range.second);
+      NodeDef* quantize = AddNode(NodeNameForTensor(tensor, "Quantize"),
+                                  "QuantizeV2", consumer.device());
+      quantize->add_input(input);
+      quantize->add_input(AddConst(quantize->name() + "/min", range.first,
+                                   consumer.device()));
+      quantize->add_input(AddConst(quantize->name() + "/max", range.second,
+                                   consumer.device()));
+      SetType("T", DT_QUINT8, quantize);
+      (*quantize->mutable_attr())["mode"].set_s("MIN_FIRST");
+      SetOutputs(*quantize, &quantized);
+      ++stats_->num_quantize;
+    }
+    quantized_[tensor] = quantized;
+    return quantized;
+  }
+
+  // Quantizes the value of a float constant at optimization time.
+  void QuantizeConst(const NodeDef& node, QuantizedTensor* quantized) {
+    Tensor value;
+    CHECK(value.FromProto(node.attr().at("value").tensor()));
+    auto values = value.flat<float>();
+    float min = std::numeric_limits<float>::max();
+    float max = std::numeric_limits<float>::lowest();
+    for (int64 i = 0; i < values.size(); ++i) {
+      min = std::min(min, values(i));
+      max = std::max(max, values(i));
+    }
+    AdjustRange(&min, &max);
+    const Tensor quantized_value = FloatTensorToQuantized<quint8>(value, min,
+                                                                  max);
+    NodeDef* quantized_const =
+        AddNode(NodeNameForTensor(node.name(), "Const"), "Const",
+                node.device());
+    SetType("dtype", DT_QUINT8, quantized_const);
+    quantized_value.AsProtoTensorContent(
+        (*quantized_const->mutable_attr())["value"].mutable_tensor());
+    quantized->value = quantized_const->name();
+    quantized->min = AddConst(quantized_const->name() + "/min", min,
+                              node.device());
+    quantized->max = AddConst(quantized_const->name() + "/max", max,
+                              node.device());
+  }
+
+  // Emits the quantized version of `node`, given the quantized versions of
+  // its regular inputs. `relu` is a Relu or Relu6 to fold into the
+  // requantization of the output, if any.
+  void AddQuantizedNode(const NodeDef& node,
+                        const std::vector<QuantizedTensor>& inputs,
+                        const NodeDef* relu) {
+    NodeDef* quantized =
+        AddNode(NodeNameForTensor(node.name(), "Quantized"),
+                strings::StrCat("Quantized", node.op()), node.device());
+    for (const QuantizedTensor& input : inputs) {
+      quantized->add_input(input.value);
+    }
+    for (const QuantizedTensor& input : inputs) {
+      quantized->add_input(input.min);
+      quantized->add_input(input.max);
+    }
+    for (const string& input : node.input()) {
+      if (IsControlInput(input)) {
+        quantized->add_input(QuantizedControlInput(input));
+      }
+    }
+
+    if (node.op() == "MatMul") {
+      SetType("T1", DT_QUINT8, quantized);
+      SetType("T2", DT_QUINT8, quantized);
+      SetType("Toutput", DT_QINT32, quantized);
+      CopyAttr(node, "transpose_a", quantized);
+      CopyAttr(node, "transpose_b", quantized);
+    } else if (node.op() == "Conv2D") {
+      SetType("Tinput", DT_QUINT8, quantized);
+      SetType("Tfilter", DT_QUINT8, quantized);
+      SetType("out_type", DT_QINT32, quantized);
+      CopyAttr(node, "strides", quantized);
+      CopyAttr(node, "padding", quantized);
+      CopyAttr(node, "dilations", quantized);
+    } else if (node.op() == "BiasAdd") {
+      SetType("T1", DT_QUINT8, quantized);
+      SetType("T2", DT_QUINT8, quantized);
+      SetType("out_type", DT_QINT32, quantized);
+    } else if (IsRelu(node)) {
+      SetType("Tinput", DT_QUINT8, quantized);
+      SetType("out_type", DT_QUINT8, quantized);
+    } else {
+      // MaxPool and AvgPool.
+      SetType("T", DT_QUINT8, quantized);
+      CopyAttr(node, "ksize", quantized);
+      CopyAttr(node, "strides", quantized);
+      CopyAttr(node, "padding", quantized);
+    }
+
+    QuantizedTensor output;
+    SetOutputs(*quantized, &output);
+    const NodeDef& result = relu != nullptr ? *relu : node;
+    if (HasWideOutput(node)) {
+      // An uncalibrated folded Relu has the range of its input, clamped.
+      auto it = ranges_.find(result.name());
+      std::pair<float, float> range =
+          it != ranges_.end() ? it->second : ranges_.at(node.name());
+      if (relu != nullptr) {
+        range.first = 0;
+        if (relu->op() == "Relu6") range.second = std::min(range.second, 6.0f);
+      }
+      AdjustRange(&range.first, &range.second);
+      NodeDef* requantize =
+          AddNode(NodeNameForTensor(result.name(), "Requantize"),
+                  "Requantize", node.device());
+      requantize->add_input(output.value);
+      requantize->add_input(output.min);
+      requantize->add_input(output.max);
+      requantize->add_input(AddConst(requantize->name() + "/min", range.first,
+                                     node.device()));
+      requantize->add_input(AddConst(requantize->name() + "/max",
+                                     range.second, node.device()));
+      if (relu != nullptr) {
+        for (const string& input : relu->input()) {
+          if (IsControlInput(input)) {
+            requantize->add_input(QuantizedControlInput(input));
+          }
+        }
+      }
+      SetType("Tinput", DT_QINT32, requantize);
+      SetType("out_type", DT_QUINT8, requantize);
+      SetOutputs(*requantize, &output);
+      ++stats_->num_requantize;
+      requantized_ranges_[result.name()] = range;
+    }
+    quantized_[result.name()] = output;
+    control_inputs_[result.name()] = AsControlDependency(output.value);
+  }
+
+  // Returns the control input which replaces `input` in the quantized graph:
+  // a quantized node only keeps its name if it has float consumers.
+  string QuantizedControlInput(const string& input) const {
+    auto it = control_inputs_.find(NodeName(input));
+    return it == control_inputs_.end() ? input : it->second;
+  }
+
+  // Emits a Dequantize node which replaces `node` for its float consumers.
+  void AddDequantize(const NodeDef& node) {
+    const QuantizedTensor& quantized = quantized_.at(node.name());
+    NodeDef* dequantize = AddNode(node.name(), "Dequantize", node.device());
+    dequantize->add_input(quantized.value);
+    dequantize->add_input(quantized.min);
+    dequantize->add_input(quantized.max);
+    SetType("T", DT_QUINT8, dequantize);
+    (*dequantize->mutable_attr())["mode"].set_s("MIN_FIRST");
+    ++stats_->num_dequantize;
+    const std::pair<float, float>* range = nullptr;
+    auto requantized = requantized_ranges_.find(node.name());
+    if (requantized != requantized_ranges_.end()) {
+      range = &requantized->second;
+    } else {
+      auto calibrated = ranges_.find(node.name());
+      if (calibrated != ranges_.end()) range = &calibrated->second;
+    }
+    if (range != nullptr) {
+      float min = range->first;
+      float max = range->second;
+      AdjustRange(&min, &max);
+      stats_->max_output_rounding_error =
+          std::max(stats_->max_output_rounding_error, (max - min) / 255 / 2);
+    }
+  }
+
+ private:
+  NodeDef* AddNode(const string& name, const string& op,
+                   const string& device) {
+    NodeDef* node = graph_->add_node();
+    node->set_name(name);
+    node->set_op(op);
+    node->set_device(device);
+    return node;
+  }
+
+  string AddConst(const string& name, float value, const string& device) {
+    NodeDef* node = AddNode(name, "Const", device);
+    SetType("dtype", DT_FLOAT, node);
+    Tensor tensor(DT_FLOAT, TensorShape({}));
+    tensor.scalar<float>()() = value;
+    tensor.AsProtoTensorContent(
+        (*node->mutable_attr())["value"].mutable_tensor());
+    return node->name();
+  }
+
+  static void SetOutputs(const NodeDef& node, QuantizedTensor* quantized) {
+    quantized->value = node.name();
+    quantized->min = strings::StrCat(node.name(), ":1");
+    quantized->max = strings::StrCat(node.name(), ":2");
+  }
+
+  const std::unordered_map<string, std::pair<float, float>>& ranges_;
+  GraphDef* graph_;
+  QuantizationOptimizer::QuantizationStats* stats_;
+  // Quantized version of each float tensor, with ":0" omitted.
+  std::unordered_map<string, QuantizedTensor> quantized_;
+  // Range to which the output of each node with a 32 bit result, or of the
+  // Relu folded into it, is requantized.
+  std::unordered_map<string, std::pair<float, float>> requantized_ranges_;
+  // Control input on the last node emitted for each quantized node.
+  std::unordered_map<string, string> control_inputs_;
+};
+
+}  // namespace
+
+std::vector<string> QuantizationCalibrator::TensorsToCalibrate(
+    const GraphDef& graph, const Cluster* cluster) {
+  const bool has_gpu = ClusterHasGpu(cluster);
+  std::unordered_map<string, const NodeDef*> nodes;
+  for (const NodeDef& node : graph.node()) {
+    nodes[node.name()] = &node;
+  }
+  std::vector<string> tensors;
+  std::unordered_set<string> seen;
+  for (const NodeDef& node : graph.node()) {
+    if (!HasQuantizedKernel(node, has_gpu)) continue;
+    for (const string& input : node.input()) {
+      if (IsControlInput(input)) continue;
+      auto producer = nodes.find(NodeName(input));
+      if (producer != nodes.end() && IsFloatConst(*producer->second)) {
+        continue;
+      }
+      const string tensor = TensorName(input);
+      if (seen.insert(tensor).second) tensors.push_back(tensor);
+    }
+    if (seen.insert(node.name()).second) tensors.push_back(node.name());
+  }
+  return tensors;
+}
+
+void QuantizationCalibrator::AddTensor(const string& tensor,
+                                       const Tensor& value) {
+  if (value.dtype() != DT_FLOAT || value.NumElements() == 0) return;
+  auto values = value.flat<float>();
+  const string name = TensorName(tensor);
+  auto it = ranges_.find(name);
+  if (it == ranges_.end()) {
+    it = ranges_.emplace(name, Range{values(0), values(0), 0}).first;
+  }
+  Range& range = it->second;
+  for (int64 i = 0; i < values.size(); ++i) {
+    range.min = std::min(range.min, values(i));
+    range.max = std::max(range.max, values(i));
+  }
+  ++range.num_samples;
+}
+
+QuantizationCalibration QuantizationCalibrator::Calibration() const {
+  QuantizationCalibration calibration;
+  for (const auto& tensor : ranges_) {
+    QuantizationCalibration::Range* range = calibration.add_range();
+    range->set_tensor(tensor.first);
+    range->set_min(tensor.second.min);
+    range->set_max(tensor.second.max);
+    range->set_num_samples(tensor.second.num_samples);
+  }
+  return calibration;
+}
+
+QuantizationOptimizer::QuantizationOptimizer(
+    const QuantizationCalibration& calibration) {
+  for (const auto& range : calibration.range()) {
+    if (range.min() <= range.max()) {
+      ranges_[TensorName(range.tensor())] =
+          std::make_pair(range.min(), range.max());
+    }
+  }
+}
+
+Status QuantizationOptimizer::LoadFromFile(
+    Env* env, const string& filename,
+    std::unique_ptr<QuantizationOptimizer>* optimizer) {
+  QuantizationCalibration calibration;
+  TF_RETURN_IF_ERROR(ReadBinaryProto(env, filename, &calibration));
+  optimizer->reset(new QuantizationOptimizer(calibration));
+  return Status::OK();
+}
+
+Status QuantizationOptimizer::Optimize(Cluster* cluster,
+                                       const GrapplerItem& item,
+                                       GraphDef* optimized_graph) {
+  quantization_stats_ = QuantizationStats();
+  const bool has_gpu = ClusterHasGpu(cluster);
+
+  GraphView graph(const_cast<GraphDef*>(&item.graph));
+  const std::unordered_set<string> nodes_to_preserve = item.NodesToPreserve();
+
+  // An op is quantized if the ranges of its non-constant inputs and of its 32
+  // bit output are known.
+  std::unordered_set<const NodeDef*> candidates;
+  for (const NodeDef& node : item.graph.node()) {
+    if (!HasQuantizedKernel(node, has_gpu)) continue;
+    bool has_ranges = !HasWideOutput(node) || ranges_.count(node.name()) > 0;
+    for (int i = 0; i < NumNonControlInputs(node) && has_ranges; ++i) {
+      const GraphView::OutputPort producer =
+          graph.GetRegularFanin(GraphView::InputPort(&node, i));
+      has_ranges = producer.node != nullptr &&
+                   (IsFloatConst(*producer.node) ||
+                    ranges_.count(TensorName(node.input(i))) > 0);
+    }
+    if (has_ranges) candidates.insert(&node);
+  }
+
+  // Only regions with a MatMul or a Conv2D gain more than the conversions
+  // cost.
+  Regions regions;
+  for (const NodeDef* node : candidates) {
+    for (int i = 0; i < NumNonControlInputs(*node); ++i) {
+      const GraphView::OutputPort producer =
+          graph.GetRegularFanin(GraphView::InputPort(node, i));
+      if (candidates.count(producer.node) > 0) {
+        regions.Merge(node, producer.node);
+      }
+    }
+  }
+  std::unordered_set<const NodeDef*> regions_to_quantize;
+  for (const NodeDef* node : candidates) {
+    if (IsMatMulOrConv(*node)) regions_to_quantize.insert(regions.Find(node));
+  }
+  std::unordered_set<const NodeDef*> quantized;
+  for (const NodeDef* node : candidates) {
+    if (regions_to_quantize.count(regions.Find(node)) > 0) {
+      quantized.insert(node);
+    }
+  }
+  if (quantized.empty()) {
+    *optimized_graph = item.graph;
+    return Status::OK();
+  }
+
+  // A Relu or Relu6 is folded into the requantization of the output of its
+  // producer, if nothing else uses that output.
+  std::unordered_map<const NodeDef*, const NodeDef*> folded_relus;
+  std::unordered_set<const NodeDef*> folded;
+  for (const NodeDef* node : quantized) {
+    if (!IsRelu(*node)) continue;
+    const NodeDef* producer =
+        graph.GetRegularFanin(GraphView::InputPort(node, 0)).node;
+    if (quantized.count(producer) > 0 && HasWideOutput(*producer) &&
+        graph.GetFanouts(*producer, true).size() == 1 &&
+        nodes_to_preserve.count(producer->name()) == 0) {
+      folded_relus[producer] = node;
+      folded.insert(node);
+    }
+  }
+
+  std::unordered_map<const NodeDef*, int> topo_order;
+  TF_RETURN_IF_ERROR(
+      ComputeTopologicalOrder(item.graph, &topo_order, nullptr));
+  std::vector<const NodeDef*> nodes;
+  for (const NodeDef& node : item.graph.node()) {
+    nodes.push_back(&node);
+  }
+  std::sort(nodes.begin(), nodes.end(),
+            [&topo_order](const NodeDef* a, const NodeDef* b) {
+              return topo_order[a] < topo_order[b];
+            });
+
+  *optimized_graph->mutable_library() = item.graph.library();
+  *optimized_graph->mutable_versions() = item.graph.versions();
+  QuantizedGraphBuilder builder(ranges_, optimized_graph,
+                                &quantization_stats_);
+  for (const NodeDef* node : nodes) {
+    if (quantized.count(node) == 0) {
+      *optimized_graph->add_node() = *node;
+      continue;
+    }
+    if (folded.count(node) > 0) continue;
+    std::vector<QuantizedTensor> inputs;
+    for (int i = 0; i < NumNonControlInputs(*node); ++i) {
+      const NodeDef* producer =
+          graph.GetRegularFanin(GraphView::InputPort(node, i)).node;
+      inputs.push_back(
+          builder.GetQuantizedInput(node->input(i), *producer, *node));
+    }
+    auto relu = folded_relus.find(node);
+    builder.AddQuantizedNode(*node, inputs,
+                             relu == folded_relus.end() ? nullptr
+                                                        : relu->second);
+
+    // The float output is still needed by the consumers outside of the
+    // region, including through control dependencies, and by the fetches.
+    // Control dependencies inside of the region are on the quantized node.
+    const NodeDef& result =
+        relu == folded_relus.end() ? *node : *relu->second;
+    bool has_float_consumers = nodes_to_preserve.count(result.name()) > 0;
+    for (const auto& fanout : graph.GetFanouts(result, true)) {
+      has_float_consumers |= quantized.count(fanout.node) == 0;
+    }
+    if (has_float_consumers) builder.AddDequantize(result);
+  }
+
+  quantization_stats_.num_regions = regions_to_quantize.size();
+  quantization_stats_.num_quantized_nodes = quantized.size();
+  VLOG(1) << "Quantized " << quantization_stats_.num_quantized_nodes
+          << " nodes in " << quantization_stats_.num_regions
+          << " regions, adding " << quantization_stats_.num_quantize
+          << " QuantizeV2, " << quantization_stats_.num_requantize
+          << " Requantize and " << quantization_stats_.num_dequantize
+          << " Dequantize nodes; max output rounding error "
+          << quantization_stats_.max_output_rounding_error;
+  return Status::OK();
+}
+
+void QuantizationOptimizer::Feedback(Cluster* /*cluster*/,
+                                     const GrapplerItem& /*item*/,
+                                     const GraphDef& /*optimized_graph*/,
+                                     double result) {
+  VLOG(1) << "Measured a cost of " << result << " for the quantized graph";
+}
+
+}  // end namespace grappler
+}  // end namespace tensorflow
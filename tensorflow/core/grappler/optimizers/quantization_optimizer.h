@@ -0,0 +1,118 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_QUANTIZATION_OPTIMIZER_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_QUANTIZATION_OPTIMIZER_H_
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+#include "tensorflow/core/grappler/optimizers/quantization_calibration.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Collects the ranges of the float tensors of a graph for the quantization
+// optimizer, from evaluations of the graph on representative inputs.
+class QuantizationCalibrator {
+ public:
+  QuantizationCalibrator() {}
+
+  // Returns the float tensors whose ranges the quantization optimizer uses,
+  // i.e. the inputs and outputs of the ops it can quantize on CPU, to be
+  // fetched when evaluating the graph. `cluster` is the one the optimizer
+  // will run with, which decides where unplaced ops run.
+  static std::vector<string> TensorsToCalibrate(const GraphDef& graph,
+                                                const Cluster* cluster);
+
+  // Extends the range of the tensor to the values of `value`.
+  void AddTensor(const string& tensor, const Tensor& value);
+
+  QuantizationCalibration Calibration() const;
+
+ private:
+  struct Range {
+    float min;
+    float max;
+    int64 num_samples;
+  };
+  std::map<string, Range> ranges_;
+};
+
+// Rewrites regions of float MatMul, Conv2D, BiasAdd, Relu, Relu6, MaxPool and
+// AvgPool ops on CPU into the eight bit quantized ops of
+// core/kernels/quantized_*, using the ranges of a QuantizationCalibration:
+//
+// - a region is a connected subgraph of these ops with at least one MatMul or
+//   Conv2D, whose inputs are quantized once with QuantizeV2, or at
+//   optimization time for constants, and whose outputs are dequantized once
+//   for their float consumers;
+// - the 32 bit results of QuantizedMatMul, QuantizedConv2D and
+//   QuantizedBiasAdd are requantized to their calibrated range with a single
+//   Requantize, which also applies a Relu or Relu6 that directly follows them
+//   by clamping the range, so that no RequantizationRange op is needed.
+//
+// Ops whose inputs or 32 bit outputs have no calibrated range stay in float.
+class QuantizationOptimizer : public GraphOptimizer {
+ public:
+  explicit QuantizationOptimizer(const QuantizationCalibration& calibration);
+  ~QuantizationOptimizer() override {}
+
+  // Reads a QuantizationCalibration written with WriteBinaryProto.
+  static Status LoadFromFile(Env* env, const string& filename,
+                             std::unique_ptr<QuantizationOptimizer>* optimizer);
+
+  struct QuantizationStats {
+    int num_regions = 0;
+    int num_quantized_nodes = 0;
+    // Conversion ops added at the region boundaries and between the ops.
+    int num_quantize = 0;
+    int num_requantize = 0;
+    int num_dequantize = 0;
+    // Largest rounding error of a dequantized output, i.e. half the step of
+    // its quantized range. The errors of the inputs and weights add to it.
+    float max_output_rounding_error = 0;
+  };
+  // Stats of the last call to Optimize.
+  const QuantizationStats& quantization_stats() const {
+    return quantization_stats_;
+  }
+
+  string name() const override { return "quantization_optimizer"; };
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimized_graph, double result) override;
+
+ private:
+  // Calibrated range of each tensor, with ":0" omitted.
+  std::unordered_map<string, std::pair<float, float>> ranges_;
+  QuantizationStats quantization_stats_;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_QUANTIZATION_OPTIMIZER_H_
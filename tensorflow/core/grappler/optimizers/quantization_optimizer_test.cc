@@ -0,0 +1,307 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/quantization_optimizer.h"
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+class QuantizationOptimizerTest : public GrapplerTest {
+ protected:
+  static Tensor RandomTensor(const TensorShape& shape) {
+    Tensor tensor(DT_FLOAT, shape);
+    tensor.flat<float>().setRandom();
+    tensor.flat<float>() = tensor.flat<float>() * 2.0f - 1.0f;
+    return tensor;
+  }
+
+  // Calibrates the graph of `item` on the given values of placeholder "x".
+  QuantizationCalibration Calibrate(const GrapplerItem& item,
+                                    const std::vector<Tensor>& inputs) {
+    const std::vector<string> tensors =
+        QuantizationCalibrator::TensorsToCalibrate(item.graph, nullptr);
+    QuantizationCalibrator calibrator;
+    for (const Tensor& input : inputs) {
+      auto values = EvaluateNodes(item.graph, tensors, {{"x", input}});
+      EXPECT_EQ(tensors.size(), values.size());
+      for (int i = 0; i < values.size(); ++i) {
+        calibrator.AddTensor(tensors[i], values[i]);
+      }
+    }
+    return calibrator.Calibration();
+  }
+
+  static std::map<string, int> CountOps(const GraphDef& graph) {
+    std::map<string, int> counts;
+    for (const NodeDef& node : graph.node()) {
+      ++counts[node.op()];
+    }
+    return counts;
+  }
+};
+
+TEST_F(QuantizationOptimizerTest, QuantizeFullyConnectedLayers) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({4, 16}));
+  Output w1 = ops::Const(s.WithOpName("w1"),
+                         Input::Initializer(RandomTensor({16, 8})));
+  Output b1 =
+      ops::Const(s.WithOpName("b1"), Input::Initializer(RandomTensor({8})));
+  Output w2 = ops::Const(s.WithOpName("w2"),
+                         Input::Initializer(RandomTensor({8, 4})));
+  Output matmul1 = ops::MatMul(s.WithOpName("matmul1"), x, w1);
+  Output bias1 = ops::BiasAdd(s.WithOpName("bias1"), matmul1, b1);
+  Output relu1 = ops::Relu(s.WithOpName("relu1"), bias1);
+  Output matmul2 = ops::MatMul(s.WithOpName("matmul2"), relu1, w2);
+  Output out = ops::Identity(s.WithOpName("out"), matmul2);
+
+  GrapplerItem item;
+  item.fetch = {"out"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  std::vector<Tensor> inputs;
+  for (int i = 0; i < 10; ++i) {
+    inputs.push_back(RandomTensor({4, 16}));
+  }
+  QuantizationOptimizer optimizer(Calibrate(item, inputs));
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // The input is quantized once, and the Relu folds into the requantization
+  // of the BiasAdd.
+  auto counts = CountOps(output);
+  EXPECT_EQ(2, counts["QuantizedMatMul"]);
+  EXPECT_EQ(1, counts["QuantizedBiasAdd"]);
+  EXPECT_EQ(0, counts["Relu"]);
+  EXPECT_EQ(0, counts["QuantizedRelu"]);
+  EXPECT_EQ(1, counts["QuantizeV2"]);
+  EXPECT_EQ(3, counts["Requantize"]);
+  EXPECT_EQ(1, counts["Dequantize"]);
+  const auto& stats = optimizer.quantization_stats();
+  EXPECT_EQ(1, stats.num_regions);
+  EXPECT_EQ(4, stats.num_quantized_nodes);
+  EXPECT_GT(stats.max_output_rounding_error, 0);
+
+  auto expected = EvaluateNodes(item.graph, item.fetch, {{"x", inputs[0]}});
+  auto tensors = EvaluateNodes(output, item.fetch, {{"x", inputs[0]}});
+  ASSERT_EQ(1, expected.size());
+  ASSERT_EQ(1, tensors.size());
+  // Within 5% of the output range, which spans 510 rounding errors.
+  test::ExpectTensorNear<float>(expected[0], tensors[0],
+                                25 * stats.max_output_rounding_error);
+}
+
+TEST_F(QuantizationOptimizerTest, QuantizeConvolutionalLayers) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({2, 8, 8, 3}));
+  Output filter = ops::Const(s.WithOpName("filter"),
+                             Input::Initializer(RandomTensor({3, 3, 3, 4})));
+  Output b =
+      ops::Const(s.WithOpName("b"), Input::Initializer(RandomTensor({4})));
+  Output conv = ops::Conv2D(s.WithOpName("conv"), x, filter, {1, 1, 1, 1},
+                            "SAME");
+  Output bias = ops::BiasAdd(s.WithOpName("bias"), conv, b);
+  Output relu = ops::Relu6(s.WithOpName("relu"), bias);
+  Output max_pool = ops::MaxPool(s.WithOpName("max_pool"), relu, {1, 2, 2, 1},
+                                 {1, 2, 2, 1}, "VALID");
+  Output avg_pool = ops::AvgPool(s.WithOpName("avg_pool"), max_pool,
+                                 {1, 2, 2, 1}, {1, 2, 2, 1}, "VALID");
+
+  GrapplerItem item;
+  item.fetch = {"max_pool", "avg_pool"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  std::vector<Tensor> inputs;
+  for (int i = 0; i < 10; ++i) {
+    inputs.push_back(RandomTensor({2, 8, 8, 3}));
+  }
+  QuantizationOptimizer optimizer(Calibrate(item, inputs));
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // The Relu6 folds into the requantization of the BiasAdd, and the pools
+  // run on the eight bit values.
+  auto counts = CountOps(output);
+  EXPECT_EQ(1, counts["QuantizedConv2D"]);
+  EXPECT_EQ(1, counts["QuantizedBiasAdd"]);
+  EXPECT_EQ(0, counts["QuantizedRelu6"]);
+  EXPECT_EQ(1, counts["QuantizedMaxPool"]);
+  EXPECT_EQ(1, counts["QuantizedAvgPool"]);
+  EXPECT_EQ(1, counts["QuantizeV2"]);
+  EXPECT_EQ(2, counts["Requantize"]);
+  EXPECT_EQ(2, counts["Dequantize"]);
+  const auto& stats = optimizer.quantization_stats();
+  EXPECT_EQ(1, stats.num_regions);
+  EXPECT_EQ(5, stats.num_quantized_nodes);
+
+  auto expected = EvaluateNodes(item.graph, item.fetch, {{"x", inputs[0]}});
+  auto tensors = EvaluateNodes(output, item.fetch, {{"x", inputs[0]}});
+  ASSERT_EQ(2, expected.size());
+  ASSERT_EQ(2, tensors.size());
+  for (int i = 0; i < 2; ++i) {
+    test::ExpectTensorNear<float>(expected[i], tensors[i],
+                                  25 * stats.max_output_rounding_error);
+  }
+}
+
+TEST_F(QuantizationOptimizerTest, FoldUncalibratedRelu) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({4, 16}));
+  Output w = ops::Const(s.WithOpName("w"),
+                        Input::Initializer(RandomTensor({16, 8})));
+  Output matmul = ops::MatMul(s.WithOpName("matmul"), x, w);
+  Output relu = ops::Relu6(s.WithOpName("relu"), matmul);
+
+  GrapplerItem item;
+  item.fetch = {"relu"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  std::vector<Tensor> inputs;
+  for (int i = 0; i < 10; ++i) {
+    inputs.push_back(RandomTensor({4, 16}));
+  }
+  QuantizationCalibration calibration;
+  for (const auto& range : Calibrate(item, inputs).range()) {
+    if (range.tensor() != "relu") *calibration.add_range() = range;
+  }
+  QuantizationOptimizer optimizer(calibration);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // The Relu6 is requantized to the range of the MatMul, clamped.
+  auto counts = CountOps(output);
+  EXPECT_EQ(1, counts["QuantizedMatMul"]);
+  EXPECT_EQ(0, counts["Relu6"]);
+  EXPECT_EQ(0, counts["QuantizedRelu6"]);
+  EXPECT_EQ(1, counts["Requantize"]);
+  EXPECT_EQ(1, counts["Dequantize"]);
+  const auto& stats = optimizer.quantization_stats();
+  EXPECT_GT(stats.max_output_rounding_error, 0);
+
+  auto expected = EvaluateNodes(item.graph, item.fetch, {{"x", inputs[0]}});
+  auto tensors = EvaluateNodes(output, item.fetch, {{"x", inputs[0]}});
+  ASSERT_EQ(1, expected.size());
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(expected[0], tensors[0],
+                                25 * stats.max_output_rounding_error);
+}
+
+TEST_F(QuantizationOptimizerTest, ControlDependencyInsideRegion) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({4, 16}));
+  Output w1 = ops::Const(s.WithOpName("w1"),
+                         Input::Initializer(RandomTensor({16, 8})));
+  Output b1 =
+      ops::Const(s.WithOpName("b1"), Input::Initializer(RandomTensor({8})));
+  Output w2 = ops::Const(s.WithOpName("w2"),
+                         Input::Initializer(RandomTensor({8, 4})));
+  Output matmul1 = ops::MatMul(s.WithOpName("matmul1"), x, w1);
+  Output bias1 = ops::BiasAdd(s.WithOpName("bias1"), matmul1, b1);
+  Output matmul2 = ops::MatMul(
+      s.WithOpName("matmul2").WithControlDependencies(matmul1), bias1, w2);
+
+  GrapplerItem item;
+  item.fetch = {"matmul2"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  std::vector<Tensor> inputs;
+  for (int i = 0; i < 10; ++i) {
+    inputs.push_back(RandomTensor({4, 16}));
+  }
+  QuantizationOptimizer optimizer(Calibrate(item, inputs));
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // Only the fetch is dequantized, and the control dependency moves to the
+  // quantized version of "matmul1".
+  auto counts = CountOps(output);
+  EXPECT_EQ(2, counts["QuantizedMatMul"]);
+  EXPECT_EQ(1, counts["QuantizedBiasAdd"]);
+  EXPECT_EQ(1, counts["Dequantize"]);
+  std::set<string> names;
+  for (const NodeDef& node : output.node()) {
+    names.insert(node.name());
+  }
+  int num_control_inputs = 0;
+  for (const NodeDef& node : output.node()) {
+    for (const string& input : node.input()) {
+      EXPECT_EQ(1, names.count(NodeName(input))) << node.name() << " " << input;
+      if (IsControlInput(input)) ++num_control_inputs;
+    }
+  }
+  EXPECT_EQ(1, num_control_inputs);
+
+  const auto& stats = optimizer.quantization_stats();
+  auto expected = EvaluateNodes(item.graph, item.fetch, {{"x", inputs[0]}});
+  auto tensors = EvaluateNodes(output, item.fetch, {{"x", inputs[0]}});
+  ASSERT_EQ(1, expected.size());
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(expected[0], tensors[0],
+                                25 * stats.max_output_rounding_error);
+}
+
+TEST_F(QuantizationOptimizerTest, KeepRegionsWithoutMatMul) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({1, 4, 4, 2}));
+  Output relu = ops::Relu(s.WithOpName("relu"), x);
+  Output pool = ops::MaxPool(s.WithOpName("pool"), relu, {1, 2, 2, 1},
+                             {1, 2, 2, 1}, "VALID");
+
+  GrapplerItem item;
+  item.fetch = {"pool"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  QuantizationOptimizer optimizer(
+      Calibrate(item, {RandomTensor({1, 4, 4, 2})}));
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+  CompareGraphs(item.graph, output);
+}
+
+TEST_F(QuantizationOptimizerTest, KeepUncalibratedOps) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({4, 16}));
+  Output w = ops::Const(s.WithOpName("w"),
+                        Input::Initializer(RandomTensor({16, 8})));
+  Output matmul = ops::MatMul(s.WithOpName("matmul"), x, w);
+
+  GrapplerItem item;
+  item.fetch = {"matmul"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  QuantizationOptimizer optimizer((QuantizationCalibration()));
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+  CompareGraphs(item.graph, output);
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
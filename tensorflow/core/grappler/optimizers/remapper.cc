@@ -17,6 +17,7 @@ limitations under the License.
 
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/devices.h"
 #include "tensorflow/core/grappler/graph_view.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/op_types.h"
@@ -26,6 +27,226 @@ limitations under the License.
 namespace tensorflow {
 namespace grappler {
 
+namespace {
+
+// A Conv2D or MatMul whose output only feeds a bias addition, optionally
+// followed by an activation, which one _FusedConv2D or _FusedMatMul computes.
+struct ContractionFusion {
+  const NodeDef* contraction = nullptr;
+  // A BiasAdd, or an inference FusedBatchNorm after a Conv2D, which is folded
+  // into the filter and bias of the convolution.
+  const NodeDef* bias = nullptr;
+  const NodeDef* activation = nullptr;  // Optional.
+
+  // The node whose output the fused node computes, and whose name it takes.
+  const NodeDef* last() const { return activation ? activation : bias; }
+};
+
+// The fused kernels are registered for float and double.
+bool HasFloatType(const NodeDef& node) {
+  if (node.attr().count("T") == 0) return false;
+  const DataType type = node.attr().at("T").type();
+  return type == DT_FLOAT || type == DT_DOUBLE;
+}
+
+bool IsNHWC(const NodeDef& node) {
+  return node.attr().count("data_format") == 0 ||
+         node.attr().at("data_format").s() == "NHWC";
+}
+
+bool IsFusibleActivation(const NodeDef& node) {
+  return (node.op() == "Relu" || node.op() == "Relu6" || node.op() == "Elu") &&
+         HasFloatType(node);
+}
+
+// Returns the only node that consumes the outputs of `node`, if it only has
+// one regular fanout and no control fanouts.
+const NodeDef* GetSingleConsumer(const GraphView& graph, const NodeDef& node) {
+  auto fanouts = graph.GetFanouts(node, true);
+  if (fanouts.size() != 1 || fanouts.begin()->port_id < 0) {
+    return nullptr;
+  }
+  return fanouts.begin()->node;
+}
+
+bool IsInferenceBatchNorm(const NodeDef& node,
+                          const GraphProperties& properties,
+                          const GraphView& graph) {
+  if (node.op() != "FusedBatchNorm" && node.op() != "FusedBatchNormV2") {
+    return false;
+  }
+  // The folding nodes compute in float, like FusedBatchNorm itself.
+  if (node.attr().count("T") == 0 || node.attr().at("T").type() != DT_FLOAT ||
+      !IsNHWC(node) ||
+      (node.attr().count("is_training") > 0 &&
+       node.attr().at("is_training").b())) {
+    return false;
+  }
+  // The scale, offset, mean and variance must be constant, so that constant
+  // folding folds them into the filter.
+  int const_inputs = 0;
+  for (const auto& prop : properties.GetInputProperties(node.name())) {
+    if (prop.has_value()) ++const_inputs;
+  }
+  if (const_inputs < 4) return false;
+  // Only the first output is computed by the fused node.
+  for (GraphView::Edge edge : graph.GetFanoutEdges(node, false)) {
+    if (edge.src.port_id != 0) return false;
+  }
+  return true;
+}
+
+bool FindContractionFusion(const NodeDef& contraction,
+                           const GraphProperties& properties,
+                           const GraphView& graph,
+                           const std::unordered_set<string>& nodes_to_preserve,
+                           bool has_gpu, ContractionFusion* fusion) {
+  const bool is_conv = IsConv2D(contraction);
+  if ((!is_conv && contraction.op() != "MatMul") ||
+      !HasFloatType(contraction) || !IsNHWC(contraction) ||
+      !IsOnCpu(contraction, has_gpu) ||
+      nodes_to_preserve.count(contraction.name()) > 0) {
+    return false;
+  }
+  const NodeDef* bias = GetSingleConsumer(graph, contraction);
+  if (bias == nullptr || bias->device() != contraction.device() ||
+      NodeName(bias->input(0)) != contraction.name()) {
+    return false;
+  }
+  if (IsBiasAdd(*bias)) {
+    if (!HasFloatType(*bias) || !IsNHWC(*bias)) return false;
+  } else if (!is_conv || !IsInferenceBatchNorm(*bias, properties, graph)) {
+    return false;
+  }
+  fusion->contraction = &contraction;
+  fusion->bias = bias;
+  fusion->activation = nullptr;
+  if (nodes_to_preserve.count(bias->name()) == 0) {
+    const NodeDef* activation = GetSingleConsumer(graph, *bias);
+    if (activation != nullptr && IsFusibleActivation(*activation) &&
+        activation->device() == contraction.device()) {
+      fusion->activation = activation;
+    }
+  }
+  return true;
+}
+
+void AddControlInputs(const NodeDef& from, NodeDef* to) {
+  for (const string& input : from.input()) {
+    if (IsControlInput(input)) *to->add_input() = input;
+  }
+}
+
+// Adds the nodes that fold the inference batch norm `batch_norm` into
+// `filter`, and sets `folded_filter` and `folded_bias` to the names of the
+// scaled filter and of the bias to add to the convolution output.
+void AddBatchNormFoldingNodes(GraphDef* optimized_graph,
+                              const NodeDef& batch_norm, const string& filter,
+                              string* folded_filter, string* folded_bias) {
+  const string& name = batch_norm.name();
+  const string& device = batch_norm.device();
+  const DataType dtype = batch_norm.attr().at("T").type();
+
+  float epsilon = 0.0f;
+  if (batch_norm.attr().count("epsilon")) {
+    epsilon = batch_norm.attr().at("epsilon").f();
+  }
+  Tensor value(dtype, TensorShape());
+  value.scalar<float>()() = epsilon;
+  NodeDef* variance_epsilon = optimized_graph->add_node();
+  TF_CHECK_OK(ConstantFolding::CreateNodeDef(
+      AddPrefixToNodeName("FoldedEpsilon", name), &value, variance_epsilon));
+  variance_epsilon->set_device(device);
+
+  auto add_binary = [optimized_graph, &device, dtype](
+                        const string& op, const string& node_name,
+                        const string& x, const string& y) {
+    NodeDef* node = optimized_graph->add_node();
+    node->set_name(node_name);
+    node->set_op(op);
+    node->set_device(device);
+    (*node->mutable_attr())["T"].set_type(dtype);
+    *node->add_input() = x;
+    *node->add_input() = y;
+    return node->name();
+  };
+
+  const string variance_plus_epsilon =
+      add_binary("Add", AddPrefixToNodeName("FoldedVarPlusEpsilon", name),
+                 batch_norm.input(4), variance_epsilon->name());
+  NodeDef* inv = optimized_graph->add_node();
+  inv->set_name(AddPrefixToNodeName("FoldedInv", name));
+  inv->set_op("Rsqrt");
+  inv->set_device(device);
+  (*inv->mutable_attr())["T"].set_type(dtype);
+  *inv->add_input() = variance_plus_epsilon;
+
+  // scale / sqrt(variance + epsilon), per output channel.
+  const string scaled =
+      add_binary("Mul", AddPrefixToNodeName("FoldedScale", name), inv->name(),
+                 batch_norm.input(1));
+  // The filter is HWIO, so the scale broadcasts over its output channels.
+  *folded_filter = add_binary(
+      "Mul", AddPrefixToNodeName("FoldedFilter", name), filter, scaled);
+  const string scaled_mean =
+      add_binary("Mul", AddPrefixToNodeName("FoldedMean", name),
+                 batch_norm.input(3), scaled);
+  *folded_bias =
+      add_binary("Sub", AddPrefixToNodeName("FoldedBias", name),
+                 batch_norm.input(2), scaled_mean);
+}
+
+void AddFusedContractionNode(GraphDef* optimized_graph,
+                             const ContractionFusion& fusion) {
+  const NodeDef& contraction = *fusion.contraction;
+  string filter = contraction.input(1);
+  string bias;
+  if (IsBiasAdd(*fusion.bias)) {
+    bias = fusion.bias->input(1);
+  } else {
+    AddBatchNormFoldingNodes(optimized_graph, *fusion.bias, filter, &filter,
+                             &bias);
+  }
+
+  NodeDef* fused = optimized_graph->add_node();
+  fused->set_name(fusion.last()->name());
+  fused->set_device(contraction.device());
+  *fused->add_input() = contraction.input(0);
+  *fused->add_input() = filter;
+  *fused->add_input() = bias;
+  auto* attr = fused->mutable_attr();
+  if (IsConv2D(contraction)) {
+    fused->set_op("_FusedConv2D");
+    for (const string& name :
+         {"T", "strides", "padding", "data_format", "dilations"}) {
+      if (contraction.attr().count(name) > 0) {
+        (*attr)[name] = contraction.attr().at(name);
+      }
+    }
+  } else {
+    fused->set_op("_FusedMatMul");
+    for (const string& name : {"T", "transpose_a", "transpose_b"}) {
+      if (contraction.attr().count(name) > 0) {
+        (*attr)[name] = contraction.attr().at(name);
+      }
+    }
+  }
+  (*attr)["num_args"].set_i(1);
+  auto* fused_ops = (*attr)["fused_ops"].mutable_list();
+  fused_ops->add_s("BiasAdd");
+  if (fusion.activation != nullptr) {
+    fused_ops->add_s(fusion.activation->op());
+  }
+
+  AddControlInputs(contraction, fused);
+  AddControlInputs(*fusion.bias, fused);
+  if (fusion.activation != nullptr) {
+    AddControlInputs(*fusion.activation, fused);
+  }
+}
+
+}  // namespace
+
 void AddBatchNormNodes(GraphDef* optimized_graph, const NodeDef& fused_node) {
   const string& x = fused_node.input(0);
   string scale = fused_node.input(1);
@@ -164,15 +385,45 @@ void AddBatchNormNodes(GraphDef* optimized_graph, const NodeDef& fused_node) {
   *r->add_input() = c->name();
 }
 
-Status Remapper::Optimize(Cluster* /*cluster*/, const GrapplerItem& item,
+Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
                           GraphDef* optimized_graph) {
   GraphProperties properties(item);
   TF_RETURN_IF_ERROR(properties.InferStatically(false));
   GraphView graph(const_cast<GraphDef*>(&item.graph));
 
+  const bool has_gpu = ClusterHasGpu(cluster);
+
+  // On CPU, a Conv2D or MatMul followed by a bias addition and an activation
+  // is computed by a single kernel, which saves two passes over the output.
+  const std::unordered_set<string> nodes_to_preserve = item.NodesToPreserve();
+  std::unordered_map<string, ContractionFusion> fusions;
+  std::unordered_set<string> fused_nodes;
+  for (const NodeDef& node : item.graph.node()) {
+    ContractionFusion fusion;
+    if (FindContractionFusion(node, properties, graph, nodes_to_preserve,
+                              has_gpu, &fusion)) {
+      fused_nodes.insert(fusion.contraction->name());
+      fused_nodes.insert(fusion.bias->name());
+      if (fusion.activation != nullptr) {
+        fused_nodes.insert(fusion.activation->name());
+      }
+      fusions[fusion.last()->name()] = fusion;
+    }
+  }
+
   // During inference, most of the inputs to FusedBatchNorm are constant, and we
   // can therefore replace the op with a much cheaper set of primitives.
   for (const NodeDef& node : item.graph.node()) {
+    auto it = fusions.find(node.name());
+    if (it != fusions.end()) {
+      VLOG(1) << "Fusing " << it->second.contraction->name() << " into "
+              << node.name();
+      AddFusedContractionNode(optimized_graph, it->second);
+      continue;
+    }
+    if (fused_nodes.count(node.name()) > 0) {
+      continue;
+    }
     if (node.op() == "FusedBatchNorm" || node.op() == "FusedBatchNormV2") {
       bool optimizable = (node.attr().count("T") == 0 ||
                           node.attr().at("T").type() == DT_FLOAT);
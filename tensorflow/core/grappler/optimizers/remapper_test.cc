@@ -91,5 +91,178 @@ TEST_F(RemapperTest, FusedBatchNormNCHW) {
   }
 }
 
+// Returns a tensor with positive and negative values.
+Tensor MixedSignTensor(const TensorShape& shape) {
+  Tensor tensor(DT_FLOAT, shape);
+  for (int64 i = 0; i < tensor.NumElements(); ++i) {
+    tensor.flat<float>()(i) = static_cast<float>(i % 7) - 3.0f;
+  }
+  return tensor;
+}
+
+TEST_F(RemapperTest, FuseConv2DWithBiasAndRelu) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice(
+      "/job:localhost/replica:0/task:0/device:CPU:0");
+  Output input = ops::Placeholder(s.WithOpName("input"), DT_FLOAT);
+  Output filter =
+      ops::Const(s.WithOpName("filter"), MixedSignTensor({3, 3, 2, 4}));
+  Output bias = ops::Const(s.WithOpName("bias"), {0.5f, -1.0f, 2.0f, 0.0f});
+  Output conv = ops::Conv2D(s.WithOpName("conv"), input, filter, {1, 1, 1, 1},
+                            "SAME");
+  Output bias_add = ops::BiasAdd(s.WithOpName("bias_add"), conv, bias);
+  Output relu = ops::Relu(s.WithOpName("relu"), bias_add);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"relu"};
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE("conv", node.name());
+    EXPECT_NE("bias_add", node.name());
+    if (node.name() == "relu") {
+      EXPECT_EQ("_FusedConv2D", node.op());
+      ASSERT_EQ(3, node.input_size());
+      EXPECT_EQ("input", node.input(0));
+      EXPECT_EQ("filter", node.input(1));
+      EXPECT_EQ("bias", node.input(2));
+      const auto& fused_ops = node.attr().at("fused_ops").list();
+      ASSERT_EQ(2, fused_ops.s_size());
+      EXPECT_EQ("BiasAdd", fused_ops.s(0));
+      EXPECT_EQ("Relu", fused_ops.s(1));
+      ++found;
+    }
+  }
+  EXPECT_EQ(1, found);
+
+  Tensor input_t = MixedSignTensor({2, 5, 5, 2});
+  auto tensors_expected =
+      EvaluateNodes(item.graph, item.fetch, {{"input", input_t}});
+  auto tensors = EvaluateNodes(output, item.fetch, {{"input", input_t}});
+  EXPECT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-5);
+}
+
+TEST_F(RemapperTest, FuseMatMulWithBiasAndElu) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice(
+      "/job:localhost/replica:0/task:0/device:CPU:0");
+  Output a = ops::Placeholder(s.WithOpName("a"), DT_FLOAT);
+  Output b = ops::Const(s.WithOpName("b"), MixedSignTensor({6, 3}));
+  Output bias = ops::Const(s.WithOpName("bias"), {0.5f, -1.0f, 2.0f});
+  Output matmul = ops::MatMul(s.WithOpName("matmul"), a, b);
+  Output bias_add = ops::BiasAdd(s.WithOpName("bias_add"), matmul, bias);
+  Output elu = ops::Elu(s.WithOpName("elu"), bias_add);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"elu"};
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_EQ(1, CountOpNodes(output, "_FusedMatMul"));
+  EXPECT_EQ(0, CountOpNodes(output, "MatMul"));
+  EXPECT_EQ(0, CountOpNodes(output, "BiasAdd"));
+
+  Tensor a_t = MixedSignTensor({4, 6});
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, {{"a", a_t}});
+  auto tensors = EvaluateNodes(output, item.fetch, {{"a", a_t}});
+  EXPECT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-5);
+}
+
+TEST_F(RemapperTest, FuseDoubleMatMulWithBiasAndRelu) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice(
+      "/job:localhost/replica:0/task:0/device:CPU:0");
+  Output a = ops::Placeholder(s.WithOpName("a"), DT_DOUBLE);
+  Output b = ops::Cast(s.WithOpName("b"),
+                       ops::Const(s, MixedSignTensor({6, 3})), DT_DOUBLE);
+  Output bias = ops::Const(s.WithOpName("bias"), {0.5, -1.0, 2.0});
+  Output matmul = ops::MatMul(s.WithOpName("matmul"), a, b);
+  Output bias_add = ops::BiasAdd(s.WithOpName("bias_add"), matmul, bias);
+  Output relu = ops::Relu(s.WithOpName("relu"), bias_add);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"relu"};
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_EQ(1, CountOpNodes(output, "_FusedMatMul"));
+  EXPECT_EQ(0, CountOpNodes(output, "MatMul"));
+  EXPECT_EQ(0, CountOpNodes(output, "BiasAdd"));
+
+  Tensor a_t(DT_DOUBLE, TensorShape({4, 6}));
+  for (int64 i = 0; i < a_t.NumElements(); ++i) {
+    a_t.flat<double>()(i) = static_cast<double>(i % 5) - 2.0;
+  }
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, {{"a", a_t}});
+  auto tensors = EvaluateNodes(output, item.fetch, {{"a", a_t}});
+  EXPECT_EQ(1, tensors.size());
+  test::ExpectTensorNear<double>(tensors_expected[0], tensors[0], 1e-10);
+}
+
+TEST_F(RemapperTest, FuseConv2DWithBatchNorm) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice(
+      "/job:localhost/replica:0/task:0/device:CPU:0");
+  Output input = ops::Placeholder(s.WithOpName("input"), DT_FLOAT);
+  Output filter =
+      ops::Const(s.WithOpName("filter"), MixedSignTensor({1, 1, 3, 2}));
+  Output conv = ops::Conv2D(s.WithOpName("conv"), input, filter, {1, 1, 1, 1},
+                            "VALID");
+  Output scale = ops::Const(s.WithOpName("scale"), {0.3f, 7.0f}, {2});
+  Output offset = ops::Const(s.WithOpName("offset"), {0.123f, 2.1f}, {2});
+  Output mean = ops::Const(s.WithOpName("mean"), {7.3f, 8.3f}, {2});
+  Output variance = ops::Const(s.WithOpName("variance"), {0.57f, 1.0f}, {2});
+  ops::FusedBatchNorm::Attrs attr;
+  attr = attr.IsTraining(false);
+  ops::FusedBatchNorm bn(s.WithOpName("batch_norm"), conv, scale, offset,
+                         mean, variance, attr);
+  Output relu6 = ops::Relu6(s.WithOpName("relu6"), bn.y);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"relu6"};
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_EQ(1, CountOpNodes(output, "_FusedConv2D"));
+  EXPECT_EQ(0, CountOpNodes(output, "FusedBatchNorm"));
+
+  Tensor input_t = MixedSignTensor({1, 3, 3, 3});
+  auto tensors_expected =
+      EvaluateNodes(item.graph, item.fetch, {{"input", input_t}});
+  auto tensors = EvaluateNodes(output, item.fetch, {{"input", input_t}});
+  EXPECT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-4);
+}
+
+TEST_F(RemapperTest, DoNotFuseContractionWithOtherConsumers) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice(
+      "/job:localhost/replica:0/task:0/device:CPU:0");
+  Output a = ops::Placeholder(s.WithOpName("a"), DT_FLOAT);
+  Output b = ops::Const(s.WithOpName("b"), MixedSignTensor({6, 3}));
+  Output bias = ops::Const(s.WithOpName("bias"), {0.5f, -1.0f, 2.0f});
+  Output matmul = ops::MatMul(s.WithOpName("matmul"), a, b);
+  Output bias_add = ops::BiasAdd(s.WithOpName("bias_add"), matmul, bias);
+  Output sum = ops::Add(s.WithOpName("sum"), bias_add, matmul);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"sum"};
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+  EXPECT_EQ(0, CountOpNodes(output, "_FusedMatMul"));
+  EXPECT_EQ(1, CountOpNodes(output, "MatMul"));
+}
+
 }  // namespace grappler
 }  // namespace tensorflow
@@ -26,6 +26,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/scanner.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/notification.h"
+#include "tensorflow/core/util/device_name_utils.h"
 
 namespace tensorflow {
 namespace grappler {
@@ -298,6 +299,16 @@ DataType GetDataTypeFromAttr(const NodeDef& node, const string& attr_name) {
   return attr.type();
 }
 
+bool IsOnCpu(const NodeDef& node, bool has_gpu) {
+  DeviceNameUtils::ParsedName parsed;
+  if (!node.device().empty() &&
+      DeviceNameUtils::ParseFullName(node.device(), &parsed) &&
+      parsed.has_type) {
+    return parsed.type == "CPU";
+  }
+  return !has_gpu;
+}
+
 NodeDef* GetTailOfChain(const NodeDef& source, const NodeMap& node_map,
                         bool follow_control_input,
                         const std::function<bool(const NodeDef&)>& pred_fn) {
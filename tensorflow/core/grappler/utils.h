@@ -190,6 +190,10 @@ void DedupControlInputs(NodeDef* node);
 // doesn't exist, returns DT_INVALID.
 DataType GetDataTypeFromAttr(const NodeDef& node, const string& attr_name);
 
+// Returns true if `node` is placed on a CPU. A node without a device type is
+// placed on CPU unless the cluster has GPUs, see ClusterHasGpu().
+bool IsOnCpu(const NodeDef& node, bool has_gpu);
+
 // Returns the last node in the simple chain starting at source and traversing
 // through the input(0) edge from each node as long as the next node satisfies
 // the predicate given in pred_fn. If no nodes satisfy the predicate, &source
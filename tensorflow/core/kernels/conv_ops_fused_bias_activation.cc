@@ -0,0 +1,164 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/nn_ops.cc.
+
+#define USE_EIGEN_TENSOR
+#define EIGEN_USE_THREADS
+
+#include <limits>
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/kernels/bounds_check.h"
+#include "tensorflow/core/kernels/conv_ops.h"
+#include "tensorflow/core/kernels/fused_bias_activation.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/util/padding.h"
+#include "tensorflow/core/util/tensor_format.h"
+
+namespace tensorflow {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+// Computes Conv2D followed by BiasAdd and an optional activation, which the
+// Grappler remapper fuses into one node. The bias and activation are applied
+// in one pass over the convolution output, instead of one kernel and one
+// pass each.
+template <typename Device, typename T>
+class FusedConv2DOp : public OpKernel {
+ public:
+  explicit FusedConv2DOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("strides", &strides_));
+    OP_REQUIRES_OK(context, context->GetAttr("dilations", &dilations_));
+    OP_REQUIRES_OK(context, context->GetAttr("padding", &padding_));
+    string data_format;
+    OP_REQUIRES_OK(context, context->GetAttr("data_format", &data_format));
+    OP_REQUIRES(context, FormatFromString(data_format, &data_format_),
+                errors::InvalidArgument("Invalid data format"));
+    OP_REQUIRES(context, data_format_ == FORMAT_NHWC,
+                errors::Unimplemented("_FusedConv2D only supports NHWC."));
+    OP_REQUIRES(context, strides_.size() == 4 && dilations_.size() == 4,
+                errors::InvalidArgument("Sliding window strides and dilations "
+                                        "must specify 4 dimensions"));
+    OP_REQUIRES(context,
+                strides_[0] == 1 && strides_[3] == 1 && dilations_[0] == 1 &&
+                    dilations_[3] == 1,
+                errors::InvalidArgument(
+                    "Current implementation does not yet support strides or "
+                    "dilations in the batch and depth dimensions."));
+    OP_REQUIRES(context,
+                strides_[1] > 0 && strides_[2] > 0 && dilations_[1] > 0 &&
+                    dilations_[2] > 0,
+                errors::InvalidArgument(
+                    "Strides and dilations should be larger than 0."));
+    std::vector<string> fused_ops;
+    OP_REQUIRES_OK(context, context->GetAttr("fused_ops", &fused_ops));
+    int num_args;
+    OP_REQUIRES_OK(context, context->GetAttr("num_args", &num_args));
+    OP_REQUIRES_OK(context,
+                   ParseFusedBiasActivation(fused_ops, num_args, &activation_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    // Input tensor is of the following dimensions:
+    // [ batch, in_rows, in_cols, in_depth ]
+    const Tensor& input = context->input(0);
+
+    // Input filter is of the following dimensions:
+    // [ filter_rows, filter_cols, in_depth, out_depth]
+    const Tensor& filter = context->input(1);
+
+    const Tensor& bias = context->input(2);
+
+    OP_REQUIRES(context, input.dims() == 4,
+                errors::InvalidArgument("input must be 4-dimensional",
+                                        input.shape().DebugString()));
+    OP_REQUIRES(context, filter.dims() == 4,
+                errors::InvalidArgument("filter must be 4-dimensional: ",
+                                        filter.shape().DebugString()));
+    for (int i = 0; i < 4; i++) {
+      OP_REQUIRES(
+          context,
+          FastBoundsCheck(input.dim_size(i), std::numeric_limits<int>::max()) &&
+              FastBoundsCheck(filter.dim_size(i),
+                              std::numeric_limits<int>::max()),
+          errors::InvalidArgument("input or filter too large"));
+    }
+    OP_REQUIRES(context, input.dim_size(3) == filter.dim_size(2),
+                errors::InvalidArgument(
+                    "input and filter must have the same depth: ",
+                    input.dim_size(3), " vs ", filter.dim_size(2)));
+    const int64 out_depth = filter.dim_size(3);
+    OP_REQUIRES(context,
+                TensorShapeUtils::IsVector(bias.shape()) &&
+                    bias.dim_size(0) == out_depth,
+                errors::InvalidArgument(
+                    "bias must be a vector of the output depth ", out_depth,
+                    ": ", bias.shape().DebugString()));
+
+    int64 out_rows = 0, out_cols = 0, pad_rows = 0, pad_cols = 0;
+    OP_REQUIRES_OK(context, GetWindowedOutputSizeV2(
+                                input.dim_size(1), filter.dim_size(0),
+                                dilations_[1], strides_[1], padding_,
+                                &out_rows, &pad_rows));
+    OP_REQUIRES_OK(context, GetWindowedOutputSizeV2(
+                                input.dim_size(2), filter.dim_size(1),
+                                dilations_[2], strides_[2], padding_,
+                                &out_cols, &pad_cols));
+    TensorShape out_shape = ShapeFromFormat(data_format_, input.dim_size(0),
+                                            out_rows, out_cols, out_depth);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, out_shape, &output));
+    if (out_shape.num_elements() == 0) {
+      return;
+    }
+
+    LaunchConv2DOp<Device, T>()(context, false, false, input, filter,
+                                dilations_[1], dilations_[2], strides_[1],
+                                strides_[2], padding_, output, data_format_);
+    if (!context->status().ok()) {
+      return;
+    }
+    functor::FusedBiasActivation<Device, T>()(
+        context->eigen_device<Device>(),
+        output->shaped<T, 2>({out_shape.num_elements() / out_depth, out_depth}),
+        bias.vec<T>(), activation_);
+  }
+
+ private:
+  std::vector<int32> strides_;
+  std::vector<int32> dilations_;
+  Padding padding_;
+  TensorFormat data_format_;
+  FusedActivation activation_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(FusedConv2DOp);
+};
+
+#define REGISTER_CPU(T)                                                \
+  REGISTER_KERNEL_BUILDER(                                             \
+      Name("_FusedConv2D").Device(DEVICE_CPU).TypeConstraint<T>("T"), \
+      FusedConv2DOp<CPUDevice, T>);
+
+TF_CALL_float(REGISTER_CPU);
+TF_CALL_double(REGISTER_CPU);
+#undef REGISTER_CPU
+
+}  // namespace tensorflow
@@ -0,0 +1,330 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/math_ops.cc.
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/cwise_ops.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+namespace {
+
+enum class Opcode {
+  // Unary.
+  kAbs,
+  kExp,
+  kLog,
+  kNeg,
+  kReciprocal,
+  kRelu,
+  kRsqrt,
+  kSigmoid,
+  kSqrt,
+  kSquare,
+  kTanh,
+  // Binary.
+  kAdd,
+  kDiv,
+  kMaximum,
+  kMinimum,
+  kMul,
+  kSquaredDifference,
+  kSub,
+};
+
+bool ParseOpcode(const string& name, Opcode* opcode, int* arity) {
+  static const auto* const kOpcodes =
+      new std::unordered_map<string, std::pair<Opcode, int>>({
+          {"Abs", {Opcode::kAbs, 1}},
+          {"Exp", {Opcode::kExp, 1}},
+          {"Log", {Opcode::kLog, 1}},
+          {"Neg", {Opcode::kNeg, 1}},
+          {"Reciprocal", {Opcode::kReciprocal, 1}},
+          {"Relu", {Opcode::kRelu, 1}},
+          {"Rsqrt", {Opcode::kRsqrt, 1}},
+          {"Sigmoid", {Opcode::kSigmoid, 1}},
+          {"Sqrt", {Opcode::kSqrt, 1}},
+          {"Square", {Opcode::kSquare, 1}},
+          {"Tanh", {Opcode::kTanh, 1}},
+          {"Add", {Opcode::kAdd, 2}},
+          {"Div", {Opcode::kDiv, 2}},
+          {"RealDiv", {Opcode::kDiv, 2}},
+          {"Maximum", {Opcode::kMaximum, 2}},
+          {"Minimum", {Opcode::kMinimum, 2}},
+          {"Mul", {Opcode::kMul, 2}},
+          {"SquaredDifference", {Opcode::kSquaredDifference, 2}},
+          {"Sub", {Opcode::kSub, 2}},
+      });
+  auto it = kOpcodes->find(name);
+  if (it == kOpcodes->end()) return false;
+  *opcode = it->second.first;
+  *arity = it->second.second;
+  return true;
+}
+
+}  // namespace
+
+// Evaluates the program of a _FusedElementwise node, which the Grappler
+// elementwise fusion pass creates from a chain of cwise ops.
+//
+// The output is computed in blocks small enough for all the live
+// intermediate results of a block to stay in cache, so every input is read
+// and the output is written once, instead of once per op. Each instruction
+// uses the functor of the corresponding cwise kernel, vectorized by Eigen.
+template <typename T>
+class FusedElementwiseOp : public OpKernel {
+ public:
+  // Number of elements of a block.
+  static constexpr int64 kBlockSize = 2048;
+
+  explicit FusedElementwiseOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    std::vector<string> opcodes;
+    std::vector<int32> operands;
+    OP_REQUIRES_OK(context, context->GetAttr("opcodes", &opcodes));
+    OP_REQUIRES_OK(context, context->GetAttr("operands", &operands));
+    OP_REQUIRES(context, !opcodes.empty(),
+                errors::InvalidArgument("The program has no opcodes"));
+    num_inputs_ = context->num_inputs();
+
+    // Parses the program, and assigns the result of each instruction to the
+    // first free scratch slot. A slot is freed after the last read of its
+    // register, and the last instruction writes the output instead.
+    const int num_registers = num_inputs_ + opcodes.size();
+    std::vector<int> last_use(num_registers, -1);
+    int next_operand = 0;
+    for (int i = 0; i < opcodes.size(); ++i) {
+      Instruction instr;
+      int arity = 0;
+      OP_REQUIRES(context, ParseOpcode(opcodes[i], &instr.opcode, &arity),
+                  errors::InvalidArgument("Unsupported opcode: ", opcodes[i]));
+      OP_REQUIRES(context, next_operand + arity <= operands.size(),
+                  errors::InvalidArgument("Too few operands for opcode ", i));
+      for (int j = 0; j < arity; ++j) {
+        const int reg = operands[next_operand++];
+        OP_REQUIRES(context, reg >= 0 && reg < num_inputs_ + i,
+                    errors::InvalidArgument("Opcode ", i,
+                                            " reads undefined register ", reg));
+        instr.operands[j] = reg;
+        last_use[reg] = i;
+      }
+      program_.push_back(instr);
+    }
+    OP_REQUIRES(context, next_operand == operands.size(),
+                errors::InvalidArgument("Too many operands: ", operands.size(),
+                                        " vs. ", next_operand));
+
+    slots_.assign(num_registers, -1);
+    std::vector<int> free_slots;
+    for (int i = 0; i + 1 < program_.size(); ++i) {
+      const int* operands = program_[i].operands;
+      for (int j = 0; j < 2; ++j) {
+        const int reg = operands[j];
+        // Mul(r, r) frees the slot of r once.
+        if (reg >= num_inputs_ && last_use[reg] == i &&
+            (j == 0 || reg != operands[0])) {
+          free_slots.push_back(slots_[reg]);
+        }
+      }
+      const int reg = num_inputs_ + i;
+      if (free_slots.empty()) {
+        slots_[reg] = num_slots_++;
+      } else {
+        slots_[reg] = free_slots.back();
+        free_slots.pop_back();
+      }
+    }
+  }
+
+  void Compute(OpKernelContext* context) override {
+    // Inputs of the output shape are read in place, and scalars are
+    // broadcast into a block of their own.
+    const Tensor* shaped = nullptr;
+    for (int i = 0; i < num_inputs_; ++i) {
+      const Tensor& input = context->input(i);
+      if (TensorShapeUtils::IsScalar(input.shape())) continue;
+      if (shaped == nullptr) {
+        shaped = &input;
+      } else {
+        OP_REQUIRES(context, input.shape() == shaped->shape(),
+                    errors::InvalidArgument(
+                        "Inputs must be scalars or have the same shape: ",
+                        shaped->shape().DebugString(), " vs. ",
+                        input.shape().DebugString()));
+      }
+    }
+    const TensorShape& out_shape =
+        shaped == nullptr ? context->input(0).shape() : shaped->shape();
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, out_shape, &output));
+    const int64 size = out_shape.num_elements();
+    if (size == 0) return;
+
+    std::vector<const T*> inputs(num_inputs_);
+    std::vector<int> scalars;
+    std::vector<bool> is_scalar(num_inputs_, false);
+    for (int i = 0; i < num_inputs_; ++i) {
+      const Tensor& input = context->input(i);
+      inputs[i] = input.flat<T>().data();
+      if (size > 1 && TensorShapeUtils::IsScalar(input.shape())) {
+        scalars.push_back(i);
+        is_scalar[i] = true;
+      }
+    }
+    T* out = output->flat<T>().data();
+
+    auto work = [this, &inputs, &scalars, &is_scalar, out, size](
+                    int64 start_block, int64 limit_block) {
+      const int64 block_size = std::min(kBlockSize, size);
+      std::vector<T> scratch((num_slots_ + scalars.size()) * block_size);
+      std::vector<const T*> registers(num_inputs_ + program_.size());
+      for (int i = 0; i < scalars.size(); ++i) {
+        T* broadcast = &scratch[(num_slots_ + i) * block_size];
+        std::fill(broadcast, broadcast + block_size, *inputs[scalars[i]]);
+        registers[scalars[i]] = broadcast;
+      }
+      for (int64 block = start_block; block < limit_block; ++block) {
+        const int64 begin = block * kBlockSize;
+        const int64 n = std::min(kBlockSize, size - begin);
+        for (int i = 0; i < num_inputs_; ++i) {
+          if (!is_scalar[i]) registers[i] = inputs[i] + begin;
+        }
+        for (int i = 0; i < program_.size(); ++i) {
+          const int reg = num_inputs_ + i;
+          T* result = i + 1 == program_.size()
+                          ? out + begin
+                          : &scratch[slots_[reg] * block_size];
+          Run(program_[i], registers, n, result);
+          registers[reg] = result;
+        }
+      }
+    };
+    const int64 num_blocks = (size + kBlockSize - 1) / kBlockSize;
+    const int64 cost_per_block =
+        std::min(kBlockSize, size) * program_.size() * 10;
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_blocks,
+          cost_per_block, work);
+  }
+
+ private:
+  struct Instruction {
+    Opcode opcode;
+    // Registers read by the instruction, -1 if unused.
+    int operands[2] = {-1, -1};
+  };
+
+  typedef typename TTypes<T>::Flat Flat;
+  typedef typename TTypes<T>::ConstFlat ConstFlat;
+
+  static void Run(const Instruction& instr,
+                  const std::vector<const T*>& registers, int64 n, T* result) {
+    Flat out(result, n);
+    ConstFlat x(registers[instr.operands[0]], n);
+    // Only read for binary opcodes.
+    ConstFlat y(instr.operands[1] < 0 ? nullptr
+                                      : registers[instr.operands[1]],
+                n);
+    switch (instr.opcode) {
+      case Opcode::kAbs:
+        out = x.unaryExpr(typename functor::abs<T>::func());
+        break;
+      case Opcode::kExp:
+        out = x.unaryExpr(typename functor::exp<T>::func());
+        break;
+      case Opcode::kLog:
+        out = x.unaryExpr(typename functor::log<T>::func());
+        break;
+      case Opcode::kNeg:
+        out = x.unaryExpr(typename functor::neg<T>::func());
+        break;
+      case Opcode::kReciprocal:
+        out = x.unaryExpr(typename functor::inverse<T>::func());
+        break;
+      case Opcode::kRelu:
+        out = x.cwiseMax(static_cast<T>(0));
+        break;
+      case Opcode::kRsqrt:
+        out = x.unaryExpr(typename functor::rsqrt<T>::func());
+        break;
+      case Opcode::kSigmoid:
+        out = x.unaryExpr(typename functor::sigmoid<T>::func());
+        break;
+      case Opcode::kSqrt:
+        out = x.unaryExpr(typename functor::sqrt<T>::func());
+        break;
+      case Opcode::kSquare:
+        out = x.unaryExpr(typename functor::square<T>::func());
+        break;
+      case Opcode::kTanh:
+        out = x.unaryExpr(typename functor::tanh<T>::func());
+        break;
+      case Opcode::kAdd:
+        out = x.binaryExpr(y, typename functor::add<T>::func());
+        break;
+      case Opcode::kDiv:
+        out = x.binaryExpr(y, typename functor::div<T>::func());
+        break;
+      case Opcode::kMaximum:
+        out = x.binaryExpr(y, typename functor::maximum<T>::func());
+        break;
+      case Opcode::kMinimum:
+        out = x.binaryExpr(y, typename functor::minimum<T>::func());
+        break;
+      case Opcode::kMul:
+        out = x.binaryExpr(y, typename functor::mul<T>::func());
+        break;
+      case Opcode::kSquaredDifference:
+        out = x.binaryExpr(y, typename functor::squared_difference<T>::func());
+        break;
+      case Opcode::kSub:
+        out = x.binaryExpr(y, typename functor::sub<T>::func());
+        break;
+    }
+  }
+
+  int num_inputs_ = 0;
+  std::vector<Instruction> program_;
+  // Scratch slot of each register, -1 for inputs and the output.
+  std::vector<int> slots_;
+  int num_slots_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(FusedElementwiseOp);
+};
+
+#define REGISTER_CPU(T)                                                     \
+  REGISTER_KERNEL_BUILDER(                                                  \
+      Name("_FusedElementwise").Device(DEVICE_CPU).TypeConstraint<T>("T"), \
+      FusedElementwiseOp<T>);
+
+TF_CALL_float(REGISTER_CPU);
+TF_CALL_double(REGISTER_CPU);
+#undef REGISTER_CPU
+
+}  // namespace tensorflow
@@ -0,0 +1,78 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+
+class FusedElementwiseOpTest : public OpsTestBase {
+ protected:
+  Status MakeOp(int num_inputs, const std::vector<string>& opcodes,
+                const std::vector<int32>& operands) {
+    TF_RETURN_IF_ERROR(NodeDefBuilder("fused", "_FusedElementwise")
+                           .Input(FakeInput(num_inputs, DT_FLOAT))
+                           .Attr("opcodes", opcodes)
+                           .Attr("operands", operands)
+                           .Finalize(node_def()));
+    return InitOp();
+  }
+};
+
+TEST_F(FusedElementwiseOpTest, ChainWithScalar) {
+  // (x + 1) * y
+  TF_ASSERT_OK(MakeOp(3, {"Add", "Mul"}, {0, 1, 3, 2}));
+  AddInputFromArray<float>(TensorShape({4}), {1, 2, 3, 4});
+  AddInputFromArray<float>(TensorShape({}), {1});
+  AddInputFromArray<float>(TensorShape({4}), {2, 2, -1, 0});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({4}));
+  test::FillValues<float>(&expected, {4, 6, -4, 0});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(FusedElementwiseOpTest, SquareOfIntermediate) {
+  // Exp(x) * Exp(x) + Exp(x), where the product reads its register twice
+  // and must keep its result until the last Exp(x) is added.
+  TF_ASSERT_OK(
+      MakeOp(1, {"Exp", "Mul", "Exp", "Add"}, {0, 1, 1, 0, 2, 3}));
+  AddInputFromArray<float>(TensorShape({3}), {0, 1, -1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({3}));
+  test::FillValues<float>(&expected, {2, std::exp(2.f) + std::exp(1.f),
+                                      std::exp(-2.f) + std::exp(-1.f)});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(FusedElementwiseOpTest, RejectsInvalidPrograms) {
+  EXPECT_FALSE(MakeOp(1, {}, {}).ok());
+  EXPECT_FALSE(MakeOp(1, {"Cos"}, {0}).ok());
+  // Register 1 is written by the instruction that reads it.
+  EXPECT_FALSE(MakeOp(1, {"Neg"}, {1}).ok());
+  EXPECT_FALSE(MakeOp(1, {"Add"}, {0}).ok());
+  EXPECT_FALSE(MakeOp(1, {"Neg"}, {0, 0}).ok());
+}
+
+}  // namespace tensorflow
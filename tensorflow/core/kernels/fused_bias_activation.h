@@ -0,0 +1,95 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Bias and activation epilogues of the _FusedConv2D and _FusedMatMul kernels.
+
+#ifndef TENSORFLOW_CORE_KERNELS_FUSED_BIAS_ACTIVATION_H_
+#define TENSORFLOW_CORE_KERNELS_FUSED_BIAS_ACTIVATION_H_
+
+#include <string>
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+
+namespace tensorflow {
+
+enum class FusedActivation { kNone, kRelu, kRelu6, kElu };
+
+// Parses the `fused_ops` attribute of a fused contraction, which must be
+// "BiasAdd" optionally followed by an activation, with one argument.
+inline Status ParseFusedBiasActivation(const std::vector<string>& fused_ops,
+                                       int num_args,
+                                       FusedActivation* activation) {
+  if (fused_ops.empty() || fused_ops.size() > 2 || fused_ops[0] != "BiasAdd" ||
+      num_args != 1) {
+    return errors::Unimplemented("Unsupported fusion: [",
+                                 str_util::Join(fused_ops, ","),
+                                 "] with ", num_args, " arguments");
+  }
+  *activation = FusedActivation::kNone;
+  if (fused_ops.size() == 2) {
+    if (fused_ops[1] == "Relu") {
+      *activation = FusedActivation::kRelu;
+    } else if (fused_ops[1] == "Relu6") {
+      *activation = FusedActivation::kRelu6;
+    } else if (fused_ops[1] == "Elu") {
+      *activation = FusedActivation::kElu;
+    } else {
+      return errors::Unimplemented("Unsupported fused activation: ",
+                                   fused_ops[1]);
+    }
+  }
+  return Status::OK();
+}
+
+namespace functor {
+
+// Computes on device "d": out = activation(out + bias), where "bias" is
+// broadcast over the rows of "out", in a single pass over "out".
+template <typename Device, typename T>
+struct FusedBiasActivation {
+  void operator()(const Device& d, typename TTypes<T>::Matrix out,
+                  typename TTypes<T>::ConstVec bias,
+                  FusedActivation activation) {
+    Eigen::array<Eigen::DenseIndex, 2> bias_shape{{1, bias.dimension(0)}};
+    Eigen::array<Eigen::DenseIndex, 2> broadcast{{out.dimension(0), 1}};
+    auto biased = out + bias.reshape(bias_shape).broadcast(broadcast);
+    switch (activation) {
+      case FusedActivation::kNone:
+        out.device(d) = biased;
+        break;
+      case FusedActivation::kRelu:
+        out.device(d) = biased.cwiseMax(static_cast<T>(0));
+        break;
+      case FusedActivation::kRelu6:
+        out.device(d) =
+            biased.cwiseMax(static_cast<T>(0)).cwiseMin(static_cast<T>(6));
+        break;
+      case FusedActivation::kElu:
+        out.device(d) = (biased < static_cast<T>(0))
+                            .select(biased.exp() - static_cast<T>(1), biased);
+        break;
+    }
+  }
+};
+
+}  // namespace functor
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_FUSED_BIAS_ACTIVATION_H_
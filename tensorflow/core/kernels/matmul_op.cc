@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/kernels/fill_functor.h"
+#include "tensorflow/core/kernels/fused_bias_activation.h"
 #include "tensorflow/core/util/matmul_autotune.h"
 #if GOOGLE_CUDA
 #include "cuda/include/cuda.h"
@@ -500,6 +501,79 @@ class MatMulOp : public OpKernel {
   bool transpose_b_;
 };
 
+// Computes MatMul followed by BiasAdd and an optional activation, which the
+// Grappler remapper fuses into one node. The bias and activation are applied
+// in one pass over the product, instead of one kernel and one pass each.
+template <typename Device, typename T>
+class FusedMatMulOp : public OpKernel {
+ public:
+  explicit FusedMatMulOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("transpose_a", &transpose_a_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("transpose_b", &transpose_b_));
+    std::vector<string> fused_ops;
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("fused_ops", &fused_ops));
+    int num_args;
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("num_args", &num_args));
+    OP_REQUIRES_OK(ctx,
+                   ParseFusedBiasActivation(fused_ops, num_args, &activation_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& a = ctx->input(0);
+    const Tensor& b = ctx->input(1);
+    const Tensor& bias = ctx->input(2);
+
+    OP_REQUIRES(ctx, TensorShapeUtils::IsMatrix(a.shape()),
+                errors::InvalidArgument("In[0] is not a matrix"));
+    OP_REQUIRES(ctx, TensorShapeUtils::IsMatrix(b.shape()),
+                errors::InvalidArgument("In[1] is not a matrix"));
+    Eigen::array<Eigen::IndexPair<Eigen::DenseIndex>, 1> dim_pair;
+    dim_pair[0].first = transpose_a_ ? 0 : 1;
+    dim_pair[0].second = transpose_b_ ? 1 : 0;
+
+    OP_REQUIRES(
+        ctx, a.dim_size(dim_pair[0].first) == b.dim_size(dim_pair[0].second),
+        errors::InvalidArgument(
+            "Matrix size-incompatible: In[0]: ", a.shape().DebugString(),
+            ", In[1]: ", b.shape().DebugString()));
+    int a_dim_remaining = 1 - dim_pair[0].first;
+    int b_dim_remaining = 1 - dim_pair[0].second;
+    TensorShape out_shape(
+        {a.dim_size(a_dim_remaining), b.dim_size(b_dim_remaining)});
+    OP_REQUIRES(ctx,
+                TensorShapeUtils::IsVector(bias.shape()) &&
+                    bias.dim_size(0) == out_shape.dim_size(1),
+                errors::InvalidArgument(
+                    "bias must be a vector of the number of columns ",
+                    out_shape.dim_size(1), ": ", bias.shape().DebugString()));
+    Tensor* out = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, out_shape, &out));
+
+    if (out->NumElements() == 0) {
+      return;
+    }
+
+    if (a.NumElements() == 0 || b.NumElements() == 0) {
+      functor::SetZeroFunctor<Device, T> f;
+      f(ctx->eigen_device<Device>(), out->flat<T>());
+    } else {
+      std::vector<int64> algorithms;
+      LaunchMatMul<Device, T, false>::launch(ctx, a, b, dim_pair, &algorithms,
+                                             false, out);
+    }
+    functor::FusedBiasActivation<Device, T>()(ctx->eigen_device<Device>(),
+                                              out->matrix<T>(), bias.vec<T>(),
+                                              activation_);
+  }
+
+ private:
+  bool transpose_a_;
+  bool transpose_b_;
+  FusedActivation activation_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(FusedMatMulOp);
+};
+
 namespace functor {
 
 // Partial specialization MatMulFunctor<Device=CPUDevice, T>.
@@ -572,6 +646,15 @@ TF_CALL_complex64(REGISTER_CPU);
 TF_CALL_complex128(REGISTER_CPU);
 #endif
 
+#define REGISTER_FUSED_CPU(T)                                          \
+  REGISTER_KERNEL_BUILDER(                                             \
+      Name("_FusedMatMul").Device(DEVICE_CPU).TypeConstraint<T>("T"), \
+      FusedMatMulOp<CPUDevice, T>);
+
+TF_CALL_float(REGISTER_FUSED_CPU);
+TF_CALL_double(REGISTER_FUSED_CPU);
+#undef REGISTER_FUSED_CPU
+
 #if GOOGLE_CUDA
 TF_CALL_float(REGISTER_GPU);
 TF_CALL_double(REGISTER_GPU);
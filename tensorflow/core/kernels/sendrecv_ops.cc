@@ -140,6 +140,12 @@ RecvOp::RecvOp(OpKernelConstruction* ctx) : AsyncOpKernel(ctx) {
   if (!ctx->GetAttr("_hostmem_sendrecv", &hostmem_sendrecv_).ok()) {
     hostmem_sendrecv_ = false;
   }
+  if (!ctx->GetAttr("_wire_compression", &wire_compression_).ok()) {
+    wire_compression_.clear();
+  }
+  if (!ctx->GetAttr("_prefetch_staleness", &prefetch_staleness_).ok()) {
+    prefetch_staleness_ = 0;
+  }
 }
 
 namespace {
@@ -177,6 +183,8 @@ void RecvOp::ComputeAsync(OpKernelContext* ctx, DoneCallback done) {
   Rendezvous::Args args;
   args.device_context = ctx->op_device_context();
   args.alloc_attrs = ctx->output_alloc_attr(0);
+  args.wire_compression = wire_compression_;
+  args.prefetch_staleness = prefetch_staleness_;
 
   FrameAndIter frame_iter = GetFrameAndIter(ctx, hostmem_sendrecv_);
   if (frame_iter == FrameAndIter(0, 0)) {
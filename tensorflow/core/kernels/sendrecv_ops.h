@@ -43,6 +43,8 @@ class RecvOp : public AsyncOpKernel {
   string key_prefix_;
   Rendezvous::ParsedKey parsed_key_;
   bool hostmem_sendrecv_;
+  string wire_compression_;
+  int32 prefetch_staleness_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(RecvOp);
 };
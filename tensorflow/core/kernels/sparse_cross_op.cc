@@ -146,7 +146,7 @@ class OutputUpdater {
         values_out_(values_out) {}
 
   void Update(const int64 batch_index, const int64 cross_count,
-              const OutType& cross) const {
+              OutType cross) const {
     const int64 output_index = output_start_indices_[batch_index] + cross_count;
 
     auto indices_matrix = indices_out_->matrix<int64>();
@@ -154,7 +154,7 @@ class OutputUpdater {
     indices_matrix(output_index, 1) = cross_count;
 
     auto value_vec = values_out_->vec<OutType>();
-    value_vec(output_index) = cross;
+    value_vec(output_index) = std::move(cross);
   }
 
  private:
@@ -174,15 +174,27 @@ class StringCrosser {
 
   string Generate(const int64 batch_index,
                   const std::vector<int>& permutation) const {
-    static const auto k_feature_separator = "_X_";
+    static const StringPiece k_feature_separator = "_X_";
 
     gtl::InlinedVector<InternalType, 6> cross_vec(columns_.size());
+    size_t cross_size = 0;
     for (int i = 0; i < permutation.size(); i++) {
       cross_vec[i] = columns_[i]->Feature(batch_index, permutation[i]);
+      cross_size += cross_vec[i].size();
     }
-    // TODO(zakaria): this will copy the string twice, might effect
-    // performance.
-    return str_util::Join(cross_vec, k_feature_separator);
+    if (!cross_vec.empty()) {
+      cross_size += (cross_vec.size() - 1) * k_feature_separator.size();
+    }
+    // Builds the cross in place; the caller moves it into the output.
+    string cross;
+    cross.reserve(cross_size);
+    for (int i = 0; i < cross_vec.size(); i++) {
+      if (i > 0) {
+        cross.append(k_feature_separator.data(), k_feature_separator.size());
+      }
+      cross.append(cross_vec[i].data(), cross_vec[i].size());
+    }
+    return cross;
   }
 
  private:
@@ -240,8 +252,10 @@ class ProductIterator {
     }
   }
 
-  std::vector<int> Next() {
-    std::vector<int> permutation(next_permutation_);
+  // Returns the current permutation and advances to the next one. The
+  // returned reference is valid until the following call.
+  const std::vector<int>& Next() {
+    permutation_ = next_permutation_;
 
     // Generates next permutation, if available.
     bool carry = true;
@@ -257,7 +271,7 @@ class ProductIterator {
       }
     }
     has_next_ = !carry;
-    return permutation;
+    return permutation_;
   }
 
   bool HasNext() { return has_next_; }
@@ -266,9 +280,34 @@ class ProductIterator {
   bool has_next_;
   const std::vector<std::unique_ptr<ColumnInterface<InternalType>>>& columns_;
   const int64 batch_index_;
+  std::vector<int> permutation_;
   std::vector<int> next_permutation_;
 };
 
+// Returns in *fingerprints an int64 tensor of the same shape as `strings`
+// holding the Fingerprint64 of every string, computed on the worker threads.
+// Hashed crosses use it so that each string is fingerprinted once rather than
+// once for every cross that it takes part in.
+Status FingerprintStrings(OpKernelContext* context, const Tensor& strings,
+                          Tensor* fingerprints) {
+  TF_RETURN_IF_ERROR(
+      context->allocate_temp(DT_INT64, strings.shape(), fingerprints));
+  const auto strings_flat = strings.flat<string>();
+  auto fingerprints_flat = fingerprints->flat<int64>();
+  auto fingerprint_range = [&strings_flat, &fingerprints_flat](int64 start,
+                                                               int64 limit) {
+    for (int64 i = start; i < limit; ++i) {
+      fingerprints_flat(i) = Fingerprint64(strings_flat(i));
+    }
+  };
+  auto* worker_threads = context->device()->tensorflow_cpu_worker_threads();
+  // Rough cost of fingerprinting a short string, in cycles.
+  const int64 kCostPerUnit = 50;
+  Shard(worker_threads->num_threads, worker_threads->workers,
+        strings_flat.size(), kCostPerUnit, fingerprint_range);
+  return Status::OK();
+}
+
 template <bool HASHED_OUTPUT, typename InternalType>
 struct CrossTraits;
 
@@ -311,16 +350,44 @@ class SparseCrossOp : public OpKernel {
     ValidateInput(context, indices_list_in, values_list_in, shapes_list_in,
                   dense_list_in);
 
+    // The columns refer to these tensors, which outlive them.
+    std::vector<Tensor> values_in;
+    values_in.reserve(values_list_in.size());
+    for (const Tensor& values : values_list_in) {
+      values_in.push_back(values);
+    }
+    std::vector<Tensor> dense_in;
+    dense_in.reserve(dense_list_in.size());
+    for (const Tensor& dense : dense_list_in) {
+      dense_in.push_back(dense);
+    }
+    if (HASHED_OUTPUT) {
+      for (Tensor& values : values_in) {
+        if (values.dtype() != DT_STRING) continue;
+        Tensor fingerprints;
+        OP_REQUIRES_OK(context,
+                       FingerprintStrings(context, values, &fingerprints));
+        values = fingerprints;
+      }
+      for (Tensor& dense : dense_in) {
+        if (dense.dtype() != DT_STRING) continue;
+        Tensor fingerprints;
+        OP_REQUIRES_OK(context,
+                       FingerprintStrings(context, dense, &fingerprints));
+        dense = fingerprints;
+      }
+    }
+
+    const int64 batch_size = CalculateBatchSize(shapes_list_in, dense_list_in);
     std::vector<std::unique_ptr<ColumnInterface<InternalType>>> columns =
-        GenerateColumnsFromInput(indices_list_in, values_list_in,
-                                 shapes_list_in, dense_list_in);
+        GenerateColumnsFromInput(indices_list_in, values_in, dense_in,
+                                 batch_size);
 
     typename CrossTraits<HASHED_OUTPUT, InternalType>::Crosser crosser(
         columns, num_buckets_, hash_key_);
     Tensor* indices_out;
     Tensor* values_out;
     Tensor* shape_out;
-    const int64 batch_size = CalculateBatchSize(shapes_list_in, dense_list_in);
     std::vector<int64> output_start_indices(batch_size);
     CreateOutputTensors(columns, batch_size, context, &indices_out, &values_out,
                         &shape_out, &output_start_indices);
@@ -332,7 +399,7 @@ class SparseCrossOp : public OpKernel {
         ProductIterator<InternalType> product_iterator(columns, b);
         int64 cross_count = 0;
         while (product_iterator.HasNext()) {
-          const auto permutation = product_iterator.Next();
+          const auto& permutation = product_iterator.Next();
           updater.Update(b, cross_count, crosser.Generate(b, permutation));
           cross_count++;
         }
@@ -444,12 +511,11 @@ class SparseCrossOp : public OpKernel {
   // Generate the columns given the sparse and dense inputs.
   std::vector<std::unique_ptr<ColumnInterface<InternalType>>>
   GenerateColumnsFromInput(const OpInputList& indices_list_in,
-                           const OpInputList& values_list_in,
-                           const OpInputList& shapes_list_in,
-                           const OpInputList& dense_list_in) {
+                           const std::vector<Tensor>& values_list_in,
+                           const std::vector<Tensor>& dense_list_in,
+                           int64 batch_size) {
     std::vector<std::unique_ptr<ColumnInterface<InternalType>>> columns;
-    const int64 batch_size = CalculateBatchSize(shapes_list_in, dense_list_in);
-    const int64 number_of_columns = shapes_list_in.size();
+    const int64 number_of_columns = values_list_in.size();
 
     std::vector<std::vector<int64>> feature_counts(number_of_columns,
                                                    std::vector<int64>());
@@ -19,6 +19,9 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/sparse_tensor_dense_matmul_op.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/kernels/bounds_check.h"
@@ -237,11 +240,36 @@ Status MOutOfBoundsError(int64 m, std::size_t i, int lhs_index_a,
   return errors::InvalidArgument("m (", m, ") from index[", i, ",", lhs_index_a,
                                  "] out of bounds (>=", out_dim0, ")");
 }
+
+// Computes out_row[0:n] += alpha * b_row[0:n] using Eigen packet math, with a
+// scalar loop for the remainder that does not fill a whole packet.
+template <typename T>
+EIGEN_ALWAYS_INLINE void ScaledRowAccumulate(const T alpha, const T* b_row,
+                                             T* out_row, std::size_t n) {
+  typedef typename Eigen::internal::packet_traits<T>::type Packet;
+  const std::size_t kPacketSize =
+      Eigen::internal::unpacket_traits<Packet>::size;
+  std::size_t j = 0;
+  if (kPacketSize > 1) {
+    const Packet p_alpha = Eigen::internal::pset1<Packet>(alpha);
+    for (; j + kPacketSize <= n; j += kPacketSize) {
+      const Packet p_b = Eigen::internal::ploadu<Packet>(b_row + j);
+      const Packet p_out = Eigen::internal::ploadu<Packet>(out_row + j);
+      Eigen::internal::pstoreu<T>(out_row + j,
+                                  Eigen::internal::pmadd(p_alpha, p_b, p_out));
+    }
+  }
+  for (; j < n; ++j) {
+    out_row[j] += alpha * b_row[j];
+  }
+}
+
 }  // namespace
 
 template <typename T, typename Tindices, bool ADJ_A, bool ADJ_B>
 struct SparseTensorDenseMatMulFunctor<CPUDevice, T, Tindices, ADJ_A, ADJ_B> {
-  // Vectorize certain operations above this size.
+  // Transpose B up front (for ADJ_B) only when the output rows are at least
+  // this wide; otherwise read B through MaybeAdjoint.
   static const std::size_t kNumVectorize = 32;
 
   static Status Compute(const CPUDevice& d, typename TTypes<T>::Matrix out,
@@ -253,63 +281,91 @@ struct SparseTensorDenseMatMulFunctor<CPUDevice, T, Tindices, ADJ_A, ADJ_B> {
     const std::size_t lhs_right = (ADJ_B ? b.dimension(1) : b.dimension(0));
     const int lhs_index_a = ADJ_A ? 1 : 0;
     const int rhs_index_a = ADJ_A ? 0 : 1;
+    const int64 out_rows = out.dimension(0);
+
+    // Validate the indices and count the nonzeros that land in each output
+    // row.  row_starts[m] .. row_starts[m + 1] will delimit the nonzeros that
+    // update output row m.
+    std::vector<int64> row_starts(out_rows + 1, 0);
+    bool sorted_by_row = true;
+    Tindices prev_m = 0;
+    for (std::size_t i = 0; i < nnz; ++i) {
+      const Tindices m = internal::SubtleMustCopy(a_indices(i, lhs_index_a));
+      const Tindices k = internal::SubtleMustCopy(a_indices(i, rhs_index_a));
+      if (!FastBoundsCheck(k, lhs_right)) {
+        return KOutOfBoundsError(k, i, rhs_index_a, lhs_right);
+      }
+      if (!FastBoundsCheck(m, out_rows)) {
+        return MOutOfBoundsError(m, i, lhs_index_a, out_rows);
+      }
+      if (m < prev_m) sorted_by_row = false;
+      prev_m = m;
+      ++row_starts[m + 1];
+    }
+    for (int64 m = 0; m < out_rows; ++m) {
+      row_starts[m + 1] += row_starts[m];
+    }
 
-    out.setZero();
-
-    // TODO(ebrevdo): After many failed experiments, can't find a multi-threaded
-    // approach that achieves the performance of the single threaded
-    // one.  Perhaps Eigen threadpool implementation is just too slow?
-
-    if (rhs_right < kNumVectorize) {
-      // Disable vectorization if the RHS of output is too small
-      auto maybe_adjoint_b = MaybeAdjoint<decltype(b), ADJ_B>(b);
-
+    // Row-major (canonically ordered) indices with !ADJ_A are already grouped
+    // by output row.  Otherwise, and in particular for ADJ_A where the output
+    // row is A's column, group the nonzeros with a stable counting sort so
+    // that every output row is accumulated in the original nonzero order.
+    std::vector<int64> perm;
+    if (!sorted_by_row) {
+      perm.resize(nnz);
+      std::vector<int64> next(row_starts.begin(), row_starts.end() - 1);
       for (std::size_t i = 0; i < nnz; ++i) {
         const Tindices m = internal::SubtleMustCopy(a_indices(i, lhs_index_a));
-        const Tindices k = internal::SubtleMustCopy(a_indices(i, rhs_index_a));
-        if (!FastBoundsCheck(k, lhs_right)) {
-          return KOutOfBoundsError(k, i, rhs_index_a, lhs_right);
-        }
-        if (!FastBoundsCheck(m, out.dimension(0))) {
-          return MOutOfBoundsError(m, i, lhs_index_a, out.dimension(0));
-        }
-        const T a_value = ADJ_A ? MaybeConj(a_values(i)) : a_values(i);
-        for (std::size_t n = 0; n < rhs_right; ++n) {
-          const T b_value = maybe_adjoint_b(k, n);
-          out(m, n) += a_value * b_value;
-        }
+        perm[next[m]++] = i;
       }
-    } else {
-      // Vectorization via Eigen.
-      const int b_chip_index = ADJ_B ? 1 : 0;
-
-#define LOOP_NNZ(b_passed)                                                  \
-  for (std::size_t i = 0; i < nnz; ++i) {                                   \
-    const Tindices m = internal::SubtleMustCopy(a_indices(i, lhs_index_a)); \
-    const Tindices k = internal::SubtleMustCopy(a_indices(i, rhs_index_a)); \
-    const T a_value = (ADJ_A) ? MaybeConj(a_values(i)) : a_values(i);       \
-    if (!FastBoundsCheck(k, lhs_right)) {                                   \
-      return KOutOfBoundsError(k, i, rhs_index_a, lhs_right);               \
-    }                                                                       \
-    if (!FastBoundsCheck(m, out.dimension(0))) {                            \
-      return MOutOfBoundsError(m, i, lhs_index_a, out.dimension(0));        \
-    }                                                                       \
-    out.template chip<0>(m) +=                                              \
-        b_passed.template chip<b_chip_index>(k) * a_value;                  \
-  }
+    }
 
-      if (ADJ_B) {
-        // Perform transpose and conjugation on B once, since we chip out B's
-        // columns in the nnz loop.
-        Eigen::array<int, 2> shuffle(1, 0);  // preserve dimension order
-        Eigen::Tensor<T, 2, Eigen::ColMajor> col_major_conj_b =
-            b.swap_layout().shuffle(shuffle).conjugate();
-        LOOP_NNZ(col_major_conj_b);
-      } else {
-        LOOP_NNZ(b);
-      }
-#undef LOOP_NNZ
+    // With ADJ_B, B's columns are chipped out in the nonzero loop, so
+    // transpose and conjugate B once into a row-major buffer when the rows
+    // are wide enough for the copy to pay off.
+    const bool transpose_b = ADJ_B && rhs_right >= kNumVectorize;
+    Eigen::Tensor<T, 2, Eigen::RowMajor> b_adjoint;
+    if (transpose_b) {
+      Eigen::array<int, 2> shuffle(1, 0);
+      b_adjoint.resize(b.dimension(1), b.dimension(0));
+      b_adjoint.device(d) = b.shuffle(shuffle).conjugate();
     }
+    const T* b_rows = transpose_b ? b_adjoint.data() : b.data();
+    auto maybe_adjoint_b = MaybeAdjoint<decltype(b), ADJ_B>(b);
+
+    // Each shard owns a disjoint range of output rows, so no synchronization
+    // is required between shards.
+    auto compute_rows = [&](int64 begin_row, int64 end_row) {
+      for (int64 m = begin_row; m < end_row; ++m) {
+        T* out_row = &out(m, 0);
+        std::fill(out_row, out_row + rhs_right, T(0));
+        for (int64 j = row_starts[m]; j < row_starts[m + 1]; ++j) {
+          const int64 i = sorted_by_row ? j : perm[j];
+          const Tindices k =
+              internal::SubtleMustCopy(a_indices(i, rhs_index_a));
+          const T a_value = ADJ_A ? MaybeConj(a_values(i)) : a_values(i);
+          if (ADJ_B && !transpose_b) {
+            for (std::size_t n = 0; n < rhs_right; ++n) {
+              out_row[n] += a_value * maybe_adjoint_b(k, n);
+            }
+          } else {
+            ScaledRowAccumulate(a_value, b_rows + k * rhs_right, out_row,
+                                rhs_right);
+          }
+        }
+      }
+    };
+
+    const double avg_nnz_per_row =
+        static_cast<double>(nnz) / static_cast<double>(out_rows);
+    const Eigen::TensorOpCost cost_per_row(
+        /*bytes_loaded=*/avg_nnz_per_row *
+            (rhs_right * sizeof(T) + sizeof(T) + 2 * sizeof(Tindices)),
+        /*bytes_stored=*/rhs_right * sizeof(T),
+        /*compute_cycles=*/avg_nnz_per_row * rhs_right *
+            (Eigen::TensorOpCost::AddCost<T>() +
+             Eigen::TensorOpCost::MulCost<T>()));
+    d.parallelFor(out_rows, cost_per_row, compute_rows);
     return Status::OK();
   }
 };
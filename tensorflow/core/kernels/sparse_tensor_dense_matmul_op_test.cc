@@ -117,4 +117,9 @@ BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, false, true);
 BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, true, false);
 BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, true, true);
 
+// Embedding-style shapes: a large, very sparse A against a narrow B.
+BM_SparseTensorDenseMatmul(262144, 8192, 100000, 64, false, false);
+BM_SparseTensorDenseMatmul(262144, 8192, 100000, 64, true, false);
+BM_SparseTensorDenseMatmul(262144, 8192, 100000, 64, false, true);
+
 }  // end namespace tensorflow
@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -44,15 +45,22 @@ class StringToHashBucketOp : public OpKernel {
                                             &output_tensor));
     auto output_flat = output_tensor->flat<int64>();
 
-    typedef decltype(input_flat.size()) Index;
-    for (Index i = 0; i < input_flat.size(); ++i) {
-      const uint64 input_hash = hash(input_flat(i));
-      const uint64 bucket_id = input_hash % num_buckets_;
-      // The number of buckets is always in the positive range of int64 so is
-      // the resulting bucket_id. Casting the bucket_id from uint64 to int64 is
-      // safe.
-      output_flat(i) = static_cast<int64>(bucket_id);
-    }
+    auto hash_range = [this, &input_flat, &output_flat](int64 start,
+                                                        int64 limit) {
+      for (int64 i = start; i < limit; ++i) {
+        const uint64 input_hash = hash(input_flat(i));
+        const uint64 bucket_id = input_hash % num_buckets_;
+        // The number of buckets is always in the positive range of int64 so
+        // is the resulting bucket_id. Casting the bucket_id from uint64 to
+        // int64 is safe.
+        output_flat(i) = static_cast<int64>(bucket_id);
+      }
+    };
+    // Rough cost of hashing a short string, in cycles.
+    const int64 kCostPerUnit = 50;
+    auto* worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers,
+          input_flat.size(), kCostPerUnit, hash_range);
   }
 
  private:
@@ -86,15 +94,22 @@ class StringToKeyedHashBucketOp : public OpKernel {
                                             &output_tensor));
     auto output_flat = output_tensor->flat<int64>();
 
-    typedef decltype(input_flat.size()) Index;
-    for (Index i = 0; i < input_flat.size(); ++i) {
-      const uint64 input_hash = hash(key_, input_flat(i));
-      const uint64 bucket_id = input_hash % num_buckets_;
-      // The number of buckets is always in the positive range of int64 so is
-      // the resulting bucket_id. Casting the bucket_id from uint64 to int64 is
-      // safe.
-      output_flat(i) = static_cast<int64>(bucket_id);
-    }
+    auto hash_range = [this, &input_flat, &output_flat](int64 start,
+                                                        int64 limit) {
+      for (int64 i = start; i < limit; ++i) {
+        const uint64 input_hash = hash(key_, input_flat(i));
+        const uint64 bucket_id = input_hash % num_buckets_;
+        // The number of buckets is always in the positive range of int64 so
+        // is the resulting bucket_id. Casting the bucket_id from uint64 to
+        // int64 is safe.
+        output_flat(i) = static_cast<int64>(bucket_id);
+      }
+    };
+    // Rough cost of a keyed hash of a short string, in cycles.
+    const int64 kCostPerUnit = 150;
+    auto* worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers,
+          input_flat.size(), kCostPerUnit, hash_range);
   }
 
  private:
@@ -20,7 +20,10 @@ limitations under the License.
 #include "tensorflow/core/kernels/topk_op.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <numeric>
+#include <type_traits>
 #include <vector>
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -99,6 +102,247 @@ class TopK : public OpKernel {
 
 namespace functor {
 
+namespace {
+
+// Rows shorter than this are never split across threads.
+const int64 kRadixSelectMinCols = 1 << 16;
+// Number of key bits resolved by each radix select pass.
+const int kRadixBits = 8;
+const int kRadixBuckets = 1 << kRadixBits;
+// Radix refinement stops once this few candidates remain; they are then
+// resolved with std::nth_element.
+const int64 kRadixSelectMaxCandidates = 4096;
+
+// Returns the bit pattern of a floating point value as an unsigned key whose
+// unsigned ordering matches the ordering of the values.
+template <typename Bits>
+Bits FloatBitsToRadixKey(Bits bits) {
+  const Bits sign = Bits(1) << (8 * sizeof(Bits) - 1);
+  return (bits & sign) ? static_cast<Bits>(~bits)
+                       : static_cast<Bits>(bits | sign);
+}
+
+// RadixSelectKey<T>::Get(v) maps v to an unsigned integer key such that
+// a < b iff Get(a) < Get(b).  -0.0 and +0.0 map to the same key, matching
+// the comparison used by the heap-based selection.  NaNs are ordered by their
+// bit pattern (positive NaNs above +inf).
+template <typename T, typename Enable = void>
+struct RadixSelectKey;
+
+template <typename T>
+struct RadixSelectKey<
+    T, typename std::enable_if<std::is_integral<T>::value>::type> {
+  typedef typename std::make_unsigned<T>::type Key;
+  static Key Get(T v) {
+    const Key flip = std::is_signed<T>::value
+                         ? static_cast<Key>(Key(1) << (8 * sizeof(Key) - 1))
+                         : Key(0);
+    return static_cast<Key>(static_cast<Key>(v) ^ flip);
+  }
+};
+
+template <>
+struct RadixSelectKey<float> {
+  typedef uint32 Key;
+  static Key Get(float v) {
+    if (v == 0.0f) v = 0.0f;
+    Key bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    return FloatBitsToRadixKey(bits);
+  }
+};
+
+template <>
+struct RadixSelectKey<double> {
+  typedef uint64 Key;
+  static Key Get(double v) {
+    if (v == 0.0) v = 0.0;
+    Key bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    return FloatBitsToRadixKey(bits);
+  }
+};
+
+template <>
+struct RadixSelectKey<Eigen::half> {
+  typedef uint16 Key;
+  static Key Get(Eigen::half v) {
+    const Key bits = static_cast<float>(v) == 0.0f ? Key(0) : v.x;
+    return FloatBitsToRadixKey(bits);
+  }
+};
+
+template <>
+struct RadixSelectKey<bfloat16> {
+  typedef uint16 Key;
+  static Key Get(bfloat16 v) {
+    const Key bits = static_cast<float>(v) == 0.0f ? Key(0) : v.value;
+    return FloatBitsToRadixKey(bits);
+  }
+};
+
+// Returns true if rows of this shape are expected to be faster with a radix
+// select parallelized within each row than with a heap per row and rows
+// sharded over the threads.  Costs are in units of one element comparison.
+bool UseRadixSelect(int64 num_rows, int64 num_cols, int k, int num_threads) {
+  if (num_threads <= 1 || num_cols < kRadixSelectMinCols || k >= num_cols) {
+    return false;
+  }
+  const double n = static_cast<double>(num_cols);
+  const double log_k = Eigen::numext::log2(static_cast<double>(k) + 1);
+  // Every element is compared against the heap's minimum; for inputs in
+  // random order about k * ln(n / k) of them are pushed at log(k) each.
+  const double heap_row_cost = n + 4 * k * std::log(n / k) * log_k;
+  // Each pass builds a histogram of its entries and gathers them, both split
+  // over all threads, at about three comparisons per entry.  The bucket of
+  // the top key byte which holds the k-th largest key can hold about half of
+  // the row (e.g. the values of [0.5, 1) share their sign and exponent bits),
+  // and the later passes shrink the candidates by the radix.  The k survivors
+  // are then sorted.
+  const double candidates = n / 2;
+  const double radix_row_cost = 3 * (n + candidates) / num_threads +
+                                k * log_k;
+  const double heap_cost =
+      heap_row_cost * ((num_rows + num_threads - 1) / num_threads);
+  const double radix_cost = radix_row_cost * num_rows;
+  return radix_cost < heap_cost;
+}
+
+// Runs one radix select pass over entries[0:num_entries], or over the
+// columns [0:num_entries) if `entries` is null.  Finds the bucket of the
+// need-th largest key, given the bucket of each column by `bucket_of`,
+// appends the entries in the buckets above it to `winners`, and returns
+// those in that bucket in `candidates`, both in entry order.  Returns the
+// number of winners.
+//
+// Per-block histograms are built in parallel, and the entries are gathered
+// in parallel at offsets derived from the block histograms.
+template <typename T, typename BucketFn>
+int64 RadixSelectPass(const DeviceBase::CpuWorkerThreads& worker_threads,
+                      const int32* entries, int64 num_entries, int64 need,
+                      const BucketFn& bucket_of, int32* winners,
+                      std::vector<int32>* candidates) {
+  const int64 num_blocks = std::max<int64>(
+      1, std::min<int64>(4 * worker_threads.num_threads,
+                         (num_entries + kRadixSelectMinCols / 4 - 1) /
+                             (kRadixSelectMinCols / 4)));
+  const int64 block_size = (num_entries + num_blocks - 1) / num_blocks;
+  const int64 block_cost = block_size * 4 * Eigen::TensorOpCost::AddCost<T>();
+  const auto entry = [entries](int64 i) {
+    return entries == nullptr ? static_cast<int32>(i) : entries[i];
+  };
+
+  std::vector<int64> block_hist(num_blocks * kRadixBuckets, 0);
+  Shard(worker_threads.num_threads, worker_threads.workers, num_blocks,
+        block_cost, [&](int64 start_block, int64 limit_block) {
+          for (int64 blk = start_block; blk < limit_block; ++blk) {
+            int64* hist = &block_hist[blk * kRadixBuckets];
+            const int64 limit = std::min(num_entries, (blk + 1) * block_size);
+            for (int64 i = blk * block_size; i < limit; ++i) {
+              ++hist[bucket_of(entry(i))];
+            }
+          }
+        });
+
+  int64 hist[kRadixBuckets] = {0};
+  for (int64 blk = 0; blk < num_blocks; ++blk) {
+    for (int i = 0; i < kRadixBuckets; ++i) {
+      hist[i] += block_hist[blk * kRadixBuckets + i];
+    }
+  }
+  int pivot = kRadixBuckets - 1;
+  int64 num_winners = 0;
+  while (num_winners + hist[pivot] < need) {
+    num_winners += hist[pivot--];
+  }
+
+  std::vector<int64> winner_offsets(num_blocks + 1, 0);
+  std::vector<int64> candidate_offsets(num_blocks + 1, 0);
+  for (int64 blk = 0; blk < num_blocks; ++blk) {
+    const int64* blk_hist = &block_hist[blk * kRadixBuckets];
+    int64 blk_winners = 0;
+    for (int i = pivot + 1; i < kRadixBuckets; ++i) blk_winners += blk_hist[i];
+    winner_offsets[blk + 1] = winner_offsets[blk] + blk_winners;
+    candidate_offsets[blk + 1] = candidate_offsets[blk] + blk_hist[pivot];
+  }
+  candidates->resize(hist[pivot]);
+  Shard(worker_threads.num_threads, worker_threads.workers, num_blocks,
+        block_cost, [&](int64 start_block, int64 limit_block) {
+          for (int64 blk = start_block; blk < limit_block; ++blk) {
+            int32* winner = winners + winner_offsets[blk];
+            int32* candidate = candidates->data() + candidate_offsets[blk];
+            int32* const candidate_end =
+                candidates->data() + candidate_offsets[blk + 1];
+            const int64 limit = std::min(num_entries, (blk + 1) * block_size);
+            for (int64 i = blk * block_size; i < limit; ++i) {
+              const int32 c = entry(i);
+              const int bucket = bucket_of(c);
+              if (bucket > pivot) *winner++ = c;
+              // Often about half of the entries are candidates, in random
+              // order, so store without branching on the bucket.
+              if (candidate != candidate_end) {
+                *candidate = c;
+                candidate += bucket == pivot;
+              }
+            }
+          }
+        });
+  return num_winners;
+}
+
+// Writes the indices of the k largest entries of input[0:num_cols] to
+// indices[0:k], breaking ties in favor of lower indices, sorted in descending
+// order of value if `sorted`.
+//
+// Each radix pass resolves the next 8 key bits of the remaining candidates,
+// in parallel, until few enough of them remain for std::nth_element.
+template <typename T, typename Comp>
+void RadixSelectTopK(const DeviceBase::CpuWorkerThreads& worker_threads,
+                     const T* input_data, int64 num_cols, int k, bool sorted,
+                     const Comp& stable_comp, int32* indices) {
+  typedef RadixSelectKey<T> KeyFn;
+  const int kKeyBits = 8 * sizeof(typename KeyFn::Key);
+  int shift = kKeyBits - kRadixBits;
+
+  std::vector<int32> candidates;
+  int64 num_winners = RadixSelectPass<T>(
+      worker_threads, nullptr, num_cols, k,
+      [input_data, shift](int32 c) {
+        return static_cast<int>(KeyFn::Get(input_data[c]) >> shift);
+      },
+      indices, &candidates);
+
+  // All remaining candidates share the key bits above `shift`.
+  int64 need = k - num_winners;
+  std::vector<int32> next_candidates;
+  while (need < static_cast<int64>(candidates.size()) &&
+         candidates.size() > kRadixSelectMaxCandidates && shift > 0) {
+    shift = std::max(0, shift - kRadixBits);
+    const int64 above = RadixSelectPass<T>(
+        worker_threads, candidates.data(), candidates.size(), need,
+        [input_data, shift](int32 c) {
+          return static_cast<int>((KeyFn::Get(input_data[c]) >> shift) &
+                                  (kRadixBuckets - 1));
+        },
+        indices + num_winners, &next_candidates);
+    num_winners += above;
+    need -= above;
+    candidates.swap(next_candidates);
+  }
+  if (need < static_cast<int64>(candidates.size())) {
+    std::nth_element(candidates.begin(), candidates.begin() + need,
+                     candidates.end(), stable_comp);
+  }
+  std::copy(candidates.begin(), candidates.begin() + need,
+            indices + num_winners);
+
+  if (sorted) {
+    std::sort(indices, indices + k, stable_comp);
+  }
+}
+
+}  // namespace
+
 template <typename T>
 struct TopKFunctor<CPUDevice, T> {
   static EIGEN_ALWAYS_INLINE Status
@@ -134,18 +378,38 @@ struct TopKFunctor<CPUDevice, T> {
       return Status::OK();
     }
 
+    // Orders indices by descending value, breaking ties by ascending index.
+    const auto make_stable_comp = [](const T* input_data) {
+      return [input_data](const int32 a, const int32 b) {
+        if (input_data[b] < input_data[a]) {
+          return true;
+        } else if (input_data[b] > input_data[a]) {
+          return false;
+        } else {
+          return a < b;
+        }
+      };
+    };
+
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    if (UseRadixSelect(num_rows, num_cols, k, worker_threads.num_threads)) {
+      // Too few rows to keep the threads busy: parallelize within each row.
+      for (int64 b = 0; b < num_rows; ++b) {
+        const T* input_data = &input(b, 0);
+        RadixSelectTopK(worker_threads, input_data, num_cols, k, sorted,
+                        make_stable_comp(input_data), &indices(b, 0));
+        std::transform(&indices(b, 0), &indices(b, k), &values(b, 0),
+                       [input_data](const int32 loc) {
+                         return input_data[loc];
+                       });
+      }
+      return Status::OK();
+    }
+
     auto SortIndices = [&, context](int start_batch, int limit_batch) {
       for (int32 b = start_batch; b < limit_batch; ++b) {
         const T* input_data = &input(b, 0);
-        const auto stable_comp = [input_data](const int32 a, const int32 b) {
-          if (input_data[b] < input_data[a]) {
-            return true;
-          } else if (input_data[b] > input_data[a]) {
-            return false;
-          } else {
-            return a < b;
-          }
-        };
+        const auto stable_comp = make_stable_comp(input_data);
         const auto comp = [input_data](const int32 a, const int32 b) {
           return input_data[b] < input_data[a];
         };
@@ -219,7 +483,6 @@ struct TopKFunctor<CPUDevice, T> {
     const int64 final_cost = (total_cost >= static_cast<double>(kint64max))
                                  ? kint64max
                                  : static_cast<int64>(total_cost);
-    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
     Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
           final_cost, SortIndices);
 
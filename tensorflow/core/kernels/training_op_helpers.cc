@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/training_op_helpers.h"
 
+#include "tensorflow/core/lib/hash/hash.h"
+
 namespace tensorflow {
 
 mutex* GetTrainingVariableMutex(OpKernelContext* ctx, int input) {
@@ -72,4 +74,14 @@ void MaybeForwardRefInputToRefOutput(OpKernelContext* ctx, int input,
   }
 }
 
+mutex* GetRowMutex(const Tensor& var, int64 row) {
+  // Enough stripes that concurrent updates of a few thousand distinct rows
+  // rarely collide.
+  static const int kNumRowMutexes = 4096;
+  static mutex* row_mutexes = new mutex[kNumRowMutexes];
+  const uint64 buffer = reinterpret_cast<uintptr_t>(var.tensor_data().data());
+  const uint64 h = Hash64Combine(buffer, static_cast<uint64>(row));
+  return &row_mutexes[h % kNumRowMutexes];
+}
+
 }  // end namespace tensorflow
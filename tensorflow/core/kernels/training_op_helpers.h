@@ -16,10 +16,15 @@ limitations under the License.
 #ifndef TENSORFLOW_KERNELS_TRAINING_OP_HELPERS_H_
 #define TENSORFLOW_KERNELS_TRAINING_OP_HELPERS_H_
 
+#include <functional>
+
 #include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_types.h"
 #include "tensorflow/core/framework/variant_op_registry.h"
+#include "tensorflow/core/kernels/bounds_check.h"
 #include "tensorflow/core/kernels/dense_update_functor.h"
 #include "tensorflow/core/kernels/variable_ops.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -31,6 +36,48 @@ std::vector<mutex_lock> MaybeLockVariableInputMutexesInOrder(
 void MaybeForwardRefInputToRefOutput(OpKernelContext* ctx, int input,
                                      int output);
 
+// Returns one of a fixed, process-wide set of mutexes, striped by the buffer
+// of the variable tensor `var` and a row index into its first dimension.
+// Sparse training kernels with `use_row_locking` hold it while they update a
+// row of a variable and of its slots in place, instead of holding the mutex
+// of the whole variable.
+mutex* GetRowMutex(const Tensor& var, int64 row);
+
+// Calls `fn(i, index)` for every i in [0, indices.size()) with the row
+// `index = indices(i)` of `var` that the i-th row of a sparse update applies
+// to, skipping indices outside [0, num_rows), which the caller is expected to
+// have reported already.  If `lock_rows`, the calls run in parallel on the
+// intra-op thread pool and each holds GetRowMutex(var, index), so that
+// duplicate indices are still applied one at a time.  Otherwise they run in
+// order on the calling thread.
+template <typename Tindex>
+void ForEachSparseUpdateRow(OpKernelContext* ctx, const Tensor& var,
+                            typename TTypes<Tindex>::ConstVec indices,
+                            Tindex num_rows, bool lock_rows,
+                            int64 cost_per_row,
+                            const std::function<void(Tindex, Tindex)>& fn) {
+  const Tindex n = indices.size();
+  auto apply_range = [&](int64 start, int64 end) {
+    for (int64 i = start; i < end; ++i) {
+      const Tindex index = internal::SubtleMustCopy(indices(i));
+      if (!FastBoundsCheck(index, num_rows)) continue;
+      if (lock_rows) {
+        mutex_lock l(*GetRowMutex(var, index));
+        fn(i, index);
+      } else {
+        fn(i, index);
+      }
+    }
+  };
+  if (!lock_rows) {
+    apply_range(0, n);
+    return;
+  }
+  auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+  Shard(worker_threads->num_threads, worker_threads->workers, n, cost_per_row,
+        apply_range);
+}
+
 // This is for use with ResourceVariables to ensure *tensor has a
 // reference count of 1 before you update it.
 // REQUIRES: If you pass in variable->tensor(), *variable->mu() must be held.
@@ -1272,6 +1272,7 @@ class SparseApplyAdagradOp : public OpKernel {
   explicit SparseApplyAdagradOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("use_locking", &use_exclusive_lock_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("update_slots", &update_slots_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("use_row_locking", &use_row_locking_));
   }
 
   void Compute(OpKernelContext* ctx) override NO_THREAD_SAFETY_ANALYSIS {
@@ -1326,51 +1327,50 @@ class SparseApplyAdagradOp : public OpKernel {
                     "Inner dimension should be greater than zero."));
 
     if (N > 0) {
+      const Tindex first_dim_size = var.dim_size(0);
+      auto indices_vec = indices.vec<Tindex>();
+      for (Tindex i = 0; i < N; i++) {
+        const Tindex index = internal::SubtleMustCopy(indices_vec(i));
+        OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
+                    errors::InvalidArgument(
+                        strings::StrCat("Index ", index, " at offset ", i,
+                                        " in indices is out of range")));
+      }
+      const bool lock_rows = use_row_locking_ && !use_exclusive_lock_;
+      T lr_scalar = lr.scalar<T>()();
       if (inner_dim > 1) {
-        const Tindex first_dim_size = var.dim_size(0);
-        auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat_outer_dims<T>();
         auto accum_flat = accum.flat_outer_dims<T>();
         auto grad_flat = grad.flat_outer_dims<T>();
-        T lr_scalar = lr.scalar<T>()();
 
         // Note(yonghui): It might be worth multi-threading square() and
         // rsqrt().
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-          auto a = accum_flat.template chip<0>(index);
-          auto g = grad_flat.template chip<0>(i);
-          auto v = var_flat.template chip<0>(index);
-          if (update_slots_) {
-            a += g.square();
-          }
-          v -= g.constant(lr_scalar) * g * a.rsqrt();
-        }
+        ForEachSparseUpdateRow<Tindex>(
+            ctx, var, indices_vec, first_dim_size, lock_rows, 10 * inner_dim,
+            [&](Tindex i, Tindex index) {
+              auto a = accum_flat.template chip<0>(index);
+              auto g = grad_flat.template chip<0>(i);
+              auto v = var_flat.template chip<0>(index);
+              if (update_slots_) {
+                a += g.square();
+              }
+              v -= g.constant(lr_scalar) * g * a.rsqrt();
+            });
       } else {
-        auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat<T>();
         auto accum_flat = accum.flat<T>();
         auto grad_flat = grad.flat<T>();
-        T lr_scalar = lr.scalar<T>()();
-        const Tindex first_dim_size = accum_flat.size();
 
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-          T& a = accum_flat(index);
-          const T& g = grad_flat(i);
-          if (update_slots_) {
-            a += g * g;
-          }
-          var_flat(index) -= lr_scalar * g / Eigen::numext::sqrt(a);
-        }
+        ForEachSparseUpdateRow<Tindex>(
+            ctx, var, indices_vec, first_dim_size, lock_rows, 10,
+            [&](Tindex i, Tindex index) {
+              T& a = accum_flat(index);
+              const T& g = grad_flat(i);
+              if (update_slots_) {
+                a += g * g;
+              }
+              var_flat(index) -= lr_scalar * g / Eigen::numext::sqrt(a);
+            });
       }
     }
 
@@ -1380,6 +1380,7 @@ class SparseApplyAdagradOp : public OpKernel {
  private:
   bool use_exclusive_lock_;
   bool update_slots_;
+  bool use_row_locking_;
 };
 
 #define REGISTER_KERNELS(T, Tindices)                                \
@@ -2035,6 +2036,7 @@ class SparseApplyFtrlOp : public OpKernel {
  public:
   explicit SparseApplyFtrlOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("use_locking", &use_exclusive_lock_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("use_row_locking", &use_row_locking_));
   }
 
   void Compute(OpKernelContext* ctx) override NO_THREAD_SAFETY_ANALYSIS {
@@ -2138,32 +2140,38 @@ class SparseApplyFtrlOp : public OpKernel {
     }
 
     if (N > 0) {
+      const Tindex first_dim_size = var.dim_size(0);
+      auto indices_vec = indices.vec<Tindex>();
+      for (Tindex i = 0; i < N; i++) {
+        const Tindex index = internal::SubtleMustCopy(indices_vec(i));
+        OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
+                    errors::InvalidArgument(
+                        strings::StrCat("Index ", index, " at offset ", i,
+                                        " in indices is out of range")));
+      }
+      const bool lock_rows = use_row_locking_ && !use_exclusive_lock_;
+      T lr_scalar = lr.scalar<T>()();
+      T l1_scalar = l1.scalar<T>()();
+      T l2_scalar = l2.scalar<T>()();
+      T l2_shrinkage_scalar;
+      if (has_l2_shrinkage) {
+        l2_shrinkage_scalar = l2_shrinkage->scalar<T>()();
+      }
+      T lr_power_scalar = lr_power.scalar<T>()();
+
       if (inner_dim > 1) {
-        const Tindex first_dim_size = var.dim_size(0);
-        auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat_outer_dims<T>();
         auto accum_flat = accum.flat_outer_dims<T>();
         auto linear_flat = linear.flat_outer_dims<T>();
         auto grad_flat = grad.flat_outer_dims<T>();
-        T lr_scalar = lr.scalar<T>()();
-        T l1_scalar = l1.scalar<T>()();
-        T l2_scalar = l2.scalar<T>()();
-        T l2_shrinkage_scalar;
-        if (has_l2_shrinkage) {
-          l2_shrinkage_scalar = l2_shrinkage->scalar<T>()();
-        }
-        T lr_power_scalar = lr_power.scalar<T>()();
 
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-          auto accum = accum_flat.template chip<0>(index);
-          auto linear = linear_flat.template chip<0>(index);
-          auto grad = grad_flat.template chip<0>(i);
-          auto var = var_flat.template chip<0>(index);
+        ForEachSparseUpdateRow<Tindex>(
+            ctx, var, indices_vec, first_dim_size, lock_rows, 40 * inner_dim,
+            [&](Tindex i, Tindex index) {
+              auto accum = accum_flat.template chip<0>(index);
+              auto linear = linear_flat.template chip<0>(index);
+              auto grad = grad_flat.template chip<0>(i);
+              auto var = var_flat.template chip<0>(index);
 
 // Use a macro to implement the computation here due to the templating of the
 // eigen tensor library.
@@ -2190,59 +2198,46 @@ class SparseApplyFtrlOp : public OpKernel {
   }                                                                            \
   accum += grad_to_use.square();
 
-          if (has_l2_shrinkage) {
-            auto grad_with_shrinkage =
-                grad + static_cast<T>(2) * l2_shrinkage_scalar * var;
-            COMPUTE_FTRL(grad_with_shrinkage);
-          } else {
-            COMPUTE_FTRL(grad);
-          }
-        }
+              if (has_l2_shrinkage) {
+                auto grad_with_shrinkage =
+                    grad + static_cast<T>(2) * l2_shrinkage_scalar * var;
+                COMPUTE_FTRL(grad_with_shrinkage);
+              } else {
+                COMPUTE_FTRL(grad);
+              }
 #undef COMPUTE_FTRL
+            });
       } else {
-        T lr_scalar = lr.scalar<T>()();
-        T l1_scalar = l1.scalar<T>()();
-        T l2_scalar = l2.scalar<T>()();
-        T lr_power_scalar = lr_power.scalar<T>()();
-        T l2_shrinkage_scalar;
-        if (has_l2_shrinkage) {
-          l2_shrinkage_scalar = l2_shrinkage->scalar<T>()();
-        }
-
-        auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat<T>();
         auto accum_flat = accum.flat<T>();
         auto linear_flat = linear.flat<T>();
         auto grad_flat = grad.flat<T>();
-        const Tindex first_dim_size = accum_flat.size();
-
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-          T& a = accum_flat(index);
-          T& l = linear_flat(index);
-          T& v = var_flat(index);
-          T g;
-          if (has_l2_shrinkage) {
-            g = grad_flat(i) +
-                (static_cast<T>(2) * l2_shrinkage_scalar * var_flat(i));
-          } else {
-            g = grad_flat(i);
-          }
 
-          T updated_a = a + g * g;
-          using Eigen::numext::pow;
-          T sigma = pow(updated_a, -lr_power_scalar) - pow(a, -lr_power_scalar);
-          sigma /= lr_scalar;
-          T updated_l = l + g - sigma * v;
-          v = FtrlCompute(updated_a, updated_l, lr_scalar, l1_scalar, l2_scalar,
-                          lr_power_scalar);
-          a = updated_a;
-          l = updated_l;
-        }
+        ForEachSparseUpdateRow<Tindex>(
+            ctx, var, indices_vec, first_dim_size, lock_rows, 40,
+            [&](Tindex i, Tindex index) {
+              T& a = accum_flat(index);
+              T& l = linear_flat(index);
+              T& v = var_flat(index);
+              T g;
+              if (has_l2_shrinkage) {
+                g = grad_flat(i) +
+                    (static_cast<T>(2) * l2_shrinkage_scalar * v);
+              } else {
+                g = grad_flat(i);
+              }
+
+              T updated_a = a + g * g;
+              using Eigen::numext::pow;
+              T sigma =
+                  pow(updated_a, -lr_power_scalar) - pow(a, -lr_power_scalar);
+              sigma /= lr_scalar;
+              T updated_l = l + g - sigma * v;
+              v = FtrlCompute(updated_a, updated_l, lr_scalar, l1_scalar,
+                              l2_scalar, lr_power_scalar);
+              a = updated_a;
+              l = updated_l;
+            });
       }
     }
 
@@ -2251,6 +2246,7 @@ class SparseApplyFtrlOp : public OpKernel {
 
  private:
   bool use_exclusive_lock_;
+  bool use_row_locking_;
 };
 
 #define REGISTER_KERNELS(T, Tindices)                                         \
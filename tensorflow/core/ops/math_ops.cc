@@ -716,6 +716,63 @@ REGISTER_OP("MatMul")
     .Attr("T: {bfloat16, half, float, double, int32, complex64, complex128}")
     .SetShapeFn(shape_inference::MatMulShape);
 
+REGISTER_OP("_FusedMatMul")
+    .Input("a: T")
+    .Input("b: T")
+    .Input("args: num_args * T")
+    .Output("product: T")
+    .Attr("transpose_a: bool = false")
+    .Attr("transpose_b: bool = false")
+    .Attr("T: {float, double}")
+    .Attr("num_args: int >= 0")
+    .Attr("fused_ops: list(string) = []")
+    .SetShapeFn(shape_inference::MatMulShape)
+    .Doc(R"doc(
+Computes a matrix product followed by the operations in `fused_ops`.
+
+`fused_ops` is "BiasAdd", optionally followed by one of "Relu", "Relu6" or
+"Elu", and `args` holds the bias. The bias and activation are applied in one
+pass over the product, on CPU.
+
+NOTE Do not invoke this operator directly in Python. Grappler is expected to
+create these operators.
+)doc");
+
+REGISTER_OP("_FusedElementwise")
+    .Input("inputs: N * T")
+    .Output("output: T")
+    .Attr("T: {float, double}")
+    .Attr("N: int >= 1")
+    .Attr("opcodes: list(string) >= 1")
+    .Attr("operands: list(int)")
+    .SetShapeFn([](InferenceContext* c) {
+      // Every input is either a scalar or has the shape of the output.
+      ShapeHandle out = c->Scalar();
+      for (int i = 0; i < c->num_inputs(); ++i) {
+        ShapeHandle input = c->input(i);
+        if (c->RankKnown(input) && c->Rank(input) == 0) continue;
+        if (c->RankKnown(out) && c->Rank(out) == 0) {
+          out = input;
+        } else {
+          TF_RETURN_IF_ERROR(c->Merge(out, input, &out));
+        }
+      }
+      c->set_output(0, out);
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Evaluates a chain of elementwise operations in a single pass over its inputs.
+
+The chain is a small program: registers `0` to `N - 1` hold `inputs`, and the
+i-th opcode writes register `N + i`, reading one register (unary opcodes) or
+two registers (binary opcodes) from `operands`, in order. The output is the
+last register. Every input is either a scalar, which is broadcast, or has the
+shape of the output.
+
+NOTE Do not invoke this operator directly in Python. Grappler is expected to
+create these operators.
+)doc");
+
 REGISTER_OP("SparseMatMul")
     .Input("a: Ta")
     .Input("b: Tb")
@@ -274,6 +274,30 @@ REGISTER_OP("Conv2D")
     .Attr("dilations: list(int) = [1, 1, 1, 1]")
     .SetShapeFn(shape_inference::Conv2DShape);
 
+REGISTER_OP("_FusedConv2D")
+    .Input("input: T")
+    .Input("filter: T")
+    .Input("args: num_args * T")
+    .Output("output: T")
+    .Attr("T: {float, double}")
+    .Attr("num_args: int >= 0")
+    .Attr("strides: list(int)")
+    .Attr(GetPaddingAttrString())
+    .Attr(GetConvnetDataFormatAttrString())
+    .Attr("dilations: list(int) = [1, 1, 1, 1]")
+    .Attr("fused_ops: list(string) = []")
+    .SetShapeFn(shape_inference::Conv2DShape)
+    .Doc(R"doc(
+Computes a 2-D convolution followed by the operations in `fused_ops`.
+
+`fused_ops` is "BiasAdd", optionally followed by one of "Relu", "Relu6" or
+"Elu", and `args` holds the bias. The bias and activation are applied in one
+pass over the output of the convolution. Only NHWC is supported, on CPU.
+
+NOTE Do not invoke this operator directly in Python. Grappler is expected to
+create these operators.
+)doc");
+
 REGISTER_OP("Conv2DBackpropInput")
     .Input("input_sizes: int32")
     .Input("filter: T")
@@ -23,6 +23,7 @@ import sys
 
 import numpy as np
 
+from tensorflow.core.protobuf import config_pb2
 from tensorflow.python.client import session
 from tensorflow.python.framework import constant_op
 from tensorflow.python.framework import dtypes
@@ -148,6 +149,30 @@ class TopKTest(test.TestCase):
     self._testMediumTopK(np.float32)
     self._testMediumTopK(np.float16)
 
+  def _testLongRowTopK(self, dtype):
+    # A single long row takes the radix select path on multi-core hosts.
+    n = 1 << 17
+    k = 1000
+    inputs = np.random.permutation(
+        np.linspace(-100, 100, n, dtype=dtype)).reshape(1, n)
+    indices = np.argsort(-inputs, axis=1)[:, :k]
+    values = -np.sort(-inputs, axis=1)[:, :k]
+    self._validateTopK(inputs, k, values, indices)
+    self._validateTopK(inputs, k, values, indices, sorted=False)
+
+  def testLongRowTopK(self):
+    self._testLongRowTopK(np.float32)
+    self._testLongRowTopK(np.float64)
+
+  def testLongRowStableSort(self):
+    n = 1 << 17
+    inputs = np.random.permutation(
+        np.linspace(-3, 3, n, dtype=np.int32)).reshape(1, n)
+    for k in [5, 5000]:
+      indices = np.argsort(-inputs, axis=1, kind="mergesort")[:, :k]
+      values = -np.sort(-inputs, axis=1)[:, :k]
+      self._validateTopK(inputs, k, values, indices)
+
   def testStableSort(self):
     b = 5
     n = 500
@@ -235,6 +260,27 @@ class TopKBenchmark(test.Benchmark):
                 "Throughput: %0.03g GB/s" % (name, r["wall_time"], throughput))
           sys.stdout.flush()
 
+  def benchmarkTopKLongRow(self):
+    # The number of threads at which the radix select within the row beats
+    # the heap depends on the cost of the radix passes.
+    for (n, k, num_threads) in itertools.product(
+        [1000000, 10000000], [10, 1000, 100000], [1, 2, 4, 8, 16]):
+      name = "m_1_n_%d_k_%d_threads_%d" % (n, k, num_threads)
+      with ops.Graph().as_default():
+        with ops.device("/cpu:0"):
+          x = random_ops.random_uniform((1, n))
+          v = resource_variable_ops.ResourceVariable(x)
+          op = nn_ops.top_k(v, k)
+        config = config_pb2.ConfigProto(
+            intra_op_parallelism_threads=num_threads)
+        with session.Session(config=config) as sess:
+          v.initializer.run()
+          r = self.run_op_benchmark(sess, op, min_iters=20, name=name)
+          throughput = n / 1.0e9 / r["wall_time"]
+          print("Benchmark: %s \t wall_time: %0.03g s \t "
+                "Throughput: %0.03g GB/s" % (name, r["wall_time"], throughput))
+          sys.stdout.flush()
+
 
 if __name__ == "__main__":
   test.main()
@@ -38,7 +38,7 @@ class AdagradOptimizer(optimizer.Optimizer):
   """
 
   def __init__(self, learning_rate, initial_accumulator_value=0.1,
-               use_locking=False, name="Adagrad"):
+               use_locking=False, name="Adagrad", use_row_locking=False):
     """Construct a new Adagrad optimizer.
 
     Args:
@@ -48,6 +48,8 @@ class AdagradOptimizer(optimizer.Optimizer):
       use_locking: If `True` use locks for update operations.
       name: Optional name prefix for the operations created when applying
         gradients.  Defaults to "Adagrad".
+      use_row_locking: If `True` and `use_locking` is `False`, sparse updates
+        lock only the rows they update, and apply distinct rows in parallel.
 
     Raises:
       ValueError: If the `initial_accumulator_value` is invalid.
@@ -58,6 +60,7 @@ class AdagradOptimizer(optimizer.Optimizer):
     super(AdagradOptimizer, self).__init__(use_locking, name)
     self._learning_rate = learning_rate
     self._initial_accumulator_value = initial_accumulator_value
+    self._use_row_locking = use_row_locking
     # Created in Initialize.
     self._learning_rate_tensor = None
 
@@ -107,7 +110,8 @@ class AdagradOptimizer(optimizer.Optimizer):
         math_ops.cast(self._learning_rate_tensor, var.dtype.base_dtype),
         grad.values,
         grad.indices,
-        use_locking=self._use_locking)
+        use_locking=self._use_locking,
+        use_row_locking=self._use_row_locking)
 
   def _resource_apply_sparse(self, grad, var, indices):
     acc = self.get_slot(var, "accumulator")
@@ -117,4 +121,5 @@ class AdagradOptimizer(optimizer.Optimizer):
         math_ops.cast(self._learning_rate_tensor, grad.dtype),
         grad,
         indices,
-        use_locking=self._use_locking)
+        use_locking=self._use_locking,
+        use_row_locking=self._use_row_locking)
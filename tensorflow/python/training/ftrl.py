@@ -46,7 +46,8 @@ class FtrlOptimizer(optimizer.Optimizer):
                name="Ftrl",
                accum_name=None,
                linear_name=None,
-               l2_shrinkage_regularization_strength=0.0):
+               l2_shrinkage_regularization_strength=0.0,
+               use_row_locking=False):
     r"""Construct a new FTRL optimizer.
 
     Args:
@@ -78,6 +79,8 @@ class FtrlOptimizer(optimizer.Optimizer):
                   2*L2_shrinkage*lr_t / (1 + 2*L2*lr_t) * w_t
         where lr_t is the learning rate at t.
         When input is sparse shrinkage will only happen on the active weights.
+      use_row_locking: If `True` and `use_locking` is `False`, sparse updates
+        lock only the rows they update, and apply distinct rows in parallel.
 
     Raises:
       ValueError: If one of the arguments is invalid.
@@ -118,6 +121,7 @@ class FtrlOptimizer(optimizer.Optimizer):
     self._l2_shrinkage_regularization_strength_tensor = None
     self._accum_name = accum_name
     self._linear_name = linear_name
+    self._use_row_locking = use_row_locking
 
   def _create_slots(self, var_list):
     # Create the "accum" and "linear" slots.
@@ -221,7 +225,8 @@ class FtrlOptimizer(optimizer.Optimizer):
           math_ops.cast(self._l2_regularization_strength_tensor,
                         var.dtype.base_dtype),
           math_ops.cast(self._learning_rate_power_tensor, var.dtype.base_dtype),
-          use_locking=self._use_locking)
+          use_locking=self._use_locking,
+          use_row_locking=self._use_row_locking)
     else:
       return training_ops.sparse_apply_ftrl_v2(
           var,
@@ -237,7 +242,8 @@ class FtrlOptimizer(optimizer.Optimizer):
           math_ops.cast(self._l2_shrinkage_regularization_strength_tensor,
                         grad.dtype.base_dtype),
           math_ops.cast(self._learning_rate_power_tensor, var.dtype.base_dtype),
-          use_locking=self._use_locking)
+          use_locking=self._use_locking,
+          use_row_locking=self._use_row_locking)
 
   def _resource_apply_sparse(self, grad, var, indices):
     accum = self.get_slot(var, "accum")
@@ -253,7 +259,8 @@ class FtrlOptimizer(optimizer.Optimizer):
           math_ops.cast(self._l1_regularization_strength_tensor, grad.dtype),
           math_ops.cast(self._l2_regularization_strength_tensor, grad.dtype),
           math_ops.cast(self._learning_rate_power_tensor, grad.dtype),
-          use_locking=self._use_locking)
+          use_locking=self._use_locking,
+          use_row_locking=self._use_row_locking)
     else:
       return training_ops.resource_sparse_apply_ftrl_v2(
           var.handle,
@@ -267,4 +274,5 @@ class FtrlOptimizer(optimizer.Optimizer):
           math_ops.cast(self._l2_shrinkage_regularization_strength_tensor,
                         grad.dtype),
           math_ops.cast(self._learning_rate_power_tensor, grad.dtype),
-          use_locking=self._use_locking)
+          use_locking=self._use_locking,
+          use_row_locking=self._use_row_locking)
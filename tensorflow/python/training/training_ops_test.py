@@ -245,6 +245,94 @@ class TrainingOpsTest(TensorFlowTestCase):
       indices = np.array([0, 2]).astype(index_type)
       self._testTypesForSparseFtrl(x, y, z, lr, grad, indices)
 
+  def testSparseApplyFtrlV2Dim1(self):
+    # The shrinkage term uses var at the updated index, not at the position
+    # of the gradient.
+    x = np.array([1.0, 2.0, 3.0, 4.0])
+    y = np.array([1.0, 2.0, 3.0, 4.0])
+    z = np.array([0.5, -0.5, 1.0, -1.0])
+    grad = np.array([0.5, -0.25])
+    indices = np.array([3, 1], dtype=np.int64)
+    lr, l1, l2, l2_shrinkage, lr_power = 0.1, 0.01, 0.02, 0.5, -0.5
+    expected_var, expected_accum, expected_linear = x.copy(), y.copy(), z.copy()
+    for i, index in enumerate(indices):
+      g = grad[i] + 2 * l2_shrinkage * x[index]
+      accum = y[index] + g * g
+      linear = z[index] + g - (np.sqrt(accum) - np.sqrt(y[index])) / lr * x[
+          index]
+      quadratic = np.sqrt(accum) / lr + 2 * l2
+      expected_var[index] = (np.clip(linear, -l1, l1) - linear) / quadratic
+      expected_accum[index] = accum
+      expected_linear[index] = linear
+    for use_row_locking in [False, True]:
+      with self.test_session(use_gpu=False):
+        var = variables.Variable(x)
+        accum = variables.Variable(y)
+        linear = variables.Variable(z)
+        variables.global_variables_initializer().run()
+        training_ops.sparse_apply_ftrl_v2(
+            var, accum, linear, grad, indices, lr, l1, l2, l2_shrinkage,
+            lr_power, use_row_locking=use_row_locking).eval()
+        self.assertAllClose(expected_var, var.eval())
+        self.assertAllClose(expected_accum, accum.eval())
+        self.assertAllClose(expected_linear, linear.eval())
+
+  def testSparseApplyAdagradRowLocking(self):
+    for inner_dim in [1, 4]:
+      x = np.random.rand(64, inner_dim)
+      y = np.random.rand(64, inner_dim) + 0.1
+      lr = np.array(0.5)
+      indices = np.random.permutation(64)[:48].astype(np.int64)
+      grad = np.random.randn(48, inner_dim)
+      expected_var = x.copy()
+      expected_accum = y.copy()
+      expected_accum[indices] += grad * grad
+      expected_var[indices] -= lr * grad / np.sqrt(expected_accum[indices])
+      with self.test_session(use_gpu=False):
+        var = variables.Variable(x)
+        accum = variables.Variable(y)
+        variables.global_variables_initializer().run()
+        training_ops.sparse_apply_adagrad(
+            var, accum, lr, grad, indices, use_row_locking=True).eval()
+        self.assertAllClose(expected_accum, accum.eval())
+        self.assertAllClose(expected_var, var.eval())
+
+  def testConcurrentSparseApplyAdagradRowLocking(self):
+    with self.test_session(use_gpu=False) as sess:
+      var = variables.Variable(np.zeros([16, 8]))
+      accum = variables.Variable(np.ones([16, 8]))
+      variables.global_variables_initializer().run()
+      indices = np.tile(np.arange(16, dtype=np.int64), 100)
+      grad = np.ones([1600, 8])
+      updates = [
+          training_ops.sparse_apply_adagrad(
+              var, accum, 0.1, grad, indices, use_row_locking=True)
+          for _ in range(8)
+      ]
+      sess.run(updates)
+      # No update of the accumulators is lost.
+      self.assertAllEqual(np.full([16, 8], 1.0 + 8 * 100), accum.eval())
+
+  def testSparseApplyFtrlRowLocking(self):
+    x = np.random.rand(32, 4)
+    y = np.random.rand(32, 4) + 1.0
+    z = np.random.randn(32, 4)
+    indices = np.random.permutation(32)[:20].astype(np.int32)
+    grad = np.random.randn(20, 4)
+    results = []
+    for use_row_locking in [False, True]:
+      with self.test_session(use_gpu=False):
+        var = variables.Variable(x)
+        accum = variables.Variable(y)
+        linear = variables.Variable(z)
+        variables.global_variables_initializer().run()
+        training_ops.sparse_apply_ftrl(
+            var, accum, linear, grad, indices, 0.1, 0.01, 0.02, -0.5,
+            use_row_locking=use_row_locking).eval()
+        results.append([var.eval(), accum.eval(), linear.eval()])
+    for serial, parallel in zip(*results):
+      self.assertAllClose(serial, parallel)
+
   def testApplyAdam(self):
     for dtype, use_gpu in itertools.product(
         [np.float16, np.float32, np.float64], [False, True]):